@@ -0,0 +1,10 @@
+#include <stdint.h>
+
+#include "hart.h"
+
+uint32_t hart_current_id(void) {
+  uint64_t id;
+
+  __asm__ volatile("mv %0, tp" : "=r"(id));
+  return (uint32_t)id;
+}
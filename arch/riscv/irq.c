@@ -0,0 +1,20 @@
+#include <stdint.h>
+
+#include "riscv_irq.h"
+
+enum {
+  SSTATUS_SIE = 1ULL << 1,
+};
+
+uint64_t riscv_irq_save(void) {
+  uint64_t previous;
+
+  __asm__ volatile("csrrc %0, sstatus, %1" : "=r"(previous) : "r"(SSTATUS_SIE) : "memory");
+  return previous & SSTATUS_SIE;
+}
+
+void riscv_irq_restore(uint64_t state) {
+  if (state != 0ULL) {
+    __asm__ volatile("csrs sstatus, %0" : : "r"(SSTATUS_SIE) : "memory");
+  }
+}
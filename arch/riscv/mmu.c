@@ -0,0 +1,11 @@
+#include <stdint.h>
+
+#include "mmu.h"
+
+void mmu_set_satp(uint64_t satp) {
+  __asm__ volatile("sfence.vma zero, zero" ::: "memory");
+  __asm__ volatile("csrw satp, %0" : : "r"(satp) : "memory");
+  __asm__ volatile("sfence.vma zero, zero" ::: "memory");
+}
+
+void mmu_flush_tlb(void) { __asm__ volatile("sfence.vma zero, zero" ::: "memory"); }
@@ -0,0 +1,42 @@
+#include <stdint.h>
+
+#include "sbi.h"
+
+enum {
+  SBI_EXT_IPI_EID = 0x735049UL,
+  SBI_EXT_IPI_SEND_FID = 0x00UL,
+  SBI_EXT_HSM_EID = 0x48534dUL,
+  SBI_EXT_HSM_HART_START_FID = 0x00UL,
+  SBI_EXT_HSM_HART_GET_STATUS_FID = 0x02UL,
+};
+
+sbi_ret_t sbi_call(uint64_t eid, uint64_t fid, uint64_t arg0, uint64_t arg1, uint64_t arg2) {
+  register long a0 __asm__("a0") = (long)arg0;
+  register long a1 __asm__("a1") = (long)arg1;
+  register long a2 __asm__("a2") = (long)arg2;
+  register long a6 __asm__("a6") = (long)fid;
+  register long a7 __asm__("a7") = (long)eid;
+  sbi_ret_t ret;
+
+  __asm__ volatile("ecall"
+                   : "+r"(a0), "+r"(a1)
+                   : "r"(a2), "r"(a6), "r"(a7)
+                   : "memory");
+
+  ret.error = a0;
+  ret.value = a1;
+  return ret;
+}
+
+sbi_ret_t sbi_hart_start(uint64_t hart_id, uintptr_t start_addr, uint64_t opaque) {
+  return sbi_call(SBI_EXT_HSM_EID, SBI_EXT_HSM_HART_START_FID, hart_id, (uint64_t)start_addr,
+                  opaque);
+}
+
+sbi_ret_t sbi_hart_get_status(uint64_t hart_id) {
+  return sbi_call(SBI_EXT_HSM_EID, SBI_EXT_HSM_HART_GET_STATUS_FID, hart_id, 0ULL, 0ULL);
+}
+
+sbi_ret_t sbi_send_ipi(uint64_t hart_mask, uint64_t hart_mask_base) {
+  return sbi_call(SBI_EXT_IPI_EID, SBI_EXT_IPI_SEND_FID, hart_mask, hart_mask_base, 0ULL);
+}
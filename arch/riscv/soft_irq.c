@@ -0,0 +1,25 @@
+#include <stdint.h>
+
+#include "riscv_soft_irq.h"
+#include "sbi.h"
+
+enum {
+  SIE_SSIE = 1ULL << 1,
+  SIP_SSIP = 1ULL << 1,
+};
+
+void riscv_soft_irq_enable(void) {
+  __asm__ volatile("csrs sie, %0" : : "r"(SIE_SSIE));
+}
+
+void riscv_soft_irq_raise(void) {
+  __asm__ volatile("csrs sip, %0" : : "r"(SIP_SSIP) : "memory");
+}
+
+void riscv_soft_irq_clear(void) {
+  __asm__ volatile("csrc sip, %0" : : "r"(SIP_SSIP));
+}
+
+void riscv_soft_irq_send(uint32_t hart_id) {
+  (void)sbi_send_ipi(1ULL << hart_id, 0ULL);
+}
@@ -0,0 +1,89 @@
+#include <stdint.h>
+
+#include "hart.h"
+#include "plic.h"
+#include "trace.h"
+#include "trap.h"
+
+enum {
+  PLIC_BASE = PLIC_MMIO_BASE,
+  PLIC_PRIORITY = 0x000000u,
+  PLIC_ENABLE = 0x002000u,
+  PLIC_ENABLE_STRIDE = 0x80u,
+  PLIC_CONTEXT = 0x200000u,
+  PLIC_CONTEXT_STRIDE = 0x1000u,
+  PLIC_THRESHOLD = 0x0u,
+  PLIC_CLAIM = 0x4u,
+  /* QEMU virt gives each hart an M-mode context followed by an S-mode one. */
+  PLIC_CONTEXTS_PER_HART = 2u,
+  PLIC_SUPERVISOR_CONTEXT = 1u,
+};
+
+enum {
+  SIE_SEIE = 1ULL << 9,
+};
+
+static plic_handler_t g_plic_handlers[PLIC_MAX_IRQS];
+static uint64_t g_plic_counts[PLIC_MAX_IRQS];
+
+static inline volatile uint32_t *plic_reg(uint32_t offset) {
+  return (volatile uint32_t *)(uintptr_t)(PLIC_BASE + offset);
+}
+
+static uint32_t plic_context(void) {
+  return hart_current_id() * PLIC_CONTEXTS_PER_HART + PLIC_SUPERVISOR_CONTEXT;
+}
+
+static struct trap_frame *plic_handle_interrupt(struct trap_frame *frame) {
+  uint32_t context = plic_context();
+  volatile uint32_t *claim = plic_reg(PLIC_CONTEXT + context * PLIC_CONTEXT_STRIDE + PLIC_CLAIM);
+  uint32_t irq;
+
+  /* Drain every pending source before returning; a zero claim means none is left. */
+  while ((irq = *claim) != 0u) {
+    trace_event(TRACE_TRAP_ENTER, frame->mcause, irq, 0u);
+    if (irq < PLIC_MAX_IRQS) {
+      plic_handler_t handler = __atomic_load_n(&g_plic_handlers[irq], __ATOMIC_ACQUIRE);
+
+      __atomic_fetch_add(&g_plic_counts[irq], 1u, __ATOMIC_RELAXED);
+      if (handler != (plic_handler_t)0) {
+        handler(irq);
+      }
+    }
+    *claim = irq;
+    trace_event(TRACE_TRAP_EXIT, 0u, 0u, 0u);
+  }
+
+  return frame;
+}
+
+void plic_init(void) {
+  uint32_t context = plic_context();
+
+  *plic_reg(PLIC_CONTEXT + context * PLIC_CONTEXT_STRIDE + PLIC_THRESHOLD) = 0u;
+  (void)trap_register_irq(TRAP_IRQ_EXTERNAL, plic_handle_interrupt);
+  __asm__ volatile("csrs sie, %0" : : "r"(SIE_SEIE));
+}
+
+int plic_register(uint32_t irq, plic_handler_t handler) {
+  uint32_t context = plic_context();
+  volatile uint32_t *enable;
+
+  if (irq == 0u || irq >= PLIC_MAX_IRQS) {
+    return -1;
+  }
+
+  __atomic_store_n(&g_plic_handlers[irq], handler, __ATOMIC_RELEASE);
+  *plic_reg(PLIC_PRIORITY + irq * 4u) = 1u;
+  enable = plic_reg(PLIC_ENABLE + context * PLIC_ENABLE_STRIDE + (irq / 32u) * 4u);
+  *enable |= 1u << (irq % 32u);
+  return 0;
+}
+
+uint64_t plic_irq_count(uint32_t irq) {
+  if (irq >= PLIC_MAX_IRQS) {
+    return 0u;
+  }
+
+  return __atomic_load_n(&g_plic_counts[irq], __ATOMIC_RELAXED);
+}
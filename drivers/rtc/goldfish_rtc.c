@@ -0,0 +1,22 @@
+#include <stdint.h>
+
+#include "rtc.h"
+
+enum {
+  RTC_BASE = RTC_MMIO_BASE,
+  RTC_TIME_LOW = 0x00,
+  RTC_TIME_HIGH = 0x04,
+};
+
+static inline uint32_t rtc_reg_read(uint32_t offset) {
+  volatile uint32_t *reg = (volatile uint32_t *)(uintptr_t)(RTC_BASE + offset);
+  return *reg;
+}
+
+uint64_t rtc_read_ns(void) {
+  /* Reading TIME_LOW latches TIME_HIGH, so the low word must come first. */
+  uint64_t low = rtc_reg_read(RTC_TIME_LOW);
+  uint64_t high = rtc_reg_read(RTC_TIME_HIGH);
+
+  return (high << 32) | low;
+}
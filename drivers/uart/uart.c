@@ -1,9 +1,14 @@
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "clock.h"
+#include "riscv_irq.h"
+#include "riscv_timer.h"
+#include "spinlock.h"
 #include "uart.h"
 
 enum {
-  UART_BASE = 0x10000000u,
+  UART_BASE = UART_MMIO_BASE,
   UART_RBR = 0x00,
   UART_THR = 0x00,
   UART_IER = 0x01,
@@ -17,6 +22,39 @@ enum {
   LSR_TX_EMPTY = 1u << 5,
 };
 
+enum {
+  IER_RX_AVAILABLE = 1u << 0,
+  IER_TX_EMPTY = 1u << 1,
+};
+
+enum {
+  /* THRE means the whole 16550 FIFO is empty, so one interrupt can refill all of it. */
+  UART_TX_FIFO_DEPTH = 16u,
+  UART_TX_RING_SIZE = 4096u,
+  UART_RX_RING_SIZE = 256u,
+};
+
+_Static_assert((UART_TX_RING_SIZE & (UART_TX_RING_SIZE - 1u)) == 0u, "tx ring power of two");
+_Static_assert((UART_RX_RING_SIZE & (UART_RX_RING_SIZE - 1u)) == 0u, "rx ring power of two");
+
+/* Free-running indices; the ring holds head - tail bytes. */
+typedef struct uart_ring_state {
+  spinlock_t lock;
+  bool interrupt_mode;
+  uint8_t ier;
+  uint32_t tx_head;
+  uint32_t tx_tail;
+  uint32_t rx_head;
+  uint32_t rx_tail;
+  uint64_t tx_active_since;
+  uint8_t tx_ring[UART_TX_RING_SIZE];
+  uint8_t rx_ring[UART_RX_RING_SIZE];
+} uart_ring_state_t;
+
+static uart_ring_state_t g_uart;
+static uart_stats_t g_uart_stats;
+static void (*g_uart_rx_notify)(void);
+
 static inline void uart_reg_write(uint32_t offset, uint8_t value) {
   volatile uint8_t *reg = (volatile uint8_t *)(uintptr_t)(UART_BASE + offset);
   *reg = value;
@@ -27,7 +65,57 @@ static inline uint8_t uart_reg_read(uint32_t offset) {
   return *reg;
 }
 
+static void uart_set_ier(uint8_t ier) {
+  g_uart.ier = ier;
+  uart_reg_write(UART_IER, ier);
+}
+
+static void uart_write_polled(uint8_t byte) {
+  while ((uart_reg_read(UART_LSR) & LSR_TX_EMPTY) == 0u) {
+  }
+  uart_reg_write(UART_THR, byte);
+}
+
+static void uart_tx_idle(void) {
+  g_uart_stats.tx_active_ns += clock_now_ns() - g_uart.tx_active_since;
+  uart_set_ier((uint8_t)(g_uart.ier & ~IER_TX_EMPTY));
+}
+
+/* Called with the lock held. Polls the ring empty, for a full ring or a masked writer. */
+static void uart_tx_drain_polled(void) {
+  if (g_uart.tx_head == g_uart.tx_tail) {
+    return;
+  }
+
+  while (g_uart.tx_head != g_uart.tx_tail) {
+    uart_write_polled(g_uart.tx_ring[g_uart.tx_tail & (UART_TX_RING_SIZE - 1u)]);
+    g_uart.tx_tail++;
+  }
+  uart_tx_idle();
+}
+
+/* Called with the lock held; moves what the receiver holds into the RX ring. */
+static uint32_t uart_rx_fill(void) {
+  uint32_t received = 0u;
+
+  while ((uart_reg_read(UART_LSR) & LSR_DATA_READY) != 0u) {
+    uint8_t byte = uart_reg_read(UART_RBR);
+
+    if (g_uart.rx_head - g_uart.rx_tail == UART_RX_RING_SIZE) {
+      g_uart_stats.rx_dropped++;
+      continue;
+    }
+    g_uart.rx_ring[g_uart.rx_head & (UART_RX_RING_SIZE - 1u)] = byte;
+    g_uart.rx_head++;
+    g_uart_stats.rx_bytes++;
+    received++;
+  }
+
+  return received;
+}
+
 void uart_init(void) {
+  spinlock_init(&g_uart.lock, (lock_stats_t *)0);
   uart_reg_write(UART_IER, 0x00);
   uart_reg_write(UART_LCR, 0x80);
   uart_reg_write(UART_RBR, 0x03);
@@ -37,13 +125,45 @@ void uart_init(void) {
 }
 
 bool uart_can_read(void) {
+  if (__atomic_load_n(&g_uart.rx_head, __ATOMIC_ACQUIRE) !=
+      __atomic_load_n(&g_uart.rx_tail, __ATOMIC_RELAXED)) {
+    return true;
+  }
+
   return (uart_reg_read(UART_LSR) & LSR_DATA_READY) != 0u;
 }
 
 void uart_write_byte(uint8_t byte) {
-  while ((uart_reg_read(UART_LSR) & LSR_TX_EMPTY) == 0u) {
+  uint64_t start = riscv_cycle_now();
+  uint64_t irq_state = spin_lock_irqsave(&g_uart.lock);
+
+  if (!g_uart.interrupt_mode) {
+    uint64_t active_since = clock_now_ns();
+
+    uart_write_polled(byte);
+    g_uart_stats.tx_active_ns += clock_now_ns() - active_since;
+  } else if (irq_state == 0u) {
+    /* Keep ordering: anything still queued goes out first. */
+    uart_tx_drain_polled();
+    uart_write_polled(byte);
+  } else {
+    if (g_uart.tx_head - g_uart.tx_tail == UART_TX_RING_SIZE) {
+      g_uart_stats.tx_full_waits++;
+      uart_tx_drain_polled();
+    }
+    if (g_uart.tx_head == g_uart.tx_tail) {
+      g_uart.tx_active_since = clock_now_ns();
+    }
+    g_uart.tx_ring[g_uart.tx_head & (UART_TX_RING_SIZE - 1u)] = byte;
+    g_uart.tx_head++;
+    /* Enabling THRE while the FIFO is empty raises the interrupt straight away. */
+    if ((g_uart.ier & IER_TX_EMPTY) == 0u) {
+      uart_set_ier((uint8_t)(g_uart.ier | IER_TX_EMPTY));
+    }
   }
-  uart_reg_write(UART_THR, byte);
+  g_uart_stats.tx_bytes++;
+  g_uart_stats.write_cycles += riscv_cycle_now() - start;
+  spin_unlock_irqrestore(&g_uart.lock, irq_state);
 }
 
 void uart_write(const char *s) {
@@ -53,18 +173,28 @@ void uart_write(const char *s) {
 }
 
 int uart_read_byte_nonblocking(void) {
-  if (!uart_can_read()) {
-    return -1;
-  }
+  uint64_t irq_state = spin_lock_irqsave(&g_uart.lock);
+  int byte = -1;
 
-  return (int)uart_reg_read(UART_RBR);
+  /* Polled mode, or input that arrived while the interrupt was masked. */
+  if (g_uart.rx_head == g_uart.rx_tail) {
+    (void)uart_rx_fill();
+  }
+  if (g_uart.rx_head != g_uart.rx_tail) {
+    byte = (int)g_uart.rx_ring[g_uart.rx_tail & (UART_RX_RING_SIZE - 1u)];
+    __atomic_store_n(&g_uart.rx_tail, g_uart.rx_tail + 1u, __ATOMIC_RELEASE);
+  }
+  spin_unlock_irqrestore(&g_uart.lock, irq_state);
+  return byte;
 }
 
 uint8_t uart_read_byte_blocking(void) {
-  while (!uart_can_read()) {
+  int byte;
+
+  while ((byte = uart_read_byte_nonblocking()) < 0) {
   }
 
-  return uart_reg_read(UART_RBR);
+  return (uint8_t)byte;
 }
 
 void uart_putc(char c) {
@@ -74,3 +204,73 @@ void uart_putc(char c) {
 void uart_puts(const char *s) {
   uart_write(s);
 }
+
+void uart_handle_interrupt(uint32_t irq) {
+  uint64_t start = riscv_cycle_now();
+  uint32_t received;
+  uint32_t sent = 0u;
+  void (*notify)(void);
+
+  (void)irq;
+  spin_lock(&g_uart.lock);
+  g_uart_stats.interrupts++;
+  received = uart_rx_fill();
+  if ((uart_reg_read(UART_LSR) & LSR_TX_EMPTY) != 0u) {
+    while (sent < UART_TX_FIFO_DEPTH && g_uart.tx_head != g_uart.tx_tail) {
+      uart_reg_write(UART_THR, g_uart.tx_ring[g_uart.tx_tail & (UART_TX_RING_SIZE - 1u)]);
+      g_uart.tx_tail++;
+      sent++;
+    }
+    if (g_uart.tx_head == g_uart.tx_tail && (g_uart.ier & IER_TX_EMPTY) != 0u) {
+      uart_tx_idle();
+    }
+  }
+  g_uart_stats.irq_cycles += riscv_cycle_now() - start;
+  notify = g_uart_rx_notify;
+  spin_unlock(&g_uart.lock);
+
+  if (received != 0u && notify != (void (*)(void))0) {
+    notify();
+  }
+}
+
+void uart_set_interrupt_mode(bool enabled) {
+  uint64_t irq_state = spin_lock_irqsave(&g_uart.lock);
+
+  uart_tx_drain_polled();
+  g_uart.interrupt_mode = enabled;
+  uart_set_ier(enabled ? (uint8_t)IER_RX_AVAILABLE : 0u);
+  spin_unlock_irqrestore(&g_uart.lock, irq_state);
+}
+
+bool uart_interrupt_mode(void) {
+  return __atomic_load_n(&g_uart.interrupt_mode, __ATOMIC_RELAXED);
+}
+
+void uart_set_rx_notify(void (*notify)(void)) {
+  g_uart_rx_notify = notify;
+}
+
+void uart_stats(uart_stats_t *out) {
+  uint64_t irq_state = spin_lock_irqsave(&g_uart.lock);
+
+  *out = g_uart_stats;
+  spin_unlock_irqrestore(&g_uart.lock, irq_state);
+}
+
+void uart_stats_reset(void) {
+  uint64_t irq_state = spin_lock_irqsave(&g_uart.lock);
+
+  g_uart_stats.tx_bytes = 0u;
+  g_uart_stats.rx_bytes = 0u;
+  g_uart_stats.rx_dropped = 0u;
+  g_uart_stats.interrupts = 0u;
+  g_uart_stats.tx_full_waits = 0u;
+  g_uart_stats.write_cycles = 0u;
+  g_uart_stats.irq_cycles = 0u;
+  g_uart_stats.tx_active_ns = 0u;
+  if (g_uart.tx_head != g_uart.tx_tail) {
+    g_uart.tx_active_since = clock_now_ns();
+  }
+  spin_unlock_irqrestore(&g_uart.lock, irq_state);
+}
@@ -4,6 +4,7 @@
 #include <string.h>
 
 #include "fs.h"
+#include "perf.h"
 
 #define FS_DIR_ENTRY_SIZE 64u
 #define FS_SUPERBLOCK_SIZE 64u
@@ -588,6 +589,7 @@ int fs_seek(fs_handle_t *fs, int fd, uint32_t offset) {
 }
 
 int fs_read(fs_handle_t *fs, int fd, void *buf, size_t len, size_t *bytes_read) {
+  PERF_SCOPE("fs_read");
   fs_open_file_t *open_file;
   fs_dir_entry_disk_t *entry;
   uint8_t block_buf[FS_BLOCK_SIZE];
@@ -650,6 +652,7 @@ int fs_read(fs_handle_t *fs, int fd, void *buf, size_t len, size_t *bytes_read)
 }
 
 int fs_write(fs_handle_t *fs, int fd, const void *buf, size_t len, size_t *bytes_written) {
+  PERF_SCOPE("fs_write");
   fs_open_file_t *open_file;
   fs_dir_entry_disk_t *entry;
   uint8_t block_buf[FS_BLOCK_SIZE];
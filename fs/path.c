@@ -1,6 +1,7 @@
 #include <stddef.h>
 
 #include "fs_path.h"
+#include "perf.h"
 
 typedef struct {
   size_t offset;
@@ -52,6 +53,7 @@ static int segment_is_dotdot(const char *segment, size_t len) {
 }
 
 int fs_path_normalize(const char *path, char *out, size_t out_len) {
+  PERF_SCOPE("fs_path_normalize");
   path_segment_t segments[FS_PATH_MAX / 2u];
   char segment_pool[FS_PATH_MAX];
   size_t seg_count = 0u;
@@ -0,0 +1,23 @@
+#ifndef BITOPS_H
+#define BITOPS_H
+
+#include <stdint.h>
+
+/*
+ * rv64imac has no Zbb count instructions and the kernel links without libgcc, so
+ * count-trailing-zeros uses a de Bruijn multiply instead of __builtin_ctzll.
+ * The result is undefined for value == 0.
+ */
+static inline unsigned int bitops_ctz64(uint64_t value) {
+  static const uint8_t k_debruijn_index[64] = {
+      0,  1,  48, 2,  57, 49, 28, 3,  61, 58, 50, 42, 38, 29, 17, 4,
+      62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+      63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+      46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9,  13, 8,  7,  6,
+  };
+  uint64_t lowest = value & (~value + 1ull);
+
+  return k_debruijn_index[(lowest * 0x03f79d71b4cb0a89ull) >> 58];
+}
+
+#endif
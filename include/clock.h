@@ -1,10 +1,60 @@
 #ifndef CLOCK_H
 #define CLOCK_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+typedef struct clock_hart_stats {
+  bool running;
+  /* The periodic tick is stopped because the hart has nothing to switch to. */
+  bool tickless;
+  uint64_t interrupts;
+  /* Interrupts taken while tickless: idle backstops and requested events. */
+  uint64_t idle_interrupts;
+  /* Timer value when the hart's clock started. */
+  uint64_t started_at;
+} clock_hart_stats_t;
+
 void clock_init(void);
+/* Starts the periodic tick on a secondary hart; the boot hart uses clock_init(). */
+void clock_init_secondary(void);
 void clock_handle_timer_interrupt(void);
+/*
+ * Re-evaluates the calling hart's deadline after a scheduling decision. It only touches
+ * the SBI timer when the hart moves between periodic slices and tickless idle.
+ */
+void clock_reprogram(void);
+/*
+ * With tickless on, a hart whose run queue is idle (sched_hart_idle()) programs its
+ * timer for the earliest requested event instead of the next slice. Off after clock_init().
+ */
+void clock_set_tickless(bool enabled);
+bool clock_tickless_enabled(void);
+/* Asks for a timer interrupt on the calling hart no later than `deadline`. */
+void clock_request_event(uint64_t deadline);
+/*
+ * Sets the `time` CSR frequency (the DTB timebase-frequency) and precomputes the tick to
+ * nanosecond mult/shift and the slice length. Call it before clock_init(); 0 restores
+ * the 10 MHz default.
+ */
+void clock_set_timebase(uint64_t hz);
+uint64_t clock_timebase_hz(void);
+/* Timer ticks per scheduler slice (100 ms). */
+uint64_t clock_slice_ticks(void);
+/*
+ * Monotonic nanoseconds since the timer started counting; a multiply and shift, no
+ * division. The base for latency measurements.
+ */
+uint64_t clock_now_ns(void);
+uint64_t clock_ticks_to_ns(uint64_t ticks);
+/* Divides; meant for turning intervals into deadlines, not for hot paths. */
+uint64_t clock_ns_to_ticks(uint64_t ns);
+/* Wall time is clock_now_ns() plus an offset fixed by clock_set_wall_ns(). */
+void clock_set_wall_ns(uint64_t wall_ns);
+uint64_t clock_wall_ns(void);
+/* Ticks taken by the calling hart. */
 uint64_t clock_ticks(void);
+uint64_t clock_hart_ticks(uint32_t hart_id);
+int clock_hart_stats(uint32_t hart_id, clock_hart_stats_t *out);
 
 #endif
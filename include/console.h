@@ -7,6 +7,9 @@ void console_init(void);
 void console_putc(char c);
 void console_write(const char *s);
 int console_getc_nonblocking(void);
+/* Sleeps between polls when called from a task; root contexts run idle work instead. */
 uint8_t console_getc_blocking(void);
+/* Wakes readers sleeping in console_getc_blocking() once input has arrived. */
+void console_rx_notify(void);
 
 #endif
@@ -0,0 +1,28 @@
+#ifndef FDT_H
+#define FDT_H
+
+#include <stdint.h>
+
+enum {
+  FDT_MAX_MEMORY_REGIONS = 8,
+  FDT_MAX_RESERVED_REGIONS = 16,
+};
+
+typedef struct fdt_region {
+  uint64_t base;
+  uint64_t size;
+} fdt_region_t;
+
+typedef struct fdt_platform_info {
+  uint32_t total_size;
+  uint32_t memory_count;
+  uint32_t reserved_count;
+  fdt_region_t memory[FDT_MAX_MEMORY_REGIONS];
+  fdt_region_t reserved[FDT_MAX_RESERVED_REGIONS];
+  uint64_t timebase_frequency;
+} fdt_platform_info_t;
+
+/* Returns 0 on success, -1 if the blob is missing, malformed, or an unsupported version. */
+int fdt_parse(const void *blob, fdt_platform_info_t *out);
+
+#endif
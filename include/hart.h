@@ -0,0 +1,13 @@
+#ifndef HART_H
+#define HART_H
+
+#include <stdint.h>
+
+enum {
+  HART_MAX_HARTS = 4,
+};
+
+/* Hart id handed over by SBI in a0 at entry; _start keeps it in tp. */
+uint32_t hart_current_id(void);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <stdbool.h>
+
+/* Returns false once there is no deferred work left, so callers may halt instead. */
+bool idle_run_once(void);
+
+#endif
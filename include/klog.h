@@ -0,0 +1,82 @@
+#ifndef KLOG_H
+#define KLOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Kernel log. Each hart appends fixed-size records to its own ring with one atomic
+ * fetch-add and no lock, so logging from a trap handler costs a record copy instead of
+ * a serial write. Records carry a timestamp and a level. Until klogd starts, every record
+ * is also flushed straight to the console; afterwards the flusher task drains the rings
+ * in time order and `dmesg` reads them back.
+ */
+enum {
+  KLOG_RING_RECORDS = 64u,
+  KLOG_TEXT_MAX = 96u,
+  KLOG_RECORD_SIZE = 128u,
+};
+
+typedef enum klog_level {
+  KLOG_ERR = 3,
+  KLOG_WARN = 4,
+  KLOG_INFO = 6,
+  KLOG_DEBUG = 7,
+} klog_level_t;
+
+typedef struct klog_record {
+  /* Ring index + 1 once the record is complete; 0 while it is being written. */
+  uint64_t seq;
+  uint64_t time_ns;
+  uint64_t start_cycles;
+  uint8_t level;
+  uint8_t hart;
+  uint16_t len;
+  /* The writer's interrupt state, restored by klog_end(). */
+  uint8_t irq_state;
+  char text[KLOG_TEXT_MAX];
+} klog_record_t;
+
+_Static_assert(sizeof(klog_record_t) == KLOG_RECORD_SIZE, "klog record size");
+
+typedef struct klog_hart_stats {
+  uint64_t records;
+  /* Records overwritten before the flusher reached them. */
+  uint64_t dropped;
+  /* Cycles from klog_begin() to klog_end(), summed over records. */
+  uint64_t cycles;
+} klog_hart_stats_t;
+
+/*
+ * Builds one record in place: klog_begin() reserves the slot, the put helpers append
+ * (text past KLOG_TEXT_MAX is cut), klog_end() publishes it. Interrupts stay masked in
+ * between so a preempted writer never holds the flusher back. Lines carry no newline.
+ */
+klog_record_t *klog_begin(klog_level_t level);
+void klog_puts(klog_record_t *record, const char *s);
+void klog_put_u64(klog_record_t *record, uint64_t value);
+void klog_end(klog_record_t *record);
+void klog(klog_level_t level, const char *text);
+
+/* Writes every record not yet flushed to the console, oldest first. */
+void klog_flush(void);
+/* True when some ring holds records the flusher has not written. */
+bool klog_pending(void);
+/* Defers console output to the flusher, which `notify` wakes; see klog_arm_notify(). */
+void klog_set_deferred(bool deferred, void (*notify)(void));
+/*
+ * Asks for one notify() call on the next published record. The flusher arms it before
+ * it sleeps, so only the first record after an idle stretch pays for a wakeup.
+ */
+void klog_arm_notify(void);
+/*
+ * Copies up to `max` complete records from all rings into `out`, oldest first, and
+ * returns how many were copied.
+ */
+uint32_t klog_read(klog_record_t *out, uint32_t max);
+int klog_hart_stats(uint32_t hart_id, klog_hart_stats_t *out);
+
+/* Starts the flusher task; console output from klog is deferred from then on. */
+int klogd_start(void);
+
+#endif
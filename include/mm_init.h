@@ -1,6 +1,14 @@
 #ifndef MM_INIT_H
 #define MM_INIT_H
 
-void mm_init(void);
+#include <stdint.h>
+
+#include "fdt.h"
+
+/*
+ * Hands RAM described by `platform` to the page allocator, skipping the kernel image,
+ * reserved regions, and the DTB at dtb_addr. A null platform falls back to a fixed range.
+ */
+void mm_init(const fdt_platform_info_t *platform, uintptr_t dtb_addr);
 
 #endif
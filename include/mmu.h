@@ -0,0 +1,10 @@
+#ifndef MMU_H
+#define MMU_H
+
+#include <stdint.h>
+
+/* Writes satp and flushes the TLB; satp is built by vm_space_satp(). */
+void mmu_set_satp(uint64_t satp);
+void mmu_flush_tlb(void);
+
+#endif
@@ -7,16 +7,110 @@
 
 enum {
   PAGE_ALLOC_PAGE_SIZE = 4096u,
+  PAGE_ALLOC_MAX_ORDER = 10u,
+  PAGE_ALLOC_BOOTSTRAP_PAGES = 32768u,
+  PAGE_ALLOC_RUN_BUCKETS = 16u,
+  PAGE_ALLOC_TRACE_RING_SIZE = 256u,
+  PAGE_ALLOC_TRACE_SITES = 16u,
 };
 
+typedef enum page_alloc_trace_kind {
+  PAGE_ALLOC_TRACE_ALLOC = 0,
+  PAGE_ALLOC_TRACE_FREE = 1,
+} page_alloc_trace_kind_t;
+
+typedef struct page_alloc_trace_entry {
+  uint64_t timestamp;
+  uintptr_t caller;
+  uint32_t page_index;
+  uint8_t order;
+  uint8_t kind;
+} page_alloc_trace_entry_t;
+
+typedef struct page_alloc_trace_site {
+  uintptr_t caller;
+  uint64_t alloc_calls;
+  uint64_t alloc_pages;
+  uint64_t free_pages;
+} page_alloc_trace_site_t;
+
+/* Bucket b of run_histogram counts free runs of [2^b, 2^(b+1)) pages; the last bucket is open. */
+typedef struct page_alloc_frag_report {
+  size_t free_pages;
+  size_t free_runs;
+  size_t largest_free_run;
+  size_t run_histogram[PAGE_ALLOC_RUN_BUCKETS];
+} page_alloc_frag_report_t;
+
+typedef uint64_t (*page_alloc_clock_fn_t)(void);
+/* Runs under the allocator lock after each buddy allocation (`alloc`) or free. */
+typedef void (*page_alloc_event_fn_t)(bool alloc, uintptr_t addr, unsigned int order,
+                                      uintptr_t caller);
+/* Single-page front end for page_alloc()/page_free(); see page_alloc_set_frontend(). */
+typedef void *(*page_alloc_single_fn_t)(void);
+typedef bool (*page_free_single_fn_t)(void *page);
+
+/*
+ * Upper bound in 64-bit words on the metadata needed for a range of `pages` pages:
+ * four per-page bitmaps, per-order free bitmaps (< 2x a page bitmap), and their
+ * summaries, plus one word of rounding slack per order for each.
+ */
+#define PAGE_ALLOC_METADATA_WORDS(pages)                                        \
+  ((6u * (((pages) + 63u) / 64u)) + ((((2u * (((pages) + 63u) / 64u)) + 63u) / 64u)) + \
+   (4u * (PAGE_ALLOC_MAX_ORDER + 1u)))
+
 void page_alloc_init(uintptr_t range_start, uintptr_t range_end);
+size_t page_alloc_metadata_bytes(size_t pages);
+void page_alloc_init_with_metadata(uintptr_t range_start,
+                                   uintptr_t range_end,
+                                   void *metadata,
+                                   size_t metadata_bytes);
+size_t page_alloc_release_range(uintptr_t range_start, uintptr_t range_end);
+/* Single pages; these go through the front end when one is installed. */
 void *page_alloc(void);
 bool page_free(void *page);
+/* Always the buddy allocator, for any order including 0. */
+void *page_alloc_order(unsigned int order);
+bool page_free_order(void *page, unsigned int order);
 bool page_alloc_owns(const void *page);
+bool page_alloc_is_allocated(const void *page);
+bool page_alloc_block_order(const void *page, unsigned int *order_out);
+/*
+ * Marks an allocated single page as parked in a per-hart cache. Fails if the page is not
+ * an allocated order-0 block or is already marked, which is how a free of the same page on
+ * two harts is caught. A marked page cannot be freed until page_alloc_cache_release().
+ */
+bool page_alloc_cache_claim(const void *page);
+void page_alloc_cache_release(const void *page);
 
 uintptr_t page_alloc_range_start(void);
 uintptr_t page_alloc_range_end(void);
 size_t page_alloc_total_pages(void);
 size_t page_alloc_free_pages(void);
+size_t page_alloc_free_blocks(unsigned int order);
+void page_alloc_fragmentation(page_alloc_frag_report_t *out);
+
+/*
+ * Optional tracing: while enabled, every allocation and free records its caller, page, and
+ * a timestamp from `clock` (0 if null) in a ring, and per-caller page totals are kept for
+ * the first PAGE_ALLOC_TRACE_SITES callers. Enabling clears previous trace state.
+ */
+void page_alloc_trace_enable(page_alloc_clock_fn_t clock);
+void page_alloc_trace_disable(void);
+bool page_alloc_trace_enabled(void);
+uint64_t page_alloc_trace_records(void);
+uint64_t page_alloc_trace_untracked_pages(void);
+/* Copies up to `max` of the most recent entries, oldest first. */
+size_t page_alloc_trace_snapshot(page_alloc_trace_entry_t *out, size_t max);
+/* Copies up to `max` sites ordered by allocated pages, largest first. */
+size_t page_alloc_trace_top_sites(page_alloc_trace_site_t *out, size_t max);
+/* Installs a hook for kernel-wide tracing; null removes it. */
+void page_alloc_set_event_hook(page_alloc_event_fn_t hook);
+/*
+ * Routes page_alloc()/page_free() through `alloc`/`free_fn` (page_cache_init() installs the
+ * per-hart magazines). The front end refills from page_alloc_order(0). Initializing the
+ * allocator removes it, since its cached pages belong to the old range.
+ */
+void page_alloc_set_frontend(page_alloc_single_fn_t alloc, page_free_single_fn_t free_fn);
 
 #endif
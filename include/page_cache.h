@@ -0,0 +1,28 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+  PAGE_CACHE_MAGAZINE_SIZE = 32u,
+  PAGE_CACHE_BATCH = 16u,
+};
+
+typedef struct page_cache_stats {
+  uint64_t alloc_hits;
+  uint64_t free_hits;
+  uint64_t refills;
+  uint64_t drains;
+  uint32_t cached_pages;
+} page_cache_stats_t;
+
+void page_cache_init(void);
+void *page_cache_alloc(void);
+bool page_cache_free(void *page);
+void page_cache_drain_hart(uint32_t hart_id);
+size_t page_cache_cached_pages(void);
+bool page_cache_stats(uint32_t hart_id, page_cache_stats_t *out);
+
+#endif
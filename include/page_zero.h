@@ -0,0 +1,26 @@
+#ifndef PAGE_ZERO_H
+#define PAGE_ZERO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum {
+  PAGE_ZERO_POOL_CAPACITY = 64u,
+};
+
+typedef struct page_zero_stats {
+  uint32_t depth;
+  uint32_t target;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t idle_zeroed;
+} page_zero_stats_t;
+
+void page_zero_init(uint32_t target_depth);
+void *page_alloc_zeroed(void);
+uint32_t page_zero_idle_work(uint32_t max_pages);
+void page_zero_release(void);
+void page_zero_get_stats(page_zero_stats_t *out);
+
+#endif
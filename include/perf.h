@@ -0,0 +1,78 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+
+#include "riscv_timer.h"
+
+/*
+ * Hot-path instrumentation. PERF_SCOPE("name") at the top of a function reads the cycle
+ * and instret counters there and again as the function returns, and folds the difference
+ * into a static per-site record. `perfstat` prints every site that has run. Builds with
+ * PERF_SCOPE_ENABLED=0 (make PERF_SCOPES=0, and every host build) expand the macro to
+ * nothing. Traps taken inside a scope count toward it.
+ */
+#ifndef PERF_SCOPE_ENABLED
+#define PERF_SCOPE_ENABLED 0
+#endif
+
+enum {
+  PERF_HIST_BUCKETS = 32u,
+};
+
+typedef struct perf_site {
+  const char *name;
+  uint64_t count;
+  uint64_t cycles;
+  uint64_t cycles_min;
+  uint64_t cycles_max;
+  uint64_t instret;
+  /* Bucket b counts calls that took [2^b, 2^(b+1)) cycles; the last one is open-ended. */
+  uint64_t hist[PERF_HIST_BUCKETS];
+  uint32_t registered;
+  struct perf_site *next;
+} perf_site_t;
+
+typedef struct perf_scope {
+  perf_site_t *site;
+  uint64_t cycles;
+  uint64_t instret;
+} perf_scope_t;
+
+void perf_site_register(perf_site_t *site);
+/* Runs as the scope's cleanup when the enclosing function returns. */
+void perf_scope_end(perf_scope_t *scope);
+
+static inline perf_scope_t perf_scope_begin(perf_site_t *site) {
+  perf_scope_t scope;
+
+  if (__atomic_load_n(&site->registered, __ATOMIC_ACQUIRE) == 0u) {
+    perf_site_register(site);
+  }
+  scope.site = site;
+  scope.instret = riscv_instret_now();
+  scope.cycles = riscv_cycle_now();
+  return scope;
+}
+
+#define PERF_CONCAT_INNER(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_INNER(a, b)
+
+#if PERF_SCOPE_ENABLED
+#define PERF_SCOPE(site_name)                                                           \
+  static perf_site_t PERF_CONCAT(perf_site_, __LINE__) = {.name = (site_name),          \
+                                                          .cycles_min = ~0ULL};         \
+  perf_scope_t PERF_CONCAT(perf_scope_, __LINE__) __attribute__((cleanup(perf_scope_end))) = \
+      perf_scope_begin(&PERF_CONCAT(perf_site_, __LINE__))
+#else
+#define PERF_SCOPE(site_name) ((void)0)
+#endif
+
+/* Sites in registration order; the list only grows. */
+const perf_site_t *perf_site_first(void);
+/* Upper bound, in cycles, of the histogram bucket holding the `pct`th percentile call. */
+uint64_t perf_site_percentile(const perf_site_t *site, uint32_t pct);
+/* Zeroes every site; calls in flight during a reset may land on either side of it. */
+void perf_reset(void);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef PLIC_H
+#define PLIC_H
+
+#include <stdint.h>
+
+/* Platform-level interrupt controller on the QEMU virt machine. */
+enum {
+  PLIC_MMIO_BASE = 0x0c000000u,
+  PLIC_MMIO_SIZE = 0x600000u,
+  PLIC_MAX_IRQS = 64u,
+};
+
+/* Wired interrupt sources. */
+enum {
+  PLIC_IRQ_UART0 = 10u,
+};
+
+typedef void (*plic_handler_t)(uint32_t irq);
+
+/*
+ * Takes the supervisor external interrupt on the calling hart and accepts every
+ * priority there. Sources stay masked until plic_register() enables them.
+ */
+void plic_init(void);
+/* Routes `irq` to the calling hart and calls `handler` for each claim of it. */
+int plic_register(uint32_t irq, plic_handler_t handler);
+uint64_t plic_irq_count(uint32_t irq);
+
+#endif
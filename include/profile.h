@@ -0,0 +1,53 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Sampling profiler. While running, every timer interrupt records the interrupted pc,
+ * the return address register and the current task in the hart's sample buffer. A full
+ * buffer counts further samples as dropped, so a run keeps its first window intact.
+ * `profile dump` prints the samples for scripts/profile_symbolize.py.
+ */
+enum {
+  PROFILE_SAMPLES_PER_HART = 2048u,
+};
+
+typedef struct profile_sample {
+  uint64_t pc;
+  /* The caller for leaf code; for other code it may point back into the same function. */
+  uint64_t ra;
+  uint32_t task;
+  uint32_t reserved;
+} profile_sample_t;
+
+typedef struct profile_hart_stats {
+  uint32_t samples;
+  uint64_t dropped;
+} profile_hart_stats_t;
+
+/* Read by the tick path; written only through profile_start() and profile_stop(). */
+extern bool g_profile_running;
+
+void profile_record(uint64_t pc, uint64_t ra);
+
+/* Called from the timer interrupt with interrupts masked. */
+static inline void profile_tick(uint64_t pc, uint64_t ra) {
+  if (__atomic_load_n(&g_profile_running, __ATOMIC_RELAXED)) {
+    profile_record(pc, ra);
+  }
+}
+
+/* Discards the previous run's samples. */
+void profile_start(void);
+void profile_stop(void);
+bool profile_running(void);
+int profile_hart_stats(uint32_t hart_id, profile_hart_stats_t *out);
+/*
+ * Writes a header, the task names and the samples through `write`, one "PROFILE:" line
+ * each. Consecutive identical samples on a hart share a line with a repeat count.
+ */
+void profile_dump(void (*write)(const char *s));
+
+#endif
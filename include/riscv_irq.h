@@ -0,0 +1,13 @@
+#ifndef RISCV_IRQ_H
+#define RISCV_IRQ_H
+
+#include <stdint.h>
+
+/*
+ * Local interrupt masking around short critical sections shared with trap handlers.
+ * riscv_irq_save() clears sstatus.SIE and returns the previous state for restore.
+ */
+uint64_t riscv_irq_save(void);
+void riscv_irq_restore(uint64_t state);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef RISCV_SOFT_IRQ_H
+#define RISCV_SOFT_IRQ_H
+
+#include <stdint.h>
+
+/*
+ * Supervisor software interrupt (SSIP). Raising it on the local hart traps straight into
+ * trap_vector once interrupts are enabled, which the scheduler uses for sched_yield().
+ */
+void riscv_soft_irq_enable(void);
+void riscv_soft_irq_raise(void);
+void riscv_soft_irq_clear(void);
+/* Raises SSIP on another hart through the SBI IPI extension. */
+void riscv_soft_irq_send(uint32_t hart_id);
+
+#endif
@@ -4,6 +4,8 @@
 #include <stdint.h>
 
 uint64_t riscv_timer_now(void);
+uint64_t riscv_cycle_now(void);
+uint64_t riscv_instret_now(void);
 uint64_t riscv_timer_read_time(void);
 void riscv_timer_set_deadline(uint64_t deadline);
 void riscv_timer_enable_interrupts(void);
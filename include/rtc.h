@@ -0,0 +1,15 @@
+#ifndef RTC_H
+#define RTC_H
+
+#include <stdint.h>
+
+/* Goldfish RTC on the QEMU virt machine. */
+enum {
+  RTC_MMIO_BASE = 0x00101000u,
+  RTC_MMIO_SIZE = 0x1000u,
+};
+
+/* Nanoseconds since the Unix epoch. */
+uint64_t rtc_read_ns(void);
+
+#endif
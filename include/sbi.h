@@ -0,0 +1,28 @@
+#ifndef SBI_H
+#define SBI_H
+
+#include <stdint.h>
+
+enum {
+  SBI_SUCCESS = 0,
+  SBI_ERR_INVALID_PARAM = -3,
+  SBI_ERR_ALREADY_AVAILABLE = -6,
+  /* sbi_hart_get_status() values. */
+  SBI_HSM_STATE_STARTED = 0,
+  SBI_HSM_STATE_STOPPED = 1,
+  SBI_HSM_STATE_START_PENDING = 2,
+};
+
+typedef struct sbi_ret {
+  long error;
+  long value;
+} sbi_ret_t;
+
+sbi_ret_t sbi_call(uint64_t eid, uint64_t fid, uint64_t arg0, uint64_t arg1, uint64_t arg2);
+/* Starts a stopped hart at `start_addr` with a0 = hart id, a1 = opaque, satp = 0. */
+sbi_ret_t sbi_hart_start(uint64_t hart_id, uintptr_t start_addr, uint64_t opaque);
+sbi_ret_t sbi_hart_get_status(uint64_t hart_id);
+/* Raises SSIP on every hart in hart_mask, which is relative to hart_mask_base. */
+sbi_ret_t sbi_send_ipi(uint64_t hart_mask, uint64_t hart_mask_base);
+
+#endif
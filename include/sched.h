@@ -1,13 +1,157 @@
 #ifndef SCHED_H
 #define SCHED_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#include "task.h"
 #include "trap.h"
 
+/*
+ * Lower numbers run first. A runnable task at a more urgent level always preempts
+ * less urgent work; tasks sharing a level take turns.
+ */
+enum {
+  SCHED_PRIORITY_LEVELS = 32,
+  SCHED_PRIORITY_INTERACTIVE = 4,
+  SCHED_PRIORITY_DEFAULT = TASK_DEFAULT_PRIORITY,
+  SCHED_PRIORITY_BATCH = 24,
+  /* Secondary harts' idle loops. */
+  SCHED_PRIORITY_IDLE = SCHED_PRIORITY_LEVELS - 1,
+};
+
+typedef struct sched_hart_stats {
+  bool online;
+  uint32_t tasks;
+  uint32_t ready;
+  uint64_t switches;
+  /* Tasks this hart took from other queues, and tasks other harts took from it. */
+  uint64_t steals;
+  uint64_t stolen;
+} sched_hart_stats_t;
+
+/* Live view of a task's accounting, including the stint in progress; see task_context_t. */
+typedef struct sched_task_stats {
+  uint32_t id;
+  const char *name;
+  task_state_t state;
+  uint8_t hart;
+  uint8_t priority;
+  uint64_t run_ns;
+  uint64_t wait_ns;
+  uint64_t voluntary_switches;
+  uint64_t involuntary_switches;
+  uint64_t wakeups;
+  uint64_t wakeup_latency_ns;
+  uint64_t wakeup_latency_max_ns;
+  /* Time since sched_add_task(), or since the hart came up for root contexts. */
+  uint64_t age_ns;
+} sched_task_stats_t;
+
+typedef enum sched_event_type {
+  /* `task` left for `other`; `state` is why it left. */
+  SCHED_EVENT_SWITCH = 1,
+  /* `task` was made runnable by hart `other`. */
+  SCHED_EVENT_WAKE = 2,
+  /* `task` was taken from hart `other`'s queue. */
+  SCHED_EVENT_STEAL = 3,
+} sched_event_type_t;
+
+typedef struct sched_event {
+  uint64_t time_ns;
+  uint8_t type;
+  uint8_t state;
+  uint8_t task;
+  uint8_t other;
+} sched_event_t;
+
+enum {
+  /* Recent events kept per hart; older ones are overwritten. */
+  SCHED_EVENT_RING_SIZE = 64,
+};
+
+typedef struct sched_switch_bench {
+  uint32_t yields;
+  uint64_t switches;
+  uint64_t cycles;
+} sched_switch_bench_t;
+
+/* Resets every hart's queue; the calling hart becomes the boot hart running task 0. */
 void sched_init(void);
+/* Called on a secondary hart before it enables interrupts; its idle loop becomes the root. */
+void sched_hart_online(void);
 void sched_bootstrap_test_tasks(void);
-void sched_handle_timer_interrupt(const struct trap_frame *frame);
+/* Lets timer and yield interrupts switch tasks; sched_bootstrap_test_tasks() calls it. */
+void sched_start(void);
+/*
+ * A hart whose queue holds nothing but its root context steals the newest allowed task
+ * from the busiest other queue on its next switch. On by default.
+ */
+void sched_set_stealing(bool enabled);
+/*
+ * Bit h allows hart h. It is a hint used for placement and stealing; a task already
+ * queued stays put until it is stolen.
+ */
+int sched_set_affinity(task_control_block_t *task, uint32_t affinity);
+/*
+ * Queues a freshly created task on the least-loaded online hart and kicks that hart when
+ * the task is more urgent than what it is running.
+ */
+int sched_add_task(task_control_block_t *task);
+/* Moves a task to another level, requeueing it and preempting as needed. */
+int sched_set_priority(task_control_block_t *task, uint32_t priority);
+/*
+ * Trap-side entry points. `frame` is the interrupted context; the return value is the
+ * frame trap_vector restores, which belongs to the next task when a switch happens.
+ */
+struct trap_frame *sched_handle_timer_interrupt(struct trap_frame *frame);
+struct trap_frame *sched_handle_yield(struct trap_frame *frame);
+/*
+ * Called by trap_vector once sp points at the frame a switch returned, i.e. the hart is
+ * off the previous task's stack. Only then may another hart steal or resume that task.
+ */
+void sched_finish_switch(void);
+/*
+ * True when a timer tick would change what runs on the calling hart: the current task
+ * stopped running, a queued task is at least as urgent, or there is work to steal.
+ * Otherwise the tick can return without a full register save.
+ */
+bool sched_tick_needs_switch(void);
+/* Gives up the rest of the slice by raising a supervisor software interrupt. */
+void sched_yield(void);
+/*
+ * Marks the running task blocked but keeps it on the CPU, so a waiter can re-check its
+ * condition before yielding. sched_wake() on the still-running task undoes it.
+ */
+int sched_prepare_block(void);
+/*
+ * Marks the running task blocked and raises a yield, so it leaves the CPU when interrupts
+ * are next enabled. Root contexts cannot block and get -1.
+ */
+int sched_block_current(void);
+/*
+ * Requeues a blocked task on its hart, kicking the hart when the task outranks what runs
+ * there. A task woken before its switch-out simply keeps running.
+ */
+int sched_wake(task_control_block_t *task);
+task_control_block_t *sched_current_task(void);
+/*
+ * True when the calling hart is in its idle loop with nothing queued and, with stealing
+ * on, no other queue has work to take. The clock stops the periodic tick then; placing a
+ * task on the hart always preempts the idle loop, so the kick restarts it.
+ */
+bool sched_hart_idle(void);
+/* Tasks owned by all queues, not counting root contexts. */
 uint32_t sched_runnable_count(void);
+int sched_hart_stats(uint32_t hart_id, sched_hart_stats_t *out);
+int sched_task_stats(const task_control_block_t *task, sched_task_stats_t *out);
+/*
+ * Copies up to `max` of the hart's most recent events, oldest first, and returns how
+ * many were copied. `*total` (when non-null) receives the number ever recorded.
+ */
+uint32_t sched_events_read(uint32_t hart_id, sched_event_t *out, uint32_t max, uint64_t *total);
+uint64_t sched_switch_count(void);
+/* Yields `yields` times from the calling task and reports cycles per completed switch. */
+int sched_bench_switch_cost(uint32_t yields, sched_switch_bench_t *out);
 
 #endif
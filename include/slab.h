@@ -0,0 +1,46 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "spinlock.h"
+
+enum {
+  SLAB_CACHE_LINE_SIZE = 64u,
+  SLAB_MIN_OBJECT_SIZE = 16u,
+  SLAB_MAX_OBJECT_SIZE = 2048u,
+};
+
+struct slab_page;
+
+/* Every operation on a cache holds its irqsave lock; kfree() may run in trap handlers. */
+typedef struct slab_cache {
+  spinlock_t lock;
+  const char *name;
+  uint32_t object_size;
+  uint32_t stride;
+  uint32_t objects_per_slab;
+  struct slab_page *partial;
+  struct slab_page *full;
+  struct slab_page *empty;
+  uint64_t alloc_count;
+  uint64_t free_count;
+  uint32_t slab_count;
+  uint32_t active_objects;
+} slab_cache_t;
+
+bool slab_cache_init(slab_cache_t *cache, const char *name, size_t object_size);
+void *slab_alloc(slab_cache_t *cache);
+bool slab_free(slab_cache_t *cache, void *object);
+void slab_cache_shrink(slab_cache_t *cache);
+
+void kmalloc_init(void);
+void *kmalloc(size_t size);
+void *kzalloc(size_t size);
+bool kfree(void *ptr);
+const slab_cache_t *kmalloc_cache(size_t index);
+size_t kmalloc_cache_count(void);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+
+enum {
+  SMP_STACK_SIZE = 16384,
+};
+
+/*
+ * Starts every stopped hart below HART_MAX_HARTS through SBI HSM and waits for each one
+ * to come online. Needs sched_init() and vm_kernel_init() to have run on the boot hart.
+ * Returns the number of online harts, including the caller.
+ */
+uint32_t smp_start_secondaries(void);
+uint32_t smp_online_count(void);
+uint32_t smp_online_mask(void);
+/* C entry for _secondary_start, running on the hart's own stack with tp = hart id. */
+void smp_secondary_main(uint64_t hart_id);
+
+#endif
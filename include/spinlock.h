@@ -0,0 +1,88 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Busy-wait locks for state shared between harts and with trap handlers. All three kinds
+ * are built on GCC __atomic builtins, which lower to RV64A amoswap/amoadd and lr/sc:
+ *
+ *   spinlock_t  test-and-test-and-set; smallest and fastest uncontended, not fair.
+ *   ticket_lock_t  FIFO hand-off through a next/serving pair; fair, all waiters spin on
+ *                  one word.
+ *   mcs_lock_t  FIFO queue of caller-owned nodes; each waiter spins on its own node.
+ *
+ * The _irqsave variants also mask local interrupts and must be used for any lock a trap
+ * handler can take. Locks are not recursive.
+ */
+
+typedef uint64_t (*lock_clock_fn_t)(void);
+
+/*
+ * Optional per-lock counters. They are only written while the lock is held, so they need
+ * no atomics. Hold times are measured only once lock_stats_set_clock() has a clock.
+ */
+typedef struct lock_stats {
+  const char *name;
+  uint64_t acquisitions;
+  /* Acquisitions that found the lock taken, and the spin iterations they waited. */
+  uint64_t contended;
+  uint64_t spins;
+  uint64_t hold_ns;
+  uint64_t hold_max_ns;
+  uint64_t held_since;
+  struct lock_stats *next;
+} lock_stats_t;
+
+typedef struct spinlock {
+  uint32_t locked;
+  lock_stats_t *stats;
+} spinlock_t;
+
+typedef struct ticket_lock {
+  uint32_t next;
+  uint32_t serving;
+  lock_stats_t *stats;
+} ticket_lock_t;
+
+typedef struct mcs_node {
+  struct mcs_node *next;
+  uint32_t waiting;
+} mcs_node_t;
+
+typedef struct mcs_lock {
+  mcs_node_t *tail;
+  lock_stats_t *stats;
+} mcs_lock_t;
+
+/* `stats` may be null. */
+void spinlock_init(spinlock_t *lock, lock_stats_t *stats);
+void spin_lock(spinlock_t *lock);
+bool spin_trylock(spinlock_t *lock);
+void spin_unlock(spinlock_t *lock);
+uint64_t spin_lock_irqsave(spinlock_t *lock);
+void spin_unlock_irqrestore(spinlock_t *lock, uint64_t irq_state);
+
+void ticket_lock_init(ticket_lock_t *lock, lock_stats_t *stats);
+void ticket_lock(ticket_lock_t *lock);
+bool ticket_trylock(ticket_lock_t *lock);
+void ticket_unlock(ticket_lock_t *lock);
+uint64_t ticket_lock_irqsave(ticket_lock_t *lock);
+void ticket_unlock_irqrestore(ticket_lock_t *lock, uint64_t irq_state);
+
+/* `node` belongs to the caller (usually on its stack) until the matching unlock. */
+void mcs_lock_init(mcs_lock_t *lock, lock_stats_t *stats);
+void mcs_lock(mcs_lock_t *lock, mcs_node_t *node);
+bool mcs_trylock(mcs_lock_t *lock, mcs_node_t *node);
+void mcs_unlock(mcs_lock_t *lock, mcs_node_t *node);
+uint64_t mcs_lock_irqsave(mcs_lock_t *lock, mcs_node_t *node);
+void mcs_unlock_irqrestore(mcs_lock_t *lock, mcs_node_t *node, uint64_t irq_state);
+
+/* Clears `stats` and adds it to the list walked by lock_stats_first(); repeat calls reset it. */
+void lock_stats_register(lock_stats_t *stats, const char *name);
+const lock_stats_t *lock_stats_first(void);
+/* Hold times are in the clock's units; the kernel passes clock_now_ns. */
+void lock_stats_set_clock(lock_clock_fn_t clock);
+
+#endif
@@ -1,14 +1,20 @@
 #ifndef TASK_H
 #define TASK_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "timer.h"
 #include "trap.h"
 
 typedef enum task_state {
   TASK_STATE_UNUSED = 0,
   TASK_STATE_RUNNABLE = 1,
   TASK_STATE_RUNNING = 2,
+  TASK_STATE_EXITED = 3,
+  /* Off every run queue until sched_wake(); still owned by its hart. */
+  TASK_STATE_BLOCKED = 4,
 } task_state_t;
 
 struct task_control_block;
@@ -19,6 +25,25 @@ typedef struct task_context {
   uint64_t switches_out;
   uint64_t last_mepc;
   uint64_t last_mcause;
+  /* Register file to resume from; it lives at the top of the task's own stack. */
+  struct trap_frame *frame;
+  /*
+   * CPU accounting in clock_now_ns() time, kept by the scheduler; read it through
+   * sched_task_stats(). Voluntary switches leave blocked or exited, involuntary ones
+   * leave still runnable (preempted, out of slice, or yielding).
+   */
+  uint64_t run_ns;
+  uint64_t wait_ns;
+  uint64_t voluntary_switches;
+  uint64_t involuntary_switches;
+  /* Wakeup-to-run latency after sched_wake(). */
+  uint64_t wakeups;
+  uint64_t wakeup_latency_ns;
+  uint64_t wakeup_latency_max_ns;
+  uint64_t added_at;
+  uint64_t switched_in_at;
+  uint64_t ready_since;
+  bool woken;
 } task_context_t;
 
 typedef struct task_control_block {
@@ -28,16 +53,51 @@ typedef struct task_control_block {
   uint64_t run_count;
   task_context_t context;
   task_entry_fn entry;
+  void *stack_base;
+  /* 0 is the most urgent level; see SCHED_PRIORITY_* in sched.h. */
+  uint8_t priority;
+  /* Next task in the same priority level's ready FIFO. */
+  struct task_control_block *run_next;
+  /* Hart whose run queue owns the task. */
+  uint8_t hart;
+  /*
+   * Set from switch-in until the hart that switched the task out has left its stack
+   * (sched_finish_switch()); other harts must not resume the task while it is set.
+   */
+  bool on_cpu;
+  /* Harts the task prefers, one bit per hart id; see sched_set_affinity(). */
+  uint32_t affinity;
+  /* Armed by task_sleep_until() and by waits with a deadline. */
+  ktimer_t sleep_timer;
+  /* Queue the task is waiting on, and the next waiter on it; see wait.h. */
+  struct wait_queue *wait_queue;
+  struct task_control_block *wait_next;
 } task_control_block_t;
 
 enum {
-  TASK_MAX_TASKS = 8,
+  TASK_MAX_TASKS = 16,
+  /*
+   * Boot context (kernel_main and the shell) runs as task 0 on the boot stack. Secondary
+   * harts get an idle root context with the same id.
+   */
+  TASK_BOOT_ID = 0,
+  TASK_STACK_ORDER = 1,
+  TASK_STACK_SIZE = 4096 << TASK_STACK_ORDER,
+  SSTATUS_SPIE = 1 << 5,
+  SSTATUS_SPP = 1 << 8,
+  TASK_DEFAULT_PRIORITY = 16,
 };
 
 void task_system_init(void);
+task_control_block_t *task_boot(void);
+task_control_block_t *task_hart_root(uint32_t hart_id);
+/* Allocates a stack and an initial frame that enters `entry(task)` on first switch-in. */
 task_control_block_t *task_create(const char *name, task_entry_fn entry);
 task_control_block_t *task_find(uint32_t task_id);
-void task_context_switch_out(task_control_block_t *task, const struct trap_frame *frame);
+/* Frees the stack of an exited task that is no longer running and releases its slot. */
+void task_reap(task_control_block_t *task);
+void task_exit(void);
+void task_context_switch_out(task_control_block_t *task, struct trap_frame *frame);
 void task_context_switch_in(task_control_block_t *task, const struct trap_frame *frame);
 
 #endif
@@ -1,10 +1,60 @@
 #ifndef TIMER_H
 #define TIMER_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
-uint64_t riscv_timer_read_time(void);
-void riscv_timer_set_deadline(uint64_t deadline);
-void riscv_timer_enable_interrupts(void);
+/*
+ * One-shot kernel timers on a per-hart hierarchical timing wheel. Deadlines are absolute
+ * timer values (riscv_timer_now()) rounded up to a jiffy of 1 << TIMER_JIFFY_SHIFT ticks
+ * (about 0.8 ms at 10 MHz), so a timer never fires early. Callbacks run in the timer
+ * interrupt of the hart that armed them, with interrupts off and no locks held.
+ */
+enum {
+  TIMER_JIFFY_SHIFT = 13,
+  TIMER_WHEEL_LEVEL_BITS = 6,
+  TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_LEVEL_BITS,
+  TIMER_WHEEL_LEVELS = 4,
+};
+
+struct ktimer;
+typedef void (*ktimer_fn_t)(struct ktimer *timer, void *arg);
+
+typedef struct ktimer {
+  struct ktimer *next;
+  /* The link that points at this timer, so cancel unlinks in O(1). */
+  struct ktimer **pprev;
+  /* Deadline in jiffies, already rounded up. */
+  uint64_t expires;
+  ktimer_fn_t fn;
+  void *arg;
+  uint8_t hart;
+  uint8_t level;
+  uint8_t slot;
+  bool pending;
+} ktimer_t;
+
+void timer_init(ktimer_t *timer, ktimer_fn_t fn, void *arg);
+/*
+ * Arms `timer` on the calling hart's wheel, re-arming it if it was pending. A deadline
+ * already in the past fires on the next timer interrupt.
+ */
+int timer_add(ktimer_t *timer, uint64_t deadline);
+/* Returns true when the timer was pending and will not fire. */
+bool timer_cancel(ktimer_t *timer);
+bool timer_pending(const ktimer_t *timer);
+/* Timers pending on a hart's wheel. */
+uint32_t timer_hart_count(uint32_t hart_id);
+
+/* Clock-side hooks: reset the calling hart's wheel at `now`, and expire due timers. */
+void timer_hart_init(uint64_t now);
+/* Runs every timer due at `now`; returns the next wheel deadline, or ~0 when empty. */
+uint64_t timer_run(uint64_t now);
+
+/*
+ * Blocks the calling task until the timer reaches `deadline`; it costs nothing while it
+ * waits. Root contexts cannot block and get -1.
+ */
+int task_sleep_until(uint64_t deadline);
 
 #endif
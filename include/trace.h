@@ -0,0 +1,77 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Binary tracepoints: an event id, a timestamp and up to three u64 arguments appended to
+ * the calling hart's ring, with no formatting. A disabled tracepoint costs one load and a
+ * branch. `trace dump` writes the rings as hex lines that scripts/trace_decode.py turns
+ * into Chrome trace JSON.
+ */
+enum {
+  TRACE_RING_EVENTS = 512u,
+  TRACE_MAX_ARGS = 3u,
+  TRACE_EVENT_SIZE = 40u,
+  TRACE_FORMAT_VERSION = 1u,
+};
+
+typedef enum trace_event_id {
+  /* prev task, next task, prev state */
+  TRACE_SCHED_SWITCH = 1,
+  /* task, waking hart */
+  TRACE_SCHED_WAKE = 2,
+  /* task, victim hart */
+  TRACE_SCHED_STEAL = 3,
+  /* scause, PLIC source or 0 */
+  TRACE_TRAP_ENTER = 4,
+  TRACE_TRAP_EXIT = 5,
+  /* address, order, caller */
+  TRACE_PAGE_ALLOC = 6,
+  TRACE_PAGE_FREE = 7,
+  /* windows; the end carries the frame marker */
+  TRACE_WM_RENDER_BEGIN = 8,
+  TRACE_WM_RENDER_END = 9,
+  /* the end carries the exit code */
+  TRACE_SHELL_EXEC_BEGIN = 10,
+  TRACE_SHELL_EXEC_END = 11,
+  TRACE_EVENT_COUNT = 12,
+} trace_event_id_t;
+
+typedef struct trace_event {
+  uint64_t time_ns;
+  uint16_t id;
+  uint8_t hart;
+  uint8_t reserved[5];
+  uint64_t args[TRACE_MAX_ARGS];
+} trace_event_t;
+
+_Static_assert(sizeof(trace_event_t) == TRACE_EVENT_SIZE, "trace event size");
+
+/* Read by every tracepoint; written only through trace_set_enabled(). */
+extern bool g_trace_enabled;
+
+void trace_record(trace_event_id_t id, uint64_t arg0, uint64_t arg1, uint64_t arg2);
+
+static inline void trace_event(trace_event_id_t id, uint64_t arg0, uint64_t arg1,
+                               uint64_t arg2) {
+  if (__atomic_load_n(&g_trace_enabled, __ATOMIC_RELAXED)) {
+    trace_record(id, arg0, arg1, arg2);
+  }
+}
+
+/* Enabling also hooks the page allocator, which has no tracepoints of its own. */
+void trace_set_enabled(bool enabled);
+bool trace_enabled(void);
+void trace_clear(void);
+/* Events held across all rings, and events overwritten before a dump. */
+uint64_t trace_event_count(void);
+uint64_t trace_lost_count(void);
+/*
+ * Writes the header, the event name table and every held event through `write`, one
+ * "TRACE:" line each. Tracing pauses for the dump and resumes afterwards.
+ */
+void trace_dump(void (*write)(const char *s));
+
+#endif
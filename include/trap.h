@@ -39,8 +39,26 @@
 #define TRAP_FRAME_RESERVED 280
 #define TRAP_FRAME_SIZE 288
 
+/* scause of a supervisor timer interrupt, the only trap taken on the fast path. */
+#define TRAP_SCAUSE_SUPERVISOR_TIMER 0x8000000000000005
+
+/* Interrupt codes with their own vectored stvec slot, and the handler table size. */
+#define TRAP_IRQ_SOFTWARE 1
+#define TRAP_IRQ_TIMER 5
+#define TRAP_IRQ_EXTERNAL 9
+#define TRAP_IRQ_COUNT 16
+
+/* Layout of trap_cycle_stats_t; trap.S indexes one 32-byte entry per hart by tp. */
+#define TRAP_STATS_FAST_COUNT 0
+#define TRAP_STATS_FAST_CYCLES 8
+#define TRAP_STATS_FULL_COUNT 16
+#define TRAP_STATS_FULL_CYCLES 24
+#define TRAP_STATS_SHIFT 5
+#define TRAP_STATS_HART_MASK 3
+
 #ifndef __ASSEMBLER__
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -89,9 +107,51 @@ _Static_assert(offsetof(struct trap_frame, mepc) == TRAP_FRAME_MEPC, "trap frame
 _Static_assert(offsetof(struct trap_frame, mcause) == TRAP_FRAME_MCAUSE, "trap frame mcause");
 _Static_assert(sizeof(struct trap_frame) == TRAP_FRAME_SIZE, "trap frame size");
 
+/*
+ * Entry-to-sret cycles per hart. "fast" counts timer ticks that kept the current task and
+ * only saved caller-saved registers; "full" counts every other trap.
+ */
+typedef struct trap_cycle_stats {
+  uint64_t fast_count;
+  uint64_t fast_cycles;
+  uint64_t full_count;
+  uint64_t full_cycles;
+} trap_cycle_stats_t;
+
+_Static_assert(offsetof(trap_cycle_stats_t, fast_cycles) == TRAP_STATS_FAST_CYCLES,
+               "trap stats fast cycles");
+_Static_assert(offsetof(trap_cycle_stats_t, full_count) == TRAP_STATS_FULL_COUNT,
+               "trap stats full count");
+_Static_assert(sizeof(trap_cycle_stats_t) == 1u << TRAP_STATS_SHIFT, "trap stats size");
+
+/*
+ * Interrupt handler for one scause code. It gets the fully saved frame and returns the
+ * frame to resume, which differs from `frame` when it switched tasks.
+ */
+typedef struct trap_frame *(*trap_irq_handler_t)(struct trap_frame *frame);
+
+/*
+ * Uses vectored stvec where the hart supports it, so timer, software and external
+ * interrupts enter through their own stubs and skip the scause decode. Falls back to
+ * direct mode otherwise.
+ */
 void trap_init(void);
+/* Installs the handler for interrupt `code`; replaces the default timer and yield ones. */
+int trap_register_irq(uint32_t code, trap_irq_handler_t handler);
+bool trap_vectored(void);
 void trap_test_trigger(void);
-void trap_handle(struct trap_frame *frame);
+struct trap_frame *trap_handle(struct trap_frame *frame);
+/*
+ * Timer fast path called from trap.S with only caller-saved registers and ra stored in
+ * `frame`. Runs the tick and returns true when the scheduler wants a switch, in which
+ * case trap.S saves the rest of the frame and calls trap_timer_switch().
+ */
+bool trap_timer_fast(struct trap_frame *frame);
+struct trap_frame *trap_timer_switch(struct trap_frame *frame);
+/* On by default; off sends every timer tick through the full save for comparison. */
+void trap_set_fast_path(bool enabled);
+bool trap_fast_path_enabled(void);
+int trap_cycle_stats(uint32_t hart_id, trap_cycle_stats_t *out);
 
 #endif
 
@@ -4,6 +4,28 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+enum {
+  UART_MMIO_BASE = 0x10000000u,
+  UART_MMIO_SIZE = 0x1000u,
+};
+
+/*
+ * Counters for comparing polled and interrupt-driven output. CPU time is what writers
+ * spend in uart_write_byte() plus what the interrupt handler spends; tx_active_ns is how
+ * long the transmitter had bytes to send.
+ */
+typedef struct uart_stats {
+  uint64_t tx_bytes;
+  uint64_t rx_bytes;
+  uint64_t rx_dropped;
+  uint64_t interrupts;
+  /* Writes that found the TX ring full and drained it by polling. */
+  uint64_t tx_full_waits;
+  uint64_t write_cycles;
+  uint64_t irq_cycles;
+  uint64_t tx_active_ns;
+} uart_stats_t;
+
 void uart_init(void);
 void uart_write_byte(uint8_t byte);
 void uart_write(const char *s);
@@ -13,4 +35,18 @@ bool uart_can_read(void);
 void uart_putc(char c);
 void uart_puts(const char *s);
 
+/*
+ * Interrupt mode queues output in a TX ring drained on THRE interrupts and fills an RX
+ * ring from the receive interrupt. Writers with interrupts masked still poll, after the
+ * ring, so trap and panic output is never stranded. Switching modes drains the TX ring.
+ */
+void uart_set_interrupt_mode(bool enabled);
+bool uart_interrupt_mode(void);
+/* PLIC handler for the UART source. */
+void uart_handle_interrupt(uint32_t irq);
+/* Called after the RX interrupt queued input; console readers sleep on it. */
+void uart_set_rx_notify(void (*notify)(void));
+void uart_stats(uart_stats_t *out);
+void uart_stats_reset(void);
+
 #endif
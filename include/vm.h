@@ -0,0 +1,58 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint64_t vm_pte_t;
+
+enum {
+  VM_PTE_V = 1u << 0,
+  VM_PTE_R = 1u << 1,
+  VM_PTE_W = 1u << 2,
+  VM_PTE_X = 1u << 3,
+  VM_PTE_U = 1u << 4,
+  VM_PTE_G = 1u << 5,
+  VM_PTE_A = 1u << 6,
+  VM_PTE_D = 1u << 7,
+};
+
+/* Leaf levels: level 0 maps 4 KiB pages, level 1 2 MiB megapages, level 2 1 GiB gigapages. */
+enum {
+  VM_LEVEL_4K = 0u,
+  VM_LEVEL_2M = 1u,
+  VM_LEVEL_1G = 2u,
+  VM_LEVELS = 3u,
+  VM_PTES_PER_TABLE = 512u,
+};
+
+typedef struct vm_space {
+  vm_pte_t *root;
+  size_t table_pages;
+  size_t leaf_count[VM_LEVELS];
+} vm_space_t;
+
+/* Sv39 virtual addresses handled here: the lower half, [0, 2^38). */
+#define VM_VA_LIMIT (1ull << 38)
+
+static inline uint64_t vm_level_size(unsigned int level) {
+  return 4096ull << (9u * level);
+}
+
+int vm_space_init(vm_space_t *space);
+/*
+ * Maps [va, va + size) to [pa, pa + size) with `perms` (R/W/X/U/G). Each step uses the
+ * largest leaf up to max_level that both addresses are aligned to and that fits in what
+ * remains. Returns -1 on misalignment, overlap with an existing mapping, or when a
+ * table page cannot be allocated; mappings made before the failure are kept.
+ */
+int vm_map(vm_space_t *space, uintptr_t va, uintptr_t pa, size_t size, uint64_t perms,
+           unsigned int max_level);
+/* Clears whole leaves in [va, va + size) and flushes the TLB; table pages are kept. */
+int vm_unmap(vm_space_t *space, uintptr_t va, size_t size);
+bool vm_translate(const vm_space_t *space, uintptr_t va, uintptr_t *pa_out,
+                  unsigned int *level_out);
+uint64_t vm_space_satp(const vm_space_t *space);
+
+#endif
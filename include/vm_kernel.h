@@ -0,0 +1,27 @@
+#ifndef VM_KERNEL_H
+#define VM_KERNEL_H
+
+#include <stdint.h>
+
+#include "vm.h"
+
+typedef struct vm_tlb_bench_result {
+  uint32_t pages;
+  uint32_t passes;
+  uint64_t small_ns;
+  uint64_t huge_ns;
+} vm_tlb_bench_result_t;
+
+/*
+ * Builds the kernel identity map (image, page-allocator span, MMIO) with the largest
+ * leaves alignment allows and turns on Sv39. Must run after mm_init().
+ */
+int vm_kernel_init(void);
+const vm_space_t *vm_kernel_space(void);
+/*
+ * Reads one word from every page of a RAM window mapped twice, once with 4 KiB pages
+ * and once with 2 MiB megapages, and reports nanoseconds for each pass set.
+ */
+int vm_kernel_tlb_bench(uint32_t passes, vm_tlb_bench_result_t *out);
+
+#endif
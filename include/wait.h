@@ -0,0 +1,95 @@
+#ifndef WAIT_H
+#define WAIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "idle.h"
+#include "riscv_timer.h"
+#include "sched.h"
+#include "spinlock.h"
+#include "task.h"
+
+/*
+ * Blocking waits for tasks. A waiter queues itself and is marked TASK_STATE_BLOCKED, so
+ * it sits on no run queue and costs nothing until wake_up() or its timeout requeues it.
+ * Wakers may be interrupt handlers. Root contexts cannot block; they fall back to
+ * idle_run_once() between checks, as before.
+ */
+typedef struct wait_queue {
+  spinlock_t lock;
+  /* FIFO of waiting tasks linked through wait_next. */
+  task_control_block_t *head;
+  task_control_block_t *tail;
+} wait_queue_t;
+
+/* Deadline for waits without a timeout. */
+#define WAIT_FOREVER (~0ULL)
+
+void wait_queue_init(wait_queue_t *wq);
+/*
+ * Queues the calling task and marks it blocked without yielding, so the caller can check
+ * its condition once more before sched_yield(). A deadline other than WAIT_FOREVER arms
+ * the task's timer to end the wait. Returns false for root contexts.
+ */
+bool wait_prepare(wait_queue_t *wq, uint64_t deadline);
+/* Leaves the queue after a wake, a timeout or a condition that already held. */
+void wait_finish(wait_queue_t *wq);
+/* Wakes the oldest waiter, or every waiter; returns how many were woken. */
+uint32_t wake_up(wait_queue_t *wq);
+uint32_t wake_up_all(wait_queue_t *wq);
+bool wait_queue_empty(const wait_queue_t *wq);
+
+/*
+ * Sleeps until `cond` holds. `cond` is evaluated until it first succeeds and never
+ * again, so a claim with side effects (sem_trydown()) is fine.
+ */
+#define wait_event(wq, cond) wait_event_until((wq), (cond), WAIT_FOREVER)
+
+/* As wait_event(), but also returns once the timer passes `deadline`; re-check `cond`. */
+#define wait_event_until(wq, cond, deadline)           \
+  do {                                                 \
+    while (!(cond)) {                                  \
+      if (!wait_prepare((wq), (deadline))) {           \
+        idle_run_once();                               \
+      } else if (cond) {                               \
+        wait_finish(wq);                               \
+        break;                                         \
+      } else {                                         \
+        sched_yield();                                 \
+        wait_finish(wq);                               \
+      }                                                \
+      if ((deadline) != WAIT_FOREVER &&                \
+          riscv_timer_now() >= (uint64_t)(deadline)) { \
+        break;                                         \
+      }                                                \
+    }                                                  \
+  } while (0)
+
+/* Counting semaphore; sem_down() sleeps while the count is zero. */
+typedef struct semaphore {
+  spinlock_t lock;
+  uint32_t count;
+  wait_queue_t waiters;
+} semaphore_t;
+
+void sem_init(semaphore_t *sem, uint32_t count);
+void sem_down(semaphore_t *sem);
+bool sem_trydown(semaphore_t *sem);
+void sem_up(semaphore_t *sem);
+
+/*
+ * Condition variable paired with a spinlock held without irqsave. condvar_wait() drops
+ * the lock while it sleeps and retakes it before returning. Wakeups can be spurious, so
+ * callers wait in a loop on their predicate.
+ */
+typedef struct condvar {
+  wait_queue_t waiters;
+} condvar_t;
+
+void condvar_init(condvar_t *cv);
+void condvar_wait(condvar_t *cv, spinlock_t *lock);
+void condvar_signal(condvar_t *cv);
+void condvar_broadcast(condvar_t *cv);
+
+#endif
@@ -1,49 +1,267 @@
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "clock.h"
-#include "console.h"
+#include "hart.h"
+#include "klog.h"
+#include "riscv_irq.h"
 #include "riscv_timer.h"
+#include "sched.h"
+#include "timer.h"
 
 enum {
-  CLOCK_INTERVAL_TICKS = 1000000ULL,
+  CLOCK_NSEC_PER_SEC = 1000000000ULL,
+  CLOCK_SLICE_NS = 100000000ULL,
+  /* Longest an idle hart sleeps with no event pending, in slices; a backstop, not a tick. */
+  CLOCK_IDLE_MAX_SLICES = 64ULL,
+  /* QEMU virt; kernel_main replaces it with the DTB value. */
+  CLOCK_DEFAULT_TIMEBASE_HZ = 10000000ULL,
+  /* mult must fit in 32 bits so the low half of a tick count times mult cannot overflow. */
+  CLOCK_MULT_MAX = 0xffffffffULL,
+  CLOCK_SHIFT_MAX = 32U,
   CLOCK_LOG_LIMIT = 4U,
 };
 
-static volatile uint64_t g_tick_count;
-static uint64_t g_next_deadline;
+static const uint64_t k_clock_no_event = ~0ULL;
+
+/* Every hart programs its own SBI timer, so tick state is kept per hart. */
+typedef struct clock_hart_state {
+  volatile uint64_t tick_count;
+  uint64_t idle_ticks;
+  /* Next periodic slice boundary. */
+  uint64_t next_deadline;
+  /* The value last handed to the SBI timer. */
+  uint64_t armed_deadline;
+  uint64_t next_event;
+  uint64_t started_at;
+  bool running;
+  bool tickless;
+} clock_hart_state_t;
+
+static clock_hart_state_t g_clock_harts[HART_MAX_HARTS];
 static uint32_t g_tick_log_count;
+static uint64_t g_timebase_hz = CLOCK_DEFAULT_TIMEBASE_HZ;
+/* ns = ticks * mult >> shift, precomputed for the timebase; defaults match 10 MHz. */
+static uint64_t g_ns_mult = 3355443200ULL;
+static uint32_t g_ns_shift = 25U;
+static uint64_t g_slice_ticks = 1000000ULL;
+static uint64_t g_wall_offset_ns;
+static bool g_tickless_enabled;
 
-static void clock_program_deadline(void) {
-  uint64_t now = riscv_timer_read_time();
+static clock_hart_state_t *clock_this_hart(void) {
+  return &g_clock_harts[hart_current_id() % HART_MAX_HARTS];
+}
+
+static void clock_arm(clock_hart_state_t *state, uint64_t deadline) {
+  state->armed_deadline = deadline;
+  riscv_timer_set_deadline(deadline);
+}
+
+static void clock_program_deadline(clock_hart_state_t *state, uint64_t now) {
+  uint64_t deadline;
+
+  if (g_tickless_enabled && sched_hart_idle()) {
+    /* Already parked on a deadline that is ahead and not past the next event. */
+    if (state->tickless && state->armed_deadline > now &&
+        state->armed_deadline <= state->next_event) {
+      return;
+    }
+
+    deadline = now + (CLOCK_IDLE_MAX_SLICES * g_slice_ticks);
+    if (state->next_event < deadline) {
+      deadline = state->next_event;
+    }
+    state->tickless = true;
+    clock_arm(state, deadline);
+    return;
+  }
 
-  if (g_next_deadline <= now) {
-    uint64_t missed = ((now - g_next_deadline) / CLOCK_INTERVAL_TICKS) + 1ULL;
-    g_next_deadline += missed * CLOCK_INTERVAL_TICKS;
+  if (state->tickless) {
+    /* Work showed up while parked: slices restart from now. */
+    state->tickless = false;
+    state->next_deadline = now + g_slice_ticks;
+  } else if (state->next_deadline <= now) {
+    uint64_t missed = ((now - state->next_deadline) / g_slice_ticks) + 1ULL;
+    state->next_deadline += missed * g_slice_ticks;
   }
 
-  riscv_timer_set_deadline(g_next_deadline);
+  deadline = state->next_deadline;
+  if (state->next_event < deadline) {
+    deadline = state->next_event;
+  }
+  if (deadline != state->armed_deadline) {
+    clock_arm(state, deadline);
+  }
+}
+
+static void clock_start_hart(void) {
+  clock_hart_state_t *state = clock_this_hart();
+
+  state->tick_count = 0ULL;
+  state->idle_ticks = 0ULL;
+  state->started_at = riscv_timer_read_time();
+  state->next_deadline = state->started_at + g_slice_ticks;
+  state->next_event = k_clock_no_event;
+  state->tickless = false;
+  state->running = true;
+  timer_hart_init(state->started_at);
+
+  clock_arm(state, state->next_deadline);
+  riscv_timer_enable_interrupts();
 }
 
 void clock_init(void) {
-  g_tick_count = 0ULL;
   g_tick_log_count = 0U;
-  g_next_deadline = riscv_timer_read_time() + CLOCK_INTERVAL_TICKS;
+  g_tickless_enabled = false;
+  clock_start_hart();
+}
 
-  riscv_timer_set_deadline(g_next_deadline);
-  riscv_timer_enable_interrupts();
+void clock_init_secondary(void) {
+  clock_start_hart();
 }
 
 void clock_handle_timer_interrupt(void) {
-  g_tick_count++;
-  g_next_deadline += CLOCK_INTERVAL_TICKS;
-  clock_program_deadline();
+  clock_hart_state_t *state = clock_this_hart();
+  uint64_t now = riscv_timer_read_time();
+  uint64_t next_timer;
+
+  state->tick_count++;
+  if (state->tickless) {
+    state->idle_ticks++;
+  } else if (state->armed_deadline == state->next_deadline) {
+    /* A requested event firing between slices does not end the slice. */
+    state->next_deadline += g_slice_ticks;
+  }
+  if (state->next_event <= now) {
+    state->next_event = k_clock_no_event;
+  }
+  next_timer = timer_run(now);
+  if (next_timer < state->next_event) {
+    state->next_event = next_timer;
+  }
+  clock_program_deadline(state, now);
 
   if (g_tick_log_count < CLOCK_LOG_LIMIT) {
-    console_write("TICK: periodic interrupt\n");
+    klog(KLOG_DEBUG, "TICK: periodic interrupt");
     g_tick_log_count++;
   }
 }
 
+void clock_reprogram(void) {
+  clock_hart_state_t *state = clock_this_hart();
+
+  if (!state->running) {
+    return;
+  }
+
+  clock_program_deadline(state, riscv_timer_read_time());
+}
+
+void clock_set_tickless(bool enabled) {
+  g_tickless_enabled = enabled;
+}
+
+bool clock_tickless_enabled(void) {
+  return g_tickless_enabled;
+}
+
+void clock_request_event(uint64_t deadline) {
+  clock_hart_state_t *state = clock_this_hart();
+  uint64_t irq_state = riscv_irq_save();
+
+  if (deadline < state->next_event) {
+    state->next_event = deadline;
+    if (state->running && deadline < state->armed_deadline) {
+      clock_arm(state, deadline);
+    }
+  }
+
+  riscv_irq_restore(irq_state);
+}
+
+void clock_set_timebase(uint64_t hz) {
+  uint32_t shift = CLOCK_SHIFT_MAX;
+  uint64_t mult;
+
+  if (hz == 0ULL) {
+    hz = CLOCK_DEFAULT_TIMEBASE_HZ;
+  }
+
+  /* Largest shift whose rounded mult still fits; the division happens once, here. */
+  for (;;) {
+    mult = (((uint64_t)CLOCK_NSEC_PER_SEC << shift) + (hz / 2ULL)) / hz;
+    if (mult <= CLOCK_MULT_MAX || shift == 0U) {
+      break;
+    }
+    shift--;
+  }
+
+  g_timebase_hz = hz;
+  g_ns_mult = mult;
+  g_ns_shift = shift;
+  g_slice_ticks = clock_ns_to_ticks(CLOCK_SLICE_NS);
+  if (g_slice_ticks == 0ULL) {
+    g_slice_ticks = 1ULL;
+  }
+}
+
+uint64_t clock_timebase_hz(void) {
+  return g_timebase_hz;
+}
+
+uint64_t clock_ticks_to_ns(uint64_t ticks) {
+  uint64_t high = ticks >> 32;
+  uint64_t low = ticks & 0xffffffffULL;
+
+  /* Split so neither product overflows; shift <= 32 keeps the high half exact. */
+  return ((high * g_ns_mult) << (32U - g_ns_shift)) + ((low * g_ns_mult) >> g_ns_shift);
+}
+
+uint64_t clock_ns_to_ticks(uint64_t ns) {
+  return ((ns / CLOCK_NSEC_PER_SEC) * g_timebase_hz) +
+         (((ns % CLOCK_NSEC_PER_SEC) * g_timebase_hz) / CLOCK_NSEC_PER_SEC);
+}
+
+uint64_t clock_now_ns(void) {
+  return clock_ticks_to_ns(riscv_timer_now());
+}
+
+void clock_set_wall_ns(uint64_t wall_ns) {
+  g_wall_offset_ns = wall_ns - clock_now_ns();
+}
+
+uint64_t clock_wall_ns(void) {
+  return clock_now_ns() + g_wall_offset_ns;
+}
+
+uint64_t clock_slice_ticks(void) {
+  return g_slice_ticks;
+}
+
 uint64_t clock_ticks(void) {
-  return g_tick_count;
+  return clock_this_hart()->tick_count;
+}
+
+uint64_t clock_hart_ticks(uint32_t hart_id) {
+  if (hart_id >= HART_MAX_HARTS) {
+    return 0ULL;
+  }
+
+  return g_clock_harts[hart_id].tick_count;
+}
+
+int clock_hart_stats(uint32_t hart_id, clock_hart_stats_t *out) {
+  const clock_hart_state_t *state;
+
+  if (hart_id >= HART_MAX_HARTS || out == (clock_hart_stats_t *)0) {
+    return -1;
+  }
+
+  state = &g_clock_harts[hart_id];
+  out->running = state->running;
+  out->tickless = state->tickless;
+  out->interrupts = state->tick_count;
+  out->idle_interrupts = state->idle_ticks;
+  out->started_at = state->started_at;
+  return 0;
 }
@@ -1,10 +1,49 @@
 #include <stdint.h>
 
+#include "clock.h"
 #include "console.h"
+#include "idle.h"
+#include "riscv_irq.h"
+#include "riscv_timer.h"
+#include "sched.h"
+#include "task.h"
 #include "uart.h"
+#include "wait.h"
+
+enum {
+  /* Sleeping readers re-poll this often while the UART runs without interrupts. */
+  CONSOLE_RX_POLL_NS = 10000000ULL,
+};
+
+static wait_queue_t g_console_rx_wait;
+
+static bool console_in_root(void) {
+  const task_control_block_t *task = sched_current_task();
+
+  return task == (const task_control_block_t *)0 || task->id == TASK_BOOT_ID;
+}
+
+/*
+ * Root contexts cannot sleep, but with the RX interrupt they can halt until it fires.
+ * The check runs masked so a byte landing in between still ends the wfi.
+ */
+static void console_root_wait_rx(void) {
+  uint64_t irq_state;
+
+  if (idle_run_once()) {
+    return;
+  }
+  irq_state = riscv_irq_save();
+  if (!uart_can_read()) {
+    __asm__ volatile("wfi");
+  }
+  riscv_irq_restore(irq_state);
+}
 
 void console_init(void) {
+  wait_queue_init(&g_console_rx_wait);
   uart_init();
+  uart_set_rx_notify(console_rx_notify);
 }
 
 void console_putc(char c) {
@@ -25,5 +64,25 @@ int console_getc_nonblocking(void) {
 }
 
 uint8_t console_getc_blocking(void) {
-  return uart_read_byte_blocking();
+  int byte = -1;
+
+  while (byte < 0) {
+    uint64_t deadline = riscv_timer_now() + clock_ns_to_ticks(CONSOLE_RX_POLL_NS);
+
+    if (!uart_interrupt_mode()) {
+      wait_event_until(&g_console_rx_wait, (byte = uart_read_byte_nonblocking()) >= 0, deadline);
+    } else if (console_in_root()) {
+      if ((byte = uart_read_byte_nonblocking()) < 0) {
+        console_root_wait_rx();
+      }
+    } else {
+      wait_event(&g_console_rx_wait, (byte = uart_read_byte_nonblocking()) >= 0);
+    }
+  }
+
+  return (uint8_t)byte;
+}
+
+void console_rx_notify(void) {
+  (void)wake_up_all(&g_console_rx_wait);
 }
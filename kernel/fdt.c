@@ -0,0 +1,265 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fdt.h"
+
+/*
+ * Minimal flattened device tree reader. It extracts only what early boot
+ * needs: /memory banks, the memory reservation block plus /reserved-memory
+ * children, and timebase-frequency from /cpus (or its first cpu node).
+ */
+
+enum {
+  FDT_MAGIC = 0xd00dfeedu,
+  FDT_HEADER_SIZE = 40u,
+  FDT_MIN_VERSION = 16u,
+  FDT_BEGIN_NODE = 1u,
+  FDT_END_NODE = 2u,
+  FDT_PROP = 3u,
+  FDT_NOP = 4u,
+  FDT_END = 9u,
+  FDT_MAX_DEPTH = 8u,
+  FDT_DEFAULT_ADDRESS_CELLS = 2u,
+  FDT_DEFAULT_SIZE_CELLS = 1u,
+};
+
+typedef struct fdt_node_state {
+  const char *name;
+  uint32_t address_cells;
+  uint32_t size_cells;
+  bool is_memory;
+  const uint8_t *reg;
+  uint32_t reg_len;
+} fdt_node_state_t;
+
+static uint32_t fdt_be32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static uint64_t fdt_be64(const uint8_t *p) {
+  return ((uint64_t)fdt_be32(p) << 32) | (uint64_t)fdt_be32(p + 4);
+}
+
+static bool fdt_str_eq(const char *a, const char *b) {
+  while (*a != '\0' && *a == *b) {
+    ++a;
+    ++b;
+  }
+
+  return *a == *b;
+}
+
+/* Matches "name" and "name@unit-address". */
+static bool fdt_node_name_is(const char *node_name, const char *base) {
+  while (*base != '\0') {
+    if (*node_name != *base) {
+      return false;
+    }
+    ++node_name;
+    ++base;
+  }
+
+  return *node_name == '\0' || *node_name == '@';
+}
+
+static uint64_t fdt_read_cells(const uint8_t *p, uint32_t cells) {
+  if (cells == 1u) {
+    return fdt_be32(p);
+  }
+  if (cells == 2u) {
+    return fdt_be64(p);
+  }
+  return 0u;
+}
+
+static void fdt_add_region(fdt_region_t *regions, uint32_t *count, uint32_t capacity,
+                           uint64_t base, uint64_t size) {
+  if (size == 0u || *count >= capacity) {
+    return;
+  }
+
+  regions[*count].base = base;
+  regions[*count].size = size;
+  *count += 1u;
+}
+
+static void fdt_add_reg_regions(const fdt_node_state_t *parent, const fdt_node_state_t *node,
+                                fdt_region_t *regions, uint32_t *count, uint32_t capacity) {
+  uint32_t entry_len = (parent->address_cells + parent->size_cells) * 4u;
+  uint32_t offset;
+
+  if (node->reg == (const uint8_t *)0 || entry_len == 0u || parent->address_cells > 2u ||
+      parent->size_cells > 2u) {
+    return;
+  }
+
+  for (offset = 0u; offset + entry_len <= node->reg_len; offset += entry_len) {
+    uint64_t base = fdt_read_cells(node->reg + offset, parent->address_cells);
+    uint64_t size =
+        fdt_read_cells(node->reg + offset + (parent->address_cells * 4u), parent->size_cells);
+
+    fdt_add_region(regions, count, capacity, base, size);
+  }
+}
+
+static void fdt_parse_reservation_block(const uint8_t *blob, uint32_t offset, uint32_t total,
+                                        fdt_platform_info_t *out) {
+  while (offset + 16u <= total) {
+    uint64_t base = fdt_be64(blob + offset);
+    uint64_t size = fdt_be64(blob + offset + 8u);
+
+    if (base == 0u && size == 0u) {
+      return;
+    }
+
+    fdt_add_region(out->reserved, &out->reserved_count, FDT_MAX_RESERVED_REGIONS, base, size);
+    offset += 16u;
+  }
+}
+
+static void fdt_reset_info(fdt_platform_info_t *out) {
+  uint32_t i;
+
+  out->total_size = 0u;
+  out->memory_count = 0u;
+  out->reserved_count = 0u;
+  out->timebase_frequency = 0u;
+  for (i = 0u; i < FDT_MAX_MEMORY_REGIONS; ++i) {
+    out->memory[i].base = 0u;
+    out->memory[i].size = 0u;
+  }
+  for (i = 0u; i < FDT_MAX_RESERVED_REGIONS; ++i) {
+    out->reserved[i].base = 0u;
+    out->reserved[i].size = 0u;
+  }
+}
+
+int fdt_parse(const void *blob, fdt_platform_info_t *out) {
+  const uint8_t *base = (const uint8_t *)blob;
+  fdt_node_state_t stack[FDT_MAX_DEPTH + 1u];
+  uint32_t total;
+  uint32_t struct_off;
+  uint32_t struct_size;
+  uint32_t strings_off;
+  uint32_t strings_size;
+  uint32_t pos;
+  uint32_t end;
+  uint32_t depth = 0u;
+
+  if (base == (const uint8_t *)0 || out == (fdt_platform_info_t *)0) {
+    return -1;
+  }
+
+  fdt_reset_info(out);
+  if (fdt_be32(base) != FDT_MAGIC) {
+    return -1;
+  }
+
+  total = fdt_be32(base + 4);
+  struct_off = fdt_be32(base + 8);
+  strings_off = fdt_be32(base + 12);
+  strings_size = fdt_be32(base + 32);
+  struct_size = fdt_be32(base + 36);
+  if (total < FDT_HEADER_SIZE || fdt_be32(base + 20) < FDT_MIN_VERSION ||
+      struct_off > total || struct_size > total - struct_off || strings_off > total ||
+      strings_size > total - strings_off) {
+    return -1;
+  }
+
+  out->total_size = total;
+  fdt_parse_reservation_block(base, fdt_be32(base + 16), total, out);
+
+  stack[0].name = "";
+  stack[0].address_cells = FDT_DEFAULT_ADDRESS_CELLS;
+  stack[0].size_cells = FDT_DEFAULT_SIZE_CELLS;
+  stack[0].is_memory = false;
+  stack[0].reg = (const uint8_t *)0;
+  stack[0].reg_len = 0u;
+
+  pos = struct_off;
+  end = struct_off + struct_size;
+  while (pos + 4u <= end) {
+    uint32_t token = fdt_be32(base + pos);
+
+    pos += 4u;
+    if (token == FDT_BEGIN_NODE) {
+      const char *name = (const char *)(base + pos);
+      uint32_t name_len = 0u;
+
+      while (pos + name_len < end && base[pos + name_len] != '\0') {
+        name_len++;
+      }
+      if (pos + name_len >= end || depth >= FDT_MAX_DEPTH) {
+        return -1;
+      }
+      pos = (pos + name_len + 4u) & ~3u;
+
+      depth++;
+      stack[depth].name = name;
+      stack[depth].address_cells = FDT_DEFAULT_ADDRESS_CELLS;
+      stack[depth].size_cells = FDT_DEFAULT_SIZE_CELLS;
+      stack[depth].is_memory = depth == 2u && fdt_node_name_is(name, "memory");
+      stack[depth].reg = (const uint8_t *)0;
+      stack[depth].reg_len = 0u;
+    } else if (token == FDT_END_NODE) {
+      if (depth == 0u) {
+        return -1;
+      }
+
+      if (stack[depth].is_memory) {
+        fdt_add_reg_regions(&stack[depth - 1u], &stack[depth], out->memory, &out->memory_count,
+                            FDT_MAX_MEMORY_REGIONS);
+      } else if (depth == 3u && fdt_node_name_is(stack[2].name, "reserved-memory")) {
+        fdt_add_reg_regions(&stack[2], &stack[3], out->reserved, &out->reserved_count,
+                            FDT_MAX_RESERVED_REGIONS);
+      }
+      depth--;
+    } else if (token == FDT_PROP) {
+      uint32_t len;
+      uint32_t nameoff;
+      const uint8_t *value;
+      const char *prop;
+
+      if (pos + 8u > end) {
+        return -1;
+      }
+      len = fdt_be32(base + pos);
+      nameoff = fdt_be32(base + pos + 4u);
+      pos += 8u;
+      if (len > end - pos || nameoff >= strings_size || depth == 0u) {
+        return -1;
+      }
+
+      value = base + pos;
+      prop = (const char *)(base + strings_off + nameoff);
+      pos = (pos + len + 3u) & ~3u;
+
+      if (fdt_str_eq(prop, "#address-cells") && len == 4u) {
+        stack[depth].address_cells = fdt_be32(value);
+      } else if (fdt_str_eq(prop, "#size-cells") && len == 4u) {
+        stack[depth].size_cells = fdt_be32(value);
+      } else if (fdt_str_eq(prop, "reg")) {
+        stack[depth].reg = value;
+        stack[depth].reg_len = len;
+      } else if (fdt_str_eq(prop, "device_type") && len >= 7u &&
+                 fdt_str_eq((const char *)value, "memory")) {
+        stack[depth].is_memory = depth == 2u;
+      } else if (fdt_str_eq(prop, "timebase-frequency") && out->timebase_frequency == 0u &&
+                 (fdt_node_name_is(stack[depth].name, "cpus") ||
+                  fdt_node_name_is(stack[depth].name, "cpu"))) {
+        if (len == 4u) {
+          out->timebase_frequency = fdt_be32(value);
+        } else if (len == 8u) {
+          out->timebase_frequency = fdt_be64(value);
+        }
+      }
+    } else if (token == FDT_END) {
+      return depth == 0u ? 0 : -1;
+    } else if (token != FDT_NOP) {
+      return -1;
+    }
+  }
+
+  return -1;
+}
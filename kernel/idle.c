@@ -0,0 +1,13 @@
+#include <stdint.h>
+
+#include "idle.h"
+#include "page_zero.h"
+
+enum {
+  IDLE_ZERO_PAGES_PER_PASS = 1u,
+};
+
+/* One bounded slice of deferred work; callers loop on it while waiting for input. */
+bool idle_run_once(void) {
+  return page_zero_idle_work(IDLE_ZERO_PAGES_PER_PASS) != 0u;
+}
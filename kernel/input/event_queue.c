@@ -1,6 +1,7 @@
 #include <stdint.h>
 
 #include "event_queue.h"
+#include "spinlock.h"
 
 typedef struct input_event_queue {
   input_event_t events[INPUT_EVENT_QUEUE_CAPACITY];
@@ -10,19 +11,28 @@ typedef struct input_event_queue {
 } input_event_queue_t;
 
 static input_event_queue_t g_input_event_queue;
+/* Producers may be interrupt handlers, so every access masks local interrupts. */
+static spinlock_t g_input_event_lock;
+static lock_stats_t g_input_event_lock_stats;
 
 void input_event_queue_reset(void) {
+  lock_stats_register(&g_input_event_lock_stats, "input_events");
+  spinlock_init(&g_input_event_lock, &g_input_event_lock_stats);
   g_input_event_queue.read_index = 0u;
   g_input_event_queue.write_index = 0u;
   g_input_event_queue.count = 0u;
 }
 
 int input_event_queue_push(const input_event_t *event) {
+  uint64_t irq_state;
+
   if (event == (const input_event_t *)0) {
     return -1;
   }
 
+  irq_state = spin_lock_irqsave(&g_input_event_lock);
   if (g_input_event_queue.count >= INPUT_EVENT_QUEUE_CAPACITY) {
+    spin_unlock_irqrestore(&g_input_event_lock, irq_state);
     return -1;
   }
 
@@ -33,15 +43,20 @@ int input_event_queue_push(const input_event_t *event) {
   }
 
   g_input_event_queue.count += 1u;
+  spin_unlock_irqrestore(&g_input_event_lock, irq_state);
   return 0;
 }
 
 int input_event_queue_pop(input_event_t *out_event) {
+  uint64_t irq_state;
+
   if (out_event == (input_event_t *)0) {
     return -1;
   }
 
+  irq_state = spin_lock_irqsave(&g_input_event_lock);
   if (g_input_event_queue.count == 0u) {
+    spin_unlock_irqrestore(&g_input_event_lock, irq_state);
     return -1;
   }
 
@@ -52,6 +67,7 @@ int input_event_queue_pop(input_event_t *out_event) {
   }
 
   g_input_event_queue.count -= 1u;
+  spin_unlock_irqrestore(&g_input_event_lock, irq_state);
   return 0;
 }
 
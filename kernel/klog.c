@@ -0,0 +1,292 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "clock.h"
+#include "console.h"
+#include "hart.h"
+#include "klog.h"
+#include "riscv_irq.h"
+#include "riscv_timer.h"
+#include "spinlock.h"
+
+_Static_assert((KLOG_RING_RECORDS & (KLOG_RING_RECORDS - 1u)) == 0u, "klog ring power of two");
+
+typedef enum klog_slot_state {
+  KLOG_SLOT_READY = 0,
+  /* Reserved but not yet published. */
+  KLOG_SLOT_BUSY = 1,
+  /* Overwritten by a later lap of the ring. */
+  KLOG_SLOT_LOST = 2,
+} klog_slot_state_t;
+
+/* Only the owning hart appends; `flushed` belongs to whoever holds the flush lock. */
+typedef struct klog_ring {
+  uint64_t head;
+  uint64_t flushed;
+  klog_hart_stats_t stats;
+  klog_record_t records[KLOG_RING_RECORDS];
+} klog_ring_t;
+
+static klog_ring_t g_klog_rings[HART_MAX_HARTS];
+static spinlock_t g_klog_flush_lock;
+static bool g_klog_deferred;
+static bool g_klog_notify_armed;
+static void (*g_klog_notify)(void);
+
+static klog_ring_t *klog_this_ring(void) {
+  return &g_klog_rings[hart_current_id() % HART_MAX_HARTS];
+}
+
+/* Field by field: the kernel has no memcpy for a struct assignment to fall back on. */
+static void klog_record_copy(klog_record_t *dst, const klog_record_t *src) {
+  uint16_t len = src->len > KLOG_TEXT_MAX ? (uint16_t)KLOG_TEXT_MAX : src->len;
+  uint16_t i;
+
+  dst->seq = src->seq;
+  dst->time_ns = src->time_ns;
+  dst->start_cycles = src->start_cycles;
+  dst->level = src->level;
+  dst->hart = src->hart;
+  dst->len = len;
+  dst->irq_state = src->irq_state;
+  for (i = 0u; i < len; ++i) {
+    dst->text[i] = src->text[i];
+  }
+}
+
+/*
+ * Seqlock-style copy of record `index`: the sequence is checked before and after, so a
+ * writer lapping the reader mid-copy is detected instead of returning torn text.
+ */
+static klog_slot_state_t klog_copy(const klog_ring_t *ring, uint64_t index, klog_record_t *out) {
+  const klog_record_t *record = &ring->records[index & (KLOG_RING_RECORDS - 1u)];
+  uint64_t seq = __atomic_load_n(&record->seq, __ATOMIC_ACQUIRE);
+
+  if (seq != index + 1u) {
+    /* In progress for this index, or still holding an older lap's record. */
+    return (seq == ~(index + 1u) || seq < index + 1u) ? KLOG_SLOT_BUSY : KLOG_SLOT_LOST;
+  }
+
+  klog_record_copy(out, record);
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return __atomic_load_n(&record->seq, __ATOMIC_RELAXED) == seq ? KLOG_SLOT_READY
+                                                                 : KLOG_SLOT_LOST;
+}
+
+klog_record_t *klog_begin(klog_level_t level) {
+  uint64_t irq_state = riscv_irq_save();
+  klog_ring_t *ring = klog_this_ring();
+  uint64_t start = riscv_cycle_now();
+  /* The fetch-add still gives a trap that logs between two steps below its own slot. */
+  uint64_t index = __atomic_fetch_add(&ring->head, 1u, __ATOMIC_RELAXED);
+  klog_record_t *record = &ring->records[index & (KLOG_RING_RECORDS - 1u)];
+
+  __atomic_store_n(&record->seq, ~(index + 1u), __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  record->time_ns = clock_now_ns();
+  record->start_cycles = start;
+  record->level = (uint8_t)level;
+  record->hart = (uint8_t)(hart_current_id() % HART_MAX_HARTS);
+  record->len = 0u;
+  record->irq_state = (uint8_t)irq_state;
+  return record;
+}
+
+void klog_puts(klog_record_t *record, const char *s) {
+  while (*s != '\0' && record->len < KLOG_TEXT_MAX) {
+    record->text[record->len++] = *s++;
+  }
+}
+
+void klog_put_u64(klog_record_t *record, uint64_t value) {
+  char digits[20];
+  uint32_t count = 0u;
+
+  do {
+    digits[count++] = (char)('0' + (value % 10u));
+    value /= 10u;
+  } while (value != 0u);
+
+  while (count > 0u && record->len < KLOG_TEXT_MAX) {
+    record->text[record->len++] = digits[--count];
+  }
+}
+
+void klog_end(klog_record_t *record) {
+  klog_ring_t *ring = &g_klog_rings[record->hart];
+  uint64_t cycles = riscv_cycle_now() - record->start_cycles;
+  /* Read before publishing: once seq is set, a later lap may reuse the slot. */
+  uint64_t irq_state = record->irq_state;
+
+  __atomic_store_n(&record->seq, ~record->seq, __ATOMIC_RELEASE);
+  __atomic_fetch_add(&ring->stats.records, 1u, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&ring->stats.cycles, cycles, __ATOMIC_RELAXED);
+  riscv_irq_restore(irq_state);
+
+  if (!__atomic_load_n(&g_klog_deferred, __ATOMIC_ACQUIRE)) {
+    klog_flush();
+    return;
+  }
+  if (__atomic_exchange_n(&g_klog_notify_armed, false, __ATOMIC_ACQ_REL) &&
+      g_klog_notify != (void (*)(void))0) {
+    g_klog_notify();
+  }
+}
+
+void klog(klog_level_t level, const char *text) {
+  klog_record_t *record = klog_begin(level);
+
+  klog_puts(record, text);
+  klog_end(record);
+}
+
+/* Moves a ring's cursor past records it can no longer read; returns the cursor. */
+static uint64_t klog_skip_lost(klog_ring_t *ring) {
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+  if (head - ring->flushed > KLOG_RING_RECORDS) {
+    ring->stats.dropped += head - KLOG_RING_RECORDS - ring->flushed;
+    ring->flushed = head - KLOG_RING_RECORDS;
+  }
+  return head;
+}
+
+void klog_flush(void) {
+  uint64_t irq_state = spin_lock_irqsave(&g_klog_flush_lock);
+  klog_record_t candidate;
+  klog_record_t next;
+  char line[KLOG_TEXT_MAX + 1u];
+
+  for (;;) {
+    klog_ring_t *next_ring = (klog_ring_t *)0;
+    bool busy = false;
+    uint32_t hart;
+    uint16_t i;
+
+    /* Merge the rings by timestamp so interleaved harts print in order. */
+    for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+      klog_ring_t *ring = &g_klog_rings[hart];
+      uint64_t head = klog_skip_lost(ring);
+      klog_slot_state_t state = KLOG_SLOT_BUSY;
+
+      while (ring->flushed != head &&
+             (state = klog_copy(ring, ring->flushed, &candidate)) == KLOG_SLOT_LOST) {
+        ring->stats.dropped++;
+        ring->flushed++;
+      }
+      if (ring->flushed == head) {
+        continue;
+      }
+      /* Its timestamp may be the oldest: wait for it rather than print out of order. */
+      if (state != KLOG_SLOT_READY) {
+        busy = true;
+        break;
+      }
+      if (next_ring == (klog_ring_t *)0 || candidate.time_ns < next.time_ns) {
+        next_ring = ring;
+        klog_record_copy(&next, &candidate);
+      }
+    }
+
+    if (busy || next_ring == (klog_ring_t *)0) {
+      break;
+    }
+
+    for (i = 0u; i < next.len; ++i) {
+      line[i] = next.text[i];
+    }
+    line[next.len] = '\0';
+    __atomic_store_n(&next_ring->flushed, next_ring->flushed + 1u, __ATOMIC_RELAXED);
+    console_write(line);
+    console_write("\n");
+  }
+
+  spin_unlock_irqrestore(&g_klog_flush_lock, irq_state);
+}
+
+bool klog_pending(void) {
+  uint32_t hart;
+
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    const klog_ring_t *ring = &g_klog_rings[hart];
+
+    if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) !=
+        __atomic_load_n(&ring->flushed, __ATOMIC_RELAXED)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void klog_set_deferred(bool deferred, void (*notify)(void)) {
+  g_klog_notify = notify;
+  __atomic_store_n(&g_klog_deferred, deferred, __ATOMIC_RELEASE);
+  if (!deferred) {
+    klog_flush();
+  }
+}
+
+void klog_arm_notify(void) {
+  __atomic_store_n(&g_klog_notify_armed, true, __ATOMIC_RELEASE);
+}
+
+uint32_t klog_read(klog_record_t *out, uint32_t max) {
+  uint64_t cursor[HART_MAX_HARTS];
+  uint64_t oldest[HART_MAX_HARTS];
+  klog_record_t candidate;
+  uint32_t count = 0u;
+  uint32_t hart;
+  uint32_t i;
+
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    cursor[hart] = __atomic_load_n(&g_klog_rings[hart].head, __ATOMIC_ACQUIRE);
+    oldest[hart] = cursor[hart] > KLOG_RING_RECORDS ? cursor[hart] - KLOG_RING_RECORDS : 0u;
+  }
+
+  /* Walk back from the newest record across all rings, then reverse into time order. */
+  while (count < max) {
+    uint32_t newest = HART_MAX_HARTS;
+    uint64_t newest_time = 0u;
+
+    for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+      while (cursor[hart] > oldest[hart] &&
+             klog_copy(&g_klog_rings[hart], cursor[hart] - 1u, &candidate) != KLOG_SLOT_READY) {
+        cursor[hart]--;
+      }
+      if (cursor[hart] > oldest[hart] &&
+          (newest == HART_MAX_HARTS || candidate.time_ns > newest_time)) {
+        newest = hart;
+        newest_time = candidate.time_ns;
+      }
+    }
+    if (newest == HART_MAX_HARTS) {
+      break;
+    }
+
+    cursor[newest]--;
+    if (klog_copy(&g_klog_rings[newest], cursor[newest], &out[count]) == KLOG_SLOT_READY) {
+      count++;
+    }
+  }
+
+  for (i = 0u; i < count / 2u; ++i) {
+    klog_record_copy(&candidate, &out[i]);
+    klog_record_copy(&out[i], &out[count - 1u - i]);
+    klog_record_copy(&out[count - 1u - i], &candidate);
+  }
+  return count;
+}
+
+int klog_hart_stats(uint32_t hart_id, klog_hart_stats_t *out) {
+  const klog_ring_t *ring;
+
+  if (hart_id >= HART_MAX_HARTS || out == (klog_hart_stats_t *)0) {
+    return -1;
+  }
+
+  ring = &g_klog_rings[hart_id];
+  out->records = __atomic_load_n(&ring->stats.records, __ATOMIC_RELAXED);
+  out->dropped = ring->stats.dropped;
+  out->cycles = __atomic_load_n(&ring->stats.cycles, __ATOMIC_RELAXED);
+  return 0;
+}
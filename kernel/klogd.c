@@ -0,0 +1,43 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "klog.h"
+#include "sched.h"
+#include "task.h"
+#include "wait.h"
+
+static wait_queue_t g_klogd_wait;
+static bool g_klogd_started;
+
+static void klogd_notify(void) {
+  (void)wake_up(&g_klogd_wait);
+}
+
+static void klogd_main(task_control_block_t *task) {
+  (void)task;
+
+  for (;;) {
+    klog_flush();
+    /* Armed before the re-check in wait_event, so a record landing in between wakes us. */
+    klog_arm_notify();
+    wait_event(&g_klogd_wait, klog_pending());
+  }
+}
+
+int klogd_start(void) {
+  task_control_block_t *task;
+
+  if (g_klogd_started) {
+    return 0;
+  }
+
+  wait_queue_init(&g_klogd_wait);
+  task = task_create("klogd", klogd_main);
+  if (task == (task_control_block_t *)0 || sched_add_task(task) != 0) {
+    return -1;
+  }
+
+  g_klogd_started = true;
+  klog_set_deferred(true, klogd_notify);
+  return 0;
+}
@@ -4,19 +4,31 @@
 #include "apps/demo_window_app.h"
 #include "clock.h"
 #include "console.h"
+#include "fdt.h"
 #include "framebuffer.h"
 #include "keyboard.h"
 #include "keyboard_dispatch.h"
+#include "klog.h"
 #include "line_io.h"
 #include "mm_init.h"
 #include "mouse.h"
+#include "page_alloc.h"
+#include "plic.h"
+#include "rtc.h"
 #include "sched.h"
 #include "shell.h"
+#include "smp.h"
+#include "spinlock.h"
 #include "trap.h"
+#include "uart.h"
+#include "vm_kernel.h"
 #include "wm_compositor.h"
 #include "wm_drag.h"
 #include "wm_window.h"
 
+/* Filled from the DTB passed in a1; timebase_frequency is kept for clock setup. */
+static fdt_platform_info_t g_platform_info;
+
 static void console_put_hex32(uint32_t value) {
   static const char digits[] = "0123456789ABCDEF";
   int shift;
@@ -130,7 +142,7 @@ static void keyboard_dispatch_record(uint32_t endpoint_id, const keyboard_event_
   }
 }
 
-void kernel_main(void) {
+void kernel_main(uint64_t hart_id, uintptr_t dtb_addr) {
   uint32_t marker_a;
   uint32_t marker_b;
   uint32_t wm_marker;
@@ -156,13 +168,61 @@ void kernel_main(void) {
   wm_window_t back_window;
   wm_window_t front_window;
 
+  const fdt_platform_info_t *platform = (const fdt_platform_info_t *)0;
+
+  (void)hart_id;
   console_init();
-  mm_init();
+  if (fdt_parse((const void *)dtb_addr, &g_platform_info) == 0) {
+    platform = &g_platform_info;
+    clock_set_timebase(platform->timebase_frequency);
+  }
+  lock_stats_set_clock(clock_now_ns);
+  mm_init(platform, dtb_addr);
   line_io_write("BOOT: kernel entry\n");
+  if (platform != (const fdt_platform_info_t *)0) {
+    line_io_write("MM: fdt memory banks 0x");
+    console_put_hex32(platform->memory_count);
+    line_io_write(" reserved 0x");
+    console_put_hex32(platform->reserved_count);
+    line_io_write(" managed pages 0x");
+    console_put_hex32((uint32_t)page_alloc_total_pages());
+    line_io_write("\n");
+  } else {
+    line_io_write("MM: no device tree, using fixed memory range\n");
+  }
+  if (vm_kernel_init() == 0) {
+    const vm_space_t *space = vm_kernel_space();
+
+    line_io_write("MM: sv39 enabled 4k=0x");
+    console_put_hex32((uint32_t)space->leaf_count[VM_LEVEL_4K]);
+    line_io_write(" 2m=0x");
+    console_put_hex32((uint32_t)space->leaf_count[VM_LEVEL_2M]);
+    line_io_write(" 1g=0x");
+    console_put_hex32((uint32_t)space->leaf_count[VM_LEVEL_1G]);
+    line_io_write(" tables=0x");
+    console_put_hex32((uint32_t)space->table_pages);
+    line_io_write("\n");
+  } else {
+    line_io_write("MM: sv39 setup failed, paging stays off\n");
+  }
+  clock_set_wall_ns(rtc_read_ns());
   trap_init();
   line_io_write("console: line io ready\n");
   trap_test_trigger();
   clock_init();
+  clock_set_tickless(true);
+  sched_init();
+  plic_init();
+  if (plic_register(PLIC_IRQ_UART0, uart_handle_interrupt) == 0) {
+    uart_set_interrupt_mode(true);
+    line_io_write("UART: interrupt-driven rings ready\n");
+  }
+  line_io_write("SMP: harts online=0x");
+  console_put_hex32(smp_start_secondaries());
+  line_io_write("\n");
+  if (klogd_start() != 0) {
+    line_io_write("KLOG: flusher start failed\n");
+  }
   sched_bootstrap_test_tasks();
 
   if (framebuffer_init() != 0) {
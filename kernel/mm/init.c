@@ -1,15 +1,103 @@
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "fdt.h"
 #include "mm_init.h"
 #include "page_alloc.h"
+#include "page_cache.h"
+#include "page_zero.h"
+#include "slab.h"
 
 enum {
+  /* Used only when no usable device tree was passed in a1. */
   KERNEL_PHYS_MEM_END = 0x88000000u,
+  MM_ZERO_POOL_TARGET = 32u,
 };
 
 extern char __bss_end[];
 
-void mm_init(void) {
-  uintptr_t alloc_start = (uintptr_t)__bss_end;
-  page_alloc_init(alloc_start, (uintptr_t)KERNEL_PHYS_MEM_END);
+static uintptr_t mm_page_align_up(uintptr_t addr) {
+  uintptr_t mask = (uintptr_t)PAGE_ALLOC_PAGE_SIZE - 1u;
+  return (addr + mask) & ~mask;
+}
+
+static bool mm_exclusion(const fdt_platform_info_t *platform, uintptr_t dtb_addr, uint32_t index,
+                         uintptr_t *start_out, uintptr_t *end_out) {
+  if (index < platform->reserved_count) {
+    *start_out = (uintptr_t)platform->reserved[index].base;
+    *end_out = (uintptr_t)(platform->reserved[index].base + platform->reserved[index].size);
+    return true;
+  }
+
+  *start_out = dtb_addr;
+  *end_out = dtb_addr + (uintptr_t)platform->total_size;
+  return index == platform->reserved_count;
+}
+
+/* Releases [start, end) minus every reserved region from `index` on, plus the DTB itself. */
+static void mm_release_excluding(const fdt_platform_info_t *platform, uintptr_t dtb_addr,
+                                 uintptr_t start, uintptr_t end, uint32_t index) {
+  uintptr_t hole_start;
+  uintptr_t hole_end;
+
+  while (start < end && mm_exclusion(platform, dtb_addr, index, &hole_start, &hole_end)) {
+    index++;
+    if (hole_end <= start || hole_start >= end) {
+      continue;
+    }
+
+    if (hole_start > start) {
+      mm_release_excluding(platform, dtb_addr, start, hole_start, index);
+    }
+    start = hole_end;
+  }
+
+  if (start < end) {
+    (void)page_alloc_release_range(start, end);
+  }
+}
+
+static void mm_init_from_fdt(const fdt_platform_info_t *platform, uintptr_t dtb_addr) {
+  uintptr_t kernel_end = mm_page_align_up((uintptr_t)__bss_end);
+  uintptr_t span_end = kernel_end;
+  uintptr_t managed_start;
+  size_t metadata_bytes;
+  uint32_t i;
+
+  for (i = 0u; i < platform->memory_count; ++i) {
+    uintptr_t bank_end = (uintptr_t)(platform->memory[i].base + platform->memory[i].size);
+
+    if (bank_end > span_end) {
+      span_end = bank_end;
+    }
+  }
+
+  /* Metadata lives in the pages right after the kernel image and stays reserved. */
+  metadata_bytes =
+      page_alloc_metadata_bytes((size_t)((span_end - kernel_end) / PAGE_ALLOC_PAGE_SIZE));
+  managed_start = mm_page_align_up(kernel_end + (uintptr_t)metadata_bytes);
+  page_alloc_init_with_metadata(kernel_end, span_end, (void *)kernel_end, metadata_bytes);
+
+  for (i = 0u; i < platform->memory_count; ++i) {
+    uintptr_t bank_start = (uintptr_t)platform->memory[i].base;
+    uintptr_t bank_end = (uintptr_t)(platform->memory[i].base + platform->memory[i].size);
+
+    if (bank_start < managed_start) {
+      bank_start = managed_start;
+    }
+    mm_release_excluding(platform, dtb_addr, bank_start, bank_end, 0u);
+  }
+}
+
+void mm_init(const fdt_platform_info_t *platform, uintptr_t dtb_addr) {
+  if (platform != (const fdt_platform_info_t *)0 && platform->memory_count != 0u) {
+    mm_init_from_fdt(platform, dtb_addr);
+  } else {
+    page_alloc_init((uintptr_t)__bss_end, (uintptr_t)KERNEL_PHYS_MEM_END);
+  }
+
+  page_cache_init();
+  kmalloc_init();
+  page_zero_init(MM_ZERO_POOL_TARGET);
 }
@@ -1,18 +1,74 @@
 #include "page_alloc.h"
 
+#include "bitops.h"
+#include "perf.h"
+#include "spinlock.h"
+
 enum {
-  PAGE_ALLOC_MAX_PAGES = 131072u,
   PAGE_ALLOC_BITMAP_WORD_BITS = 64u,
-  PAGE_ALLOC_BITMAP_WORDS =
-      (PAGE_ALLOC_MAX_PAGES + PAGE_ALLOC_BITMAP_WORD_BITS - 1u) / PAGE_ALLOC_BITMAP_WORD_BITS,
+  PAGE_ALLOC_ORDER_COUNT = PAGE_ALLOC_MAX_ORDER + 1u,
 };
 
+typedef struct page_alloc_layout {
+  size_t bitmap_words;
+  size_t free_bitmap_offset[PAGE_ALLOC_ORDER_COUNT];
+  size_t free_bitmap_words[PAGE_ALLOC_ORDER_COUNT];
+  size_t free_bitmap_total;
+  size_t free_summary_offset[PAGE_ALLOC_ORDER_COUNT];
+  size_t free_summary_words[PAGE_ALLOC_ORDER_COUNT];
+  size_t free_summary_total;
+} page_alloc_layout_t;
+
+/* Metadata for page_alloc_init(); larger ranges bring their own via page_alloc_init_with_metadata. */
+static uint64_t g_bootstrap_metadata[PAGE_ALLOC_METADATA_WORDS(PAGE_ALLOC_BOOTSTRAP_PAGES)];
+
 static uintptr_t g_range_start;
 static uintptr_t g_range_end;
+/* Pages spanned by [g_range_start, g_range_end), including reserved holes. */
+static size_t g_span_pages;
+/* Pages handed to the allocator (span minus reserved pages). */
 static size_t g_total_pages;
 static size_t g_free_pages;
-static size_t g_next_hint;
-static uint64_t g_alloc_bitmap[PAGE_ALLOC_BITMAP_WORDS];
+
+/* One bit per page: set while the page belongs to an allocated block or is reserved. */
+static uint64_t *g_alloc_bitmap;
+/* One bit per page: set on the first page of every allocated block. */
+static uint64_t *g_head_bitmap;
+/* One bit per page: set for pages that never enter the free lists (holes, firmware, DTB). */
+static uint64_t *g_reserved_bitmap;
+/*
+ * One bit per page: set while an allocated page sits in a per-hart cache. Set and cleared
+ * with atomics, because page_alloc_cache_release() runs without the lock.
+ */
+static uint64_t *g_cached_bitmap;
+/* Per-order free block bitmaps; bit i of order k covers pages [i << k, (i + 1) << k). */
+static uint64_t *g_free_bitmap;
+static size_t g_free_bitmap_offset[PAGE_ALLOC_ORDER_COUNT];
+static size_t g_free_bitmap_words[PAGE_ALLOC_ORDER_COUNT];
+static size_t g_free_blocks[PAGE_ALLOC_ORDER_COUNT];
+/* Per-order summaries; bit w is set while word w of that order's free bitmap is non-zero. */
+static uint64_t *g_free_summary;
+static size_t g_free_summary_offset[PAGE_ALLOC_ORDER_COUNT];
+static size_t g_free_summary_words[PAGE_ALLOC_ORDER_COUNT];
+
+/*
+ * Guards every bitmap and counter above. A ticket lock keeps harts from starving each
+ * other on allocation storms; irqsave because stacks are freed from the scheduler's trap path.
+ */
+static ticket_lock_t g_alloc_lock;
+static lock_stats_t g_alloc_lock_stats;
+
+static bool g_trace_enabled;
+static page_alloc_clock_fn_t g_trace_clock;
+static page_alloc_event_fn_t g_event_hook;
+static page_alloc_single_fn_t g_frontend_alloc;
+static page_free_single_fn_t g_frontend_free;
+static page_alloc_trace_entry_t g_trace_ring[PAGE_ALLOC_TRACE_RING_SIZE];
+static uint64_t g_trace_records;
+static page_alloc_trace_site_t g_trace_sites[PAGE_ALLOC_TRACE_SITES];
+static size_t g_trace_site_count;
+/* Pages allocated by callers that arrived after the site table filled up. */
+static uint64_t g_trace_untracked_pages;
 
 static uintptr_t page_align_up(uintptr_t addr) {
   uintptr_t mask = (uintptr_t)PAGE_ALLOC_PAGE_SIZE - 1u;
@@ -24,24 +80,169 @@ static uintptr_t page_align_down(uintptr_t addr) {
   return addr & ~mask;
 }
 
-static bool bitmap_test(size_t index) {
+static bool bitmap_test(const uint64_t *bitmap, size_t index) {
   size_t word = index / PAGE_ALLOC_BITMAP_WORD_BITS;
   size_t bit = index % PAGE_ALLOC_BITMAP_WORD_BITS;
   uint64_t mask = 1ull << bit;
 
-  return (g_alloc_bitmap[word] & mask) != 0u;
+  return (bitmap[word] & mask) != 0u;
 }
 
-static void bitmap_set(size_t index) {
+static void bitmap_set(uint64_t *bitmap, size_t index) {
   size_t word = index / PAGE_ALLOC_BITMAP_WORD_BITS;
   size_t bit = index % PAGE_ALLOC_BITMAP_WORD_BITS;
-  g_alloc_bitmap[word] |= 1ull << bit;
+  bitmap[word] |= 1ull << bit;
 }
 
-static void bitmap_clear(size_t index) {
+static void bitmap_clear(uint64_t *bitmap, size_t index) {
   size_t word = index / PAGE_ALLOC_BITMAP_WORD_BITS;
   size_t bit = index % PAGE_ALLOC_BITMAP_WORD_BITS;
-  g_alloc_bitmap[word] &= ~(1ull << bit);
+  bitmap[word] &= ~(1ull << bit);
+}
+
+static uint64_t bitmap_range_mask(size_t bit, size_t count) {
+  if (count >= PAGE_ALLOC_BITMAP_WORD_BITS) {
+    return ~0ull;
+  }
+
+  return ((1ull << count) - 1u) << bit;
+}
+
+static void bitmap_set_range(uint64_t *bitmap, size_t index, size_t count) {
+  while (count > 0u) {
+    size_t bit = index % PAGE_ALLOC_BITMAP_WORD_BITS;
+    size_t chunk = PAGE_ALLOC_BITMAP_WORD_BITS - bit;
+
+    if (chunk > count) {
+      chunk = count;
+    }
+
+    bitmap[index / PAGE_ALLOC_BITMAP_WORD_BITS] |= bitmap_range_mask(bit, chunk);
+    index += chunk;
+    count -= chunk;
+  }
+}
+
+static void bitmap_clear_range(uint64_t *bitmap, size_t index, size_t count) {
+  while (count > 0u) {
+    size_t bit = index % PAGE_ALLOC_BITMAP_WORD_BITS;
+    size_t chunk = PAGE_ALLOC_BITMAP_WORD_BITS - bit;
+
+    if (chunk > count) {
+      chunk = count;
+    }
+
+    bitmap[index / PAGE_ALLOC_BITMAP_WORD_BITS] &= ~bitmap_range_mask(bit, chunk);
+    index += chunk;
+    count -= chunk;
+  }
+}
+
+static bool bitmap_range_all_set(const uint64_t *bitmap, size_t index, size_t count) {
+  while (count > 0u) {
+    size_t bit = index % PAGE_ALLOC_BITMAP_WORD_BITS;
+    size_t chunk = PAGE_ALLOC_BITMAP_WORD_BITS - bit;
+    uint64_t mask;
+
+    if (chunk > count) {
+      chunk = count;
+    }
+
+    mask = bitmap_range_mask(bit, chunk);
+    if ((bitmap[index / PAGE_ALLOC_BITMAP_WORD_BITS] & mask) != mask) {
+      return false;
+    }
+    index += chunk;
+    count -= chunk;
+  }
+
+  return true;
+}
+
+static bool bitmap_range_any_set(const uint64_t *bitmap, size_t index, size_t count) {
+  while (count > 0u) {
+    size_t bit = index % PAGE_ALLOC_BITMAP_WORD_BITS;
+    size_t chunk = PAGE_ALLOC_BITMAP_WORD_BITS - bit;
+
+    if (chunk > count) {
+      chunk = count;
+    }
+
+    if ((bitmap[index / PAGE_ALLOC_BITMAP_WORD_BITS] & bitmap_range_mask(bit, chunk)) != 0u) {
+      return true;
+    }
+    index += chunk;
+    count -= chunk;
+  }
+
+  return false;
+}
+
+static uint64_t *free_bitmap_for_order(unsigned int order) {
+  return &g_free_bitmap[g_free_bitmap_offset[order]];
+}
+
+static size_t order_pages(unsigned int order) {
+  return (size_t)1u << order;
+}
+
+static uint64_t *free_summary_for_order(unsigned int order) {
+  return &g_free_summary[g_free_summary_offset[order]];
+}
+
+static void free_block_insert(size_t index, unsigned int order) {
+  size_t block = index >> order;
+
+  bitmap_set(free_bitmap_for_order(order), block);
+  bitmap_set(free_summary_for_order(order), block / PAGE_ALLOC_BITMAP_WORD_BITS);
+  g_free_blocks[order]++;
+}
+
+static void free_block_remove(size_t index, unsigned int order) {
+  uint64_t *bitmap = free_bitmap_for_order(order);
+  size_t block = index >> order;
+  size_t word = block / PAGE_ALLOC_BITMAP_WORD_BITS;
+
+  bitmap_clear(bitmap, block);
+  if (bitmap[word] == 0u) {
+    bitmap_clear(free_summary_for_order(order), word);
+  }
+  g_free_blocks[order]--;
+}
+
+static bool free_block_test(size_t index, unsigned int order) {
+  return bitmap_test(free_bitmap_for_order(order), index >> order);
+}
+
+/* Lowest free block of an order: first non-zero summary word, then two ctz lookups. */
+static bool free_block_find(unsigned int order, size_t *index_out) {
+  const uint64_t *bitmap = free_bitmap_for_order(order);
+  const uint64_t *summary = free_summary_for_order(order);
+  size_t summary_word;
+
+  for (summary_word = 0u; summary_word < g_free_summary_words[order]; ++summary_word) {
+    size_t word;
+
+    if (summary[summary_word] == 0u) {
+      continue;
+    }
+
+    word = (summary_word * PAGE_ALLOC_BITMAP_WORD_BITS) + bitops_ctz64(summary[summary_word]);
+    *index_out = ((word * PAGE_ALLOC_BITMAP_WORD_BITS) + bitops_ctz64(bitmap[word])) << order;
+    return true;
+  }
+
+  return false;
+}
+
+static void mark_block_allocated(size_t index, unsigned int order) {
+  bitmap_set_range(g_alloc_bitmap, index, order_pages(order));
+  bitmap_set(g_head_bitmap, index);
+}
+
+static void mark_block_free(size_t index, unsigned int order) {
+  bitmap_clear_range(g_alloc_bitmap, index, order_pages(order));
+  bitmap_clear(g_head_bitmap, index);
 }
 
 static bool page_index_from_addr(uintptr_t addr, size_t *index_out) {
@@ -58,7 +259,7 @@ static bool page_index_from_addr(uintptr_t addr, size_t *index_out) {
   }
 
   index = (size_t)(delta / (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
-  if (index >= g_total_pages) {
+  if (index >= g_span_pages) {
     return false;
   }
 
@@ -66,59 +267,337 @@ static bool page_index_from_addr(uintptr_t addr, size_t *index_out) {
   return true;
 }
 
-void page_alloc_init(uintptr_t range_start, uintptr_t range_end) {
+static void *page_addr_from_index(size_t index) {
+  return (void *)(g_range_start + ((uintptr_t)index * (uintptr_t)PAGE_ALLOC_PAGE_SIZE));
+}
+
+/*
+ * A block freed with the wrong order is rejected: every page must still be allocated, no other
+ * block may start inside it, and the page right after it must not be the tail of the same block.
+ */
+static bool allocated_block_matches(size_t index, unsigned int order) {
+  size_t pages = order_pages(order);
+  size_t end = index + pages;
+
+  if ((index & (pages - 1u)) != 0u || end > g_span_pages) {
+    return false;
+  }
+
+  if (!bitmap_test(g_head_bitmap, index) ||
+      !bitmap_range_all_set(g_alloc_bitmap, index, pages) ||
+      bitmap_range_any_set(g_reserved_bitmap, index, pages) ||
+      (pages > 1u && bitmap_range_any_set(g_head_bitmap, index + 1u, pages - 1u))) {
+    return false;
+  }
+
+  if (end < g_span_pages && bitmap_test(g_alloc_bitmap, end) &&
+      !bitmap_test(g_head_bitmap, end) && !bitmap_test(g_reserved_bitmap, end)) {
+    return false;
+  }
+
+  return true;
+}
+
+static void page_alloc_compute_layout(size_t pages, page_alloc_layout_t *layout) {
+  unsigned int order;
+
+  layout->bitmap_words = (pages + PAGE_ALLOC_BITMAP_WORD_BITS - 1u) / PAGE_ALLOC_BITMAP_WORD_BITS;
+  layout->free_bitmap_total = 0u;
+  layout->free_summary_total = 0u;
+
+  for (order = 0u; order < PAGE_ALLOC_ORDER_COUNT; ++order) {
+    size_t blocks = (pages + order_pages(order) - 1u) >> order;
+    size_t words = (blocks + PAGE_ALLOC_BITMAP_WORD_BITS - 1u) / PAGE_ALLOC_BITMAP_WORD_BITS;
+
+    layout->free_bitmap_offset[order] = layout->free_bitmap_total;
+    layout->free_bitmap_words[order] = words;
+    layout->free_bitmap_total += words;
+
+    layout->free_summary_offset[order] = layout->free_summary_total;
+    layout->free_summary_words[order] =
+        (words + PAGE_ALLOC_BITMAP_WORD_BITS - 1u) / PAGE_ALLOC_BITMAP_WORD_BITS;
+    layout->free_summary_total += layout->free_summary_words[order];
+  }
+}
+
+static size_t page_alloc_layout_words(const page_alloc_layout_t *layout) {
+  return (4u * layout->bitmap_words) + layout->free_bitmap_total + layout->free_summary_total;
+}
+
+size_t page_alloc_metadata_bytes(size_t pages) {
+  page_alloc_layout_t layout;
+
+  page_alloc_compute_layout(pages, &layout);
+  return page_alloc_layout_words(&layout) * sizeof(uint64_t);
+}
+
+/* Largest page count whose metadata fits in metadata_bytes (metadata grows monotonically). */
+static size_t page_alloc_pages_for_metadata(size_t pages, size_t metadata_bytes) {
+  size_t low = 0u;
+  size_t high = pages;
+
+  if (page_alloc_metadata_bytes(pages) <= metadata_bytes) {
+    return pages;
+  }
+
+  while (low < high) {
+    size_t mid = low + ((high - low + 1u) / 2u);
+
+    if (page_alloc_metadata_bytes(mid) <= metadata_bytes) {
+      low = mid;
+    } else {
+      high = mid - 1u;
+    }
+  }
+
+  return low;
+}
+
+static void free_block_coalesce_insert(size_t index, unsigned int order) {
+  while (order < PAGE_ALLOC_MAX_ORDER) {
+    size_t buddy = index ^ order_pages(order);
+
+    if (buddy + order_pages(order) > g_span_pages || !free_block_test(buddy, order)) {
+      break;
+    }
+
+    free_block_remove(buddy, order);
+    if (buddy < index) {
+      index = buddy;
+    }
+    order++;
+  }
+
+  free_block_insert(index, order);
+}
+
+void page_alloc_init_with_metadata(uintptr_t range_start,
+                                   uintptr_t range_end,
+                                   void *metadata,
+                                   size_t metadata_bytes) {
   uintptr_t aligned_start = page_align_up(range_start);
   uintptr_t aligned_end = page_align_down(range_end);
+  page_alloc_layout_t layout;
+  uint64_t *words = (uint64_t *)metadata;
+  size_t word_count;
+  unsigned int order;
   size_t i;
 
-  for (i = 0u; i < PAGE_ALLOC_BITMAP_WORDS; ++i) {
-    g_alloc_bitmap[i] = 0u;
-  }
-
+  page_alloc_set_frontend((page_alloc_single_fn_t)0, (page_free_single_fn_t)0);
+  lock_stats_register(&g_alloc_lock_stats, "page_alloc");
+  ticket_lock_init(&g_alloc_lock, &g_alloc_lock_stats);
   g_range_start = 0u;
   g_range_end = 0u;
+  g_span_pages = 0u;
   g_total_pages = 0u;
   g_free_pages = 0u;
-  g_next_hint = 0u;
+  for (order = 0u; order < PAGE_ALLOC_ORDER_COUNT; ++order) {
+    g_free_bitmap_offset[order] = 0u;
+    g_free_bitmap_words[order] = 0u;
+    g_free_summary_offset[order] = 0u;
+    g_free_summary_words[order] = 0u;
+    g_free_blocks[order] = 0u;
+  }
 
-  if (aligned_end <= aligned_start) {
+  page_alloc_compute_layout(0u, &layout);
+  if (metadata != 0 && aligned_end > aligned_start) {
+    g_span_pages = page_alloc_pages_for_metadata(
+        (size_t)((aligned_end - aligned_start) / (uintptr_t)PAGE_ALLOC_PAGE_SIZE),
+        metadata_bytes);
+    page_alloc_compute_layout(g_span_pages, &layout);
+  }
+
+  g_alloc_bitmap = words;
+  g_head_bitmap = g_alloc_bitmap + layout.bitmap_words;
+  g_reserved_bitmap = g_head_bitmap + layout.bitmap_words;
+  g_cached_bitmap = g_reserved_bitmap + layout.bitmap_words;
+  g_free_bitmap = g_cached_bitmap + layout.bitmap_words;
+  g_free_summary = g_free_bitmap + layout.free_bitmap_total;
+
+  if (g_span_pages == 0u) {
     return;
   }
 
-  g_total_pages =
-      (size_t)((aligned_end - aligned_start) / (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
-  if (g_total_pages > PAGE_ALLOC_MAX_PAGES) {
-    g_total_pages = PAGE_ALLOC_MAX_PAGES;
-    aligned_end =
-        aligned_start + ((uintptr_t)g_total_pages * (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
+  word_count = page_alloc_layout_words(&layout);
+  for (i = 0u; i < word_count; ++i) {
+    words[i] = 0u;
+  }
+
+  for (order = 0u; order < PAGE_ALLOC_ORDER_COUNT; ++order) {
+    g_free_bitmap_offset[order] = layout.free_bitmap_offset[order];
+    g_free_bitmap_words[order] = layout.free_bitmap_words[order];
+    g_free_summary_offset[order] = layout.free_summary_offset[order];
+    g_free_summary_words[order] = layout.free_summary_words[order];
   }
 
   g_range_start = aligned_start;
-  g_range_end = aligned_end;
-  g_free_pages = g_total_pages;
+  g_range_end = aligned_start + ((uintptr_t)g_span_pages * (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
+  bitmap_set_range(g_alloc_bitmap, 0u, g_span_pages);
+  bitmap_set_range(g_reserved_bitmap, 0u, g_span_pages);
 }
 
-void *page_alloc(void) {
-  size_t scanned;
+static size_t page_alloc_release_range_locked(uintptr_t range_start, uintptr_t range_end) {
+  uintptr_t aligned_start = page_align_up(range_start);
+  uintptr_t aligned_end = page_align_down(range_end);
+  size_t index;
+  size_t end;
+  size_t released = 0u;
 
-  if (g_free_pages == 0u) {
-    return 0;
+  if (aligned_start < g_range_start) {
+    aligned_start = g_range_start;
   }
+  if (aligned_end > g_range_end) {
+    aligned_end = g_range_end;
+  }
+  if (aligned_end <= aligned_start) {
+    return 0u;
+  }
+
+  index = (size_t)((aligned_start - g_range_start) / (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
+  end = (size_t)((aligned_end - g_range_start) / (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
 
-  for (scanned = 0u; scanned < g_total_pages; ++scanned) {
-    size_t index = (g_next_hint + scanned) % g_total_pages;
+  while (index < end) {
+    unsigned int order = PAGE_ALLOC_MAX_ORDER;
 
-    if (bitmap_test(index)) {
+    while (order > 0u &&
+           ((index & (order_pages(order) - 1u)) != 0u || index + order_pages(order) > end ||
+            !bitmap_range_all_set(g_reserved_bitmap, index, order_pages(order)))) {
+      order--;
+    }
+
+    if (!bitmap_test(g_reserved_bitmap, index)) {
+      index++;
       continue;
     }
 
-    bitmap_set(index);
-    g_free_pages--;
-    g_next_hint = (index + 1u) % g_total_pages;
-    return (void *)(g_range_start + ((uintptr_t)index * (uintptr_t)PAGE_ALLOC_PAGE_SIZE));
+    bitmap_clear_range(g_reserved_bitmap, index, order_pages(order));
+    bitmap_clear_range(g_alloc_bitmap, index, order_pages(order));
+    free_block_coalesce_insert(index, order);
+    released += order_pages(order);
+    index += order_pages(order);
+  }
+
+  g_total_pages += released;
+  g_free_pages += released;
+  return released;
+}
+
+size_t page_alloc_release_range(uintptr_t range_start, uintptr_t range_end) {
+  uint64_t irq_state = ticket_lock_irqsave(&g_alloc_lock);
+  size_t released = page_alloc_release_range_locked(range_start, range_end);
+
+  ticket_unlock_irqrestore(&g_alloc_lock, irq_state);
+  return released;
+}
+
+void page_alloc_init(uintptr_t range_start, uintptr_t range_end) {
+  page_alloc_init_with_metadata(range_start, range_end, g_bootstrap_metadata,
+                                sizeof(g_bootstrap_metadata));
+  (void)page_alloc_release_range(range_start, range_end);
+}
+
+static page_alloc_trace_site_t *trace_site_lookup(uintptr_t caller) {
+  size_t i;
+
+  for (i = 0u; i < g_trace_site_count; ++i) {
+    if (g_trace_sites[i].caller == caller) {
+      return &g_trace_sites[i];
+    }
+  }
+
+  if (g_trace_site_count == PAGE_ALLOC_TRACE_SITES) {
+    return (page_alloc_trace_site_t *)0;
   }
 
-  return 0;
+  g_trace_sites[g_trace_site_count].caller = caller;
+  g_trace_sites[g_trace_site_count].alloc_calls = 0u;
+  g_trace_sites[g_trace_site_count].alloc_pages = 0u;
+  g_trace_sites[g_trace_site_count].free_pages = 0u;
+  return &g_trace_sites[g_trace_site_count++];
+}
+
+static void trace_record(page_alloc_trace_kind_t kind, size_t index, unsigned int order,
+                         uintptr_t caller) {
+  page_alloc_trace_entry_t *entry = &g_trace_ring[g_trace_records % PAGE_ALLOC_TRACE_RING_SIZE];
+  page_alloc_trace_site_t *site = trace_site_lookup(caller);
+
+  entry->timestamp = g_trace_clock != (page_alloc_clock_fn_t)0 ? g_trace_clock() : 0u;
+  entry->caller = caller;
+  entry->page_index = (uint32_t)index;
+  entry->order = (uint8_t)order;
+  entry->kind = (uint8_t)kind;
+  g_trace_records += 1u;
+
+  if (site == (page_alloc_trace_site_t *)0) {
+    if (kind == PAGE_ALLOC_TRACE_ALLOC) {
+      g_trace_untracked_pages += order_pages(order);
+    }
+    return;
+  }
+
+  if (kind == PAGE_ALLOC_TRACE_ALLOC) {
+    site->alloc_calls += 1u;
+    site->alloc_pages += order_pages(order);
+  } else {
+    site->free_pages += order_pages(order);
+  }
+}
+
+static void *page_alloc_order_locked(unsigned int order, uintptr_t caller) {
+  unsigned int found_order;
+  size_t index = 0u;
+
+  if (order > PAGE_ALLOC_MAX_ORDER || g_free_pages < order_pages(order)) {
+    return 0;
+  }
+
+  for (found_order = order; found_order < PAGE_ALLOC_ORDER_COUNT; ++found_order) {
+    if (g_free_blocks[found_order] != 0u && free_block_find(found_order, &index)) {
+      break;
+    }
+  }
+
+  if (found_order == PAGE_ALLOC_ORDER_COUNT) {
+    return 0;
+  }
+
+  free_block_remove(index, found_order);
+  while (found_order > order) {
+    found_order--;
+    free_block_insert(index + order_pages(found_order), found_order);
+  }
+
+  mark_block_allocated(index, order);
+  g_free_pages -= order_pages(order);
+  if (g_trace_enabled) {
+    trace_record(PAGE_ALLOC_TRACE_ALLOC, index, order, caller);
+  }
+  if (g_event_hook != (page_alloc_event_fn_t)0) {
+    g_event_hook(true, (uintptr_t)page_addr_from_index(index), order, caller);
+  }
+  return page_addr_from_index(index);
+}
+
+static void *page_alloc_order_from(unsigned int order, uintptr_t caller) {
+  PERF_SCOPE("page_alloc");
+  uint64_t irq_state = ticket_lock_irqsave(&g_alloc_lock);
+  void *page = page_alloc_order_locked(order, caller);
+
+  ticket_unlock_irqrestore(&g_alloc_lock, irq_state);
+  return page;
+}
+
+void *page_alloc_order(unsigned int order) {
+  return page_alloc_order_from(order, (uintptr_t)__builtin_return_address(0));
+}
+
+void *page_alloc(void) {
+  page_alloc_single_fn_t frontend = __atomic_load_n(&g_frontend_alloc, __ATOMIC_ACQUIRE);
+
+  if (frontend != (page_alloc_single_fn_t)0) {
+    return frontend();
+  }
+  return page_alloc_order_from(0u, (uintptr_t)__builtin_return_address(0));
 }
 
 bool page_alloc_owns(const void *page) {
@@ -131,26 +610,132 @@ bool page_alloc_owns(const void *page) {
   return page_index_from_addr((uintptr_t)page, &index);
 }
 
-bool page_free(void *page) {
+/* Lookups take the lock too, so another hart's split or coalesce is never seen half done. */
+bool page_alloc_is_allocated(const void *page) {
   size_t index;
+  uint64_t irq_state;
+  bool allocated;
 
   if (page == 0 || !page_index_from_addr((uintptr_t)page, &index)) {
     return false;
   }
 
-  if (!bitmap_test(index)) {
+  irq_state = ticket_lock_irqsave(&g_alloc_lock);
+  allocated = allocated_block_matches(index, 0u);
+  ticket_unlock_irqrestore(&g_alloc_lock, irq_state);
+  return allocated;
+}
+
+bool page_alloc_block_order(const void *page, unsigned int *order_out) {
+  size_t index;
+  unsigned int order;
+  uint64_t irq_state;
+  bool found = false;
+
+  if (page == 0 || order_out == (unsigned int *)0 ||
+      !page_index_from_addr((uintptr_t)page, &index)) {
     return false;
   }
 
-  bitmap_clear(index);
-  g_free_pages++;
-  if (index < g_next_hint || g_free_pages == 1u) {
-    g_next_hint = index;
+  irq_state = ticket_lock_irqsave(&g_alloc_lock);
+  for (order = 0u; order <= PAGE_ALLOC_MAX_ORDER; ++order) {
+    if (allocated_block_matches(index, order)) {
+      *order_out = order;
+      found = true;
+      break;
+    }
+  }
+  ticket_unlock_irqrestore(&g_alloc_lock, irq_state);
+
+  return found;
+}
+
+static bool page_cached_test(size_t index) {
+  uint64_t word = __atomic_load_n(&g_cached_bitmap[index / PAGE_ALLOC_BITMAP_WORD_BITS],
+                                  __ATOMIC_ACQUIRE);
+
+  return (word & (1ull << (index % PAGE_ALLOC_BITMAP_WORD_BITS))) != 0u;
+}
+
+bool page_alloc_cache_claim(const void *page) {
+  size_t index;
+  uint64_t mask;
+  uint64_t irq_state;
+  bool claimed = false;
+
+  if (page == 0 || !page_index_from_addr((uintptr_t)page, &index)) {
+    return false;
+  }
+
+  mask = 1ull << (index % PAGE_ALLOC_BITMAP_WORD_BITS);
+  irq_state = ticket_lock_irqsave(&g_alloc_lock);
+  if (allocated_block_matches(index, 0u)) {
+    uint64_t old = __atomic_fetch_or(&g_cached_bitmap[index / PAGE_ALLOC_BITMAP_WORD_BITS],
+                                     mask, __ATOMIC_ACQ_REL);
+
+    claimed = (old & mask) == 0u;
+  }
+  ticket_unlock_irqrestore(&g_alloc_lock, irq_state);
+  return claimed;
+}
+
+void page_alloc_cache_release(const void *page) {
+  size_t index;
+
+  if (page == 0 || !page_index_from_addr((uintptr_t)page, &index)) {
+    return;
+  }
+
+  (void)__atomic_fetch_and(&g_cached_bitmap[index / PAGE_ALLOC_BITMAP_WORD_BITS],
+                           ~(1ull << (index % PAGE_ALLOC_BITMAP_WORD_BITS)), __ATOMIC_ACQ_REL);
+}
+
+static bool page_free_order_locked(void *page, unsigned int order, uintptr_t caller) {
+  size_t index;
+
+  if (page == 0 || order > PAGE_ALLOC_MAX_ORDER ||
+      !page_index_from_addr((uintptr_t)page, &index)) {
+    return false;
+  }
+
+  /* A page parked in a per-hart cache still belongs to that cache. */
+  if (!allocated_block_matches(index, order) || page_cached_test(index)) {
+    return false;
   }
 
+  mark_block_free(index, order);
+  g_free_pages += order_pages(order);
+  free_block_coalesce_insert(index, order);
+  if (g_trace_enabled) {
+    trace_record(PAGE_ALLOC_TRACE_FREE, index, order, caller);
+  }
+  if (g_event_hook != (page_alloc_event_fn_t)0) {
+    g_event_hook(false, (uintptr_t)page, order, caller);
+  }
   return true;
 }
 
+static bool page_free_order_from(void *page, unsigned int order, uintptr_t caller) {
+  uint64_t irq_state = ticket_lock_irqsave(&g_alloc_lock);
+  bool freed = page_free_order_locked(page, order, caller);
+
+  ticket_unlock_irqrestore(&g_alloc_lock, irq_state);
+  return freed;
+}
+
+bool page_free_order(void *page, unsigned int order) {
+  return page_free_order_from(page, order, (uintptr_t)__builtin_return_address(0));
+}
+
+bool page_free(void *page) {
+  page_free_single_fn_t frontend = __atomic_load_n(&g_frontend_free, __ATOMIC_ACQUIRE);
+
+  if (frontend != (page_free_single_fn_t)0) {
+    return frontend(page);
+  }
+  return page_free_order_from(page, 0u, (uintptr_t)__builtin_return_address(0));
+}
+
 uintptr_t page_alloc_range_start(void) {
   return g_range_start;
 }
@@ -166,3 +751,178 @@ size_t page_alloc_total_pages(void) {
 size_t page_alloc_free_pages(void) {
   return g_free_pages;
 }
+
+size_t page_alloc_free_blocks(unsigned int order) {
+  if (order > PAGE_ALLOC_MAX_ORDER) {
+    return 0u;
+  }
+
+  return g_free_blocks[order];
+}
+
+static void frag_report_add_run(page_alloc_frag_report_t *out, size_t run) {
+  unsigned int bucket = 0u;
+
+  if (run == 0u) {
+    return;
+  }
+
+  while (bucket + 1u < PAGE_ALLOC_RUN_BUCKETS && (run >> (bucket + 1u)) != 0u) {
+    bucket++;
+  }
+
+  out->free_runs += 1u;
+  out->free_pages += run;
+  out->run_histogram[bucket] += 1u;
+  if (run > out->largest_free_run) {
+    out->largest_free_run = run;
+  }
+}
+
+void page_alloc_fragmentation(page_alloc_frag_report_t *out) {
+  size_t index = 0u;
+  size_t run = 0u;
+  unsigned int bucket;
+  uint64_t irq_state;
+
+  if (out == (page_alloc_frag_report_t *)0) {
+    return;
+  }
+
+  irq_state = ticket_lock_irqsave(&g_alloc_lock);
+
+  out->free_pages = 0u;
+  out->free_runs = 0u;
+  out->largest_free_run = 0u;
+  for (bucket = 0u; bucket < PAGE_ALLOC_RUN_BUCKETS; ++bucket) {
+    out->run_histogram[bucket] = 0u;
+  }
+
+  /* Free pages are exactly the clear bits of the alloc bitmap; whole words are skipped. */
+  while (index < g_span_pages) {
+    if ((index % PAGE_ALLOC_BITMAP_WORD_BITS) == 0u &&
+        index + PAGE_ALLOC_BITMAP_WORD_BITS <= g_span_pages) {
+      uint64_t word = g_alloc_bitmap[index / PAGE_ALLOC_BITMAP_WORD_BITS];
+
+      if (word == 0u) {
+        run += PAGE_ALLOC_BITMAP_WORD_BITS;
+        index += PAGE_ALLOC_BITMAP_WORD_BITS;
+        continue;
+      }
+      if (word == ~0ull) {
+        frag_report_add_run(out, run);
+        run = 0u;
+        index += PAGE_ALLOC_BITMAP_WORD_BITS;
+        continue;
+      }
+    }
+
+    if (bitmap_test(g_alloc_bitmap, index)) {
+      frag_report_add_run(out, run);
+      run = 0u;
+    } else {
+      run++;
+    }
+    index++;
+  }
+
+  frag_report_add_run(out, run);
+  ticket_unlock_irqrestore(&g_alloc_lock, irq_state);
+}
+
+void page_alloc_trace_enable(page_alloc_clock_fn_t clock) {
+  uint64_t irq_state = ticket_lock_irqsave(&g_alloc_lock);
+
+  g_trace_clock = clock;
+  g_trace_records = 0u;
+  g_trace_site_count = 0u;
+  g_trace_untracked_pages = 0u;
+  g_trace_enabled = true;
+  ticket_unlock_irqrestore(&g_alloc_lock, irq_state);
+}
+
+void page_alloc_set_event_hook(page_alloc_event_fn_t hook) {
+  __atomic_store_n(&g_event_hook, hook, __ATOMIC_RELEASE);
+}
+
+void page_alloc_set_frontend(page_alloc_single_fn_t alloc, page_free_single_fn_t free_fn) {
+  __atomic_store_n(&g_frontend_free, free_fn, __ATOMIC_RELEASE);
+  __atomic_store_n(&g_frontend_alloc, alloc, __ATOMIC_RELEASE);
+}
+
+void page_alloc_trace_disable(void) {
+  g_trace_enabled = false;
+}
+
+bool page_alloc_trace_enabled(void) {
+  return g_trace_enabled;
+}
+
+uint64_t page_alloc_trace_records(void) {
+  return g_trace_records;
+}
+
+uint64_t page_alloc_trace_untracked_pages(void) {
+  return g_trace_untracked_pages;
+}
+
+/* The ring and site table are written under g_alloc_lock, so readers copy them under it. */
+size_t page_alloc_trace_snapshot(page_alloc_trace_entry_t *out, size_t max) {
+  uint64_t available;
+  uint64_t first;
+  uint64_t irq_state;
+  size_t count;
+  size_t i;
+
+  if (out == (page_alloc_trace_entry_t *)0) {
+    return 0u;
+  }
+
+  irq_state = ticket_lock_irqsave(&g_alloc_lock);
+  available = g_trace_records;
+  if (available > PAGE_ALLOC_TRACE_RING_SIZE) {
+    available = PAGE_ALLOC_TRACE_RING_SIZE;
+  }
+  count = available < (uint64_t)max ? (size_t)available : max;
+  first = g_trace_records - count;
+
+  for (i = 0u; i < count; ++i) {
+    out[i] = g_trace_ring[(first + i) % PAGE_ALLOC_TRACE_RING_SIZE];
+  }
+  ticket_unlock_irqrestore(&g_alloc_lock, irq_state);
+
+  return count;
+}
+
+size_t page_alloc_trace_top_sites(page_alloc_trace_site_t *out, size_t max) {
+  size_t count = 0u;
+  uint64_t irq_state;
+  size_t i;
+
+  if (out == (page_alloc_trace_site_t *)0) {
+    return 0u;
+  }
+
+  irq_state = ticket_lock_irqsave(&g_alloc_lock);
+  /* Insertion into a bounded sorted output; the site table is tiny. */
+  for (i = 0u; i < g_trace_site_count; ++i) {
+    size_t pos = count < max ? count : max;
+
+    while (pos > 0u && out[pos - 1u].alloc_pages < g_trace_sites[i].alloc_pages) {
+      if (pos < max) {
+        out[pos] = out[pos - 1u];
+      }
+      pos--;
+    }
+
+    if (pos < max) {
+      out[pos] = g_trace_sites[i];
+      if (count < max) {
+        count++;
+      }
+    }
+  }
+  ticket_unlock_irqrestore(&g_alloc_lock, irq_state);
+
+  return count;
+}
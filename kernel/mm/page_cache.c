@@ -0,0 +1,168 @@
+#include "page_cache.h"
+
+#include "hart.h"
+#include "page_alloc.h"
+#include "riscv_irq.h"
+
+/*
+ * Per-hart single-page magazines in front of page_alloc()/page_free(). Hits only touch
+ * the calling hart's magazine; the buddy allocator is entered once per PAGE_CACHE_BATCH
+ * pages on refill (empty magazine) or drain (full magazine). Magazine updates run with
+ * interrupts masked, so an interrupt handler on the same hart never sees one half-done.
+ * Every parked page carries page_alloc's cached mark, so a page freed on two harts, or
+ * freed straight to the buddy allocator while parked, is rejected.
+ */
+
+enum {
+  PAGE_CACHE_LINE_SIZE = 64,
+};
+
+typedef struct page_cache_magazine {
+  _Alignas(PAGE_CACHE_LINE_SIZE) void *pages[PAGE_CACHE_MAGAZINE_SIZE];
+  uint32_t count;
+  page_cache_stats_t stats;
+} page_cache_magazine_t;
+
+static page_cache_magazine_t g_magazines[HART_MAX_HARTS];
+
+static page_cache_magazine_t *page_cache_local(void) {
+  uint32_t hart_id = hart_current_id();
+
+  if (hart_id >= (uint32_t)HART_MAX_HARTS) {
+    return (page_cache_magazine_t *)0;
+  }
+
+  return &g_magazines[hart_id];
+}
+
+static void page_cache_refill(page_cache_magazine_t *magazine) {
+  uint32_t i;
+
+  for (i = 0u; i < PAGE_CACHE_BATCH && magazine->count < PAGE_CACHE_MAGAZINE_SIZE; ++i) {
+    void *page = page_alloc_order(0u);
+
+    if (page == 0) {
+      break;
+    }
+    (void)page_alloc_cache_claim(page);
+    magazine->pages[magazine->count++] = page;
+  }
+
+  magazine->stats.refills += 1u;
+}
+
+static void page_cache_drain(page_cache_magazine_t *magazine, uint32_t pages) {
+  while (pages > 0u && magazine->count > 0u) {
+    magazine->count--;
+    page_alloc_cache_release(magazine->pages[magazine->count]);
+    (void)page_free_order(magazine->pages[magazine->count], 0u);
+    pages--;
+  }
+
+  magazine->stats.drains += 1u;
+}
+
+void page_cache_init(void) {
+  uint32_t hart;
+  uint32_t i;
+
+  for (hart = 0u; hart < (uint32_t)HART_MAX_HARTS; ++hart) {
+    for (i = 0u; i < PAGE_CACHE_MAGAZINE_SIZE; ++i) {
+      g_magazines[hart].pages[i] = 0;
+    }
+    g_magazines[hart].count = 0u;
+    g_magazines[hart].stats.alloc_hits = 0u;
+    g_magazines[hart].stats.free_hits = 0u;
+    g_magazines[hart].stats.refills = 0u;
+    g_magazines[hart].stats.drains = 0u;
+    g_magazines[hart].stats.cached_pages = 0u;
+  }
+  page_alloc_set_frontend(page_cache_alloc, page_cache_free);
+}
+
+void *page_cache_alloc(void) {
+  uint64_t irq_state = riscv_irq_save();
+  page_cache_magazine_t *magazine = page_cache_local();
+  void *page = 0;
+
+  if (magazine == (page_cache_magazine_t *)0) {
+    page = page_alloc_order(0u);
+  } else {
+    if (magazine->count == 0u) {
+      page_cache_refill(magazine);
+    } else {
+      magazine->stats.alloc_hits += 1u;
+    }
+    if (magazine->count > 0u) {
+      magazine->count--;
+      page = magazine->pages[magazine->count];
+      page_alloc_cache_release(page);
+    }
+  }
+
+  riscv_irq_restore(irq_state);
+  return page;
+}
+
+bool page_cache_free(void *page) {
+  uint64_t irq_state;
+  page_cache_magazine_t *magazine;
+  bool freed = false;
+
+  if (page == 0) {
+    return false;
+  }
+
+  irq_state = riscv_irq_save();
+  magazine = page_cache_local();
+  if (magazine == (page_cache_magazine_t *)0) {
+    freed = page_free_order(page, 0u);
+  } else if (page_alloc_cache_claim(page)) {
+    if (magazine->count == PAGE_CACHE_MAGAZINE_SIZE) {
+      page_cache_drain(magazine, PAGE_CACHE_BATCH);
+    } else {
+      magazine->stats.free_hits += 1u;
+    }
+    magazine->pages[magazine->count++] = page;
+    freed = true;
+  }
+
+  riscv_irq_restore(irq_state);
+  return freed;
+}
+
+void page_cache_drain_hart(uint32_t hart_id) {
+  uint64_t irq_state;
+
+  if (hart_id >= (uint32_t)HART_MAX_HARTS) {
+    return;
+  }
+
+  /* Only the owning hart or a quiesced one may be drained: masking is per hart. */
+  irq_state = riscv_irq_save();
+  if (g_magazines[hart_id].count != 0u) {
+    page_cache_drain(&g_magazines[hart_id], g_magazines[hart_id].count);
+  }
+  riscv_irq_restore(irq_state);
+}
+
+size_t page_cache_cached_pages(void) {
+  size_t total = 0u;
+  uint32_t hart;
+
+  for (hart = 0u; hart < (uint32_t)HART_MAX_HARTS; ++hart) {
+    total += g_magazines[hart].count;
+  }
+
+  return total;
+}
+
+bool page_cache_stats(uint32_t hart_id, page_cache_stats_t *out) {
+  if (hart_id >= (uint32_t)HART_MAX_HARTS || out == (page_cache_stats_t *)0) {
+    return false;
+  }
+
+  *out = g_magazines[hart_id].stats;
+  out->cached_pages = g_magazines[hart_id].count;
+  return true;
+}
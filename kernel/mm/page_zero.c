@@ -0,0 +1,149 @@
+#include "page_zero.h"
+
+#include "page_alloc.h"
+#include "spinlock.h"
+
+/*
+ * Pool of pages that were cleared ahead of time from the idle loop.
+ * page_alloc_zeroed() pops a cleared page when one is ready and only falls
+ * back to allocate-then-clear on the caller's path when the pool is empty.
+ * Pooled pages stay allocated in page_alloc until they are handed out.
+ * Every hart runs the idle refill, so the pool and its counters sit behind an
+ * irqsave lock; pages are cleared outside it.
+ */
+
+static void *g_zero_pool[PAGE_ZERO_POOL_CAPACITY];
+static uint32_t g_zero_depth;
+static uint32_t g_zero_target;
+static uint64_t g_zero_hits;
+static uint64_t g_zero_misses;
+static uint64_t g_zero_idle_zeroed;
+static spinlock_t g_zero_lock;
+static lock_stats_t g_zero_lock_stats;
+
+static void page_zero_clear(void *page) {
+  volatile uint64_t *words = (volatile uint64_t *)page;
+  uint32_t i;
+
+  for (i = 0u; i < PAGE_ALLOC_PAGE_SIZE / sizeof(uint64_t); ++i) {
+    words[i] = 0u;
+  }
+}
+
+void page_zero_init(uint32_t target_depth) {
+  uint32_t i;
+
+  lock_stats_register(&g_zero_lock_stats, "zero_pool");
+  spinlock_init(&g_zero_lock, &g_zero_lock_stats);
+  for (i = 0u; i < PAGE_ZERO_POOL_CAPACITY; ++i) {
+    g_zero_pool[i] = 0;
+  }
+
+  if (target_depth > PAGE_ZERO_POOL_CAPACITY) {
+    target_depth = PAGE_ZERO_POOL_CAPACITY;
+  }
+
+  g_zero_depth = 0u;
+  g_zero_target = target_depth;
+  g_zero_hits = 0u;
+  g_zero_misses = 0u;
+  g_zero_idle_zeroed = 0u;
+}
+
+void *page_alloc_zeroed(void) {
+  void *page;
+  uint64_t irq_state = spin_lock_irqsave(&g_zero_lock);
+
+  if (g_zero_depth > 0u) {
+    g_zero_depth--;
+    g_zero_hits += 1u;
+    page = g_zero_pool[g_zero_depth];
+    g_zero_pool[g_zero_depth] = 0;
+    spin_unlock_irqrestore(&g_zero_lock, irq_state);
+    return page;
+  }
+  spin_unlock_irqrestore(&g_zero_lock, irq_state);
+
+  page = page_alloc();
+  if (page == 0) {
+    return 0;
+  }
+
+  page_zero_clear(page);
+  irq_state = spin_lock_irqsave(&g_zero_lock);
+  g_zero_misses += 1u;
+  spin_unlock_irqrestore(&g_zero_lock, irq_state);
+  return page;
+}
+
+uint32_t page_zero_idle_work(uint32_t max_pages) {
+  uint32_t zeroed = 0u;
+  uint64_t irq_state;
+
+  while (zeroed < max_pages) {
+    void *page;
+    bool pooled = false;
+
+    irq_state = spin_lock_irqsave(&g_zero_lock);
+    if (g_zero_depth >= g_zero_target) {
+      spin_unlock_irqrestore(&g_zero_lock, irq_state);
+      break;
+    }
+    spin_unlock_irqrestore(&g_zero_lock, irq_state);
+
+    page = page_alloc();
+    if (page == 0) {
+      break;
+    }
+
+    page_zero_clear(page);
+    /* Another hart may have filled the pool while this page was being cleared. */
+    irq_state = spin_lock_irqsave(&g_zero_lock);
+    if (g_zero_depth < g_zero_target) {
+      g_zero_pool[g_zero_depth++] = page;
+      g_zero_idle_zeroed += 1u;
+      pooled = true;
+    }
+    spin_unlock_irqrestore(&g_zero_lock, irq_state);
+
+    if (!pooled) {
+      (void)page_free(page);
+      break;
+    }
+    zeroed++;
+  }
+
+  return zeroed;
+}
+
+void page_zero_release(void) {
+  uint64_t irq_state = spin_lock_irqsave(&g_zero_lock);
+
+  while (g_zero_depth > 0u) {
+    void *page;
+
+    g_zero_depth--;
+    page = g_zero_pool[g_zero_depth];
+    g_zero_pool[g_zero_depth] = 0;
+    spin_unlock_irqrestore(&g_zero_lock, irq_state);
+    (void)page_free(page);
+    irq_state = spin_lock_irqsave(&g_zero_lock);
+  }
+  spin_unlock_irqrestore(&g_zero_lock, irq_state);
+}
+
+void page_zero_get_stats(page_zero_stats_t *out) {
+  uint64_t irq_state;
+
+  if (out == (page_zero_stats_t *)0) {
+    return;
+  }
+
+  irq_state = spin_lock_irqsave(&g_zero_lock);
+  out->depth = g_zero_depth;
+  out->target = g_zero_target;
+  out->hits = g_zero_hits;
+  out->misses = g_zero_misses;
+  out->idle_zeroed = g_zero_idle_zeroed;
+  spin_unlock_irqrestore(&g_zero_lock, irq_state);
+}
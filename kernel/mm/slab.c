@@ -0,0 +1,366 @@
+#include "slab.h"
+
+#include "bitops.h"
+#include "page_alloc.h"
+#include "page_cache.h"
+#include "page_zero.h"
+
+/*
+ * Each slab is one page: a two-cache-line header followed by objects whose
+ * stride is a power of two up to 64 bytes and a multiple of 64 beyond that,
+ * so no object straddles a cache line it does not own. Free objects are
+ * tracked in a header bitmap and found with ctz, which also catches double
+ * frees. kmalloc() sizes above SLAB_MAX_OBJECT_SIZE go to page_alloc_order().
+ * Each cache has its own spinlock, so different size classes never contend.
+ */
+
+enum {
+  SLAB_HEADER_SIZE = 2u * SLAB_CACHE_LINE_SIZE,
+  SLAB_BITMAP_WORD_BITS = 64u,
+  SLAB_MAX_OBJECTS = (PAGE_ALLOC_PAGE_SIZE - SLAB_HEADER_SIZE) / SLAB_MIN_OBJECT_SIZE,
+  SLAB_BITMAP_WORDS = (SLAB_MAX_OBJECTS + SLAB_BITMAP_WORD_BITS - 1u) / SLAB_BITMAP_WORD_BITS,
+  SLAB_MAGIC = 0x534c4142u,
+  KMALLOC_CACHE_COUNT = 8u,
+};
+
+typedef struct slab_page {
+  uint32_t magic;
+  uint32_t free_objects;
+  slab_cache_t *cache;
+  struct slab_page *next;
+  struct slab_page *prev;
+  uint64_t free_bitmap[SLAB_BITMAP_WORDS];
+} slab_page_t;
+
+_Static_assert(sizeof(slab_page_t) <= SLAB_HEADER_SIZE, "slab header too large");
+
+static const char *const k_kmalloc_names[KMALLOC_CACHE_COUNT] = {
+    "kmalloc-16",  "kmalloc-32",  "kmalloc-64",   "kmalloc-128",
+    "kmalloc-256", "kmalloc-512", "kmalloc-1024", "kmalloc-2048",
+};
+
+static slab_cache_t g_kmalloc_caches[KMALLOC_CACHE_COUNT];
+
+static uint32_t slab_stride_for(uint32_t size) {
+  uint32_t stride = SLAB_MIN_OBJECT_SIZE;
+
+  if (size > SLAB_CACHE_LINE_SIZE) {
+    return (size + SLAB_CACHE_LINE_SIZE - 1u) & ~(SLAB_CACHE_LINE_SIZE - 1u);
+  }
+
+  while (stride < size) {
+    stride <<= 1u;
+  }
+  return stride;
+}
+
+static uint8_t *slab_objects_base(slab_page_t *slab) {
+  return (uint8_t *)slab + SLAB_HEADER_SIZE;
+}
+
+static void slab_list_remove(slab_page_t **head, slab_page_t *slab) {
+  if (slab->prev != (slab_page_t *)0) {
+    slab->prev->next = slab->next;
+  } else {
+    *head = slab->next;
+  }
+  if (slab->next != (slab_page_t *)0) {
+    slab->next->prev = slab->prev;
+  }
+
+  slab->next = (slab_page_t *)0;
+  slab->prev = (slab_page_t *)0;
+}
+
+static void slab_list_push(slab_page_t **head, slab_page_t *slab) {
+  slab->prev = (slab_page_t *)0;
+  slab->next = *head;
+  if (*head != (slab_page_t *)0) {
+    (*head)->prev = slab;
+  }
+  *head = slab;
+}
+
+static slab_page_t *slab_create(slab_cache_t *cache) {
+  slab_page_t *slab = (slab_page_t *)page_cache_alloc();
+  uint32_t i;
+
+  if (slab == (slab_page_t *)0) {
+    return (slab_page_t *)0;
+  }
+
+  slab->magic = SLAB_MAGIC;
+  slab->free_objects = cache->objects_per_slab;
+  slab->cache = cache;
+  slab->next = (slab_page_t *)0;
+  slab->prev = (slab_page_t *)0;
+  for (i = 0u; i < SLAB_BITMAP_WORDS; ++i) {
+    slab->free_bitmap[i] = 0u;
+  }
+  for (i = 0u; i < cache->objects_per_slab; ++i) {
+    slab->free_bitmap[i / SLAB_BITMAP_WORD_BITS] |= 1ull << (i % SLAB_BITMAP_WORD_BITS);
+  }
+
+  cache->slab_count += 1u;
+  return slab;
+}
+
+static void slab_destroy(slab_cache_t *cache, slab_page_t *slab) {
+  slab->magic = 0u;
+  cache->slab_count -= 1u;
+  (void)page_cache_free(slab);
+}
+
+static void *slab_take_object(slab_page_t *slab) {
+  uint32_t word;
+
+  for (word = 0u; word < SLAB_BITMAP_WORDS; ++word) {
+    uint32_t bit;
+
+    if (slab->free_bitmap[word] == 0u) {
+      continue;
+    }
+
+    bit = bitops_ctz64(slab->free_bitmap[word]);
+    slab->free_bitmap[word] &= ~(1ull << bit);
+    slab->free_objects -= 1u;
+    return slab_objects_base(slab) +
+           ((size_t)((word * SLAB_BITMAP_WORD_BITS) + bit) * slab->cache->stride);
+  }
+
+  return 0;
+}
+
+static slab_page_t *slab_from_object(const void *object) {
+  uintptr_t page = (uintptr_t)object & ~((uintptr_t)PAGE_ALLOC_PAGE_SIZE - 1u);
+  slab_page_t *slab = (slab_page_t *)page;
+
+  if (object == 0 || (uintptr_t)object == page || !page_alloc_owns((const void *)page) ||
+      slab->magic != SLAB_MAGIC) {
+    return (slab_page_t *)0;
+  }
+
+  return slab;
+}
+
+bool slab_cache_init(slab_cache_t *cache, const char *name, size_t object_size) {
+  if (cache == (slab_cache_t *)0 || object_size == 0u || object_size > SLAB_MAX_OBJECT_SIZE) {
+    return false;
+  }
+
+  spinlock_init(&cache->lock, (lock_stats_t *)0);
+  cache->name = name;
+  cache->object_size = (uint32_t)object_size;
+  cache->stride = slab_stride_for((uint32_t)object_size);
+  cache->objects_per_slab = (PAGE_ALLOC_PAGE_SIZE - SLAB_HEADER_SIZE) / cache->stride;
+  cache->partial = (slab_page_t *)0;
+  cache->full = (slab_page_t *)0;
+  cache->empty = (slab_page_t *)0;
+  cache->alloc_count = 0u;
+  cache->free_count = 0u;
+  cache->slab_count = 0u;
+  cache->active_objects = 0u;
+  return true;
+}
+
+void *slab_alloc(slab_cache_t *cache) {
+  slab_page_t *slab;
+  void *object;
+  uint64_t irq_state;
+
+  if (cache == (slab_cache_t *)0 || cache->stride == 0u) {
+    return 0;
+  }
+
+  irq_state = spin_lock_irqsave(&cache->lock);
+  slab = cache->partial;
+  if (slab == (slab_page_t *)0) {
+    slab = cache->empty;
+    if (slab != (slab_page_t *)0) {
+      cache->empty = (slab_page_t *)0;
+    } else {
+      slab = slab_create(cache);
+      if (slab == (slab_page_t *)0) {
+        spin_unlock_irqrestore(&cache->lock, irq_state);
+        return 0;
+      }
+    }
+    slab_list_push(&cache->partial, slab);
+  }
+
+  object = slab_take_object(slab);
+  if (slab->free_objects == 0u) {
+    slab_list_remove(&cache->partial, slab);
+    slab_list_push(&cache->full, slab);
+  }
+
+  cache->alloc_count += 1u;
+  cache->active_objects += 1u;
+  spin_unlock_irqrestore(&cache->lock, irq_state);
+  return object;
+}
+
+bool slab_free(slab_cache_t *cache, void *object) {
+  slab_page_t *slab = slab_from_object(object);
+  size_t offset;
+  uint32_t index;
+  uint64_t mask;
+  uint64_t irq_state;
+
+  if (slab == (slab_page_t *)0 || slab->cache != cache) {
+    return false;
+  }
+
+  offset = (size_t)((uint8_t *)object - slab_objects_base(slab));
+  if ((uint8_t *)object < slab_objects_base(slab) || (offset % cache->stride) != 0u) {
+    return false;
+  }
+
+  index = (uint32_t)(offset / cache->stride);
+  if (index >= cache->objects_per_slab) {
+    return false;
+  }
+
+  mask = 1ull << (index % SLAB_BITMAP_WORD_BITS);
+  irq_state = spin_lock_irqsave(&cache->lock);
+  if ((slab->free_bitmap[index / SLAB_BITMAP_WORD_BITS] & mask) != 0u) {
+    spin_unlock_irqrestore(&cache->lock, irq_state);
+    return false;
+  }
+
+  if (slab->free_objects == 0u) {
+    slab_list_remove(&cache->full, slab);
+    slab_list_push(&cache->partial, slab);
+  }
+
+  slab->free_bitmap[index / SLAB_BITMAP_WORD_BITS] |= mask;
+  slab->free_objects += 1u;
+  cache->free_count += 1u;
+  cache->active_objects -= 1u;
+
+  if (slab->free_objects == cache->objects_per_slab) {
+    slab_list_remove(&cache->partial, slab);
+    if (cache->empty == (slab_page_t *)0) {
+      cache->empty = slab;
+    } else {
+      slab_destroy(cache, slab);
+    }
+  }
+
+  spin_unlock_irqrestore(&cache->lock, irq_state);
+  return true;
+}
+
+void slab_cache_shrink(slab_cache_t *cache) {
+  uint64_t irq_state;
+
+  if (cache == (slab_cache_t *)0) {
+    return;
+  }
+
+  irq_state = spin_lock_irqsave(&cache->lock);
+  if (cache->empty != (slab_page_t *)0) {
+    slab_destroy(cache, cache->empty);
+    cache->empty = (slab_page_t *)0;
+  }
+  spin_unlock_irqrestore(&cache->lock, irq_state);
+}
+
+void kmalloc_init(void) {
+  uint32_t i;
+
+  for (i = 0u; i < KMALLOC_CACHE_COUNT; ++i) {
+    (void)slab_cache_init(&g_kmalloc_caches[i], k_kmalloc_names[i], SLAB_MIN_OBJECT_SIZE << i);
+  }
+}
+
+static unsigned int kmalloc_large_order(size_t size) {
+  unsigned int order = 0u;
+
+  while (order < PAGE_ALLOC_MAX_ORDER &&
+         ((size_t)PAGE_ALLOC_PAGE_SIZE << order) < size) {
+    order++;
+  }
+
+  return order;
+}
+
+void *kmalloc(size_t size) {
+  uint32_t i;
+
+  if (size == 0u) {
+    return 0;
+  }
+
+  if (size > SLAB_MAX_OBJECT_SIZE) {
+    unsigned int order = kmalloc_large_order(size);
+
+    if (((size_t)PAGE_ALLOC_PAGE_SIZE << order) < size) {
+      return 0;
+    }
+    return page_alloc_order(order);
+  }
+
+  for (i = 0u; i < KMALLOC_CACHE_COUNT; ++i) {
+    if (size <= g_kmalloc_caches[i].object_size) {
+      return slab_alloc(&g_kmalloc_caches[i]);
+    }
+  }
+
+  return 0;
+}
+
+void *kzalloc(size_t size) {
+  uint8_t *ptr;
+  size_t i;
+
+  if (size > SLAB_MAX_OBJECT_SIZE && size <= PAGE_ALLOC_PAGE_SIZE) {
+    return page_alloc_zeroed();
+  }
+
+  ptr = (uint8_t *)kmalloc(size);
+  if (ptr == (uint8_t *)0) {
+    return 0;
+  }
+
+  for (i = 0u; i < size; ++i) {
+    ptr[i] = 0u;
+  }
+
+  return ptr;
+}
+
+bool kfree(void *ptr) {
+  slab_page_t *slab;
+  unsigned int order;
+
+  if (ptr == 0) {
+    return false;
+  }
+
+  if (((uintptr_t)ptr & ((uintptr_t)PAGE_ALLOC_PAGE_SIZE - 1u)) == 0u) {
+    if (!page_alloc_block_order(ptr, &order)) {
+      return false;
+    }
+    return page_free_order(ptr, order);
+  }
+
+  slab = slab_from_object(ptr);
+  if (slab == (slab_page_t *)0) {
+    return false;
+  }
+
+  return slab_free(slab->cache, ptr);
+}
+
+const slab_cache_t *kmalloc_cache(size_t index) {
+  if (index >= KMALLOC_CACHE_COUNT) {
+    return (const slab_cache_t *)0;
+  }
+
+  return &g_kmalloc_caches[index];
+}
+
+size_t kmalloc_cache_count(void) {
+  return KMALLOC_CACHE_COUNT;
+}
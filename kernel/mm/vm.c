@@ -0,0 +1,217 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mmu.h"
+#include "page_alloc.h"
+#include "page_zero.h"
+#include "vm.h"
+
+enum {
+  VM_PTE_PPN_SHIFT = 10u,
+  VM_PAGE_SHIFT = 12u,
+  VM_VPN_BITS = 9u,
+  VM_LEAF_PERMS = VM_PTE_R | VM_PTE_W | VM_PTE_X,
+};
+
+static const uint64_t k_satp_mode_sv39 = 8ull << 60;
+
+static unsigned int vm_vpn(uintptr_t va, unsigned int level) {
+  return (unsigned int)((va >> (VM_PAGE_SHIFT + (VM_VPN_BITS * level))) &
+                        (VM_PTES_PER_TABLE - 1u));
+}
+
+static vm_pte_t vm_make_pte(uintptr_t pa, uint64_t flags) {
+  return (((uint64_t)pa >> VM_PAGE_SHIFT) << VM_PTE_PPN_SHIFT) | flags;
+}
+
+static uintptr_t vm_pte_pa(vm_pte_t pte) {
+  return (uintptr_t)((pte >> VM_PTE_PPN_SHIFT) << VM_PAGE_SHIFT);
+}
+
+static bool vm_pte_is_leaf(vm_pte_t pte) {
+  return (pte & VM_LEAF_PERMS) != 0u;
+}
+
+static bool vm_is_aligned(uintptr_t addr, unsigned int level) {
+  return (addr & (vm_level_size(level) - 1u)) == 0u;
+}
+
+int vm_space_init(vm_space_t *space) {
+  unsigned int level;
+
+  if (space == (vm_space_t *)0) {
+    return -1;
+  }
+
+  space->root = (vm_pte_t *)page_alloc_zeroed();
+  if (space->root == (vm_pte_t *)0) {
+    return -1;
+  }
+
+  space->table_pages = 1u;
+  for (level = 0u; level < VM_LEVELS; ++level) {
+    space->leaf_count[level] = 0u;
+  }
+
+  return 0;
+}
+
+/* Returns the slot for `va` at `level`, allocating intermediate tables when `create` is set. */
+static vm_pte_t *vm_walk(vm_space_t *space, uintptr_t va, unsigned int level, bool create) {
+  vm_pte_t *table = space->root;
+  unsigned int current;
+
+  for (current = VM_LEVELS - 1u; current > level; --current) {
+    vm_pte_t *slot = &table[vm_vpn(va, current)];
+
+    if ((*slot & VM_PTE_V) == 0u) {
+      vm_pte_t *next;
+
+      if (!create) {
+        return (vm_pte_t *)0;
+      }
+
+      next = (vm_pte_t *)page_alloc_zeroed();
+      if (next == (vm_pte_t *)0) {
+        return (vm_pte_t *)0;
+      }
+
+      space->table_pages += 1u;
+      *slot = vm_make_pte((uintptr_t)next, VM_PTE_V);
+    } else if (vm_pte_is_leaf(*slot)) {
+      return (vm_pte_t *)0;
+    }
+
+    table = (vm_pte_t *)vm_pte_pa(*slot);
+  }
+
+  return &table[vm_vpn(va, level)];
+}
+
+int vm_map(vm_space_t *space, uintptr_t va, uintptr_t pa, size_t size, uint64_t perms,
+           unsigned int max_level) {
+  uint64_t flags = (perms & (VM_LEAF_PERMS | VM_PTE_U | VM_PTE_G)) | VM_PTE_V | VM_PTE_A |
+                   VM_PTE_D;
+  uintptr_t end = va + (uintptr_t)size;
+
+  if (space == (vm_space_t *)0 || space->root == (vm_pte_t *)0 ||
+      (perms & VM_LEAF_PERMS) == 0u || !vm_is_aligned(va, 0u) || !vm_is_aligned(pa, 0u) ||
+      !vm_is_aligned((uintptr_t)size, 0u) || end < va || (uint64_t)end > VM_VA_LIMIT) {
+    return -1;
+  }
+  if (max_level >= VM_LEVELS) {
+    max_level = VM_LEVELS - 1u;
+  }
+
+  while (va < end) {
+    unsigned int level = max_level;
+    vm_pte_t *slot;
+
+    while (level > 0u && (!vm_is_aligned(va, level) || !vm_is_aligned(pa, level) ||
+                          (uint64_t)(end - va) < vm_level_size(level))) {
+      level--;
+    }
+
+    slot = vm_walk(space, va, level, true);
+    if (slot == (vm_pte_t *)0 || (*slot & VM_PTE_V) != 0u) {
+      return -1;
+    }
+
+    *slot = vm_make_pte(pa, flags);
+    space->leaf_count[level] += 1u;
+    va += (uintptr_t)vm_level_size(level);
+    pa += (uintptr_t)vm_level_size(level);
+  }
+
+  return 0;
+}
+
+/* Finds the leaf covering `va`; the returned level says how large it is. */
+static vm_pte_t *vm_find_leaf(const vm_space_t *space, uintptr_t va, unsigned int *level_out) {
+  vm_pte_t *table = space->root;
+  unsigned int level = VM_LEVELS;
+
+  while (level > 0u) {
+    vm_pte_t *slot;
+
+    level--;
+    slot = &table[vm_vpn(va, level)];
+    if ((*slot & VM_PTE_V) == 0u) {
+      return (vm_pte_t *)0;
+    }
+    if (vm_pte_is_leaf(*slot)) {
+      *level_out = level;
+      return slot;
+    }
+    if (level == 0u) {
+      return (vm_pte_t *)0;
+    }
+
+    table = (vm_pte_t *)vm_pte_pa(*slot);
+  }
+
+  return (vm_pte_t *)0;
+}
+
+int vm_unmap(vm_space_t *space, uintptr_t va, size_t size) {
+  uintptr_t end = va + (uintptr_t)size;
+  int result = 0;
+
+  if (space == (vm_space_t *)0 || space->root == (vm_pte_t *)0 || !vm_is_aligned(va, 0u) ||
+      !vm_is_aligned((uintptr_t)size, 0u) || end < va || (uint64_t)end > VM_VA_LIMIT) {
+    return -1;
+  }
+
+  while (va < end) {
+    unsigned int level = 0u;
+    vm_pte_t *slot = vm_find_leaf(space, va, &level);
+
+    if (slot == (vm_pte_t *)0) {
+      va += (uintptr_t)vm_level_size(0u);
+      continue;
+    }
+
+    /* A huge leaf is only removed when the range covers all of it. */
+    if (!vm_is_aligned(va, level) || (uint64_t)(end - va) < vm_level_size(level)) {
+      result = -1;
+      break;
+    }
+
+    *slot = 0u;
+    space->leaf_count[level] -= 1u;
+    va += (uintptr_t)vm_level_size(level);
+  }
+
+  mmu_flush_tlb();
+  return result;
+}
+
+bool vm_translate(const vm_space_t *space, uintptr_t va, uintptr_t *pa_out,
+                  unsigned int *level_out) {
+  unsigned int level = 0u;
+  vm_pte_t *slot;
+
+  if (space == (const vm_space_t *)0 || space->root == (vm_pte_t *)0 ||
+      (uint64_t)va >= VM_VA_LIMIT) {
+    return false;
+  }
+
+  slot = vm_find_leaf(space, va, &level);
+  if (slot == (vm_pte_t *)0) {
+    return false;
+  }
+
+  if (pa_out != (uintptr_t *)0) {
+    *pa_out = vm_pte_pa(*slot) + (va & (uintptr_t)(vm_level_size(level) - 1u));
+  }
+  if (level_out != (unsigned int *)0) {
+    *level_out = level;
+  }
+
+  return true;
+}
+
+uint64_t vm_space_satp(const vm_space_t *space) {
+  return k_satp_mode_sv39 | ((uint64_t)(uintptr_t)space->root >> VM_PAGE_SHIFT);
+}
@@ -0,0 +1,146 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "clock.h"
+#include "mmu.h"
+#include "page_alloc.h"
+#include "plic.h"
+#include "rtc.h"
+#include "uart.h"
+#include "vm.h"
+#include "vm_kernel.h"
+
+enum {
+  VM_BENCH_WINDOW_BYTES = 32u * 1024u * 1024u,
+  /* Cache lines per page; the read offset walks them so the window is not cache-bound. */
+  VM_BENCH_LINES_PER_PAGE = 64u,
+};
+
+/* Alias windows for the TLB benchmark, well away from the identity map. */
+static const uintptr_t k_bench_small_va = 0x2000000000ull;
+static const uintptr_t k_bench_huge_va = 0x3000000000ull;
+
+typedef struct vm_mmio_region {
+  uintptr_t base;
+  size_t size;
+} vm_mmio_region_t;
+
+static const vm_mmio_region_t k_mmio_regions[] = {
+    {UART_MMIO_BASE, UART_MMIO_SIZE},
+    {RTC_MMIO_BASE, RTC_MMIO_SIZE},
+    {PLIC_MMIO_BASE, PLIC_MMIO_SIZE},
+};
+
+extern char __kernel_start[];
+extern char __text_end[];
+
+static vm_space_t g_kernel_space;
+static bool g_kernel_space_ready;
+static size_t g_bench_window_bytes;
+
+int vm_kernel_init(void) {
+  uintptr_t text_start = (uintptr_t)__kernel_start;
+  uintptr_t text_end = (uintptr_t)__text_end;
+  uintptr_t ram_end = page_alloc_range_end();
+  size_t i;
+
+  if (vm_space_init(&g_kernel_space) != 0) {
+    return -1;
+  }
+
+  /* Text and rodata stay read-only; data, bss, and allocator RAM are writable. */
+  if (vm_map(&g_kernel_space, text_start, text_start, (size_t)(text_end - text_start),
+             VM_PTE_R | VM_PTE_X | VM_PTE_G, VM_LEVEL_1G) != 0) {
+    return -1;
+  }
+  if (ram_end > text_end &&
+      vm_map(&g_kernel_space, text_end, text_end, (size_t)(ram_end - text_end),
+             VM_PTE_R | VM_PTE_W | VM_PTE_G, VM_LEVEL_1G) != 0) {
+    return -1;
+  }
+
+  for (i = 0u; i < sizeof(k_mmio_regions) / sizeof(k_mmio_regions[0]); ++i) {
+    if (vm_map(&g_kernel_space, k_mmio_regions[i].base, k_mmio_regions[i].base,
+               k_mmio_regions[i].size, VM_PTE_R | VM_PTE_W | VM_PTE_G, VM_LEVEL_1G) != 0) {
+      return -1;
+    }
+  }
+
+  mmu_set_satp(vm_space_satp(&g_kernel_space));
+  g_kernel_space_ready = true;
+  return 0;
+}
+
+const vm_space_t *vm_kernel_space(void) {
+  return g_kernel_space_ready ? &g_kernel_space : (const vm_space_t *)0;
+}
+
+/* Maps both alias windows over the same RAM once; they stay mapped read-only. */
+static int vm_bench_map_windows(void) {
+  uint64_t mega = vm_level_size(VM_LEVEL_2M);
+  uintptr_t phys = (uintptr_t)((page_alloc_range_start() + mega - 1u) & ~(mega - 1u));
+  uintptr_t ram_end = page_alloc_range_end();
+  size_t window = VM_BENCH_WINDOW_BYTES;
+
+  if (g_bench_window_bytes != 0u) {
+    return 0;
+  }
+  if (phys >= ram_end) {
+    return -1;
+  }
+  if ((size_t)(ram_end - phys) < window) {
+    window = (size_t)((ram_end - phys) & ~(uintptr_t)(mega - 1u));
+  }
+  if (window == 0u) {
+    return -1;
+  }
+
+  if (vm_map(&g_kernel_space, k_bench_small_va, phys, window, VM_PTE_R | VM_PTE_G,
+             VM_LEVEL_4K) != 0 ||
+      vm_map(&g_kernel_space, k_bench_huge_va, phys, window, VM_PTE_R | VM_PTE_G,
+             VM_LEVEL_2M) != 0) {
+    return -1;
+  }
+
+  mmu_flush_tlb();
+  g_bench_window_bytes = window;
+  return 0;
+}
+
+static uint64_t vm_bench_walk(uintptr_t base, uint32_t pages, uint32_t passes) {
+  uint64_t start;
+  uint64_t sink = 0u;
+  uint32_t pass;
+  uint32_t page;
+
+  mmu_flush_tlb();
+  start = clock_now_ns();
+  for (pass = 0u; pass < passes; ++pass) {
+    for (page = 0u; page < pages; ++page) {
+      uintptr_t offset = ((uintptr_t)page * 4096u) +
+                         ((uintptr_t)(page % VM_BENCH_LINES_PER_PAGE) * 64u);
+
+      sink += *(volatile const uint64_t *)(base + offset);
+    }
+  }
+  (void)sink;
+
+  return clock_now_ns() - start;
+}
+
+int vm_kernel_tlb_bench(uint32_t passes, vm_tlb_bench_result_t *out) {
+  uint32_t pages;
+
+  if (!g_kernel_space_ready || out == (vm_tlb_bench_result_t *)0 || passes == 0u ||
+      vm_bench_map_windows() != 0) {
+    return -1;
+  }
+
+  pages = (uint32_t)(g_bench_window_bytes / vm_level_size(VM_LEVEL_4K));
+  out->pages = pages;
+  out->passes = passes;
+  out->small_ns = vm_bench_walk(k_bench_small_va, pages, passes);
+  out->huge_ns = vm_bench_walk(k_bench_huge_va, pages, passes);
+  return 0;
+}
@@ -0,0 +1,102 @@
+#include <stdint.h>
+
+#include "perf.h"
+#include "spinlock.h"
+
+static perf_site_t *g_perf_sites;
+static perf_site_t *g_perf_sites_tail;
+static spinlock_t g_perf_sites_lock;
+
+/* Floor of log2 without clz: the kernel links without libgcc and rv64imac has no Zbb. */
+static uint32_t perf_bucket(uint64_t cycles) {
+  uint32_t bucket = 0u;
+  uint32_t shift;
+
+  for (shift = 32u; shift > 0u; shift >>= 1u) {
+    if ((cycles >> shift) != 0u) {
+      cycles >>= shift;
+      bucket += shift;
+    }
+  }
+  return bucket < PERF_HIST_BUCKETS ? bucket : PERF_HIST_BUCKETS - 1u;
+}
+
+void perf_site_register(perf_site_t *site) {
+  uint64_t irq_state = spin_lock_irqsave(&g_perf_sites_lock);
+
+  /* Two harts can race to the first call; only one links the site. */
+  if (site->registered == 0u) {
+    site->next = (perf_site_t *)0;
+    if (g_perf_sites_tail == (perf_site_t *)0) {
+      g_perf_sites = site;
+    } else {
+      g_perf_sites_tail->next = site;
+    }
+    g_perf_sites_tail = site;
+    __atomic_store_n(&site->registered, 1u, __ATOMIC_RELEASE);
+  }
+  spin_unlock_irqrestore(&g_perf_sites_lock, irq_state);
+}
+
+void perf_scope_end(perf_scope_t *scope) {
+  uint64_t cycles = riscv_cycle_now() - scope->cycles;
+  uint64_t instret = riscv_instret_now() - scope->instret;
+  perf_site_t *site = scope->site;
+  uint64_t seen;
+
+  __atomic_fetch_add(&site->count, 1u, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&site->cycles, cycles, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&site->instret, instret, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&site->hist[perf_bucket(cycles)], 1u, __ATOMIC_RELAXED);
+
+  seen = __atomic_load_n(&site->cycles_min, __ATOMIC_RELAXED);
+  while (cycles < seen && !__atomic_compare_exchange_n(&site->cycles_min, &seen, cycles, true,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+  seen = __atomic_load_n(&site->cycles_max, __ATOMIC_RELAXED);
+  while (cycles > seen && !__atomic_compare_exchange_n(&site->cycles_max, &seen, cycles, true,
+                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+const perf_site_t *perf_site_first(void) {
+  return __atomic_load_n(&g_perf_sites, __ATOMIC_ACQUIRE);
+}
+
+uint64_t perf_site_percentile(const perf_site_t *site, uint32_t pct) {
+  uint64_t target;
+  uint64_t seen = 0u;
+  uint32_t bucket;
+
+  if (site->count == 0u) {
+    return 0u;
+  }
+
+  target = (site->count * pct + 99u) / 100u;
+  for (bucket = 0u; bucket < PERF_HIST_BUCKETS - 1u; ++bucket) {
+    seen += site->hist[bucket];
+    if (seen >= target) {
+      break;
+    }
+  }
+  return 2ULL << bucket;
+}
+
+void perf_reset(void) {
+  perf_site_t *site;
+  uint64_t irq_state = spin_lock_irqsave(&g_perf_sites_lock);
+
+  for (site = g_perf_sites; site != (perf_site_t *)0; site = site->next) {
+    uint32_t bucket;
+
+    __atomic_store_n(&site->count, 0u, __ATOMIC_RELAXED);
+    __atomic_store_n(&site->cycles, 0u, __ATOMIC_RELAXED);
+    __atomic_store_n(&site->cycles_min, ~0ULL, __ATOMIC_RELAXED);
+    __atomic_store_n(&site->cycles_max, 0u, __ATOMIC_RELAXED);
+    __atomic_store_n(&site->instret, 0u, __ATOMIC_RELAXED);
+    for (bucket = 0u; bucket < PERF_HIST_BUCKETS; ++bucket) {
+      __atomic_store_n(&site->hist[bucket], 0u, __ATOMIC_RELAXED);
+    }
+  }
+  spin_unlock_irqrestore(&g_perf_sites_lock, irq_state);
+}
@@ -0,0 +1,172 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hart.h"
+#include "profile.h"
+#include "sched.h"
+#include "task.h"
+
+typedef struct profile_buffer {
+  /* Published after the sample is written, so a dump during a run reads whole samples. */
+  uint32_t count;
+  uint64_t dropped;
+  profile_sample_t samples[PROFILE_SAMPLES_PER_HART];
+} profile_buffer_t;
+
+bool g_profile_running;
+static profile_buffer_t g_profile_buffers[HART_MAX_HARTS];
+
+void profile_record(uint64_t pc, uint64_t ra) {
+  profile_buffer_t *buffer = &g_profile_buffers[hart_current_id() % HART_MAX_HARTS];
+  const task_control_block_t *task = sched_current_task();
+  profile_sample_t *sample;
+
+  if (buffer->count >= PROFILE_SAMPLES_PER_HART) {
+    buffer->dropped++;
+    return;
+  }
+
+  sample = &buffer->samples[buffer->count];
+  sample->pc = pc;
+  sample->ra = ra;
+  sample->task = task != (const task_control_block_t *)0 ? task->id : TASK_BOOT_ID;
+  sample->reserved = 0u;
+  __atomic_store_n(&buffer->count, buffer->count + 1u, __ATOMIC_RELEASE);
+}
+
+void profile_start(void) {
+  uint32_t hart;
+
+  __atomic_store_n(&g_profile_running, false, __ATOMIC_RELEASE);
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    __atomic_store_n(&g_profile_buffers[hart].count, 0u, __ATOMIC_RELEASE);
+    g_profile_buffers[hart].dropped = 0u;
+  }
+  __atomic_store_n(&g_profile_running, true, __ATOMIC_RELEASE);
+}
+
+void profile_stop(void) {
+  __atomic_store_n(&g_profile_running, false, __ATOMIC_RELEASE);
+}
+
+bool profile_running(void) {
+  return __atomic_load_n(&g_profile_running, __ATOMIC_RELAXED);
+}
+
+int profile_hart_stats(uint32_t hart_id, profile_hart_stats_t *out) {
+  if (hart_id >= HART_MAX_HARTS || out == (profile_hart_stats_t *)0) {
+    return -1;
+  }
+
+  out->samples = __atomic_load_n(&g_profile_buffers[hart_id].count, __ATOMIC_ACQUIRE);
+  out->dropped = g_profile_buffers[hart_id].dropped;
+  return 0;
+}
+
+static void profile_write_u64(void (*write)(const char *s), uint64_t value) {
+  char digits[21];
+  char out[21];
+  uint32_t count = 0u;
+  uint32_t i = 0u;
+
+  do {
+    digits[count++] = (char)('0' + (value % 10u));
+    value /= 10u;
+  } while (value != 0u);
+  while (count > 0u) {
+    out[i++] = digits[--count];
+  }
+  out[i] = '\0';
+  write(out);
+}
+
+static void profile_write_hex(void (*write)(const char *s), uint64_t value) {
+  static const char k_hex_digits[] = "0123456789abcdef";
+  char out[19];
+  uint32_t shift = 64u;
+  uint32_t i = 2u;
+
+  out[0] = '0';
+  out[1] = 'x';
+  while (shift > 4u && ((value >> (shift - 4u)) & 0xFu) == 0u) {
+    shift -= 4u;
+  }
+  while (shift > 0u) {
+    shift -= 4u;
+    out[i++] = k_hex_digits[(value >> shift) & 0xFu];
+  }
+  out[i] = '\0';
+  write(out);
+}
+
+static void profile_write_sample(void (*write)(const char *s), uint32_t hart,
+                                 const profile_sample_t *sample, uint32_t repeat) {
+  write("PROFILE: s ");
+  profile_write_u64(write, hart);
+  write(" ");
+  profile_write_u64(write, sample->task);
+  write(" ");
+  profile_write_hex(write, sample->pc);
+  write(" ");
+  profile_write_hex(write, sample->ra);
+  write(" ");
+  profile_write_u64(write, repeat);
+  write("\n");
+}
+
+void profile_dump(void (*write)(const char *s)) {
+  uint64_t samples = 0u;
+  uint64_t dropped = 0u;
+  uint32_t hart;
+  uint32_t id;
+
+  write("PROFILE: begin harts=");
+  profile_write_u64(write, HART_MAX_HARTS);
+  write(" per_hart=");
+  profile_write_u64(write, PROFILE_SAMPLES_PER_HART);
+  write("\n");
+
+  write("PROFILE: task 0 root\n");
+  for (id = 1u; id <= TASK_MAX_TASKS; ++id) {
+    const task_control_block_t *task = task_find(id);
+
+    if (task != (const task_control_block_t *)0 && task->name != (const char *)0) {
+      write("PROFILE: task ");
+      profile_write_u64(write, id);
+      write(" ");
+      write(task->name);
+      write("\n");
+    }
+  }
+
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    const profile_buffer_t *buffer = &g_profile_buffers[hart];
+    uint32_t count = __atomic_load_n(&buffer->count, __ATOMIC_ACQUIRE);
+    uint32_t run = 0u;
+    uint32_t i;
+
+    /* Idle harts park on one wfi, so runs of identical samples are common. */
+    for (i = 0u; i < count; ++i) {
+      const profile_sample_t *sample = &buffer->samples[i];
+
+      if (run > 0u && (sample->pc != buffer->samples[i - 1u].pc ||
+                       sample->ra != buffer->samples[i - 1u].ra ||
+                       sample->task != buffer->samples[i - 1u].task)) {
+        profile_write_sample(write, hart, &buffer->samples[i - 1u], run);
+        run = 0u;
+      }
+      run++;
+    }
+    if (run > 0u) {
+      profile_write_sample(write, hart, &buffer->samples[count - 1u], run);
+    }
+    samples += count;
+    dropped += buffer->dropped;
+  }
+
+  write("PROFILE: end samples=");
+  profile_write_u64(write, samples);
+  write(" dropped=");
+  profile_write_u64(write, dropped);
+  write("\n");
+}
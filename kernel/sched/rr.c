@@ -1,144 +1,502 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-#include "console.h"
-#include "line_io.h"
+#include "bitops.h"
+#include "clock.h"
+#include "hart.h"
+#include "klog.h"
+#include "riscv_soft_irq.h"
+#include "riscv_timer.h"
 #include "sched.h"
+#include "spinlock.h"
 #include "task.h"
+#include "trace.h"
+
+_Static_assert((int)SCHED_EVENT_SWITCH == (int)TRACE_SCHED_SWITCH &&
+                   (int)SCHED_EVENT_WAKE == (int)TRACE_SCHED_WAKE &&
+                   (int)SCHED_EVENT_STEAL == (int)TRACE_SCHED_STEAL,
+               "scheduler events share the trace ids");
 
 enum {
   SCHED_SWITCH_LOG_LIMIT = 12u,
   SCHED_TASK_LOG_LIMIT = 4u,
   SCHED_ALT_SWITCH_TARGET = 4u,
-  SCHED_NO_SLOT = 0xffffffffu,
 };
 
-static uint32_t g_runnable_queue[TASK_MAX_TASKS];
-static uint32_t g_runnable_count;
-static uint32_t g_current_slot;
+/*
+ * One FIFO of RUNNABLE tasks per priority level, linked through run_next. Bit p of
+ * ready_mask is set while level p is non-empty, so picking the next task is a ctz
+ * plus a list pop no matter how many tasks exist. The running task is never queued.
+ */
+typedef struct sched_level {
+  task_control_block_t *head;
+  task_control_block_t *tail;
+} sched_level_t;
+
+/*
+ * Each hart schedules its own queue from its own timer and yield interrupts. Other
+ * harts only touch it to place tasks, under `lock`.
+ */
+typedef struct sched_cpu {
+  sched_level_t levels[SCHED_PRIORITY_LEVELS];
+  uint32_t ready_mask;
+  task_control_block_t *current;
+  /* Exited task whose stack was in use at its last switch-out; freed on the next switch. */
+  task_control_block_t *zombie;
+  /* Task switched out whose stack the hart is still on; on_cpu until sched_finish_switch(). */
+  task_control_block_t *switched_out;
+  /* Tasks owned by this queue, not counting the hart's root context. */
+  uint32_t task_count;
+  /* Queued tasks other than the root context; what a thief can take. */
+  uint32_t ready_tasks;
+  uint64_t switch_count;
+  uint64_t steals;
+  uint64_t stolen;
+  spinlock_t lock;
+  lock_stats_t lock_stats;
+  bool online;
+  /* Written under `lock`; event_count is the total ever recorded. */
+  sched_event_t events[SCHED_EVENT_RING_SIZE];
+  uint64_t event_count;
+} sched_cpu_t;
+
+static const char *const k_runqueue_lock_names[] = {
+    "runqueue0", "runqueue1", "runqueue2", "runqueue3",
+    "runqueue4", "runqueue5", "runqueue6", "runqueue7",
+};
+
+static sched_cpu_t g_cpus[HART_MAX_HARTS];
+static uint32_t g_boot_hart;
 static uint32_t g_switch_log_count;
 static uint32_t g_alternating_switches;
+static uint32_t g_last_test_task_id;
 static bool g_alternation_reported;
 static bool g_scheduler_running;
+static bool g_steal_enabled;
+static bool g_initialized;
 static bool g_bootstrapped;
 
-static void sched_write_u32(uint32_t value) {
-  char digits[10];
-  uint32_t i = 0u;
+/* Runs inside the switch path, so it goes to the log ring rather than the UART. */
+static void sched_log_switch(uint32_t from_id, uint32_t to_id) {
+  klog_record_t *record = klog_begin(KLOG_INFO);
 
-  if (value == 0u) {
-    console_putc('0');
-    return;
-  }
+  klog_puts(record, "SCHED: switch ");
+  klog_put_u64(record, from_id);
+  klog_puts(record, " -> ");
+  klog_put_u64(record, to_id);
+  klog_end(record);
+}
 
-  while (value > 0u && i < sizeof(digits)) {
-    digits[i++] = (char)('0' + (value % 10u));
-    value /= 10u;
-  }
+static sched_cpu_t *sched_this_cpu(void) {
+  return &g_cpus[hart_current_id() % HART_MAX_HARTS];
+}
+
+/* Trap handlers already run with SIE clear; task-context callers mask it here. */
+static uint64_t sched_cpu_lock(sched_cpu_t *cpu) {
+  return spin_lock_irqsave(&cpu->lock);
+}
 
-  while (i > 0u) {
-    i -= 1u;
-    console_putc(digits[i]);
+static void sched_cpu_unlock(sched_cpu_t *cpu, uint64_t irq_state) {
+  spin_unlock_irqrestore(&cpu->lock, irq_state);
+}
+
+/*
+ * Locks the queue that owns `task`. A steal changes task->hart under both the victim's and
+ * the thief's lock, so a value that still matches once its lock is held is stable.
+ */
+static sched_cpu_t *sched_lock_task_cpu(const task_control_block_t *task, uint64_t *irq_state) {
+  for (;;) {
+    uint8_t hart = __atomic_load_n(&task->hart, __ATOMIC_ACQUIRE);
+    sched_cpu_t *cpu = &g_cpus[hart % HART_MAX_HARTS];
+
+    *irq_state = sched_cpu_lock(cpu);
+    if (task->hart == hart) {
+      return cpu;
+    }
+    sched_cpu_unlock(cpu, *irq_state);
   }
 }
 
-static void sched_log_switch(uint32_t from_id, uint32_t to_id) {
-  line_io_write("SCHED: switch ");
-  sched_write_u32(from_id);
-  line_io_write(" -> ");
-  sched_write_u32(to_id);
-  line_io_write("\n");
+static void sched_event_record(sched_cpu_t *cpu, uint64_t now, sched_event_type_t type,
+                               const task_control_block_t *task, uint32_t other) {
+  sched_event_t *event = &cpu->events[cpu->event_count % SCHED_EVENT_RING_SIZE];
+
+  event->time_ns = now;
+  event->type = (uint8_t)type;
+  event->state = (uint8_t)task->state;
+  event->task = (uint8_t)task->id;
+  event->other = (uint8_t)other;
+  cpu->event_count++;
+  trace_event((trace_event_id_t)type, task->id, other, (uint64_t)task->state);
+}
+
+/* `ready_since` starts the task's runnable wait; a requeue passes the old value through. */
+static void sched_level_push(sched_cpu_t *cpu, task_control_block_t *task,
+                             uint64_t ready_since) {
+  sched_level_t *level = &cpu->levels[task->priority];
+
+  task->context.ready_since = ready_since;
+  task->run_next = (task_control_block_t *)0;
+  if (level->tail == (task_control_block_t *)0) {
+    level->head = task;
+  } else {
+    level->tail->run_next = task;
+  }
+  level->tail = task;
+  cpu->ready_mask |= 1u << task->priority;
+  if (task->id != TASK_BOOT_ID) {
+    cpu->ready_tasks++;
+  }
 }
 
-static task_control_block_t *sched_task_from_slot(uint32_t slot) {
-  if (slot >= g_runnable_count) {
+static task_control_block_t *sched_level_pop_highest(sched_cpu_t *cpu) {
+  sched_level_t *level;
+  task_control_block_t *task;
+  uint32_t priority;
+
+  if (cpu->ready_mask == 0u) {
     return (task_control_block_t *)0;
   }
 
-  return task_find(g_runnable_queue[slot]);
+  priority = bitops_ctz64(cpu->ready_mask);
+  level = &cpu->levels[priority];
+  task = level->head;
+  level->head = task->run_next;
+  if (level->head == (task_control_block_t *)0) {
+    level->tail = (task_control_block_t *)0;
+    cpu->ready_mask &= ~(1u << priority);
+  }
+
+  task->run_next = (task_control_block_t *)0;
+  if (task->id != TASK_BOOT_ID) {
+    cpu->ready_tasks--;
+  }
+  return task;
 }
 
-static uint32_t sched_find_next_slot(void) {
-  uint32_t offset;
-  uint32_t start_slot;
+/* Unlinks a queued task; linear only in the length of its own level. */
+static bool sched_level_remove(sched_cpu_t *cpu, task_control_block_t *task) {
+  sched_level_t *level = &cpu->levels[task->priority];
+  task_control_block_t *prev = (task_control_block_t *)0;
+  task_control_block_t *cursor = level->head;
 
-  if (g_runnable_count == 0u) {
-    return SCHED_NO_SLOT;
+  while (cursor != (task_control_block_t *)0 && cursor != task) {
+    prev = cursor;
+    cursor = cursor->run_next;
   }
 
-  if (g_current_slot == SCHED_NO_SLOT) {
-    start_slot = 0u;
+  if (cursor == (task_control_block_t *)0) {
+    return false;
+  }
+
+  if (prev == (task_control_block_t *)0) {
+    level->head = task->run_next;
   } else {
-    start_slot = g_current_slot + 1u;
-    if (start_slot >= g_runnable_count) {
-      start_slot = 0u;
-    }
+    prev->run_next = task->run_next;
+  }
+  if (level->tail == task) {
+    level->tail = prev;
+  }
+  if (level->head == (task_control_block_t *)0) {
+    cpu->ready_mask &= ~(1u << task->priority);
   }
 
-  for (offset = 0u; offset < g_runnable_count; ++offset) {
-    uint32_t slot = start_slot + offset;
-    task_control_block_t *task;
+  task->run_next = (task_control_block_t *)0;
+  if (task->id != TASK_BOOT_ID) {
+    cpu->ready_tasks--;
+  }
+  return true;
+}
 
-    if (slot >= g_runnable_count) {
-      slot -= g_runnable_count;
+/*
+ * The owner pops from the head of a level, so a thief takes the newest allowed task from
+ * the tail of the most urgent level that has one.
+ */
+static task_control_block_t *sched_steal_candidate(const sched_cpu_t *victim, uint32_t hart_id) {
+  uint32_t mask = victim->ready_mask;
+
+  while (mask != 0u) {
+    uint32_t priority = bitops_ctz64(mask);
+    task_control_block_t *cursor = victim->levels[priority].head;
+    task_control_block_t *candidate = (task_control_block_t *)0;
+
+    while (cursor != (task_control_block_t *)0) {
+      /* An on_cpu task is queued but its old hart may still be running on its stack. */
+      if (cursor->id != TASK_BOOT_ID && !__atomic_load_n(&cursor->on_cpu, __ATOMIC_ACQUIRE) &&
+          (cursor->affinity & (1u << hart_id)) != 0u) {
+        candidate = cursor;
+      }
+      cursor = cursor->run_next;
     }
 
-    task = sched_task_from_slot(slot);
-    if (task != (task_control_block_t *)0 && task->state == TASK_STATE_RUNNABLE) {
-      return slot;
+    if (candidate != (task_control_block_t *)0) {
+      return candidate;
     }
+    mask &= mask - 1u;
   }
 
-  return SCHED_NO_SLOT;
+  return (task_control_block_t *)0;
 }
 
-static void sched_test_task_1(task_control_block_t *task) {
+/* Moves one queued task from the busiest other hart onto `cpu`, whose lock is held. */
+static bool sched_try_steal(sched_cpu_t *cpu, uint64_t now) {
+  uint32_t thief = (uint32_t)(cpu - g_cpus);
+  sched_cpu_t *victim = (sched_cpu_t *)0;
+  task_control_block_t *task;
+  uint32_t busiest = 0u;
+  uint32_t hart;
+
+  /* Unlocked reads only pick a victim; the move itself happens under its lock. */
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    sched_cpu_t *other = &g_cpus[hart];
+    uint32_t ready = __atomic_load_n(&other->ready_tasks, __ATOMIC_RELAXED);
+
+    if (other == cpu || !__atomic_load_n(&other->online, __ATOMIC_ACQUIRE)) {
+      continue;
+    }
+    if (ready > busiest) {
+      busiest = ready;
+      victim = other;
+    }
+  }
+
+  /* Trylock while holding our own queue, so two thieves cannot deadlock. */
+  if (victim == (sched_cpu_t *)0 || !spin_trylock(&victim->lock)) {
+    return false;
+  }
+
+  task = sched_steal_candidate(victim, thief);
+  if (task != (task_control_block_t *)0) {
+    (void)sched_level_remove(victim, task);
+    victim->task_count--;
+    victim->stolen++;
+    /* Moved while both locks are held; see sched_lock_task_cpu(). */
+    __atomic_store_n(&task->hart, (uint8_t)thief, __ATOMIC_RELEASE);
+  }
+  spin_unlock(&victim->lock);
+
+  if (task == (task_control_block_t *)0) {
+    return false;
+  }
+
+  sched_level_push(cpu, task, task->context.ready_since);
+  cpu->task_count++;
+  cpu->steals++;
+  sched_event_record(cpu, now, SCHED_EVENT_STEAL, task, (uint32_t)(victim - g_cpus));
+  return true;
+}
+
+/* Lets other harts take the task this hart switched away from; its stack is free now. */
+static void sched_release_switched_out(sched_cpu_t *cpu) {
+  task_control_block_t *task = cpu->switched_out;
+
   if (task == (task_control_block_t *)0) {
     return;
   }
 
-  if (task->run_count <= SCHED_TASK_LOG_LIMIT) {
-    line_io_write("TASK: 1 running\n");
+  cpu->switched_out = (task_control_block_t *)0;
+  __atomic_store_n(&task->on_cpu, false, __ATOMIC_RELEASE);
+}
+
+static void sched_reap_zombie(sched_cpu_t *cpu) {
+  if (cpu->zombie == (task_control_block_t *)0 || cpu->zombie == cpu->current) {
+    return;
+  }
+
+  task_reap(cpu->zombie);
+  cpu->zombie = (task_control_block_t *)0;
+  if (cpu->task_count > 0u) {
+    cpu->task_count--;
+  }
+}
+
+/* True when `task` should run ahead of whatever is on that hart now. */
+static bool sched_should_preempt(const sched_cpu_t *cpu, const task_control_block_t *task) {
+  return g_scheduler_running && cpu->current != (task_control_block_t *)0 &&
+         task->priority < cpu->current->priority;
+}
+
+/* Makes `hart_id` reschedule: a local yield or an IPI that lands as the same SSIP. */
+static void sched_kick(uint32_t hart_id) {
+  if (hart_id == hart_current_id()) {
+    sched_yield();
+  } else {
+    riscv_soft_irq_send(hart_id);
+  }
+}
+
+/*
+ * Least-loaded online hart the task's affinity allows; the boot hart counts its shell
+ * context as one task. Affinity is a hint: with no allowed hart online, any hart will do.
+ */
+static uint32_t sched_pick_hart(uint32_t affinity) {
+  uint32_t best = g_boot_hart;
+  uint32_t best_load = 0xffffffffu;
+  uint32_t hart;
+
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    const sched_cpu_t *cpu = &g_cpus[hart];
+    uint32_t load;
+
+    if (!__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE) || (affinity & (1u << hart)) == 0u) {
+      continue;
+    }
+
+    load = cpu->task_count + (hart == g_boot_hart ? 1u : 0u);
+    if (load < best_load) {
+      best = hart;
+      best_load = load;
+    }
+  }
+
+  if (best_load == 0xffffffffu && affinity != ~0u) {
+    return sched_pick_hart(~0u);
+  }
+
+  return best;
+}
+
+static void sched_test_task_body(task_control_block_t *task, const char *message) {
+  uint64_t seen = 0ULL;
+
+  for (;;) {
+    if (task->run_count != seen) {
+      seen = task->run_count;
+      if (seen <= SCHED_TASK_LOG_LIMIT) {
+        klog(KLOG_INFO, message);
+      }
+    }
+    sched_yield();
   }
 }
 
+static void sched_test_task_1(task_control_block_t *task) {
+  sched_test_task_body(task, "TASK: 1 running");
+}
+
 static void sched_test_task_2(task_control_block_t *task) {
-  if (task == (task_control_block_t *)0) {
-    return;
+  sched_test_task_body(task, "TASK: 2 running");
+}
+
+int sched_add_task(task_control_block_t *task) {
+  sched_cpu_t *cpu;
+  uint64_t irq_state;
+  uint32_t hart;
+  bool preempt;
+
+  if (task == (task_control_block_t *)0 || task->state != TASK_STATE_RUNNABLE ||
+      task->priority >= SCHED_PRIORITY_LEVELS || task->id == TASK_BOOT_ID) {
+    return -1;
   }
 
-  if (task->run_count <= SCHED_TASK_LOG_LIMIT) {
-    line_io_write("TASK: 2 running\n");
+  hart = sched_pick_hart(task->affinity);
+  cpu = &g_cpus[hart];
+  task->hart = (uint8_t)hart;
+  task->context.added_at = clock_now_ns();
+
+  irq_state = sched_cpu_lock(cpu);
+  sched_level_push(cpu, task, task->context.added_at);
+  cpu->task_count++;
+  preempt = sched_should_preempt(cpu, task);
+  sched_cpu_unlock(cpu, irq_state);
+
+  if (preempt) {
+    sched_kick(hart);
   }
+  return 0;
 }
 
-static int sched_enqueue_task(task_control_block_t *task) {
-  if (task == (task_control_block_t *)0 || g_runnable_count >= TASK_MAX_TASKS) {
+int sched_set_priority(task_control_block_t *task, uint32_t priority) {
+  sched_cpu_t *cpu;
+  uint64_t irq_state;
+  bool preempt = false;
+
+  if (task == (task_control_block_t *)0 || priority >= SCHED_PRIORITY_LEVELS) {
     return -1;
   }
 
-  g_runnable_queue[g_runnable_count++] = task->id;
+  /* Held across the remove and the write, so a thief never sees the level change. */
+  cpu = sched_lock_task_cpu(task, &irq_state);
+  if (sched_level_remove(cpu, task)) {
+    task->priority = (uint8_t)priority;
+    sched_level_push(cpu, task, task->context.ready_since);
+    preempt = sched_should_preempt(cpu, task);
+  } else {
+    task->priority = (uint8_t)priority;
+    /* The running task dropped below queued work. */
+    preempt = task == cpu->current && cpu->ready_mask != 0u &&
+              bitops_ctz64(cpu->ready_mask) < priority;
+  }
+  sched_cpu_unlock(cpu, irq_state);
+
+  if (preempt) {
+    sched_kick((uint32_t)(cpu - g_cpus));
+  }
   return 0;
 }
 
 void sched_init(void) {
+  uint32_t hart;
   uint32_t i;
 
   task_system_init();
 
-  for (i = 0u; i < TASK_MAX_TASKS; ++i) {
-    g_runnable_queue[i] = 0u;
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    sched_cpu_t *cpu = &g_cpus[hart];
+
+    for (i = 0u; i < SCHED_PRIORITY_LEVELS; ++i) {
+      cpu->levels[i].head = (task_control_block_t *)0;
+      cpu->levels[i].tail = (task_control_block_t *)0;
+    }
+    cpu->ready_mask = 0u;
+    cpu->current = (task_control_block_t *)0;
+    cpu->zombie = (task_control_block_t *)0;
+    cpu->switched_out = (task_control_block_t *)0;
+    cpu->task_count = 0u;
+    cpu->ready_tasks = 0u;
+    cpu->switch_count = 0ULL;
+    cpu->steals = 0ULL;
+    cpu->stolen = 0ULL;
+    cpu->event_count = 0ULL;
+    lock_stats_register(&cpu->lock_stats,
+                        k_runqueue_lock_names[hart % (sizeof(k_runqueue_lock_names) /
+                                                      sizeof(k_runqueue_lock_names[0]))]);
+    spinlock_init(&cpu->lock, &cpu->lock_stats);
+    cpu->online = false;
   }
 
-  g_runnable_count = 0u;
-  g_current_slot = SCHED_NO_SLOT;
+  g_boot_hart = hart_current_id() % HART_MAX_HARTS;
+  task_boot()->context.added_at = clock_now_ns();
+  task_boot()->context.switched_in_at = task_boot()->context.added_at;
+  task_boot()->on_cpu = true;
+  g_cpus[g_boot_hart].current = task_boot();
+  g_cpus[g_boot_hart].online = true;
   g_switch_log_count = 0u;
   g_alternating_switches = 0u;
+  g_last_test_task_id = 0u;
   g_alternation_reported = false;
   g_scheduler_running = false;
+  g_steal_enabled = true;
+  g_initialized = true;
   g_bootstrapped = false;
 }
 
+void sched_hart_online(void) {
+  uint32_t hart = hart_current_id() % HART_MAX_HARTS;
+  sched_cpu_t *cpu = &g_cpus[hart];
+  task_control_block_t *root = task_hart_root(hart);
+
+  /* The idle loop only runs when every level above it is empty. */
+  root->priority = (uint8_t)SCHED_PRIORITY_IDLE;
+  root->state = TASK_STATE_RUNNING;
+  root->on_cpu = true;
+  root->context.added_at = clock_now_ns();
+  root->context.switched_in_at = root->context.added_at;
+  cpu->current = root;
+  riscv_soft_irq_enable();
+  __atomic_store_n(&cpu->online, true, __ATOMIC_RELEASE);
+}
+
 void sched_bootstrap_test_tasks(void) {
   task_control_block_t *task_1;
   task_control_block_t *task_2;
@@ -147,76 +505,427 @@ void sched_bootstrap_test_tasks(void) {
     return;
   }
 
-  sched_init();
+  if (!g_initialized) {
+    sched_init();
+  }
 
   task_1 = task_create("task-1", sched_test_task_1);
   task_2 = task_create("task-2", sched_test_task_2);
   if (task_1 == (task_control_block_t *)0 || task_2 == (task_control_block_t *)0 ||
-      sched_enqueue_task(task_1) != 0 || sched_enqueue_task(task_2) != 0) {
-    line_io_write("SCHED: bootstrap failed\n");
+      sched_add_task(task_1) != 0 || sched_add_task(task_2) != 0) {
+    klog(KLOG_ERR, "SCHED: bootstrap failed");
     g_bootstrapped = true;
     return;
   }
 
-  g_scheduler_running = true;
+  sched_start();
   g_bootstrapped = true;
 
-  line_io_write("SCHED: policy=round-robin runnable=2\n");
+  klog(KLOG_INFO, "SCHED: policy=priority-rr runnable=2");
+}
+
+void sched_start(void) {
+  riscv_soft_irq_enable();
+  g_scheduler_running = true;
+}
+
+void sched_set_stealing(bool enabled) {
+  g_steal_enabled = enabled;
+}
+
+int sched_set_affinity(task_control_block_t *task, uint32_t affinity) {
+  if (task == (task_control_block_t *)0 || task->id == TASK_BOOT_ID || affinity == 0u) {
+    return -1;
+  }
+
+  task->affinity = affinity;
+  return 0;
 }
 
-void sched_handle_timer_interrupt(const struct trap_frame *frame) {
+int sched_task_stats(const task_control_block_t *task, sched_task_stats_t *out) {
+  sched_cpu_t *cpu;
+  uint64_t irq_state;
+  uint64_t now;
+
+  if (task == (const task_control_block_t *)0 || out == (sched_task_stats_t *)0) {
+    return -1;
+  }
+
+  cpu = sched_lock_task_cpu(task, &irq_state);
+  now = clock_now_ns();
+  out->id = task->id;
+  out->name = task->name;
+  out->state = task->state;
+  out->hart = task->hart;
+  out->priority = task->priority;
+  out->run_ns = task->context.run_ns;
+  out->wait_ns = task->context.wait_ns;
+  out->voluntary_switches = task->context.voluntary_switches;
+  out->involuntary_switches = task->context.involuntary_switches;
+  out->wakeups = task->context.wakeups;
+  out->wakeup_latency_ns = task->context.wakeup_latency_ns;
+  out->wakeup_latency_max_ns = task->context.wakeup_latency_max_ns;
+  out->age_ns = now - task->context.added_at;
+  if (task == cpu->current) {
+    out->run_ns += now - task->context.switched_in_at;
+  } else if (task->state == TASK_STATE_RUNNABLE) {
+    out->wait_ns += now - task->context.ready_since;
+  }
+  sched_cpu_unlock(cpu, irq_state);
+  return 0;
+}
+
+uint32_t sched_events_read(uint32_t hart_id, sched_event_t *out, uint32_t max, uint64_t *total) {
+  sched_cpu_t *cpu;
+  uint64_t irq_state;
+  uint64_t first;
+  uint32_t count;
+  uint32_t i;
+
+  if (hart_id >= HART_MAX_HARTS || out == (sched_event_t *)0) {
+    return 0u;
+  }
+
+  cpu = &g_cpus[hart_id];
+  irq_state = sched_cpu_lock(cpu);
+  count = cpu->event_count < SCHED_EVENT_RING_SIZE ? (uint32_t)cpu->event_count
+                                                   : (uint32_t)SCHED_EVENT_RING_SIZE;
+  if (count > max) {
+    count = max;
+  }
+  first = cpu->event_count - count;
+  for (i = 0u; i < count; ++i) {
+    out[i] = cpu->events[(first + i) % SCHED_EVENT_RING_SIZE];
+  }
+  if (total != (uint64_t *)0) {
+    *total = cpu->event_count;
+  }
+  sched_cpu_unlock(cpu, irq_state);
+  return count;
+}
+
+int sched_hart_stats(uint32_t hart_id, sched_hart_stats_t *out) {
+  const sched_cpu_t *cpu;
+
+  if (hart_id >= HART_MAX_HARTS || out == (sched_hart_stats_t *)0) {
+    return -1;
+  }
+
+  cpu = &g_cpus[hart_id];
+  out->online = cpu->online;
+  out->tasks = cpu->task_count;
+  out->ready = cpu->ready_tasks;
+  out->switches = cpu->switch_count;
+  out->steals = cpu->steals;
+  out->stolen = cpu->stolen;
+  return 0;
+}
+
+static void sched_note_switch(uint32_t prev_id, uint32_t next_id) {
+  if (g_switch_log_count < SCHED_SWITCH_LOG_LIMIT) {
+    sched_log_switch(prev_id, next_id);
+    g_switch_log_count += 1u;
+  }
+
+  if (next_id != TASK_BOOT_ID) {
+    if ((g_last_test_task_id == 1u && next_id == 2u) ||
+        (g_last_test_task_id == 2u && next_id == 1u)) {
+      g_alternating_switches += 1u;
+      if (!g_alternation_reported && g_alternating_switches >= SCHED_ALT_SWITCH_TARGET) {
+        klog(KLOG_INFO, "SCHED_TEST: alternating tasks confirmed");
+        g_alternation_reported = true;
+      }
+    }
+    g_last_test_task_id = next_id;
+  }
+}
+
+static struct trap_frame *sched_switch(struct trap_frame *frame) {
+  sched_cpu_t *cpu = sched_this_cpu();
   task_control_block_t *prev_task;
   task_control_block_t *next_task;
-  uint32_t prev_id = 0u;
-  uint32_t next_slot;
+  uint64_t irq_state;
+  uint64_t now;
 
-  if (!g_scheduler_running || g_runnable_count == 0u) {
-    return;
+  if (!g_scheduler_running || !cpu->online) {
+    return frame;
   }
 
-  prev_task = sched_task_from_slot(g_current_slot);
-  if (prev_task != (task_control_block_t *)0) {
-    prev_id = prev_task->id;
-    task_context_switch_out(prev_task, frame);
+  irq_state = sched_cpu_lock(cpu);
+  /* Any trap after a switch runs on the new stack, even if trap_vector did not say so. */
+  sched_release_switched_out(cpu);
+  now = clock_now_ns();
+  prev_task = cpu->current;
+  task_context_switch_out(prev_task, frame);
+  prev_task->context.run_ns += now - prev_task->context.switched_in_at;
+  prev_task->context.switched_in_at = now;
+  sched_reap_zombie(cpu);
+
+  if (prev_task->state == TASK_STATE_RUNNABLE) {
+    /* Back of its own level, so equal priorities still round-robin. */
+    sched_level_push(cpu, prev_task, now);
+  } else if (prev_task->state == TASK_STATE_EXITED) {
+    cpu->zombie = prev_task;
   }
 
-  next_slot = sched_find_next_slot();
-  if (next_slot == SCHED_NO_SLOT) {
-    return;
+  /* Only the root context (or nothing) is left here: go looking for work. */
+  if (g_steal_enabled && cpu->ready_tasks == 0u) {
+    (void)sched_try_steal(cpu, now);
   }
 
-  next_task = sched_task_from_slot(next_slot);
+  next_task = sched_level_pop_highest(cpu);
   if (next_task == (task_control_block_t *)0) {
+    /* Nothing else can run; keep the interrupted context. */
+    if (prev_task->state == TASK_STATE_RUNNABLE) {
+      prev_task->state = TASK_STATE_RUNNING;
+    }
+    sched_cpu_unlock(cpu, irq_state);
+    return frame;
+  }
+
+  cpu->current = next_task;
+  if (prev_task != next_task) {
+    /* prev_task stays on_cpu, so it cannot be stolen until trap_vector leaves its stack. */
+    next_task->on_cpu = true;
+    cpu->switched_out = prev_task;
+  }
+  task_context_switch_in(next_task, next_task->context.frame);
+  next_task->run_count += 1ULL;
+  next_task->context.wait_ns += now - next_task->context.ready_since;
+  next_task->context.switched_in_at = now;
+  if (next_task->context.woken) {
+    uint64_t latency = now - next_task->context.ready_since;
+
+    next_task->context.woken = false;
+    next_task->context.wakeups++;
+    next_task->context.wakeup_latency_ns += latency;
+    if (latency > next_task->context.wakeup_latency_max_ns) {
+      next_task->context.wakeup_latency_max_ns = latency;
+    }
+  }
+  if (prev_task != next_task) {
+    cpu->switch_count += 1ULL;
+    if (prev_task->state == TASK_STATE_RUNNABLE) {
+      prev_task->context.involuntary_switches++;
+    } else {
+      prev_task->context.voluntary_switches++;
+    }
+    sched_event_record(cpu, now, SCHED_EVENT_SWITCH, prev_task, next_task->id);
+  }
+  sched_cpu_unlock(cpu, irq_state);
+
+  if (prev_task != next_task) {
+    /* tp holds the hart id and must follow whichever hart resumes the task. */
+    next_task->context.frame->tp = frame->tp;
+    /* Only the boot hart logs, which keeps the serial output readable. */
+    if (cpu == &g_cpus[g_boot_hart]) {
+      sched_note_switch(prev_task->id, next_task->id);
+    }
+  }
+
+  return next_task->context.frame;
+}
+
+struct trap_frame *sched_handle_timer_interrupt(struct trap_frame *frame) {
+  return sched_switch(frame);
+}
+
+struct trap_frame *sched_handle_yield(struct trap_frame *frame) {
+  riscv_soft_irq_clear();
+  return sched_switch(frame);
+}
+
+void sched_finish_switch(void) {
+  sched_cpu_t *cpu = sched_this_cpu();
+  uint64_t irq_state;
+
+  if (cpu->switched_out == (task_control_block_t *)0) {
     return;
   }
 
-  g_current_slot = next_slot;
-  task_context_switch_in(next_task, frame);
+  irq_state = sched_cpu_lock(cpu);
+  sched_release_switched_out(cpu);
+  sched_cpu_unlock(cpu, irq_state);
+}
 
-  if (prev_task != (task_control_block_t *)0 && prev_id != next_task->id &&
-      g_switch_log_count < SCHED_SWITCH_LOG_LIMIT) {
-    sched_log_switch(prev_id, next_task->id);
-    g_switch_log_count += 1u;
+void sched_yield(void) {
+  riscv_soft_irq_raise();
+}
+
+int sched_prepare_block(void) {
+  sched_cpu_t *cpu = sched_this_cpu();
+  task_control_block_t *task = cpu->current;
+  uint64_t irq_state;
+
+  if (task == (task_control_block_t *)0 || task->id == TASK_BOOT_ID) {
+    return -1;
   }
 
-  if ((prev_id == 1u && next_task->id == 2u) || (prev_id == 2u && next_task->id == 1u)) {
-    g_alternating_switches += 1u;
-    if (!g_alternation_reported && g_alternating_switches >= SCHED_ALT_SWITCH_TARGET) {
-      line_io_write("SCHED_TEST: alternating tasks confirmed\n");
-      g_alternation_reported = true;
+  irq_state = sched_cpu_lock(cpu);
+  task->state = TASK_STATE_BLOCKED;
+  sched_cpu_unlock(cpu, irq_state);
+  return 0;
+}
+
+int sched_block_current(void) {
+  if (sched_prepare_block() != 0) {
+    return -1;
+  }
+
+  sched_yield();
+  return 0;
+}
+
+int sched_wake(task_control_block_t *task) {
+  sched_cpu_t *cpu;
+  uint64_t irq_state;
+  bool preempt = false;
+
+  if (task == (task_control_block_t *)0 || task->id == TASK_BOOT_ID) {
+    return -1;
+  }
+
+  cpu = sched_lock_task_cpu(task, &irq_state);
+  if (task->state != TASK_STATE_BLOCKED) {
+    sched_cpu_unlock(cpu, irq_state);
+    return -1;
+  }
+
+  if (task == cpu->current) {
+    task->state = TASK_STATE_RUNNING;
+  } else {
+    /*
+     * The task may still be on_cpu: blocked and switched out, with its hart not yet off
+     * its stack. It is queued only on that hart, which cannot pick it before the stack
+     * switch, and thieves skip it until sched_finish_switch().
+     */
+    uint64_t now = clock_now_ns();
+
+    task->state = TASK_STATE_RUNNABLE;
+    task->context.woken = true;
+    sched_level_push(cpu, task, now);
+    sched_event_record(cpu, now, SCHED_EVENT_WAKE, task, hart_current_id() % HART_MAX_HARTS);
+    preempt = sched_should_preempt(cpu, task);
+  }
+  sched_cpu_unlock(cpu, irq_state);
+
+  /* Once unlocked the task may already be stolen; kick the hart it was queued on. */
+  if (preempt) {
+    sched_kick((uint32_t)(cpu - g_cpus));
+  }
+  return 0;
+}
+
+task_control_block_t *sched_current_task(void) {
+  return sched_this_cpu()->current;
+}
+
+bool sched_tick_needs_switch(void) {
+  uint32_t hart_id = hart_current_id() % HART_MAX_HARTS;
+  const sched_cpu_t *cpu = &g_cpus[hart_id];
+  const task_control_block_t *current = cpu->current;
+  uint32_t ready_mask;
+  uint32_t hart;
+
+  if (!g_scheduler_running || !cpu->online) {
+    return false;
+  }
+  if (current->state != TASK_STATE_RUNNING || cpu->zombie != (task_control_block_t *)0) {
+    return true;
+  }
+
+  /* The running task is requeued behind its own level, so equal priority means a turn. */
+  ready_mask = __atomic_load_n(&cpu->ready_mask, __ATOMIC_RELAXED);
+  if (ready_mask != 0u && bitops_ctz64(ready_mask) <= current->priority) {
+    return true;
+  }
+  if (!g_steal_enabled || cpu->ready_tasks != 0u) {
+    return false;
+  }
+
+  /* Racy reads, as in sched_hart_idle(); the switch itself re-checks under the locks. */
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    const sched_cpu_t *other = &g_cpus[hart];
+
+    if (hart != hart_id && __atomic_load_n(&other->online, __ATOMIC_ACQUIRE) &&
+        __atomic_load_n(&other->ready_tasks, __ATOMIC_RELAXED) != 0u) {
+      return true;
     }
   }
 
-  next_task->run_count += 1ULL;
-  if (next_task->entry != (task_entry_fn)0) {
-    next_task->entry(next_task);
+  return false;
+}
+
+bool sched_hart_idle(void) {
+  uint32_t hart_id = hart_current_id() % HART_MAX_HARTS;
+  const sched_cpu_t *cpu = &g_cpus[hart_id];
+  uint32_t hart;
+
+  /*
+   * Only idle-priority roots count. The boot hart's root is the shell, which new tasks
+   * at its own level do not preempt, so that hart keeps slicing.
+   */
+  if (!g_scheduler_running || !cpu->online || cpu->ready_tasks != 0u ||
+      cpu->current != task_hart_root(hart_id) || cpu->current->priority != SCHED_PRIORITY_IDLE) {
+    return false;
   }
 
-  if (next_task->state == TASK_STATE_RUNNING) {
-    next_task->state = TASK_STATE_RUNNABLE;
+  if (!g_steal_enabled) {
+    return true;
+  }
+
+  /* A racy read is fine: work placed later kicks this hart with an IPI. */
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    const sched_cpu_t *other = &g_cpus[hart];
+
+    if (hart != hart_id && __atomic_load_n(&other->online, __ATOMIC_ACQUIRE) &&
+        __atomic_load_n(&other->ready_tasks, __ATOMIC_RELAXED) != 0u) {
+      return false;
+    }
   }
+
+  return true;
 }
 
 uint32_t sched_runnable_count(void) {
-  return g_runnable_count;
+  uint32_t total = 0u;
+  uint32_t hart;
+
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    total += g_cpus[hart].task_count;
+  }
+
+  return total;
+}
+
+uint64_t sched_switch_count(void) {
+  uint64_t total = 0ULL;
+  uint32_t hart;
+
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    total += g_cpus[hart].switch_count;
+  }
+
+  return total;
+}
+
+int sched_bench_switch_cost(uint32_t yields, sched_switch_bench_t *out) {
+  uint64_t switches_before;
+  uint64_t start;
+  uint32_t i;
+
+  if (out == (sched_switch_bench_t *)0 || yields == 0u || !g_scheduler_running) {
+    return -1;
+  }
+
+  switches_before = sched_this_cpu()->switch_count;
+  start = riscv_cycle_now();
+  for (i = 0u; i < yields; ++i) {
+    sched_yield();
+  }
+
+  out->cycles = riscv_cycle_now() - start;
+  out->yields = yields;
+  out->switches = sched_this_cpu()->switch_count - switches_before;
+  return 0;
 }
@@ -0,0 +1,100 @@
+#include <stdint.h>
+
+#include "clock.h"
+#include "hart.h"
+#include "mmu.h"
+#include "sbi.h"
+#include "sched.h"
+#include "smp.h"
+#include "trap.h"
+#include "vm_kernel.h"
+
+enum {
+  SMP_START_TIMEOUT_NS = 1000000000ULL,
+};
+
+extern void _secondary_start(void);
+
+/* The boot hart keeps __stack_top; slots for other harts live here in .bss. */
+static uint8_t g_hart_stacks[HART_MAX_HARTS][SMP_STACK_SIZE] __attribute__((aligned(16)));
+static uint32_t g_online_mask;
+
+static void smp_mark_online(uint32_t hart_id) {
+  __atomic_fetch_or(&g_online_mask, 1u << hart_id, __ATOMIC_RELEASE);
+}
+
+static int smp_wait_online(uint32_t hart_id) {
+  uint64_t start = clock_now_ns();
+
+  while ((__atomic_load_n(&g_online_mask, __ATOMIC_ACQUIRE) & (1u << hart_id)) == 0u) {
+    if (clock_now_ns() - start > SMP_START_TIMEOUT_NS) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+uint32_t smp_start_secondaries(void) {
+  uint32_t self = hart_current_id();
+  uint32_t hart;
+
+  smp_mark_online(self);
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    uintptr_t stack_top = (uintptr_t)&g_hart_stacks[hart][SMP_STACK_SIZE];
+    sbi_ret_t status;
+
+    if (hart == self) {
+      continue;
+    }
+
+    /* Missing harts report SBI_ERR_INVALID_PARAM. */
+    status = sbi_hart_get_status(hart);
+    if (status.error != SBI_SUCCESS || status.value != SBI_HSM_STATE_STOPPED) {
+      continue;
+    }
+
+    if (sbi_hart_start(hart, (uintptr_t)_secondary_start, stack_top).error != SBI_SUCCESS) {
+      continue;
+    }
+
+    (void)smp_wait_online(hart);
+  }
+
+  return smp_online_count();
+}
+
+uint32_t smp_online_mask(void) {
+  return __atomic_load_n(&g_online_mask, __ATOMIC_ACQUIRE);
+}
+
+uint32_t smp_online_count(void) {
+  uint32_t mask = smp_online_mask();
+  uint32_t count = 0u;
+
+  while (mask != 0u) {
+    mask &= mask - 1u;
+    count++;
+  }
+
+  return count;
+}
+
+void smp_secondary_main(uint64_t hart_id) {
+  const vm_space_t *space = vm_kernel_space();
+
+  /* HSM starts harts with paging off; the kernel map is an identity map. */
+  if (space != (const vm_space_t *)0) {
+    mmu_set_satp(vm_space_satp(space));
+  }
+
+  trap_init();
+  sched_hart_online();
+  clock_init_secondary();
+  smp_mark_online((uint32_t)hart_id);
+
+  /* Idle root context: it runs only when this hart's queue is empty. */
+  for (;;) {
+    __asm__ volatile("wfi");
+  }
+}
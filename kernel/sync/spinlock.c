@@ -0,0 +1,240 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "riscv_irq.h"
+#include "spinlock.h"
+
+static lock_stats_t *g_lock_stats_head;
+static lock_clock_fn_t g_lock_clock;
+static spinlock_t g_lock_stats_list_lock;
+
+static void lock_stats_acquired(lock_stats_t *stats, bool contended, uint64_t spins) {
+  if (stats == (lock_stats_t *)0) {
+    return;
+  }
+
+  stats->acquisitions++;
+  if (contended) {
+    stats->contended++;
+    stats->spins += spins;
+  }
+  if (g_lock_clock != (lock_clock_fn_t)0) {
+    stats->held_since = g_lock_clock();
+  }
+}
+
+static void lock_stats_releasing(lock_stats_t *stats) {
+  uint64_t held;
+
+  if (stats == (lock_stats_t *)0 || g_lock_clock == (lock_clock_fn_t)0) {
+    return;
+  }
+
+  held = g_lock_clock() - stats->held_since;
+  stats->hold_ns += held;
+  if (held > stats->hold_max_ns) {
+    stats->hold_max_ns = held;
+  }
+}
+
+void spinlock_init(spinlock_t *lock, lock_stats_t *stats) {
+  lock->locked = 0u;
+  lock->stats = stats;
+}
+
+void spin_lock(spinlock_t *lock) {
+  uint64_t spins = 0ULL;
+  bool contended = false;
+
+  /* Spin on plain loads so waiters do not keep stealing the line with amoswap. */
+  while (__atomic_exchange_n(&lock->locked, 1u, __ATOMIC_ACQUIRE) != 0u) {
+    contended = true;
+    while (__atomic_load_n(&lock->locked, __ATOMIC_RELAXED) != 0u) {
+      spins++;
+    }
+  }
+
+  lock_stats_acquired(lock->stats, contended, spins);
+}
+
+bool spin_trylock(spinlock_t *lock) {
+  if (__atomic_exchange_n(&lock->locked, 1u, __ATOMIC_ACQUIRE) != 0u) {
+    return false;
+  }
+
+  lock_stats_acquired(lock->stats, false, 0ULL);
+  return true;
+}
+
+void spin_unlock(spinlock_t *lock) {
+  lock_stats_releasing(lock->stats);
+  __atomic_store_n(&lock->locked, 0u, __ATOMIC_RELEASE);
+}
+
+uint64_t spin_lock_irqsave(spinlock_t *lock) {
+  uint64_t irq_state = riscv_irq_save();
+
+  spin_lock(lock);
+  return irq_state;
+}
+
+void spin_unlock_irqrestore(spinlock_t *lock, uint64_t irq_state) {
+  spin_unlock(lock);
+  riscv_irq_restore(irq_state);
+}
+
+void ticket_lock_init(ticket_lock_t *lock, lock_stats_t *stats) {
+  lock->next = 0u;
+  lock->serving = 0u;
+  lock->stats = stats;
+}
+
+void ticket_lock(ticket_lock_t *lock) {
+  uint32_t ticket = __atomic_fetch_add(&lock->next, 1u, __ATOMIC_RELAXED);
+  uint64_t spins = 0ULL;
+
+  while (__atomic_load_n(&lock->serving, __ATOMIC_ACQUIRE) != ticket) {
+    spins++;
+  }
+
+  lock_stats_acquired(lock->stats, spins != 0ULL, spins);
+}
+
+bool ticket_trylock(ticket_lock_t *lock) {
+  uint32_t serving = __atomic_load_n(&lock->serving, __ATOMIC_ACQUIRE);
+  uint32_t expected = serving;
+
+  /* Only take a ticket when it would be served immediately. */
+  if (!__atomic_compare_exchange_n(&lock->next, &expected, serving + 1u, false, __ATOMIC_ACQUIRE,
+                                   __ATOMIC_RELAXED)) {
+    return false;
+  }
+
+  lock_stats_acquired(lock->stats, false, 0ULL);
+  return true;
+}
+
+void ticket_unlock(ticket_lock_t *lock) {
+  lock_stats_releasing(lock->stats);
+  /* Only the holder writes serving, so a plain increment is enough. */
+  __atomic_store_n(&lock->serving, lock->serving + 1u, __ATOMIC_RELEASE);
+}
+
+uint64_t ticket_lock_irqsave(ticket_lock_t *lock) {
+  uint64_t irq_state = riscv_irq_save();
+
+  ticket_lock(lock);
+  return irq_state;
+}
+
+void ticket_unlock_irqrestore(ticket_lock_t *lock, uint64_t irq_state) {
+  ticket_unlock(lock);
+  riscv_irq_restore(irq_state);
+}
+
+void mcs_lock_init(mcs_lock_t *lock, lock_stats_t *stats) {
+  lock->tail = (mcs_node_t *)0;
+  lock->stats = stats;
+}
+
+void mcs_lock(mcs_lock_t *lock, mcs_node_t *node) {
+  mcs_node_t *prev;
+  uint64_t spins = 0ULL;
+
+  node->next = (mcs_node_t *)0;
+  node->waiting = 1u;
+  prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+  if (prev != (mcs_node_t *)0) {
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&node->waiting, __ATOMIC_ACQUIRE) != 0u) {
+      spins++;
+    }
+  }
+
+  lock_stats_acquired(lock->stats, prev != (mcs_node_t *)0, spins);
+}
+
+bool mcs_trylock(mcs_lock_t *lock, mcs_node_t *node) {
+  mcs_node_t *expected = (mcs_node_t *)0;
+
+  node->next = (mcs_node_t *)0;
+  node->waiting = 0u;
+  if (!__atomic_compare_exchange_n(&lock->tail, &expected, node, false, __ATOMIC_ACQUIRE,
+                                   __ATOMIC_RELAXED)) {
+    return false;
+  }
+
+  lock_stats_acquired(lock->stats, false, 0ULL);
+  return true;
+}
+
+void mcs_unlock(mcs_lock_t *lock, mcs_node_t *node) {
+  mcs_node_t *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+
+  lock_stats_releasing(lock->stats);
+  if (next == (mcs_node_t *)0) {
+    mcs_node_t *expected = node;
+
+    if (__atomic_compare_exchange_n(&lock->tail, &expected, (mcs_node_t *)0, false,
+                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+      return;
+    }
+
+    /* A waiter swapped itself in but has not linked behind us yet. */
+    while ((next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)) == (mcs_node_t *)0) {
+    }
+  }
+
+  __atomic_store_n(&next->waiting, 0u, __ATOMIC_RELEASE);
+}
+
+uint64_t mcs_lock_irqsave(mcs_lock_t *lock, mcs_node_t *node) {
+  uint64_t irq_state = riscv_irq_save();
+
+  mcs_lock(lock, node);
+  return irq_state;
+}
+
+void mcs_unlock_irqrestore(mcs_lock_t *lock, mcs_node_t *node, uint64_t irq_state) {
+  mcs_unlock(lock, node);
+  riscv_irq_restore(irq_state);
+}
+
+void lock_stats_register(lock_stats_t *stats, const char *name) {
+  const lock_stats_t *cursor;
+  uint64_t irq_state;
+  bool listed = false;
+
+  if (stats == (lock_stats_t *)0) {
+    return;
+  }
+
+  irq_state = spin_lock_irqsave(&g_lock_stats_list_lock);
+  for (cursor = g_lock_stats_head; cursor != (const lock_stats_t *)0; cursor = cursor->next) {
+    if (cursor == stats) {
+      listed = true;
+      break;
+    }
+  }
+
+  stats->name = name;
+  stats->acquisitions = 0ULL;
+  stats->contended = 0ULL;
+  stats->spins = 0ULL;
+  stats->hold_ns = 0ULL;
+  stats->hold_max_ns = 0ULL;
+  stats->held_since = 0ULL;
+  if (!listed) {
+    stats->next = g_lock_stats_head;
+    g_lock_stats_head = stats;
+  }
+  spin_unlock_irqrestore(&g_lock_stats_list_lock, irq_state);
+}
+
+const lock_stats_t *lock_stats_first(void) {
+  return g_lock_stats_head;
+}
+
+void lock_stats_set_clock(lock_clock_fn_t clock) {
+  g_lock_clock = clock;
+}
@@ -0,0 +1,210 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "idle.h"
+#include "sched.h"
+#include "spinlock.h"
+#include "task.h"
+#include "timer.h"
+#include "wait.h"
+
+static void wait_unlink(wait_queue_t *wq, task_control_block_t *task) {
+  task_control_block_t **link = &wq->head;
+  task_control_block_t *prev = (task_control_block_t *)0;
+
+  while (*link != (task_control_block_t *)0 && *link != task) {
+    prev = *link;
+    link = &(*link)->wait_next;
+  }
+  if (*link == (task_control_block_t *)0) {
+    return;
+  }
+
+  *link = task->wait_next;
+  if (wq->tail == task) {
+    wq->tail = prev;
+  }
+  task->wait_next = (task_control_block_t *)0;
+  __atomic_store_n(&task->wait_queue, (wait_queue_t *)0, __ATOMIC_RELEASE);
+}
+
+static void wait_timeout_expired(ktimer_t *timer, void *arg) {
+  task_control_block_t *task = (task_control_block_t *)arg;
+  wait_queue_t *wq = __atomic_load_n(&task->wait_queue, __ATOMIC_ACQUIRE);
+  uint64_t irq_state;
+
+  (void)timer;
+  if (wq != (wait_queue_t *)0) {
+    irq_state = spin_lock_irqsave(&wq->lock);
+    if (task->wait_queue == wq) {
+      wait_unlink(wq, task);
+    }
+    spin_unlock_irqrestore(&wq->lock, irq_state);
+  }
+  (void)sched_wake(task);
+}
+
+void wait_queue_init(wait_queue_t *wq) {
+  spinlock_init(&wq->lock, (lock_stats_t *)0);
+  wq->head = (task_control_block_t *)0;
+  wq->tail = (task_control_block_t *)0;
+}
+
+bool wait_prepare(wait_queue_t *wq, uint64_t deadline) {
+  task_control_block_t *task = sched_current_task();
+  uint64_t irq_state;
+
+  if (task == (task_control_block_t *)0 || task->id == TASK_BOOT_ID) {
+    return false;
+  }
+
+  /* Blocked and queued under one lock, so a waker never sees half of it. */
+  irq_state = spin_lock_irqsave(&wq->lock);
+  if (sched_prepare_block() != 0) {
+    spin_unlock_irqrestore(&wq->lock, irq_state);
+    return false;
+  }
+  task->wait_next = (task_control_block_t *)0;
+  __atomic_store_n(&task->wait_queue, wq, __ATOMIC_RELEASE);
+  if (wq->tail == (task_control_block_t *)0) {
+    wq->head = task;
+  } else {
+    wq->tail->wait_next = task;
+  }
+  wq->tail = task;
+  /*
+   * Armed before the unlock, as task_sleep_until() does, so the timeout exists by the time
+   * any waker or interrupt can see the task queued. Callbacks run without the wheel lock,
+   * so taking it under wq->lock cannot invert with wait_timeout_expired().
+   */
+  if (deadline != WAIT_FOREVER) {
+    timer_init(&task->sleep_timer, wait_timeout_expired, task);
+    (void)timer_add(&task->sleep_timer, deadline);
+  }
+  spin_unlock_irqrestore(&wq->lock, irq_state);
+  return true;
+}
+
+void wait_finish(wait_queue_t *wq) {
+  task_control_block_t *task = sched_current_task();
+  uint64_t irq_state;
+
+  if (task == (task_control_block_t *)0 || task->id == TASK_BOOT_ID) {
+    return;
+  }
+
+  (void)timer_cancel(&task->sleep_timer);
+  irq_state = spin_lock_irqsave(&wq->lock);
+  if (task->wait_queue == wq) {
+    wait_unlink(wq, task);
+  }
+  spin_unlock_irqrestore(&wq->lock, irq_state);
+
+  /* Nobody woke us when the condition held on the re-check; undo the block. */
+  (void)sched_wake(task);
+}
+
+uint32_t wake_up(wait_queue_t *wq) {
+  task_control_block_t *task;
+  uint64_t irq_state;
+
+  irq_state = spin_lock_irqsave(&wq->lock);
+  task = wq->head;
+  if (task != (task_control_block_t *)0) {
+    wait_unlink(wq, task);
+  }
+  spin_unlock_irqrestore(&wq->lock, irq_state);
+
+  if (task == (task_control_block_t *)0) {
+    return 0u;
+  }
+
+  (void)sched_wake(task);
+  return 1u;
+}
+
+uint32_t wake_up_all(wait_queue_t *wq) {
+  /* Only non-root tasks wait, and each on at most one queue. */
+  task_control_block_t *woken[TASK_MAX_TASKS];
+  uint64_t irq_state;
+  uint32_t count = 0u;
+  uint32_t i;
+
+  /*
+   * Every waiter is unlinked under the lock before any is woken. A timeout racing with
+   * us then sees wait_queue == 0, and a woken task that queues itself again cannot be
+   * cut off or have its new link cleared by this walk.
+   */
+  irq_state = spin_lock_irqsave(&wq->lock);
+  while (wq->head != (task_control_block_t *)0 && count < TASK_MAX_TASKS) {
+    woken[count++] = wq->head;
+    wait_unlink(wq, wq->head);
+  }
+  spin_unlock_irqrestore(&wq->lock, irq_state);
+
+  for (i = 0u; i < count; ++i) {
+    (void)sched_wake(woken[i]);
+  }
+
+  return count;
+}
+
+bool wait_queue_empty(const wait_queue_t *wq) {
+  return __atomic_load_n(&wq->head, __ATOMIC_RELAXED) == (task_control_block_t *)0;
+}
+
+void sem_init(semaphore_t *sem, uint32_t count) {
+  spinlock_init(&sem->lock, (lock_stats_t *)0);
+  sem->count = count;
+  wait_queue_init(&sem->waiters);
+}
+
+bool sem_trydown(semaphore_t *sem) {
+  uint64_t irq_state = spin_lock_irqsave(&sem->lock);
+  bool taken = sem->count > 0u;
+
+  if (taken) {
+    sem->count--;
+  }
+  spin_unlock_irqrestore(&sem->lock, irq_state);
+  return taken;
+}
+
+void sem_down(semaphore_t *sem) {
+  wait_event(&sem->waiters, sem_trydown(sem));
+}
+
+void sem_up(semaphore_t *sem) {
+  uint64_t irq_state = spin_lock_irqsave(&sem->lock);
+
+  sem->count++;
+  spin_unlock_irqrestore(&sem->lock, irq_state);
+  (void)wake_up(&sem->waiters);
+}
+
+void condvar_init(condvar_t *cv) {
+  wait_queue_init(&cv->waiters);
+}
+
+void condvar_wait(condvar_t *cv, spinlock_t *lock) {
+  /* Queued before the lock drops, so a signal sent after that cannot be missed. */
+  if (!wait_prepare(&cv->waiters, WAIT_FOREVER)) {
+    spin_unlock(lock);
+    idle_run_once();
+    spin_lock(lock);
+    return;
+  }
+
+  spin_unlock(lock);
+  sched_yield();
+  wait_finish(&cv->waiters);
+  spin_lock(lock);
+}
+
+void condvar_signal(condvar_t *cv) {
+  (void)wake_up(&cv->waiters);
+}
+
+void condvar_broadcast(condvar_t *cv) {
+  (void)wake_up_all(&cv->waiters);
+}
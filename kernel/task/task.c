@@ -1,8 +1,14 @@
 #include <stdint.h>
 
+#include "hart.h"
+#include "page_alloc.h"
+#include "sched.h"
 #include "task.h"
 
 static task_control_block_t g_tasks[TASK_MAX_TASKS];
+/* Per-hart contexts that were running before the scheduler took over; all use id 0. */
+static task_control_block_t g_root_tasks[HART_MAX_HARTS];
+static uint32_t g_boot_hart;
 
 static void task_reset(task_control_block_t *task, uint32_t id) {
   if (task == (task_control_block_t *)0) {
@@ -17,15 +23,82 @@ static void task_reset(task_control_block_t *task, uint32_t id) {
   task->context.switches_out = 0ULL;
   task->context.last_mepc = 0ULL;
   task->context.last_mcause = 0ULL;
+  task->context.frame = (struct trap_frame *)0;
+  task->context.run_ns = 0ULL;
+  task->context.wait_ns = 0ULL;
+  task->context.voluntary_switches = 0ULL;
+  task->context.involuntary_switches = 0ULL;
+  task->context.wakeups = 0ULL;
+  task->context.wakeup_latency_ns = 0ULL;
+  task->context.wakeup_latency_max_ns = 0ULL;
+  task->context.added_at = 0ULL;
+  task->context.switched_in_at = 0ULL;
+  task->context.ready_since = 0ULL;
+  task->context.woken = false;
   task->entry = (task_entry_fn)0;
+  task->stack_base = (void *)0;
+  task->priority = (uint8_t)TASK_DEFAULT_PRIORITY;
+  task->run_next = (task_control_block_t *)0;
+  task->hart = 0u;
+  task->on_cpu = false;
+  task->affinity = ~0u;
+  task->wait_queue = (struct wait_queue *)0;
+  task->wait_next = (task_control_block_t *)0;
+}
+
+/* First code a new task runs after sret; a0 carries the TCB. */
+static void task_trampoline(task_control_block_t *task) {
+  task->entry(task);
+  task_exit();
+}
+
+static void task_init_frame(task_control_block_t *task) {
+  uintptr_t stack_top = (uintptr_t)task->stack_base + (uintptr_t)TASK_STACK_SIZE;
+  struct trap_frame *frame = (struct trap_frame *)(stack_top - sizeof(struct trap_frame));
+  uint64_t *words = (uint64_t *)frame;
+  size_t i;
+
+  for (i = 0u; i < sizeof(struct trap_frame) / sizeof(uint64_t); ++i) {
+    words[i] = 0ULL;
+  }
+
+  frame->sp = (uint64_t)stack_top;
+  frame->a0 = (uint64_t)(uintptr_t)task;
+  frame->mepc = (uint64_t)(uintptr_t)task_trampoline;
+  /* sret drops to S-mode with interrupts enabled. */
+  frame->mstatus = (uint64_t)(SSTATUS_SPP | SSTATUS_SPIE);
+  task->context.frame = frame;
 }
 
 void task_system_init(void) {
   uint32_t i;
 
   for (i = 0u; i < TASK_MAX_TASKS; ++i) {
+    if (g_tasks[i].stack_base != (void *)0) {
+      (void)page_free_order(g_tasks[i].stack_base, TASK_STACK_ORDER);
+    }
     task_reset(&g_tasks[i], i + 1u);
   }
+
+  g_boot_hart = hart_current_id() % HART_MAX_HARTS;
+  for (i = 0u; i < HART_MAX_HARTS; ++i) {
+    task_reset(&g_root_tasks[i], TASK_BOOT_ID);
+    g_root_tasks[i].name = i == g_boot_hart ? "boot" : "idle";
+    g_root_tasks[i].hart = (uint8_t)i;
+  }
+  g_root_tasks[g_boot_hart].state = TASK_STATE_RUNNING;
+}
+
+task_control_block_t *task_boot(void) {
+  return &g_root_tasks[g_boot_hart];
+}
+
+task_control_block_t *task_hart_root(uint32_t hart_id) {
+  if (hart_id >= HART_MAX_HARTS) {
+    return (task_control_block_t *)0;
+  }
+
+  return &g_root_tasks[hart_id];
 }
 
 task_control_block_t *task_create(const char *name, task_entry_fn entry) {
@@ -36,18 +109,23 @@ task_control_block_t *task_create(const char *name, task_entry_fn entry) {
   }
 
   for (i = 0u; i < TASK_MAX_TASKS; ++i) {
+    void *stack;
+
     if (g_tasks[i].state != TASK_STATE_UNUSED) {
       continue;
     }
 
+    stack = page_alloc_order(TASK_STACK_ORDER);
+    if (stack == (void *)0) {
+      return (task_control_block_t *)0;
+    }
+
+    task_reset(&g_tasks[i], i + 1u);
     g_tasks[i].name = name;
     g_tasks[i].state = TASK_STATE_RUNNABLE;
-    g_tasks[i].run_count = 0ULL;
-    g_tasks[i].context.switches_in = 0ULL;
-    g_tasks[i].context.switches_out = 0ULL;
-    g_tasks[i].context.last_mepc = 0ULL;
-    g_tasks[i].context.last_mcause = 0ULL;
     g_tasks[i].entry = entry;
+    g_tasks[i].stack_base = stack;
+    task_init_frame(&g_tasks[i]);
     return &g_tasks[i];
   }
 
@@ -55,24 +133,53 @@ task_control_block_t *task_create(const char *name, task_entry_fn entry) {
 }
 
 task_control_block_t *task_find(uint32_t task_id) {
-  uint32_t i;
+  task_control_block_t *task;
 
-  for (i = 0u; i < TASK_MAX_TASKS; ++i) {
-    if (g_tasks[i].id == task_id && g_tasks[i].state != TASK_STATE_UNUSED) {
-      return &g_tasks[i];
-    }
+  if (task_id == TASK_BOOT_ID) {
+    return task_boot();
   }
 
-  return (task_control_block_t *)0;
+  /* Slot i always carries id i + 1. */
+  if (task_id > TASK_MAX_TASKS) {
+    return (task_control_block_t *)0;
+  }
+
+  task = &g_tasks[task_id - 1u];
+  return task->state != TASK_STATE_UNUSED ? task : (task_control_block_t *)0;
+}
+
+void task_reap(task_control_block_t *task) {
+  if (task == (task_control_block_t *)0 || task->id == TASK_BOOT_ID ||
+      task->state != TASK_STATE_EXITED) {
+    return;
+  }
+
+  if (task->stack_base != (void *)0) {
+    (void)page_free_order(task->stack_base, TASK_STACK_ORDER);
+  }
+  task_reset(task, task->id);
+}
+
+void task_exit(void) {
+  task_control_block_t *task = sched_current_task();
+
+  if (task != (task_control_block_t *)0 && task->id != TASK_BOOT_ID) {
+    task->state = TASK_STATE_EXITED;
+  }
+
+  for (;;) {
+    sched_yield();
+  }
 }
 
-void task_context_switch_out(task_control_block_t *task, const struct trap_frame *frame) {
+void task_context_switch_out(task_control_block_t *task, struct trap_frame *frame) {
   if (task == (task_control_block_t *)0) {
     return;
   }
 
   task->context.switches_out += 1ULL;
-  if (frame != (const struct trap_frame *)0) {
+  if (frame != (struct trap_frame *)0) {
+    task->context.frame = frame;
     task->context.last_mepc = frame->mepc;
     task->context.last_mcause = frame->mcause;
   }
@@ -0,0 +1,340 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bitops.h"
+#include "clock.h"
+#include "hart.h"
+#include "riscv_irq.h"
+#include "riscv_timer.h"
+#include "sched.h"
+#include "spinlock.h"
+#include "task.h"
+#include "timer.h"
+
+enum {
+  TIMER_SLOT_MASK = TIMER_WHEEL_SLOTS - 1,
+  TIMER_JIFFY_MASK = (1 << TIMER_JIFFY_SHIFT) - 1,
+  /* Level of a timer that is due and waiting for its callback. */
+  TIMER_LEVEL_EXPIRED = 0xff,
+};
+
+static const uint64_t k_timer_no_deadline = ~0ULL;
+
+/*
+ * Level l has 64 slots of 64^l jiffies. A timer goes to the lowest level whose span
+ * covers its distance from `now`, so insert and cancel are O(1). Each time level 0 wraps,
+ * the current slot of level 1 is cascaded down (and level 2 when level 1 wraps, and so
+ * on), so a timer is re-filed at most once per level before it fires. The slot masks
+ * require TIMER_WHEEL_SLOTS == 64.
+ */
+typedef struct timer_wheel {
+  ktimer_t *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+  /* Bit s of pending[l] is set while slots[l][s] is non-empty. */
+  uint64_t pending[TIMER_WHEEL_LEVELS];
+  /* Due timers whose callbacks have not run yet. */
+  ktimer_t *expired;
+  /* Next jiffy to process; everything before it has fired. */
+  uint64_t now;
+  uint32_t count;
+  spinlock_t lock;
+} timer_wheel_t;
+
+static timer_wheel_t g_timer_wheels[HART_MAX_HARTS];
+
+static timer_wheel_t *timer_this_wheel(void) {
+  return &g_timer_wheels[hart_current_id() % HART_MAX_HARTS];
+}
+
+static void timer_link(ktimer_t **head, ktimer_t *timer) {
+  timer->next = *head;
+  if (*head != (ktimer_t *)0) {
+    (*head)->pprev = &timer->next;
+  }
+  timer->pprev = head;
+  *head = timer;
+}
+
+static void timer_unlink(timer_wheel_t *wheel, ktimer_t *timer) {
+  *timer->pprev = timer->next;
+  if (timer->next != (ktimer_t *)0) {
+    timer->next->pprev = timer->pprev;
+  }
+  if (timer->level != TIMER_LEVEL_EXPIRED &&
+      wheel->slots[timer->level][timer->slot] == (ktimer_t *)0) {
+    wheel->pending[timer->level] &= ~(1ULL << timer->slot);
+  }
+  timer->next = (ktimer_t *)0;
+  timer->pprev = (ktimer_t **)0;
+}
+
+static void timer_wheel_insert(timer_wheel_t *wheel, ktimer_t *timer) {
+  const uint64_t span = 1ULL << (TIMER_WHEEL_LEVEL_BITS * TIMER_WHEEL_LEVELS);
+  uint64_t expires = timer->expires < wheel->now ? wheel->now : timer->expires;
+  uint64_t delta = expires - wheel->now;
+  uint32_t level = 0u;
+  uint32_t slot;
+
+  while (level + 1u < TIMER_WHEEL_LEVELS &&
+         delta >= (1ULL << (TIMER_WHEEL_LEVEL_BITS * (level + 1u)))) {
+    level++;
+  }
+  /* Past the top level: park in its farthest slot and re-file when that slot cascades. */
+  if (delta >= span) {
+    expires = wheel->now + span - 1ULL;
+  }
+
+  slot = (uint32_t)(expires >> (TIMER_WHEEL_LEVEL_BITS * level)) & TIMER_SLOT_MASK;
+  timer->level = (uint8_t)level;
+  timer->slot = (uint8_t)slot;
+  timer_link(&wheel->slots[level][slot], timer);
+  wheel->pending[level] |= 1ULL << slot;
+}
+
+/* Called when level 0 is about to process slot 0. */
+static void timer_wheel_cascade(timer_wheel_t *wheel) {
+  uint32_t level;
+
+  for (level = 1u; level < TIMER_WHEEL_LEVELS; ++level) {
+    uint32_t slot = (uint32_t)(wheel->now >> (TIMER_WHEEL_LEVEL_BITS * level)) & TIMER_SLOT_MASK;
+    ktimer_t *list = wheel->slots[level][slot];
+
+    wheel->slots[level][slot] = (ktimer_t *)0;
+    wheel->pending[level] &= ~(1ULL << slot);
+    while (list != (ktimer_t *)0) {
+      ktimer_t *timer = list;
+
+      list = timer->next;
+      timer_wheel_insert(wheel, timer);
+    }
+
+    if (slot != 0u) {
+      break;
+    }
+  }
+}
+
+/*
+ * Next jiffy that needs processing, capped at `limit`: the next busy level-0 slot in this
+ * block, else the next cascade point while anything is queued.
+ */
+static uint64_t timer_wheel_next_step(const timer_wheel_t *wheel, uint64_t limit) {
+  uint32_t index = (uint32_t)wheel->now & TIMER_SLOT_MASK;
+  uint64_t later = index == TIMER_SLOT_MASK ? 0ULL : wheel->pending[0] & (~0ULL << (index + 1u));
+  uint64_t next = limit;
+  uint32_t level;
+
+  if (later != 0ULL) {
+    next = (wheel->now & ~(uint64_t)TIMER_SLOT_MASK) + bitops_ctz64(later);
+  } else {
+    for (level = 0u; level < TIMER_WHEEL_LEVELS; ++level) {
+      if (wheel->pending[level] != 0ULL) {
+        next = (wheel->now | TIMER_SLOT_MASK) + 1ULL;
+        break;
+      }
+    }
+  }
+
+  return next < limit ? next : limit;
+}
+
+/* Earliest real deadline, in jiffies; only the first busy slot of each level can hold it. */
+static uint64_t timer_wheel_earliest(const timer_wheel_t *wheel) {
+  uint64_t best = k_timer_no_deadline;
+  uint32_t level;
+
+  for (level = 0u; level < TIMER_WHEEL_LEVELS; ++level) {
+    uint32_t shift = TIMER_WHEEL_LEVEL_BITS * level;
+    uint64_t mask = wheel->pending[level];
+    uint32_t first;
+    uint64_t later;
+    const ktimer_t *timer;
+
+    if (mask == 0ULL) {
+      continue;
+    }
+
+    /* The current slot is still ahead only when `now` sits exactly on its cascade point. */
+    first = (uint32_t)(wheel->now >> shift) & TIMER_SLOT_MASK;
+    if ((wheel->now & ((1ULL << shift) - 1ULL)) != 0ULL) {
+      first++;
+    }
+    later = first > TIMER_SLOT_MASK ? 0ULL : mask & (~0ULL << first);
+
+    timer = wheel->slots[level][bitops_ctz64(later != 0ULL ? later : mask)];
+    for (; timer != (const ktimer_t *)0; timer = timer->next) {
+      if (timer->expires < best) {
+        best = timer->expires;
+      }
+    }
+  }
+
+  return best;
+}
+
+void timer_init(ktimer_t *timer, ktimer_fn_t fn, void *arg) {
+  timer->next = (ktimer_t *)0;
+  timer->pprev = (ktimer_t **)0;
+  timer->expires = 0ULL;
+  timer->fn = fn;
+  timer->arg = arg;
+  timer->hart = 0u;
+  timer->level = 0u;
+  timer->slot = 0u;
+  timer->pending = false;
+}
+
+int timer_add(ktimer_t *timer, uint64_t deadline) {
+  uint32_t hart = hart_current_id() % HART_MAX_HARTS;
+  timer_wheel_t *wheel = &g_timer_wheels[hart];
+  uint64_t expires = deadline >> TIMER_JIFFY_SHIFT;
+  uint64_t irq_state;
+
+  if (timer == (ktimer_t *)0 || timer->fn == (ktimer_fn_t)0) {
+    return -1;
+  }
+
+  (void)timer_cancel(timer);
+  if ((deadline & TIMER_JIFFY_MASK) != 0ULL && expires < (k_timer_no_deadline >> TIMER_JIFFY_SHIFT)) {
+    expires++;
+  }
+
+  irq_state = spin_lock_irqsave(&wheel->lock);
+  timer->expires = expires;
+  timer->hart = (uint8_t)hart;
+  timer->pending = true;
+  timer_wheel_insert(wheel, timer);
+  wheel->count++;
+  spin_unlock_irqrestore(&wheel->lock, irq_state);
+
+  clock_request_event(expires << TIMER_JIFFY_SHIFT);
+  return 0;
+}
+
+bool timer_cancel(ktimer_t *timer) {
+  timer_wheel_t *wheel;
+  uint64_t irq_state;
+  bool was_pending;
+
+  if (timer == (ktimer_t *)0) {
+    return false;
+  }
+
+  wheel = &g_timer_wheels[timer->hart % HART_MAX_HARTS];
+  irq_state = spin_lock_irqsave(&wheel->lock);
+  was_pending = timer->pending;
+  if (was_pending) {
+    timer_unlink(wheel, timer);
+    timer->pending = false;
+    wheel->count--;
+  }
+  spin_unlock_irqrestore(&wheel->lock, irq_state);
+
+  return was_pending;
+}
+
+bool timer_pending(const ktimer_t *timer) {
+  return timer != (const ktimer_t *)0 && __atomic_load_n(&timer->pending, __ATOMIC_ACQUIRE);
+}
+
+uint32_t timer_hart_count(uint32_t hart_id) {
+  if (hart_id >= HART_MAX_HARTS) {
+    return 0u;
+  }
+
+  return g_timer_wheels[hart_id].count;
+}
+
+void timer_hart_init(uint64_t now) {
+  timer_wheel_t *wheel = timer_this_wheel();
+  uint32_t level;
+  uint32_t slot;
+
+  spinlock_init(&wheel->lock, (lock_stats_t *)0);
+  for (level = 0u; level < TIMER_WHEEL_LEVELS; ++level) {
+    for (slot = 0u; slot < TIMER_WHEEL_SLOTS; ++slot) {
+      ktimer_t *timer;
+
+      for (timer = wheel->slots[level][slot]; timer != (ktimer_t *)0; timer = timer->next) {
+        timer->pending = false;
+      }
+      wheel->slots[level][slot] = (ktimer_t *)0;
+    }
+    wheel->pending[level] = 0ULL;
+  }
+  wheel->expired = (ktimer_t *)0;
+  wheel->now = now >> TIMER_JIFFY_SHIFT;
+  wheel->count = 0u;
+}
+
+uint64_t timer_run(uint64_t now) {
+  timer_wheel_t *wheel = timer_this_wheel();
+  uint64_t target = now >> TIMER_JIFFY_SHIFT;
+  uint64_t irq_state = spin_lock_irqsave(&wheel->lock);
+  uint64_t next;
+
+  while (wheel->now <= target) {
+    uint32_t index = (uint32_t)wheel->now & TIMER_SLOT_MASK;
+    ktimer_t *list;
+
+    if (index == 0u) {
+      timer_wheel_cascade(wheel);
+    }
+
+    list = wheel->slots[0][index];
+    wheel->slots[0][index] = (ktimer_t *)0;
+    wheel->pending[0] &= ~(1ULL << index);
+    while (list != (ktimer_t *)0) {
+      ktimer_t *timer = list;
+
+      list = timer->next;
+      timer->level = TIMER_LEVEL_EXPIRED;
+      timer_link(&wheel->expired, timer);
+    }
+
+    /* Step first, so timers armed by callbacks land in a slot that is still ahead. */
+    wheel->now = timer_wheel_next_step(wheel, target + 1ULL);
+
+    while (wheel->expired != (ktimer_t *)0) {
+      ktimer_t *timer = wheel->expired;
+
+      timer_unlink(wheel, timer);
+      timer->pending = false;
+      wheel->count--;
+      spin_unlock_irqrestore(&wheel->lock, irq_state);
+      timer->fn(timer, timer->arg);
+      irq_state = spin_lock_irqsave(&wheel->lock);
+    }
+  }
+
+  next = timer_wheel_earliest(wheel);
+  spin_unlock_irqrestore(&wheel->lock, irq_state);
+
+  return next == k_timer_no_deadline ? k_timer_no_deadline : next << TIMER_JIFFY_SHIFT;
+}
+
+static void timer_sleep_expired(ktimer_t *timer, void *arg) {
+  (void)timer;
+  (void)sched_wake((task_control_block_t *)arg);
+}
+
+int task_sleep_until(uint64_t deadline) {
+  task_control_block_t *task = sched_current_task();
+  uint64_t irq_state;
+
+  if (task == (task_control_block_t *)0 || task->id == TASK_BOOT_ID) {
+    return -1;
+  }
+  if (riscv_timer_now() >= deadline) {
+    return 0;
+  }
+
+  /* Masked so the timer cannot fire before the task is marked blocked. */
+  irq_state = riscv_irq_save();
+  timer_init(&task->sleep_timer, timer_sleep_expired, task);
+  (void)sched_block_current();
+  (void)timer_add(&task->sleep_timer, deadline);
+  riscv_irq_restore(irq_state);
+
+  /* The yield raised by sched_block_current() switches away; we resume once woken. */
+  return 0;
+}
@@ -0,0 +1,189 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "clock.h"
+#include "hart.h"
+#include "page_alloc.h"
+#include "riscv_irq.h"
+#include "trace.h"
+
+_Static_assert((TRACE_RING_EVENTS & (TRACE_RING_EVENTS - 1u)) == 0u, "trace ring power of two");
+
+typedef struct trace_ring {
+  /* Published after the slot is written, so readers never see a half-filled event. */
+  uint64_t head;
+  trace_event_t events[TRACE_RING_EVENTS];
+} trace_ring_t;
+
+/* Phase letters follow the Chrome trace format: B/E open and close a slice, i is instant. */
+typedef struct trace_event_desc {
+  const char *name;
+  char phase;
+  const char *args;
+} trace_event_desc_t;
+
+static const trace_event_desc_t k_trace_events[TRACE_EVENT_COUNT] = {
+    [TRACE_SCHED_SWITCH] = {"sched_switch", 'i', "prev,next,prev_state"},
+    [TRACE_SCHED_WAKE] = {"sched_wake", 'i', "task,waker_hart"},
+    [TRACE_SCHED_STEAL] = {"sched_steal", 'i', "task,victim_hart"},
+    [TRACE_TRAP_ENTER] = {"trap", 'B', "scause,irq"},
+    [TRACE_TRAP_EXIT] = {"trap", 'E', ""},
+    [TRACE_PAGE_ALLOC] = {"page_alloc", 'i', "addr,order,caller"},
+    [TRACE_PAGE_FREE] = {"page_free", 'i', "addr,order,caller"},
+    [TRACE_WM_RENDER_BEGIN] = {"wm_render", 'B', "windows"},
+    [TRACE_WM_RENDER_END] = {"wm_render", 'E', "marker"},
+    [TRACE_SHELL_EXEC_BEGIN] = {"shell_exec", 'B', ""},
+    [TRACE_SHELL_EXEC_END] = {"shell_exec", 'E', "rc"},
+};
+
+bool g_trace_enabled;
+static trace_ring_t g_trace_rings[HART_MAX_HARTS];
+
+static void trace_page_event(bool alloc, uintptr_t addr, unsigned int order, uintptr_t caller) {
+  trace_event(alloc ? TRACE_PAGE_ALLOC : TRACE_PAGE_FREE, addr, order, caller);
+}
+
+void trace_record(trace_event_id_t id, uint64_t arg0, uint64_t arg1, uint64_t arg2) {
+  uint64_t irq_state = riscv_irq_save();
+  uint32_t hart = hart_current_id() % HART_MAX_HARTS;
+  trace_ring_t *ring = &g_trace_rings[hart];
+  uint64_t index = ring->head;
+  trace_event_t *event = &ring->events[index & (TRACE_RING_EVENTS - 1u)];
+
+  event->time_ns = clock_now_ns();
+  event->id = (uint16_t)id;
+  event->hart = (uint8_t)hart;
+  event->args[0] = arg0;
+  event->args[1] = arg1;
+  event->args[2] = arg2;
+  __atomic_store_n(&ring->head, index + 1u, __ATOMIC_RELEASE);
+  riscv_irq_restore(irq_state);
+}
+
+void trace_set_enabled(bool enabled) {
+  page_alloc_set_event_hook(enabled ? trace_page_event : (page_alloc_event_fn_t)0);
+  __atomic_store_n(&g_trace_enabled, enabled, __ATOMIC_RELEASE);
+}
+
+bool trace_enabled(void) {
+  return __atomic_load_n(&g_trace_enabled, __ATOMIC_RELAXED);
+}
+
+void trace_clear(void) {
+  uint32_t hart;
+
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    __atomic_store_n(&g_trace_rings[hart].head, 0u, __ATOMIC_RELEASE);
+  }
+}
+
+/* First index a dump may read; a full ring gives up its oldest slot to a racing writer. */
+static uint64_t trace_ring_start(uint64_t head) {
+  return head >= TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS + 1u : 0u;
+}
+
+uint64_t trace_event_count(void) {
+  uint64_t total = 0u;
+  uint32_t hart;
+
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    uint64_t head = __atomic_load_n(&g_trace_rings[hart].head, __ATOMIC_ACQUIRE);
+
+    total += head - trace_ring_start(head);
+  }
+  return total;
+}
+
+uint64_t trace_lost_count(void) {
+  uint64_t total = 0u;
+  uint32_t hart;
+
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    total += trace_ring_start(__atomic_load_n(&g_trace_rings[hart].head, __ATOMIC_ACQUIRE));
+  }
+  return total;
+}
+
+static void trace_write_u64(void (*write)(const char *s), uint64_t value) {
+  char digits[21];
+  uint32_t count = 0u;
+  char out[21];
+  uint32_t i = 0u;
+
+  do {
+    digits[count++] = (char)('0' + (value % 10u));
+    value /= 10u;
+  } while (value != 0u);
+  while (count > 0u) {
+    out[i++] = digits[--count];
+  }
+  out[i] = '\0';
+  write(out);
+}
+
+/* Little-endian hex of the raw event, so the decoder unpacks it with the struct layout. */
+static void trace_write_event(void (*write)(const char *s), const trace_event_t *event) {
+  static const char k_hex_digits[] = "0123456789abcdef";
+  const uint8_t *bytes = (const uint8_t *)event;
+  char line[TRACE_EVENT_SIZE * 2u + 1u];
+  uint32_t i;
+
+  for (i = 0u; i < TRACE_EVENT_SIZE; ++i) {
+    line[i * 2u] = k_hex_digits[bytes[i] >> 4];
+    line[i * 2u + 1u] = k_hex_digits[bytes[i] & 0xFu];
+  }
+  line[TRACE_EVENT_SIZE * 2u] = '\0';
+  write("TRACE: ev ");
+  write(line);
+  write("\n");
+}
+
+void trace_dump(void (*write)(const char *s)) {
+  bool was_enabled = trace_enabled();
+  uint64_t events = 0u;
+  uint32_t hart;
+  uint32_t id;
+
+  trace_set_enabled(false);
+
+  write("TRACE: begin version=");
+  trace_write_u64(write, TRACE_FORMAT_VERSION);
+  write(" harts=");
+  trace_write_u64(write, HART_MAX_HARTS);
+  write(" event_size=");
+  trace_write_u64(write, TRACE_EVENT_SIZE);
+  write("\n");
+
+  for (id = 1u; id < TRACE_EVENT_COUNT; ++id) {
+    char phase[2] = {k_trace_events[id].phase, '\0'};
+
+    write("TRACE: name ");
+    trace_write_u64(write, id);
+    write(" ");
+    write(phase);
+    write(" ");
+    write(k_trace_events[id].name);
+    write(" ");
+    write(k_trace_events[id].args[0] != '\0' ? k_trace_events[id].args : "-");
+    write("\n");
+  }
+
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    const trace_ring_t *ring = &g_trace_rings[hart];
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t index;
+
+    for (index = trace_ring_start(head); index < head; ++index) {
+      trace_write_event(write, &ring->events[index & (TRACE_RING_EVENTS - 1u)]);
+      events++;
+    }
+  }
+
+  write("TRACE: end events=");
+  trace_write_u64(write, events);
+  write(" lost=");
+  trace_write_u64(write, trace_lost_count());
+  write("\n");
+
+  trace_set_enabled(was_enabled);
+}
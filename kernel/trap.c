@@ -3,18 +3,50 @@
 
 #include "clock.h"
 #include "console.h"
+#include "hart.h"
+#include "klog.h"
+#include "perf.h"
+#include "profile.h"
 #include "sched.h"
+#include "trace.h"
 #include "trap.h"
 
 enum {
   MCAUSE_INTERRUPT_BIT = 1ULL << 63,
   MCAUSE_CODE_MASK = MCAUSE_INTERRUPT_BIT - 1ULL,
+  MCAUSE_INTERRUPT_SUPERVISOR_SOFTWARE = 1ULL,
   MCAUSE_INTERRUPT_SUPERVISOR_TIMER = 5ULL,
   MCAUSE_INTERRUPT_MACHINE_TIMER = 7ULL,
   MCAUSE_EXCEPTION_BREAKPOINT = 3ULL,
 };
 
+_Static_assert(HART_MAX_HARTS == TRAP_STATS_HART_MASK + 1, "trap stats hart mask");
+
+enum {
+  STVEC_MODE_MASK = 0x3ULL,
+  STVEC_MODE_VECTORED = 0x1ULL,
+};
+
+_Static_assert(TRAP_IRQ_SOFTWARE == MCAUSE_INTERRUPT_SUPERVISOR_SOFTWARE, "trap irq software");
+_Static_assert(TRAP_IRQ_TIMER == MCAUSE_INTERRUPT_SUPERVISOR_TIMER, "trap irq timer");
+_Static_assert(MCAUSE_INTERRUPT_MACHINE_TIMER < TRAP_IRQ_COUNT, "trap irq table size");
+
 extern void trap_vector(void);
+extern void trap_vector_table(void);
+
+static struct trap_frame *trap_irq_software(struct trap_frame *frame);
+static struct trap_frame *trap_irq_timer(struct trap_frame *frame);
+
+/* Read and written by trap.S. */
+trap_cycle_stats_t g_trap_cycle_stats[HART_MAX_HARTS];
+uint8_t g_trap_fast_path = 1u;
+trap_irq_handler_t g_trap_irq_handlers[TRAP_IRQ_COUNT] = {
+    [MCAUSE_INTERRUPT_SUPERVISOR_SOFTWARE] = trap_irq_software,
+    [MCAUSE_INTERRUPT_SUPERVISOR_TIMER] = trap_irq_timer,
+    [MCAUSE_INTERRUPT_MACHINE_TIMER] = trap_irq_timer,
+};
+
+static bool g_trap_vectored;
 
 static volatile bool trap_test_armed;
 static volatile bool trap_test_passed;
@@ -23,6 +55,18 @@ static inline void csr_write_stvec(uint64_t value) {
   __asm__ volatile("csrw stvec, %0" : : "r"(value));
 }
 
+static inline uint64_t csr_read_stvec(void) {
+  uint64_t value;
+  __asm__ volatile("csrr %0, stvec" : "=r"(value));
+  return value;
+}
+
+static inline uint64_t csr_read_sepc(void) {
+  uint64_t value;
+  __asm__ volatile("csrr %0, sepc" : "=r"(value));
+  return value;
+}
+
 static inline bool trap_is_interrupt(uint64_t cause) {
   return (cause & MCAUSE_INTERRUPT_BIT) != 0ULL;
 }
@@ -79,23 +123,105 @@ static bool trap_dispatch_exception(struct trap_frame *frame, uint64_t code) {
   }
 }
 
-static bool trap_dispatch_interrupt(struct trap_frame *frame, uint64_t code) {
-  switch (code) {
-    case MCAUSE_INTERRUPT_SUPERVISOR_TIMER:
-    case MCAUSE_INTERRUPT_MACHINE_TIMER:
-      clock_handle_timer_interrupt();
-      sched_handle_timer_interrupt(frame);
-      return true;
-    default:
-      return false;
+static struct trap_frame *trap_irq_software(struct trap_frame *frame) {
+  trace_event(TRACE_TRAP_ENTER, frame->mcause, 0u, 0u);
+  frame = sched_handle_yield(frame);
+  /* A kick may have ended this hart's idle stretch; restart its slices. */
+  clock_reprogram();
+  trace_event(TRACE_TRAP_EXIT, 0u, 0u, 0u);
+  return frame;
+}
+
+static struct trap_frame *trap_irq_timer(struct trap_frame *frame) {
+  trace_event(TRACE_TRAP_ENTER, frame->mcause, 0u, 0u);
+  profile_tick(frame->mepc, frame->ra);
+  clock_handle_timer_interrupt();
+  return trap_timer_switch(frame);
+}
+
+/* Direct mode, and vectored causes without a stub of their own, decode here. */
+static bool trap_dispatch_interrupt(struct trap_frame **frame, uint64_t code) {
+  trap_irq_handler_t handler;
+
+  if (code >= TRAP_IRQ_COUNT) {
+    return false;
+  }
+
+  handler = __atomic_load_n(&g_trap_irq_handlers[code], __ATOMIC_ACQUIRE);
+  if (handler == (trap_irq_handler_t)0) {
+    return false;
+  }
+
+  *frame = handler(*frame);
+  return true;
+}
+
+bool trap_timer_fast(struct trap_frame *frame) {
+  bool needs_switch;
+
+  trace_event(TRACE_TRAP_ENTER, MCAUSE_INTERRUPT_BIT | MCAUSE_INTERRUPT_SUPERVISOR_TIMER, 0u,
+              0u);
+  /* The fast path never saves sepc; the CSR still holds the interrupted pc. */
+  profile_tick(csr_read_sepc(), frame->ra);
+  clock_handle_timer_interrupt();
+  needs_switch = sched_tick_needs_switch();
+  /* A switching tick closes its slice in trap_timer_switch(). */
+  if (!needs_switch) {
+    trace_event(TRACE_TRAP_EXIT, 0u, 0u, 0u);
+  }
+  return needs_switch;
+}
+
+struct trap_frame *trap_timer_switch(struct trap_frame *frame) {
+  frame = sched_handle_timer_interrupt(frame);
+  clock_reprogram();
+  trace_event(TRACE_TRAP_EXIT, 0u, 0u, 0u);
+  return frame;
+}
+
+void trap_set_fast_path(bool enabled) {
+  __atomic_store_n(&g_trap_fast_path, enabled ? 1u : 0u, __ATOMIC_RELAXED);
+}
+
+bool trap_fast_path_enabled(void) {
+  return __atomic_load_n(&g_trap_fast_path, __ATOMIC_RELAXED) != 0u;
+}
+
+int trap_cycle_stats(uint32_t hart_id, trap_cycle_stats_t *out) {
+  if (hart_id >= HART_MAX_HARTS || out == (trap_cycle_stats_t *)0) {
+    return -1;
+  }
+
+  *out = g_trap_cycle_stats[hart_id];
+  return 0;
+}
+
+int trap_register_irq(uint32_t code, trap_irq_handler_t handler) {
+  if (code >= TRAP_IRQ_COUNT) {
+    return -1;
   }
+
+  __atomic_store_n(&g_trap_irq_handlers[code], handler, __ATOMIC_RELEASE);
+  return 0;
+}
+
+bool trap_vectored(void) {
+  return g_trap_vectored;
 }
 
 void trap_init(void) {
-  uintptr_t stvec_base = (uintptr_t)&trap_vector;
-  /* Force direct mode (MODE=0) to avoid accidental low-bit mode selection. */
-  stvec_base &= ~(uintptr_t)0x3U;
-  csr_write_stvec((uint64_t)stvec_base);
+  uint64_t table = (uint64_t)(uintptr_t)&trap_vector_table & ~STVEC_MODE_MASK;
+  uint64_t direct = (uint64_t)(uintptr_t)&trap_vector & ~STVEC_MODE_MASK;
+
+  /* MODE is WARL: a hart without vectored mode reads back something else. */
+  csr_write_stvec(table | STVEC_MODE_VECTORED);
+  if ((csr_read_stvec() & STVEC_MODE_MASK) == STVEC_MODE_VECTORED) {
+    g_trap_vectored = true;
+    return;
+  }
+
+  csr_write_stvec(direct);
+  g_trap_vectored = false;
 }
 
 void trap_test_trigger(void) {
@@ -114,19 +240,29 @@ void trap_test_trigger(void) {
   trap_halt();
 }
 
-void trap_handle(struct trap_frame *frame) {
+struct trap_frame *trap_handle(struct trap_frame *frame) {
+  PERF_SCOPE("trap_handle");
   uint64_t cause = frame->mcause;
   uint64_t code = trap_cause_code(cause);
   bool is_interrupt = trap_is_interrupt(cause);
 
-  if (is_interrupt && trap_dispatch_interrupt(frame, code)) {
-    return;
+  if (is_interrupt && trap_dispatch_interrupt(&frame, code)) {
+    return frame;
   }
 
-  if (!is_interrupt && trap_dispatch_exception(frame, code)) {
-    return;
+  if (!is_interrupt) {
+    bool handled;
+
+    trace_event(TRACE_TRAP_ENTER, cause, 0u, 0u);
+    handled = trap_dispatch_exception(frame, code);
+    trace_event(TRACE_TRAP_EXIT, 0u, 0u, 0u);
+    if (handled) {
+      return frame;
+    }
   }
 
+  /* Halting: get the buffered log out ahead of the report. */
+  klog_flush();
   console_write("TRAP: unexpected mcause=");
   console_write_hex_u64(frame->mcause);
   console_write(" mepc=");
@@ -135,4 +271,5 @@ void trap_handle(struct trap_frame *frame) {
   console_write_hex_u64(frame->mtval);
   console_write("\n");
   trap_halt();
+  return frame;
 }
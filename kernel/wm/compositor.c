@@ -1,6 +1,8 @@
 #include <stdint.h>
 
 #include "framebuffer.h"
+#include "perf.h"
+#include "trace.h"
 #include "wm_compositor.h"
 #include "wm_focus.h"
 #include "wm_layers.h"
@@ -154,7 +156,7 @@ int wm_compositor_activate_at(uint32_t x, uint32_t y) {
 
 const wm_window_t *wm_compositor_active_window(void) { return wm_focus_active_window(); }
 
-uint32_t wm_compositor_render(void) {
+static uint32_t wm_compositor_render_frame(void) {
   const struct framebuffer_info *fb;
   uint32_t pixel_count;
   uint32_t i;
@@ -179,3 +181,13 @@ uint32_t wm_compositor_render(void) {
 
   return fnv1a32_pixels(fb->pixels, pixel_count);
 }
+
+uint32_t wm_compositor_render(void) {
+  PERF_SCOPE("wm_compositor_render");
+  uint32_t marker;
+
+  trace_event(TRACE_WM_RENDER_BEGIN, wm_layers_count(&g_scene.layers), 0u, 0u);
+  marker = wm_compositor_render_frame();
+  trace_event(TRACE_WM_RENDER_END, marker, 0u, 0u);
+  return marker;
+}
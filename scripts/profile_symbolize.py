@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+"""Symbolizes the PROFILE: lines of a `profile dump` serial log.
+
+Usage: profile_symbolize.py SYMBOLS [serial.log] [--folded OUT]
+
+SYMBOLS is build/kernel.elf (function symbols with sizes, statics included) or
+build/kernel.map (global symbols only). Prints a flat profile; --folded also writes
+"task;caller;function count" lines for flamegraph.pl or speedscope. The caller comes from
+the sampled ra register, so it is exact only for leaf functions and is left out when it
+points back into the sampled function.
+"""
+import bisect
+import re
+import struct
+import sys
+
+MAP_SYMBOL = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+([A-Za-z_.$][\w.$]*)\s*$")
+ELF_MAGIC = b"\x7fELF"
+SHT_SYMTAB = 2
+STT_FUNC = 2
+
+
+def load_elf_symbols(data):
+    if data[4] != 2 or data[5] != 1:
+        raise SystemExit("profile_symbolize: expected a little-endian ELF64 file")
+    shoff, = struct.unpack_from("<Q", data, 0x28)
+    shentsize, shnum = struct.unpack_from("<HH", data, 0x3A)
+    sections = [struct.unpack_from("<IIQQQQIIQQ", data, shoff + i * shentsize)
+                for i in range(shnum)]
+    symbols = []
+    for section in sections:
+        if section[1] != SHT_SYMTAB:
+            continue
+        strtab = sections[section[6]]
+        offset, size, entsize = section[4], section[5], section[9]
+        for pos in range(offset, offset + size, entsize):
+            name_off, info, _, _, value, sym_size = struct.unpack_from("<IBBHQQ", data, pos)
+            if info & 0xF != STT_FUNC or value == 0:
+                continue
+            start = strtab[4] + name_off
+            name = data[start:data.index(b"\0", start)].decode("ascii", "replace")
+            symbols.append((value, sym_size, name))
+    return symbols
+
+
+def load_map_symbols(text):
+    symbols = []
+    for line in text.splitlines():
+        match = MAP_SYMBOL.match(line)
+        if match and not match.group(2).startswith("."):
+            symbols.append((int(match.group(1), 16), 0, match.group(2)))
+    return symbols
+
+
+class Symbolizer:
+    def __init__(self, path):
+        with open(path, "rb") as handle:
+            data = handle.read()
+        if data[:4] == ELF_MAGIC:
+            symbols = load_elf_symbols(data)
+        else:
+            symbols = load_map_symbols(data.decode("utf-8", "replace"))
+        if not symbols:
+            raise SystemExit("profile_symbolize: no function symbols in %s" % path)
+        symbols.sort()
+        self.starts = [symbol[0] for symbol in symbols]
+        self.symbols = symbols
+
+    def lookup(self, addr):
+        index = bisect.bisect_right(self.starts, addr) - 1
+        if index < 0:
+            return "0x%x" % addr
+        start, size, name = self.symbols[index]
+        # Map files carry no sizes; trust the nearest symbol below.
+        if size and addr >= start + size:
+            return "0x%x" % addr
+        return name
+
+
+def parse(lines):
+    tasks = {}
+    samples = []
+    seen_begin = False
+    for line in lines:
+        start = line.find("PROFILE: ")
+        if start < 0:
+            continue
+        fields = line[start + len("PROFILE: "):].split()
+        if not fields:
+            continue
+        if fields[0] == "begin":
+            seen_begin = True
+            tasks = {}
+            samples = []
+        elif fields[0] == "task" and len(fields) >= 3:
+            tasks[int(fields[1])] = " ".join(fields[2:])
+        elif fields[0] == "s" and len(fields) == 6:
+            hart, task = int(fields[1]), int(fields[2])
+            pc, ra, count = int(fields[3], 16), int(fields[4], 16), int(fields[5])
+            samples.append((hart, task, pc, ra, count))
+    if not seen_begin:
+        raise SystemExit("profile_symbolize: no 'PROFILE: begin' line found")
+    return tasks, samples
+
+
+def main(argv):
+    args = argv[1:]
+    folded_path = None
+    if "--folded" in args:
+        index = args.index("--folded")
+        if index + 1 >= len(args):
+            raise SystemExit("profile_symbolize: --folded needs an output path")
+        folded_path = args[index + 1]
+        del args[index:index + 2]
+    if not 1 <= len(args) <= 2:
+        raise SystemExit("usage: profile_symbolize.py SYMBOLS [serial.log] [--folded OUT]")
+
+    symbolizer = Symbolizer(args[0])
+    if len(args) == 2:
+        with open(args[1], encoding="utf-8", errors="replace") as log:
+            tasks, samples = parse(log)
+    else:
+        tasks, samples = parse(sys.stdin)
+
+    flat = {}
+    folded = {}
+    total = 0
+    for hart, task, pc, ra, count in samples:
+        function = symbolizer.lookup(pc)
+        flat[function] = flat.get(function, 0) + count
+        total += count
+        task_name = tasks.get(task, "task%d" % task)
+        if task == 0:
+            task_name = "root/hart%d" % hart
+        frames = [task_name]
+        caller = symbolizer.lookup(ra) if ra else None
+        if caller is not None and caller != function:
+            frames.append(caller)
+        frames.append(function)
+        key = ";".join(frames)
+        folded[key] = folded.get(key, 0) + count
+
+    print("%10s %7s  %s" % ("samples", "percent", "function"))
+    for function, count in sorted(flat.items(), key=lambda item: (-item[1], item[0])):
+        print("%10d %6.2f%%  %s" % (count, 100.0 * count / total, function))
+    print("%10d %6.2f%%  total" % (total, 100.0 if total else 0.0))
+
+    if folded_path is not None:
+        with open(folded_path, "w", encoding="utf-8") as out:
+            for key in sorted(folded):
+                out.write("%s %d\n" % (key, folded[key]))
+
+
+if __name__ == "__main__":
+    main(sys.argv)
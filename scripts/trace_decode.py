@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""Turns the TRACE: lines of a `trace dump` serial log into Chrome trace JSON.
+
+Usage: trace_decode.py [serial.log] > trace.json, then load it in chrome://tracing or
+Perfetto. Each hart is a thread; scheduler switches also become per-hart task slices.
+"""
+import json
+import struct
+import sys
+
+EVENT_FORMAT = "<QHB5xQQQ"
+FORMAT_VERSION = 1
+TASK_TID_BASE = 100
+
+
+def parse(lines):
+    header = None
+    names = {}
+    events = []
+    for line in lines:
+        start = line.find("TRACE: ")
+        if start < 0:
+            continue
+        fields = line[start + len("TRACE: "):].split()
+        if not fields:
+            continue
+        kind = fields[0]
+        if kind == "begin":
+            header = dict(field.split("=", 1) for field in fields[1:])
+            names = {}
+            events = []
+        elif kind == "name" and len(fields) == 5:
+            args = [] if fields[4] == "-" else fields[4].split(",")
+            names[int(fields[1])] = (fields[2], fields[3], args)
+        elif kind == "ev" and len(fields) == 2:
+            raw = bytes.fromhex(fields[1])
+            if len(raw) != struct.calcsize(EVENT_FORMAT):
+                continue
+            events.append(struct.unpack(EVENT_FORMAT, raw))
+    if header is None:
+        raise SystemExit("trace_decode: no 'TRACE: begin' line found")
+    if int(header.get("version", "0")) != FORMAT_VERSION:
+        raise SystemExit("trace_decode: unsupported trace version %s" % header.get("version"))
+    return names, events
+
+
+def to_chrome(names, events):
+    out = []
+    harts = set()
+    running = {}
+    last_ts = 0.0
+    # Rings are dumped one hart at a time; a stable sort keeps each hart's order on ties.
+    for time_ns, event_id, hart, a0, a1, a2 in sorted(events, key=lambda ev: ev[0]):
+        ts = time_ns / 1000.0
+        last_ts = max(last_ts, ts)
+        harts.add(hart)
+        phase, name, arg_names = names.get(event_id, ("i", "event_%d" % event_id, []))
+        record = {"name": name, "ph": phase, "ts": ts, "pid": 0, "tid": hart}
+        if phase == "i":
+            record["s"] = "t"
+        values = (a0, a1, a2)
+        args = {arg: values[i] for i, arg in enumerate(arg_names)}
+        if "rc" in args and args["rc"] >= 1 << 63:
+            args["rc"] -= 1 << 64
+        if args:
+            record["args"] = args
+        out.append(record)
+
+        if name == "sched_switch":
+            prev = running.get(hart)
+            if prev is not None:
+                out.append(task_slice(hart, prev[0], prev[1], ts))
+            running[hart] = (a1, ts)
+
+    for hart, (task, since) in running.items():
+        out.append(task_slice(hart, task, since, last_ts))
+    for hart in sorted(harts):
+        out.append(thread_name(hart, "hart%d" % hart))
+        if hart in running:
+            out.append(thread_name(TASK_TID_BASE + hart, "hart%d tasks" % hart))
+    return {"traceEvents": out, "displayTimeUnit": "ns"}
+
+
+def task_slice(hart, task, start, end):
+    return {
+        "name": "task %d" % task,
+        "ph": "X",
+        "ts": start,
+        "dur": end - start,
+        "pid": 0,
+        "tid": TASK_TID_BASE + hart,
+        "args": {"task": task},
+    }
+
+
+def thread_name(tid, name):
+    return {"name": "thread_name", "ph": "M", "pid": 0, "tid": tid, "args": {"name": name}}
+
+
+def main(argv):
+    if len(argv) > 2:
+        raise SystemExit("usage: trace_decode.py [serial.log]")
+    if len(argv) == 2:
+        with open(argv[1], encoding="utf-8", errors="replace") as log:
+            names, events = parse(log)
+    else:
+        names, events = parse(sys.stdin)
+    json.dump(to_chrome(names, events), sys.stdout, indent=1)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main(sys.argv)
@@ -1,10 +1,33 @@
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
+#include "clock.h"
+#include "hart.h"
+#include "klog.h"
 #include "page_alloc.h"
+#include "page_cache.h"
+#include "page_zero.h"
+#include "perf.h"
+#include "profile.h"
+#include "riscv_timer.h"
+#include "sched.h"
 #include "shell_builtins.h"
 #include "shell_builtins_fs.h"
 #include "shell_fd_table.h"
+#include "spinlock.h"
+#include "task.h"
+#include "trace.h"
+#include "trap.h"
+#include "uart.h"
+#include "vm_kernel.h"
+
+enum {
+  SHELL_PAGEMAP_TOP_SITES = 8u,
+  SHELL_PAGEMAP_RECENT = 16u,
+  SHELL_SCHEDSTAT_EVENTS = 16u,
+  SHELL_DMESG_RECORDS = 32u,
+};
 
 typedef int (*shell_builtin_fn_t)(int argc, char **argv);
 
@@ -49,6 +72,25 @@ static void shell_write_u64(uint64_t value) {
   }
 }
 
+static int shell_parse_u32(const char *text, uint32_t *out) {
+  uint32_t value = 0u;
+
+  if (text == 0 || *text == '\0') {
+    return -1;
+  }
+
+  while (*text != '\0') {
+    if (*text < '0' || *text > '9' || value > (0xffffffffu - 9u) / 10u) {
+      return -1;
+    }
+    value = (value * 10u) + (uint32_t)(*text - '0');
+    ++text;
+  }
+
+  *out = value;
+  return 0;
+}
+
 static void shell_write_hex_uintptr(uintptr_t value) {
   static const char digits[] = "0123456789abcdef";
   unsigned int shift = (unsigned int)(sizeof(uintptr_t) * 8u);
@@ -64,11 +106,39 @@ static void shell_write_hex_uintptr(uintptr_t value) {
 static int shell_builtin_help(int argc, char **argv);
 static int shell_builtin_echo(int argc, char **argv);
 static int shell_builtin_meminfo(int argc, char **argv);
+static int shell_builtin_pagemap(int argc, char **argv);
+static int shell_builtin_tlbbench(int argc, char **argv);
+static int shell_builtin_ctxbench(int argc, char **argv);
+static int shell_builtin_lockstat(int argc, char **argv);
+static int shell_builtin_clockstat(int argc, char **argv);
+static int shell_builtin_trapstat(int argc, char **argv);
+static int shell_builtin_uartstat(int argc, char **argv);
+static int shell_builtin_dmesg(int argc, char **argv);
+static int shell_builtin_trace(int argc, char **argv);
+static int shell_builtin_profile(int argc, char **argv);
+static int shell_builtin_perfstat(int argc, char **argv);
+static int shell_builtin_top(int argc, char **argv);
+static int shell_builtin_schedstat(int argc, char **argv);
 
 static const shell_builtin_t g_shell_builtins[] = {
     {"help", "show this help", shell_builtin_help},
     {"echo", "print arguments", shell_builtin_echo},
-    {"meminfo", "show allocator usage", shell_builtin_meminfo},
+    {"meminfo", "show allocator usage (-v adds pagemap)", shell_builtin_meminfo},
+    {"pagemap", "show fragmentation and traced call sites", shell_builtin_pagemap},
+    {"tlbbench", "compare 4k and 2m page walks", shell_builtin_tlbbench},
+    {"ctxbench", "measure context switch cycles", shell_builtin_ctxbench},
+    {"lockstat", "show lock contention and hold times", shell_builtin_lockstat},
+    {"clockstat", "show timer interrupt rates (tickless on|off)", shell_builtin_clockstat},
+    {"trapstat", "show trap entry-to-exit cycles (fast on|off)", shell_builtin_trapstat},
+    {"uartstat", "show serial throughput and cpu cost (irq on|off, reset)",
+     shell_builtin_uartstat},
+    {"dmesg", "show the kernel log (stats adds per-hart logging cost)", shell_builtin_dmesg},
+    {"trace", "binary tracepoints (on|off|clear|dump)", shell_builtin_trace},
+    {"profile", "sample the interrupted pc each tick (start|stop|dump)", shell_builtin_profile},
+    {"perfstat", "show per-site cycles and instructions (hist, reset)", shell_builtin_perfstat},
+    {"top", "show per-task cpu time, waits and switches", shell_builtin_top},
+    {"schedstat", "show run queue counters (events adds recent switches)",
+     shell_builtin_schedstat},
     {"ls", "list files and directories", shell_builtin_ls},
     {"cat", "print file contents", shell_builtin_cat},
     {"pwd", "print current directory", shell_builtin_pwd},
@@ -113,15 +183,107 @@ static int shell_builtin_echo(int argc, char **argv) {
   return SHELL_EXEC_OK;
 }
 
+static void shell_pagemap_report(void) {
+  page_alloc_frag_report_t report;
+  page_alloc_trace_site_t sites[SHELL_PAGEMAP_TOP_SITES];
+  size_t site_count;
+  size_t i;
+
+  page_alloc_fragmentation(&report);
+  shell_fd_write("pagemap: free_pages=");
+  shell_write_u64((uint64_t)report.free_pages);
+  shell_fd_write(" free_runs=");
+  shell_write_u64((uint64_t)report.free_runs);
+  shell_fd_write(" largest_free_run=");
+  shell_write_u64((uint64_t)report.largest_free_run);
+  shell_fd_write("\n");
+
+  shell_fd_write("pagemap: run_hist");
+  for (i = 0u; i < PAGE_ALLOC_RUN_BUCKETS; ++i) {
+    if (report.run_histogram[i] == 0u) {
+      continue;
+    }
+    shell_fd_write(" ");
+    shell_write_u64(1ull << i);
+    shell_fd_write(i + 1u == PAGE_ALLOC_RUN_BUCKETS ? "+=" : "=");
+    shell_write_u64((uint64_t)report.run_histogram[i]);
+  }
+  shell_fd_write("\n");
+
+  shell_fd_write("pagemap: trace=");
+  shell_fd_write(page_alloc_trace_enabled() ? "on" : "off");
+  shell_fd_write(" records=");
+  shell_write_u64(page_alloc_trace_records());
+  shell_fd_write(" untracked_pages=");
+  shell_write_u64(page_alloc_trace_untracked_pages());
+  shell_fd_write("\n");
+
+  site_count = page_alloc_trace_top_sites(sites, SHELL_PAGEMAP_TOP_SITES);
+  for (i = 0u; i < site_count; ++i) {
+    shell_fd_write("pagemap: site ");
+    shell_write_hex_uintptr(sites[i].caller);
+    shell_fd_write(" allocs=");
+    shell_write_u64(sites[i].alloc_calls);
+    shell_fd_write(" pages=");
+    shell_write_u64(sites[i].alloc_pages);
+    shell_fd_write(" freed=");
+    shell_write_u64(sites[i].free_pages);
+    shell_fd_write("\n");
+  }
+}
+
+static void shell_pagemap_recent(void) {
+  page_alloc_trace_entry_t entries[SHELL_PAGEMAP_RECENT];
+  size_t count = page_alloc_trace_snapshot(entries, SHELL_PAGEMAP_RECENT);
+  size_t i;
+
+  for (i = 0u; i < count; ++i) {
+    shell_fd_write("pagemap: t_ns=");
+    shell_write_u64(entries[i].timestamp);
+    shell_fd_write(entries[i].kind == PAGE_ALLOC_TRACE_ALLOC ? " alloc " : " free ");
+    shell_write_hex_uintptr(page_alloc_range_start() +
+                            ((uintptr_t)entries[i].page_index * PAGE_ALLOC_PAGE_SIZE));
+    shell_fd_write(" order=");
+    shell_write_u64((uint64_t)entries[i].order);
+    shell_fd_write(" caller=");
+    shell_write_hex_uintptr(entries[i].caller);
+    shell_fd_write("\n");
+  }
+}
+
+static int shell_builtin_pagemap(int argc, char **argv) {
+  if (argc > 2 && shell_str_eq(argv[1], "trace") && shell_str_eq(argv[2], "on")) {
+    page_alloc_trace_enable(clock_now_ns);
+    shell_fd_write("pagemap: tracing enabled\n");
+    return SHELL_EXEC_OK;
+  }
+  if (argc > 2 && shell_str_eq(argv[1], "trace") && shell_str_eq(argv[2], "off")) {
+    page_alloc_trace_disable();
+    shell_fd_write("pagemap: tracing disabled\n");
+    return SHELL_EXEC_OK;
+  }
+  if (argc > 1 && shell_str_eq(argv[1], "trace")) {
+    shell_pagemap_recent();
+    return SHELL_EXEC_OK;
+  }
+  if (argc > 1) {
+    shell_fd_write("pagemap: usage: pagemap [trace [on|off]]\n");
+    return SHELL_EXEC_OK;
+  }
+
+  shell_pagemap_report();
+  return SHELL_EXEC_OK;
+}
+
 static int shell_builtin_meminfo(int argc, char **argv) {
   size_t total_pages;
   size_t free_pages;
   size_t used_pages;
   uintptr_t range_start;
   uintptr_t range_end;
-
-  (void)argc;
-  (void)argv;
+  uint32_t hart;
+  page_zero_stats_t zero_stats;
+  uint64_t zero_requests;
 
   total_pages = page_alloc_total_pages();
   free_pages = page_alloc_free_pages();
@@ -141,8 +303,627 @@ static int shell_builtin_meminfo(int argc, char **argv) {
   shell_write_u64((uint64_t)free_pages);
   shell_fd_write(" used_pages=");
   shell_write_u64((uint64_t)used_pages);
+  shell_fd_write(" cached_pages=");
+  shell_write_u64((uint64_t)page_cache_cached_pages());
   shell_fd_write("\n");
 
+  for (hart = 0u; hart < (uint32_t)HART_MAX_HARTS; ++hart) {
+    page_cache_stats_t stats;
+
+    if (!page_cache_stats(hart, &stats) ||
+        (stats.refills == 0u && stats.drains == 0u && stats.cached_pages == 0u)) {
+      continue;
+    }
+
+    shell_fd_write("meminfo: pcp hart=");
+    shell_write_u64((uint64_t)hart);
+    shell_fd_write(" cached=");
+    shell_write_u64((uint64_t)stats.cached_pages);
+    shell_fd_write(" alloc_hits=");
+    shell_write_u64(stats.alloc_hits);
+    shell_fd_write(" free_hits=");
+    shell_write_u64(stats.free_hits);
+    shell_fd_write(" refills=");
+    shell_write_u64(stats.refills);
+    shell_fd_write(" drains=");
+    shell_write_u64(stats.drains);
+    shell_fd_write("\n");
+  }
+
+  page_zero_get_stats(&zero_stats);
+  zero_requests = zero_stats.hits + zero_stats.misses;
+  shell_fd_write("meminfo: zero_pool depth=");
+  shell_write_u64((uint64_t)zero_stats.depth);
+  shell_fd_write("/");
+  shell_write_u64((uint64_t)zero_stats.target);
+  shell_fd_write(" hits=");
+  shell_write_u64(zero_stats.hits);
+  shell_fd_write(" misses=");
+  shell_write_u64(zero_stats.misses);
+  shell_fd_write(" hit_rate=");
+  shell_write_u64(zero_requests == 0u ? 0u : (zero_stats.hits * 100u) / zero_requests);
+  shell_fd_write("%\n");
+
+  if (argc > 1 && shell_str_eq(argv[1], "-v")) {
+    shell_pagemap_report();
+  }
+
+  return SHELL_EXEC_OK;
+}
+
+static int shell_builtin_tlbbench(int argc, char **argv) {
+  uint32_t passes = 4u;
+  vm_tlb_bench_result_t result;
+  uint64_t accesses;
+
+  if (argc > 1 && (shell_parse_u32(argv[1], &passes) != 0 || passes == 0u)) {
+    shell_fd_write("tlbbench: usage: tlbbench [passes]\n");
+    return SHELL_EXEC_OK;
+  }
+
+  if (vm_kernel_tlb_bench(passes, &result) != 0) {
+    shell_fd_write("tlbbench: paging is not enabled or no RAM window is free\n");
+    return SHELL_EXEC_OK;
+  }
+
+  accesses = (uint64_t)result.pages * (uint64_t)result.passes;
+  shell_fd_write("tlbbench: pages=");
+  shell_write_u64((uint64_t)result.pages);
+  shell_fd_write(" passes=");
+  shell_write_u64((uint64_t)result.passes);
+  shell_fd_write(" 4k_ns=");
+  shell_write_u64(result.small_ns);
+  shell_fd_write(" 2m_ns=");
+  shell_write_u64(result.huge_ns);
+  shell_fd_write(" 4k_ps_per_access=");
+  shell_write_u64((result.small_ns * 1000u) / accesses);
+  shell_fd_write(" 2m_ps_per_access=");
+  shell_write_u64((result.huge_ns * 1000u) / accesses);
+  shell_fd_write("\n");
+  return SHELL_EXEC_OK;
+}
+
+static int shell_builtin_ctxbench(int argc, char **argv) {
+  uint32_t yields = 1000u;
+  sched_switch_bench_t result;
+
+  if (argc > 1 && (shell_parse_u32(argv[1], &yields) != 0 || yields == 0u)) {
+    shell_fd_write("ctxbench: usage: ctxbench [yields]\n");
+    return SHELL_EXEC_OK;
+  }
+
+  if (sched_bench_switch_cost(yields, &result) != 0) {
+    shell_fd_write("ctxbench: scheduler is not running\n");
+    return SHELL_EXEC_OK;
+  }
+
+  shell_fd_write("ctxbench: yields=");
+  shell_write_u64((uint64_t)result.yields);
+  shell_fd_write(" switches=");
+  shell_write_u64(result.switches);
+  shell_fd_write(" cycles=");
+  shell_write_u64(result.cycles);
+  shell_fd_write(" cycles_per_switch=");
+  shell_write_u64(result.switches == 0u ? 0u : result.cycles / result.switches);
+  shell_fd_write("\n");
+  return SHELL_EXEC_OK;
+}
+
+static int shell_builtin_lockstat(int argc, char **argv) {
+  const lock_stats_t *stats;
+
+  (void)argc;
+  (void)argv;
+
+  for (stats = lock_stats_first(); stats != (const lock_stats_t *)0; stats = stats->next) {
+    shell_fd_write("lockstat: ");
+    shell_fd_write(stats->name != (const char *)0 ? stats->name : "?");
+    shell_fd_write(" acquisitions=");
+    shell_write_u64(stats->acquisitions);
+    shell_fd_write(" contended=");
+    shell_write_u64(stats->contended);
+    shell_fd_write(" spins=");
+    shell_write_u64(stats->spins);
+    shell_fd_write(" hold_avg_ns=");
+    shell_write_u64(stats->acquisitions == 0u ? 0u : stats->hold_ns / stats->acquisitions);
+    shell_fd_write(" hold_max_ns=");
+    shell_write_u64(stats->hold_max_ns);
+    shell_fd_write("\n");
+  }
+
+  return SHELL_EXEC_OK;
+}
+
+/* Rates are reported over the window since the previous clockstat, or since start. */
+static uint64_t g_clockstat_interrupts[HART_MAX_HARTS];
+static uint64_t g_clockstat_time[HART_MAX_HARTS];
+
+static int shell_builtin_clockstat(int argc, char **argv) {
+  uint64_t now = riscv_timer_now();
+  uint32_t hart;
+
+  if (argc > 2 && shell_str_eq(argv[1], "tickless") &&
+      (shell_str_eq(argv[2], "on") || shell_str_eq(argv[2], "off"))) {
+    clock_set_tickless(shell_str_eq(argv[2], "on"));
+  } else if (argc > 1) {
+    shell_fd_write("clockstat: usage: clockstat [tickless on|off]\n");
+    return SHELL_EXEC_OK;
+  }
+
+  shell_fd_write("clockstat: tickless=");
+  shell_fd_write(clock_tickless_enabled() ? "on" : "off");
+  shell_fd_write(" timebase_hz=");
+  shell_write_u64(clock_timebase_hz());
+  shell_fd_write("\n");
+
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    clock_hart_stats_t stats;
+    uint64_t window;
+
+    if (clock_hart_stats(hart, &stats) != 0 || !stats.running) {
+      continue;
+    }
+
+    if (g_clockstat_time[hart] < stats.started_at) {
+      g_clockstat_time[hart] = stats.started_at;
+      g_clockstat_interrupts[hart] = 0u;
+    }
+    window = now - g_clockstat_time[hart];
+
+    shell_fd_write("clockstat: hart");
+    shell_write_u64((uint64_t)hart);
+    shell_fd_write(stats.tickless ? " mode=tickless" : " mode=periodic");
+    shell_fd_write(" interrupts=");
+    shell_write_u64(stats.interrupts);
+    shell_fd_write(" idle=");
+    shell_write_u64(stats.idle_interrupts);
+    shell_fd_write(" per_sec=");
+    shell_write_u64(window == 0u ? 0u
+                                 : ((stats.interrupts - g_clockstat_interrupts[hart]) *
+                                    clock_timebase_hz()) / window);
+    shell_fd_write("\n");
+
+    g_clockstat_interrupts[hart] = stats.interrupts;
+    g_clockstat_time[hart] = now;
+  }
+
+  return SHELL_EXEC_OK;
+}
+
+static int shell_builtin_trapstat(int argc, char **argv) {
+  uint32_t hart;
+
+  if (argc > 2 && shell_str_eq(argv[1], "fast") &&
+      (shell_str_eq(argv[2], "on") || shell_str_eq(argv[2], "off"))) {
+    trap_set_fast_path(shell_str_eq(argv[2], "on"));
+  } else if (argc > 1) {
+    shell_fd_write("trapstat: usage: trapstat [fast on|off]\n");
+    return SHELL_EXEC_OK;
+  }
+
+  shell_fd_write("trapstat: fast_path=");
+  shell_fd_write(trap_fast_path_enabled() ? "on" : "off");
+  shell_fd_write(" stvec=");
+  shell_fd_write(trap_vectored() ? "vectored" : "direct");
+  shell_fd_write("\n");
+
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    trap_cycle_stats_t stats;
+
+    if (trap_cycle_stats(hart, &stats) != 0 || stats.fast_count + stats.full_count == 0u) {
+      continue;
+    }
+
+    shell_fd_write("trapstat: hart");
+    shell_write_u64(hart);
+    shell_fd_write(" fast=");
+    shell_write_u64(stats.fast_count);
+    shell_fd_write(" fast_avg_cycles=");
+    shell_write_u64(stats.fast_count == 0u ? 0u : stats.fast_cycles / stats.fast_count);
+    shell_fd_write(" full=");
+    shell_write_u64(stats.full_count);
+    shell_fd_write(" full_avg_cycles=");
+    shell_write_u64(stats.full_count == 0u ? 0u : stats.full_cycles / stats.full_count);
+    shell_fd_write("\n");
+  }
+
+  return SHELL_EXEC_OK;
+}
+
+/* Switching modes resets the counters so each run of a large cat is measured alone. */
+static int shell_builtin_uartstat(int argc, char **argv) {
+  uart_stats_t stats;
+  uint64_t cpu_cycles;
+
+  if (argc > 2 && shell_str_eq(argv[1], "irq") &&
+      (shell_str_eq(argv[2], "on") || shell_str_eq(argv[2], "off"))) {
+    uart_set_interrupt_mode(shell_str_eq(argv[2], "on"));
+    uart_stats_reset();
+  } else if (argc == 2 && shell_str_eq(argv[1], "reset")) {
+    uart_stats_reset();
+  } else if (argc > 1) {
+    shell_fd_write("uartstat: usage: uartstat [irq on|off|reset]\n");
+    return SHELL_EXEC_OK;
+  }
+
+  /* Snapshot first: printing the report moves the counters. */
+  uart_stats(&stats);
+  cpu_cycles = stats.write_cycles + stats.irq_cycles;
+
+  shell_fd_write("uartstat: mode=");
+  shell_fd_write(uart_interrupt_mode() ? "irq" : "polled");
+  shell_fd_write(" tx_bytes=");
+  shell_write_u64(stats.tx_bytes);
+  shell_fd_write(" rx_bytes=");
+  shell_write_u64(stats.rx_bytes);
+  shell_fd_write(" rx_dropped=");
+  shell_write_u64(stats.rx_dropped);
+  shell_fd_write(" irqs=");
+  shell_write_u64(stats.interrupts);
+  shell_fd_write(" full_waits=");
+  shell_write_u64(stats.tx_full_waits);
+  shell_fd_write("\n");
+
+  shell_fd_write("uartstat: cpu_cycles=");
+  shell_write_u64(cpu_cycles);
+  shell_fd_write(" cycles_per_byte=");
+  shell_write_u64(stats.tx_bytes == 0u ? 0u : cpu_cycles / stats.tx_bytes);
+  shell_fd_write(" tx_active_ns=");
+  shell_write_u64(stats.tx_active_ns);
+  shell_fd_write(" tx_bytes_per_s=");
+  shell_write_u64(stats.tx_active_ns == 0u ? 0u
+                                           : stats.tx_bytes * 1000000000ULL / stats.tx_active_ns);
+  shell_fd_write("\n");
+  return SHELL_EXEC_OK;
+}
+
+static const char *shell_klog_level_name(uint8_t level) {
+  switch (level) {
+    case KLOG_ERR:
+      return "err";
+    case KLOG_WARN:
+      return "warn";
+    case KLOG_INFO:
+      return "info";
+    default:
+      return "debug";
+  }
+}
+
+static int shell_builtin_dmesg(int argc, char **argv) {
+  static klog_record_t records[SHELL_DMESG_RECORDS];
+  char text[KLOG_TEXT_MAX + 1u];
+  uint32_t count;
+  uint32_t hart;
+  uint32_t i;
+
+  if (argc == 2 && shell_str_eq(argv[1], "stats")) {
+    for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+      klog_hart_stats_t stats;
+
+      if (klog_hart_stats(hart, &stats) != 0 || stats.records == 0u) {
+        continue;
+      }
+
+      shell_fd_write("dmesg: hart");
+      shell_write_u64(hart);
+      shell_fd_write(" records=");
+      shell_write_u64(stats.records);
+      shell_fd_write(" dropped=");
+      shell_write_u64(stats.dropped);
+      shell_fd_write(" avg_cycles=");
+      shell_write_u64(stats.cycles / stats.records);
+      shell_fd_write("\n");
+    }
+    return SHELL_EXEC_OK;
+  }
+  if (argc > 1) {
+    shell_fd_write("dmesg: usage: dmesg [stats]\n");
+    return SHELL_EXEC_OK;
+  }
+
+  count = klog_read(records, SHELL_DMESG_RECORDS);
+  for (i = 0u; i < count; ++i) {
+    uint16_t j;
+
+    for (j = 0u; j < records[i].len; ++j) {
+      text[j] = records[i].text[j];
+    }
+    text[records[i].len] = '\0';
+
+    shell_fd_write("dmesg: t_ns=");
+    shell_write_u64(records[i].time_ns);
+    shell_fd_write(" hart");
+    shell_write_u64(records[i].hart);
+    shell_fd_write(" ");
+    shell_fd_write(shell_klog_level_name(records[i].level));
+    shell_fd_write(" ");
+    shell_fd_write(text);
+    shell_fd_write("\n");
+  }
+  return SHELL_EXEC_OK;
+}
+
+/* The dump goes to the console for scripts/trace_decode.py to pick out of the serial log. */
+static int shell_builtin_trace(int argc, char **argv) {
+  if (argc == 2 && (shell_str_eq(argv[1], "on") || shell_str_eq(argv[1], "off"))) {
+    trace_set_enabled(shell_str_eq(argv[1], "on"));
+  } else if (argc == 2 && shell_str_eq(argv[1], "clear")) {
+    trace_clear();
+  } else if (argc == 2 && shell_str_eq(argv[1], "dump")) {
+    trace_dump(shell_fd_write);
+    return SHELL_EXEC_OK;
+  } else if (argc > 1) {
+    shell_fd_write("trace: usage: trace [on|off|clear|dump]\n");
+    return SHELL_EXEC_OK;
+  }
+
+  shell_fd_write("trace: ");
+  shell_fd_write(trace_enabled() ? "on" : "off");
+  shell_fd_write(" events=");
+  shell_write_u64(trace_event_count());
+  shell_fd_write(" lost=");
+  shell_write_u64(trace_lost_count());
+  shell_fd_write("\n");
+  return SHELL_EXEC_OK;
+}
+
+/* The dump goes to the console for scripts/profile_symbolize.py, like `trace dump`. */
+static int shell_builtin_profile(int argc, char **argv) {
+  uint32_t hart;
+
+  if (argc == 2 && shell_str_eq(argv[1], "start")) {
+    profile_start();
+  } else if (argc == 2 && shell_str_eq(argv[1], "stop")) {
+    profile_stop();
+  } else if (argc == 2 && shell_str_eq(argv[1], "dump")) {
+    profile_dump(shell_fd_write);
+    return SHELL_EXEC_OK;
+  } else if (argc > 1) {
+    shell_fd_write("profile: usage: profile [start|stop|dump]\n");
+    return SHELL_EXEC_OK;
+  }
+
+  shell_fd_write("profile: ");
+  shell_fd_write(profile_running() ? "running" : "stopped");
+  shell_fd_write("\n");
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    profile_hart_stats_t stats;
+
+    if (profile_hart_stats(hart, &stats) != 0 || stats.samples + stats.dropped == 0u) {
+      continue;
+    }
+
+    shell_fd_write("profile: hart");
+    shell_write_u64(hart);
+    shell_fd_write(" samples=");
+    shell_write_u64(stats.samples);
+    shell_fd_write(" dropped=");
+    shell_write_u64(stats.dropped);
+    shell_fd_write("\n");
+  }
+  return SHELL_EXEC_OK;
+}
+
+static void shell_perfstat_print_hist(const perf_site_t *site) {
+  uint32_t bucket;
+
+  shell_fd_write("perfstat:   hist");
+  for (bucket = 0u; bucket < PERF_HIST_BUCKETS; ++bucket) {
+    if (site->hist[bucket] == 0u) {
+      continue;
+    }
+    shell_fd_write(" 2^");
+    shell_write_u64(bucket);
+    shell_fd_write("=");
+    shell_write_u64(site->hist[bucket]);
+  }
+  shell_fd_write("\n");
+}
+
+/* Cycle columns; p50 and p99 are histogram bucket upper bounds, not exact values. */
+static int shell_builtin_perfstat(int argc, char **argv) {
+  const perf_site_t *site;
+  bool hist = false;
+
+  if (argc == 2 && shell_str_eq(argv[1], "reset")) {
+    perf_reset();
+    return SHELL_EXEC_OK;
+  }
+  if (argc == 2 && shell_str_eq(argv[1], "hist")) {
+    hist = true;
+  } else if (argc > 1) {
+    shell_fd_write("perfstat: usage: perfstat [hist|reset]\n");
+    return SHELL_EXEC_OK;
+  }
+
+  site = perf_site_first();
+  if (site == (const perf_site_t *)0) {
+    shell_fd_write("perfstat: no sites (kernel built with PERF_SCOPES=0?)\n");
+    return SHELL_EXEC_OK;
+  }
+
+  for (; site != (const perf_site_t *)0; site = site->next) {
+    uint64_t count = site->count;
+
+    if (count == 0u) {
+      continue;
+    }
+
+    shell_fd_write("perfstat: ");
+    shell_fd_write(site->name);
+    shell_fd_write(" calls=");
+    shell_write_u64(count);
+    shell_fd_write(" min=");
+    shell_write_u64(site->cycles_min);
+    shell_fd_write(" avg=");
+    shell_write_u64(site->cycles / count);
+    shell_fd_write(" max=");
+    shell_write_u64(site->cycles_max);
+    shell_fd_write(" p50<");
+    shell_write_u64(perf_site_percentile(site, 50u));
+    shell_fd_write(" p99<");
+    shell_write_u64(perf_site_percentile(site, 99u));
+    shell_fd_write(" instret_avg=");
+    shell_write_u64(site->instret / count);
+    shell_fd_write("\n");
+    if (hist) {
+      shell_perfstat_print_hist(site);
+    }
+  }
+  return SHELL_EXEC_OK;
+}
+
+static const char *shell_task_state_name(uint32_t state) {
+  switch (state) {
+    case TASK_STATE_RUNNABLE:
+      return "runnable";
+    case TASK_STATE_RUNNING:
+      return "running";
+    case TASK_STATE_EXITED:
+      return "exited";
+    case TASK_STATE_BLOCKED:
+      return "blocked";
+    default:
+      return "unused";
+  }
+}
+
+static void shell_top_print(const task_control_block_t *task) {
+  sched_task_stats_t stats;
+
+  if (sched_task_stats(task, &stats) != 0) {
+    return;
+  }
+
+  shell_fd_write("top: id=");
+  shell_write_u64(stats.id);
+  shell_fd_write(" name=");
+  shell_fd_write(stats.name != (const char *)0 ? stats.name : "?");
+  shell_fd_write(" hart=");
+  shell_write_u64(stats.hart);
+  shell_fd_write(" state=");
+  shell_fd_write(shell_task_state_name((uint32_t)stats.state));
+  shell_fd_write(" prio=");
+  shell_write_u64(stats.priority);
+  shell_fd_write(" cpu_pct=");
+  shell_write_u64(stats.age_ns == 0u ? 0u : (stats.run_ns * 100u) / stats.age_ns);
+  shell_fd_write(" run_ns=");
+  shell_write_u64(stats.run_ns);
+  shell_fd_write(" wait_ns=");
+  shell_write_u64(stats.wait_ns);
+  shell_fd_write(" vcsw=");
+  shell_write_u64(stats.voluntary_switches);
+  shell_fd_write(" ivcsw=");
+  shell_write_u64(stats.involuntary_switches);
+  shell_fd_write(" wake_avg_ns=");
+  shell_write_u64(stats.wakeups == 0u ? 0u : stats.wakeup_latency_ns / stats.wakeups);
+  shell_fd_write(" wake_max_ns=");
+  shell_write_u64(stats.wakeup_latency_max_ns);
+  shell_fd_write("\n");
+}
+
+static int shell_builtin_top(int argc, char **argv) {
+  uint32_t hart;
+  uint32_t id;
+
+  (void)argc;
+  (void)argv;
+
+  /* Root contexts share id 0, so list them by hart before the created tasks. */
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    sched_hart_stats_t stats;
+
+    if (sched_hart_stats(hart, &stats) == 0 && stats.online) {
+      shell_top_print(task_hart_root(hart));
+    }
+  }
+  for (id = 1u; id <= TASK_MAX_TASKS; ++id) {
+    const task_control_block_t *task = task_find(id);
+
+    if (task != (const task_control_block_t *)0) {
+      shell_top_print(task);
+    }
+  }
+
+  return SHELL_EXEC_OK;
+}
+
+static void shell_schedstat_print_event(uint32_t hart, const sched_event_t *event) {
+  shell_fd_write("schedstat: hart");
+  shell_write_u64(hart);
+  shell_fd_write(" t_ns=");
+  shell_write_u64(event->time_ns);
+  switch (event->type) {
+    case SCHED_EVENT_SWITCH:
+      shell_fd_write(" switch ");
+      shell_write_u64(event->task);
+      shell_fd_write("->");
+      shell_write_u64(event->other);
+      shell_fd_write(" prev=");
+      shell_fd_write(shell_task_state_name(event->state));
+      break;
+    case SCHED_EVENT_WAKE:
+      shell_fd_write(" wake ");
+      shell_write_u64(event->task);
+      shell_fd_write(" by hart");
+      shell_write_u64(event->other);
+      break;
+    case SCHED_EVENT_STEAL:
+      shell_fd_write(" steal ");
+      shell_write_u64(event->task);
+      shell_fd_write(" from hart");
+      shell_write_u64(event->other);
+      break;
+    default:
+      shell_fd_write(" unknown");
+      break;
+  }
+  shell_fd_write("\n");
+}
+
+static int shell_builtin_schedstat(int argc, char **argv) {
+  sched_event_t events[SHELL_SCHEDSTAT_EVENTS];
+  bool show_events = argc > 1 && shell_str_eq(argv[1], "events");
+  uint32_t hart;
+
+  if (argc > 1 && !show_events) {
+    shell_fd_write("schedstat: usage: schedstat [events]\n");
+    return SHELL_EXEC_OK;
+  }
+
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    sched_hart_stats_t stats;
+    uint64_t total = 0u;
+    uint32_t count;
+    uint32_t i;
+
+    if (sched_hart_stats(hart, &stats) != 0 || !stats.online) {
+      continue;
+    }
+
+    count = sched_events_read(hart, events, SHELL_SCHEDSTAT_EVENTS, &total);
+    shell_fd_write("schedstat: hart");
+    shell_write_u64(hart);
+    shell_fd_write(" tasks=");
+    shell_write_u64(stats.tasks);
+    shell_fd_write(" ready=");
+    shell_write_u64(stats.ready);
+    shell_fd_write(" switches=");
+    shell_write_u64(stats.switches);
+    shell_fd_write(" steals=");
+    shell_write_u64(stats.steals);
+    shell_fd_write(" stolen=");
+    shell_write_u64(stats.stolen);
+    shell_fd_write(" events=");
+    shell_write_u64(total);
+    shell_fd_write("\n");
+
+    for (i = 0u; show_events && i < count; ++i) {
+      shell_schedstat_print_event(hart, &events[i]);
+    }
+  }
+
   return SHELL_EXEC_OK;
 }
 
@@ -1,10 +1,12 @@
 #include <stddef.h>
 
 #include "path_state.h"
+#include "perf.h"
 #include "shell_builtins.h"
 #include "shell_exec_pipeline.h"
 #include "shell_fd_table.h"
 #include "shell_parser.h"
+#include "trace.h"
 
 enum {
   SHELL_FALLBACK_TEXT_CAP = 128,
@@ -140,14 +142,9 @@ static int shell_execute_pipe(shell_parse_result_t *parse_result) {
   return shell_write_redirection(parse_result);
 }
 
-int shell_execute_line(char *line, const char *raw_line) {
+static int shell_execute_parsed(char *line) {
   shell_parse_result_t parse_result;
 
-  if (line == (char *)0 || raw_line == (const char *)0) {
-    return -1;
-  }
-  (void)raw_line;
-
   if (shell_parse_with_redirection(line, &parse_result) != 0) {
     shell_fd_set_stdout_console();
     shell_fd_write("parse: invalid command\n");
@@ -160,3 +157,18 @@ int shell_execute_line(char *line, const char *raw_line) {
 
   return shell_execute_single(&parse_result);
 }
+
+int shell_execute_line(char *line, const char *raw_line) {
+  PERF_SCOPE("shell_execute_line");
+  int rc;
+
+  if (line == (char *)0 || raw_line == (const char *)0) {
+    return -1;
+  }
+  (void)raw_line;
+
+  trace_event(TRACE_SHELL_EXEC_BEGIN, 0u, 0u, 0u);
+  rc = shell_execute_parsed(line);
+  trace_event(TRACE_SHELL_EXEC_END, (uint64_t)(int64_t)rc, 0u, 0u);
+  return rc;
+}
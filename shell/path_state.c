@@ -3,6 +3,7 @@
 #include "fs_dir.h"
 #include "fs_path.h"
 #include "path_state.h"
+#include "slab.h"
 
 enum {
   PATH_STATE_DYNAMIC_MAX_FILES = 32,
@@ -14,10 +15,11 @@ typedef struct {
   const char *content;
 } path_state_file_t;
 
+/* `content` comes from kmalloc() when the slot is first used, not from a static array. */
 typedef struct {
   int used;
   char path[FS_PATH_MAX];
-  char content[PATH_STATE_DYNAMIC_CONTENT_MAX];
+  char *content;
   size_t content_len;
 } path_state_dynamic_file_t;
 
@@ -95,7 +97,10 @@ static void dynamic_files_reset(void) {
   for (i = 0u; i < PATH_STATE_DYNAMIC_MAX_FILES; ++i) {
     g_dynamic_files[i].used = 0;
     g_dynamic_files[i].path[0] = '\0';
-    g_dynamic_files[i].content[0] = '\0';
+    if (g_dynamic_files[i].content != NULL) {
+      (void)kfree(g_dynamic_files[i].content);
+      g_dynamic_files[i].content = NULL;
+    }
     g_dynamic_files[i].content_len = 0u;
   }
 }
@@ -208,6 +213,12 @@ static int dynamic_file_index_alloc(const char *absolute_path) {
 
   for (i = 0u; i < PATH_STATE_DYNAMIC_MAX_FILES; ++i) {
     if (g_dynamic_files[i].used == 0) {
+      if (g_dynamic_files[i].content == NULL) {
+        g_dynamic_files[i].content = (char *)kmalloc(PATH_STATE_DYNAMIC_CONTENT_MAX);
+        if (g_dynamic_files[i].content == NULL) {
+          return -1;
+        }
+      }
       g_dynamic_files[i].used = 1;
       g_dynamic_files[i].content_len = 0u;
       g_dynamic_files[i].content[0] = '\0';
@@ -0,0 +1,221 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "page_alloc.h"
+
+/*
+ * Host benchmark for single-page allocation cost at increasing pool occupancy.
+ * The allocator only touches its own metadata, so a fake physical range is used.
+ * "legacy" replays the original bit-at-a-time next-fit scan over an identical bitmap.
+ *
+ * Each occupancy level allocates the low part of the pool and leaves the top free.
+ * Every round frees a batch of random pages inside the allocated region and then
+ * allocates the same number of pages again, so searches start behind long full runs.
+ */
+
+enum {
+  BENCH_PAGES = 131072u,
+  BENCH_WORD_BITS = 64u,
+  BENCH_WORDS = BENCH_PAGES / BENCH_WORD_BITS,
+  BENCH_BATCH = 64u,
+  BENCH_ROUNDS = 200u,
+};
+
+static const uintptr_t k_bench_range_start = 0x80400000u;
+
+static uint64_t g_metadata[PAGE_ALLOC_METADATA_WORDS(BENCH_PAGES)];
+static uint64_t g_legacy_bitmap[BENCH_WORDS];
+static size_t g_legacy_free;
+static size_t g_legacy_hint;
+static uint64_t g_legacy_probes;
+static uint32_t g_order[BENCH_PAGES];
+static size_t g_victim_count;
+static size_t g_victim_cursor;
+
+uint64_t riscv_irq_save(void) { return 0u; }
+
+void riscv_irq_restore(uint64_t state) { (void)state; }
+
+static uint64_t bench_now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+}
+
+static bool legacy_test(size_t index) {
+  return (g_legacy_bitmap[index / BENCH_WORD_BITS] & (1ull << (index % BENCH_WORD_BITS))) != 0u;
+}
+
+static void legacy_set(size_t index) {
+  g_legacy_bitmap[index / BENCH_WORD_BITS] |= 1ull << (index % BENCH_WORD_BITS);
+}
+
+static void legacy_clear(size_t index) {
+  g_legacy_bitmap[index / BENCH_WORD_BITS] &= ~(1ull << (index % BENCH_WORD_BITS));
+}
+
+static long legacy_alloc(void) {
+  size_t scanned;
+
+  if (g_legacy_free == 0u) {
+    return -1;
+  }
+
+  for (scanned = 0u; scanned < BENCH_PAGES; ++scanned) {
+    size_t index = (g_legacy_hint + scanned) % BENCH_PAGES;
+
+    g_legacy_probes++;
+    if (legacy_test(index)) {
+      continue;
+    }
+
+    legacy_set(index);
+    g_legacy_free--;
+    g_legacy_hint = (index + 1u) % BENCH_PAGES;
+    return (long)index;
+  }
+
+  return -1;
+}
+
+static void legacy_free(size_t index) {
+  legacy_clear(index);
+  g_legacy_free++;
+  if (index < g_legacy_hint || g_legacy_free == 1u) {
+    g_legacy_hint = index;
+  }
+}
+
+static void shuffle_order(void) {
+  uint64_t state = 0x9e3779b97f4a7c15ull;
+  size_t i;
+
+  for (i = 0u; i < BENCH_PAGES; ++i) {
+    g_order[i] = (uint32_t)i;
+  }
+
+  for (i = BENCH_PAGES - 1u; i > 0u; --i) {
+    size_t j;
+    uint32_t tmp;
+
+    state = (state * 6364136223846793005ull) + 1442695040888963407ull;
+    j = (size_t)((state >> 33) % (uint64_t)(i + 1u));
+    tmp = g_order[i];
+    g_order[i] = g_order[j];
+    g_order[j] = tmp;
+  }
+}
+
+static void *bench_page_addr(size_t index) {
+  return (void *)(k_bench_range_start + ((uintptr_t)index * PAGE_ALLOC_PAGE_SIZE));
+}
+
+static void fill_to_occupancy(unsigned int percent) {
+  size_t allocated = (BENCH_PAGES * (size_t)percent) / 100u;
+  uintptr_t range_end = k_bench_range_start + ((uintptr_t)BENCH_PAGES * PAGE_ALLOC_PAGE_SIZE);
+  size_t i;
+
+  page_alloc_init_with_metadata(k_bench_range_start, range_end, g_metadata, sizeof(g_metadata));
+  (void)page_alloc_release_range(k_bench_range_start, range_end);
+  for (i = 0u; i < BENCH_WORDS; ++i) {
+    g_legacy_bitmap[i] = 0u;
+  }
+  g_legacy_free = BENCH_PAGES;
+  g_legacy_hint = 0u;
+
+  for (i = 0u; i < allocated; ++i) {
+    (void)page_alloc();
+    (void)legacy_alloc();
+  }
+
+  g_victim_count = 0u;
+  g_victim_cursor = 0u;
+  for (i = 0u; i < BENCH_PAGES; ++i) {
+    if (g_order[i] < allocated) {
+      g_order[g_victim_count++] = g_order[i];
+    }
+  }
+}
+
+static size_t next_victim(void) {
+  size_t victim = g_order[g_victim_cursor];
+
+  g_victim_cursor = (g_victim_cursor + 1u) % g_victim_count;
+  return victim;
+}
+
+static double bench_current(void) {
+  uint64_t elapsed = 0u;
+  size_t round;
+  size_t i;
+
+  g_victim_cursor = 0u;
+  for (round = 0u; round < BENCH_ROUNDS; ++round) {
+    uint64_t start;
+
+    for (i = 0u; i < BENCH_BATCH; ++i) {
+      (void)page_free(bench_page_addr(next_victim()));
+    }
+
+    start = bench_now_ns();
+    for (i = 0u; i < BENCH_BATCH; ++i) {
+      (void)page_alloc();
+    }
+    elapsed += bench_now_ns() - start;
+  }
+
+  return (double)elapsed / (double)(BENCH_ROUNDS * BENCH_BATCH);
+}
+
+static double bench_legacy(void) {
+  uint64_t elapsed = 0u;
+  size_t round;
+  size_t i;
+
+  g_victim_cursor = 0u;
+  g_legacy_probes = 0u;
+  for (round = 0u; round < BENCH_ROUNDS; ++round) {
+    uint64_t start;
+
+    for (i = 0u; i < BENCH_BATCH; ++i) {
+      legacy_free(next_victim());
+    }
+
+    start = bench_now_ns();
+    for (i = 0u; i < BENCH_BATCH; ++i) {
+      (void)legacy_alloc();
+    }
+    elapsed += bench_now_ns() - start;
+  }
+
+  return (double)elapsed / (double)(BENCH_ROUNDS * BENCH_BATCH);
+}
+
+int main(void) {
+  static const unsigned int k_occupancy[] = {10u, 50u, 90u, 99u};
+  size_t i;
+
+  printf("page_alloc benchmark: %u pages, %u-page batches x %u rounds\n", BENCH_PAGES,
+         BENCH_BATCH, BENCH_ROUNDS);
+  printf("%-10s %16s %18s %16s\n", "occupancy", "legacy ns/alloc", "legacy probes/alloc",
+         "ctz ns/alloc");
+
+  for (i = 0u; i < sizeof(k_occupancy) / sizeof(k_occupancy[0]); ++i) {
+    double legacy_ns;
+    double current_ns;
+
+    shuffle_order();
+    fill_to_occupancy(k_occupancy[i]);
+    legacy_ns = bench_legacy();
+    current_ns = bench_current();
+
+    printf("%8u%% %16.1f %18.1f %16.1f\n", k_occupancy[i], legacy_ns,
+           (double)g_legacy_probes / (double)(BENCH_ROUNDS * BENCH_BATCH), current_ns);
+  }
+
+  return 0;
+}
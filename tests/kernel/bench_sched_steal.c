@@ -0,0 +1,184 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hart.h"
+#include "page_alloc.h"
+#include "sched.h"
+#include "task.h"
+#include "trap.h"
+
+/*
+ * Host benchmark for the work-stealing balancer. HART_MAX_HARTS harts are simulated in
+ * lock-step: every tick each hart burns one unit of work for its current task, then takes
+ * a timer interrupt. A task exits when its work is done. Makespan is the number of ticks
+ * until every task has exited.
+ *
+ * "skewed" places every task on the boot hart, as a static assignment from one spawner
+ * would. "spread" lets placement balance task counts but gives a few tasks most of the
+ * work. Each set runs with stealing off and on.
+ */
+
+enum {
+  BENCH_TASKS = 12u,
+  BENCH_TICK_LIMIT = 100000u,
+  BENCH_STACK_PAGES = TASK_MAX_TASKS * (1u << TASK_STACK_ORDER),
+};
+
+static const uint32_t k_bench_work[BENCH_TASKS] = {
+    64u, 8u, 8u, 48u, 16u, 16u, 32u, 8u, 24u, 40u, 8u, 16u,
+};
+
+static uint32_t g_fake_hart;
+static uint32_t g_remaining_work[TASK_MAX_TASKS + 1u];
+static uint8_t g_stack_region[(BENCH_STACK_PAGES + 1u) * PAGE_ALLOC_PAGE_SIZE];
+
+void line_io_write(const char *s) { (void)s; }
+
+void console_write(const char *s) { (void)s; }
+
+void console_putc(char c) { (void)c; }
+
+uint64_t riscv_cycle_now(void) { return 0ULL; }
+
+uint64_t clock_now_ns(void) { return 0ULL; }
+
+void riscv_soft_irq_enable(void) {}
+
+void riscv_soft_irq_raise(void) {}
+
+void riscv_soft_irq_clear(void) {}
+
+void riscv_soft_irq_send(uint32_t hart_id) { (void)hart_id; }
+
+uint64_t riscv_irq_save(void) { return 0ULL; }
+
+void riscv_irq_restore(uint64_t state) { (void)state; }
+
+uint32_t hart_current_id(void) { return g_fake_hart; }
+
+static void bench_task_entry(task_control_block_t *task) { (void)task; }
+
+typedef struct bench_result {
+  uint32_t makespan;
+  uint32_t busy[HART_MAX_HARTS];
+  uint64_t steals;
+} bench_result_t;
+
+static int bench_run(bool skewed, bool stealing, bench_result_t *out) {
+  struct trap_frame root_frames[HART_MAX_HARTS];
+  struct trap_frame *frames[HART_MAX_HARTS];
+  uintptr_t start = ((uintptr_t)&g_stack_region[0] + (PAGE_ALLOC_PAGE_SIZE - 1u)) &
+                    ~((uintptr_t)PAGE_ALLOC_PAGE_SIZE - 1u);
+  uint32_t remaining = BENCH_TASKS;
+  uint32_t hart;
+  uint32_t i;
+
+  page_alloc_init(start, start + ((uintptr_t)BENCH_STACK_PAGES * PAGE_ALLOC_PAGE_SIZE));
+  memset(out, 0, sizeof(*out));
+  memset(root_frames, 0, sizeof(root_frames));
+
+  g_fake_hart = 0u;
+  sched_init();
+  for (hart = 1u; hart < HART_MAX_HARTS; ++hart) {
+    g_fake_hart = hart;
+    sched_hart_online();
+  }
+  g_fake_hart = 0u;
+  sched_set_stealing(stealing);
+  sched_start();
+
+  for (i = 0u; i < BENCH_TASKS; ++i) {
+    task_control_block_t *task = task_create("bench", bench_task_entry);
+
+    if (task == (task_control_block_t *)0) {
+      return -1;
+    }
+    if (skewed) {
+      (void)sched_set_affinity(task, 1u << 0);
+    }
+    if (sched_add_task(task) != 0) {
+      return -1;
+    }
+    (void)sched_set_affinity(task, ~0u);
+    g_remaining_work[task->id] = k_bench_work[i];
+  }
+
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    root_frames[hart].tp = hart;
+    frames[hart] = &root_frames[hart];
+  }
+
+  while (remaining > 0u && out->makespan < BENCH_TICK_LIMIT) {
+    for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+      task_control_block_t *current;
+
+      g_fake_hart = hart;
+      current = sched_current_task();
+      if (current->id != TASK_BOOT_ID && g_remaining_work[current->id] > 0u) {
+        out->busy[hart]++;
+        if (--g_remaining_work[current->id] == 0u) {
+          current->state = TASK_STATE_EXITED;
+          remaining--;
+        }
+      }
+      frames[hart] = sched_handle_timer_interrupt(frames[hart]);
+      sched_finish_switch();
+    }
+    out->makespan++;
+  }
+
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    sched_hart_stats_t stats;
+
+    (void)sched_hart_stats(hart, &stats);
+    out->steals += stats.steals;
+  }
+
+  g_fake_hart = 0u;
+  return remaining == 0u ? 0 : -1;
+}
+
+static void bench_print(const char *name, bool stealing, const bench_result_t *result) {
+  uint32_t hart;
+
+  printf("%-7s %-9s %9u %7llu ", name, stealing ? "stealing" : "static", result->makespan,
+         (unsigned long long)result->steals);
+  for (hart = 0u; hart < HART_MAX_HARTS; ++hart) {
+    printf(" %5u", result->busy[hart]);
+  }
+  printf("\n");
+}
+
+int main(void) {
+  static const bool k_skewed[] = {true, false};
+  uint32_t total_work = 0u;
+  size_t i;
+
+  for (i = 0u; i < BENCH_TASKS; ++i) {
+    total_work += k_bench_work[i];
+  }
+
+  printf("sched steal benchmark: %u tasks, %u work ticks, %u harts (ideal makespan %u)\n",
+         BENCH_TASKS, total_work, HART_MAX_HARTS,
+         (total_work + HART_MAX_HARTS - 1u) / HART_MAX_HARTS);
+  printf("%-7s %-9s %9s %7s  busy ticks per hart\n", "set", "mode", "makespan", "steals");
+
+  for (i = 0u; i < sizeof(k_skewed) / sizeof(k_skewed[0]); ++i) {
+    bench_result_t fixed;
+    bench_result_t balanced;
+    const char *name = k_skewed[i] ? "skewed" : "spread";
+
+    if (bench_run(k_skewed[i], false, &fixed) != 0 ||
+        bench_run(k_skewed[i], true, &balanced) != 0) {
+      fprintf(stderr, "benchmark run did not finish\n");
+      return 1;
+    }
+
+    bench_print(name, false, &fixed);
+    bench_print(name, true, &balanced);
+  }
+
+  return 0;
+}
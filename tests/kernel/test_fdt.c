@@ -0,0 +1,285 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "fdt.h"
+
+#define TEST_ASSERT(cond, msg)                          \
+  do {                                                  \
+    if (!(cond)) {                                      \
+      fprintf(stderr, "FAIL: %s\n", (msg));            \
+      return 1;                                         \
+    }                                                   \
+  } while (0)
+
+enum {
+  BLOB_CAPACITY = 2048u,
+  STRINGS_CAPACITY = 256u,
+};
+
+/* Small DTB builder: struct block and strings block are assembled separately. */
+typedef struct blob_builder {
+  uint8_t structs[BLOB_CAPACITY];
+  uint32_t struct_len;
+  char strings[STRINGS_CAPACITY];
+  uint32_t strings_len;
+  uint64_t rsvmap[8];
+  uint32_t rsvmap_words;
+} blob_builder_t;
+
+static uint8_t g_blob[BLOB_CAPACITY + STRINGS_CAPACITY + 256u] __attribute__((aligned(8)));
+static blob_builder_t g_builder;
+
+static void put_be32(uint8_t *p, uint32_t value) {
+  p[0] = (uint8_t)(value >> 24);
+  p[1] = (uint8_t)(value >> 16);
+  p[2] = (uint8_t)(value >> 8);
+  p[3] = (uint8_t)value;
+}
+
+static void put_be64(uint8_t *p, uint64_t value) {
+  put_be32(p, (uint32_t)(value >> 32));
+  put_be32(p + 4, (uint32_t)value);
+}
+
+static void builder_reset(void) {
+  g_builder.struct_len = 0u;
+  g_builder.strings_len = 0u;
+  g_builder.rsvmap_words = 0u;
+}
+
+static void emit_u32(uint32_t value) {
+  put_be32(&g_builder.structs[g_builder.struct_len], value);
+  g_builder.struct_len += 4u;
+}
+
+static void emit_bytes(const void *data, uint32_t len) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  uint32_t i;
+
+  for (i = 0u; i < len; ++i) {
+    g_builder.structs[g_builder.struct_len++] = bytes[i];
+  }
+  while ((g_builder.struct_len & 3u) != 0u) {
+    g_builder.structs[g_builder.struct_len++] = 0u;
+  }
+}
+
+static uint32_t string_offset(const char *name) {
+  uint32_t offset = g_builder.strings_len;
+  uint32_t i = 0u;
+
+  do {
+    g_builder.strings[g_builder.strings_len++] = name[i];
+  } while (name[i++] != '\0');
+
+  return offset;
+}
+
+static void begin_node(const char *name) {
+  uint32_t len = 0u;
+
+  while (name[len] != '\0') {
+    len++;
+  }
+  emit_u32(1u);
+  emit_bytes(name, len + 1u);
+}
+
+static void end_node(void) {
+  emit_u32(2u);
+}
+
+static void prop_raw(const char *name, const void *value, uint32_t len) {
+  emit_u32(3u);
+  emit_u32(len);
+  emit_u32(string_offset(name));
+  emit_bytes(value, len);
+}
+
+static void prop_u32(const char *name, uint32_t value) {
+  uint8_t cell[4];
+
+  put_be32(cell, value);
+  prop_raw(name, cell, 4u);
+}
+
+static void prop_reg64(const char *name, uint64_t base, uint64_t size) {
+  uint8_t cells[16];
+
+  put_be64(cells, base);
+  put_be64(cells + 8, size);
+  prop_raw(name, cells, 16u);
+}
+
+static void add_rsvmap(uint64_t base, uint64_t size) {
+  g_builder.rsvmap[g_builder.rsvmap_words++] = base;
+  g_builder.rsvmap[g_builder.rsvmap_words++] = size;
+}
+
+static uint32_t builder_finish(void) {
+  uint32_t rsvmap_off = 40u;
+  uint32_t struct_off;
+  uint32_t strings_off;
+  uint32_t total;
+  uint32_t i;
+
+  emit_u32(9u);
+  add_rsvmap(0u, 0u);
+  struct_off = rsvmap_off + (g_builder.rsvmap_words * 8u);
+  strings_off = struct_off + g_builder.struct_len;
+  total = strings_off + g_builder.strings_len;
+
+  put_be32(&g_blob[0], 0xd00dfeedu);
+  put_be32(&g_blob[4], total);
+  put_be32(&g_blob[8], struct_off);
+  put_be32(&g_blob[12], strings_off);
+  put_be32(&g_blob[16], rsvmap_off);
+  put_be32(&g_blob[20], 17u);
+  put_be32(&g_blob[24], 16u);
+  put_be32(&g_blob[28], 0u);
+  put_be32(&g_blob[32], g_builder.strings_len);
+  put_be32(&g_blob[36], g_builder.struct_len);
+  for (i = 0u; i < g_builder.rsvmap_words; ++i) {
+    put_be64(&g_blob[rsvmap_off + (i * 8u)], g_builder.rsvmap[i]);
+  }
+  for (i = 0u; i < g_builder.struct_len; ++i) {
+    g_blob[struct_off + i] = g_builder.structs[i];
+  }
+  for (i = 0u; i < g_builder.strings_len; ++i) {
+    g_blob[strings_off + i] = (uint8_t)g_builder.strings[i];
+  }
+
+  return total;
+}
+
+/* Mirrors the shape of the QEMU virt DTB with two memory banks. */
+static uint32_t build_virt_like_blob(void) {
+  builder_reset();
+  add_rsvmap(0x80000000u, 0x80000u);
+
+  begin_node("");
+  prop_u32("#address-cells", 2u);
+  prop_u32("#size-cells", 2u);
+
+  begin_node("cpus");
+  prop_u32("#address-cells", 1u);
+  prop_u32("#size-cells", 0u);
+  prop_u32("timebase-frequency", 10000000u);
+  begin_node("cpu@0");
+  prop_raw("device_type", "cpu", 4u);
+  end_node();
+  end_node();
+
+  begin_node("memory@80000000");
+  prop_raw("device_type", "memory", 7u);
+  prop_reg64("reg", 0x80000000u, 0x40000000u);
+  end_node();
+
+  begin_node("ram");
+  emit_u32(4u);
+  prop_raw("device_type", "memory", 7u);
+  prop_reg64("reg", 0x100000000ull, 0x80000000ull);
+  end_node();
+
+  begin_node("reserved-memory");
+  prop_u32("#address-cells", 2u);
+  prop_u32("#size-cells", 2u);
+  begin_node("mmode_resv0@80040000");
+  prop_reg64("reg", 0x80040000u, 0x20000u);
+  end_node();
+  end_node();
+
+  begin_node("soc");
+  begin_node("memory-controller@1000");
+  prop_reg64("reg", 0x1000u, 0x1000u);
+  end_node();
+  end_node();
+
+  end_node();
+  return builder_finish();
+}
+
+static int test_parse_memory_reserved_and_timebase(void) {
+  fdt_platform_info_t info;
+  uint32_t total = build_virt_like_blob();
+
+  TEST_ASSERT(fdt_parse(g_blob, &info) == 0, "well-formed blob should parse");
+  TEST_ASSERT(info.total_size == total, "total size should come from the header");
+  TEST_ASSERT(info.timebase_frequency == 10000000u, "timebase should come from /cpus");
+
+  TEST_ASSERT(info.memory_count == 2u, "both memory nodes should be found");
+  TEST_ASSERT(info.memory[0].base == 0x80000000u && info.memory[0].size == 0x40000000u,
+              "first bank should match memory@ reg");
+  TEST_ASSERT(info.memory[1].base == 0x100000000ull && info.memory[1].size == 0x80000000ull,
+              "device_type=memory bank should be found");
+
+  TEST_ASSERT(info.reserved_count == 2u, "rsvmap and reserved-memory child should be found");
+  TEST_ASSERT(info.reserved[0].base == 0x80000000u && info.reserved[0].size == 0x80000u,
+              "rsvmap entry should come first");
+  TEST_ASSERT(info.reserved[1].base == 0x80040000u && info.reserved[1].size == 0x20000u,
+              "reserved-memory child reg should be recorded");
+  return 0;
+}
+
+static int test_one_cell_sizes(void) {
+  fdt_platform_info_t info;
+  uint8_t cells[8];
+
+  builder_reset();
+  begin_node("");
+  prop_u32("#address-cells", 1u);
+  prop_u32("#size-cells", 1u);
+  begin_node("memory@80000000");
+  put_be32(cells, 0x80000000u);
+  put_be32(cells + 4, 0x08000000u);
+  prop_raw("reg", cells, 8u);
+  end_node();
+  end_node();
+  (void)builder_finish();
+
+  TEST_ASSERT(fdt_parse(g_blob, &info) == 0, "32-bit cell blob should parse");
+  TEST_ASSERT(info.memory_count == 1u, "single bank should be found");
+  TEST_ASSERT(info.memory[0].base == 0x80000000u && info.memory[0].size == 0x08000000u,
+              "parent #address-cells/#size-cells should decode reg");
+  TEST_ASSERT(info.timebase_frequency == 0u, "missing timebase should stay zero");
+  return 0;
+}
+
+static int test_rejects_bad_blobs(void) {
+  fdt_platform_info_t info;
+  uint32_t total;
+
+  TEST_ASSERT(fdt_parse((const void *)0, &info) != 0, "null blob should be rejected");
+
+  total = build_virt_like_blob();
+  g_blob[0] = 0u;
+  TEST_ASSERT(fdt_parse(g_blob, &info) != 0, "bad magic should be rejected");
+
+  (void)build_virt_like_blob();
+  put_be32(&g_blob[20], 15u);
+  TEST_ASSERT(fdt_parse(g_blob, &info) != 0, "old versions should be rejected");
+
+  (void)build_virt_like_blob();
+  put_be32(&g_blob[36], total);
+  TEST_ASSERT(fdt_parse(g_blob, &info) != 0, "struct block past total size should be rejected");
+
+  (void)build_virt_like_blob();
+  put_be32(&g_blob[36], 16u);
+  TEST_ASSERT(fdt_parse(g_blob, &info) != 0, "truncated struct block should be rejected");
+  return 0;
+}
+
+int fdt_tests_run(void) {
+  if (test_parse_memory_reserved_and_timebase() != 0) {
+    return 1;
+  }
+  if (test_one_cell_sizes() != 0) {
+    return 1;
+  }
+  if (test_rejects_bad_blobs() != 0) {
+    return 1;
+  }
+
+  printf("fdt unit tests passed\n");
+  return 0;
+}
@@ -1,6 +1,13 @@
 #include <stdio.h>
 
 int page_alloc_tests_run(void);
+int page_cache_tests_run(void);
+int slab_tests_run(void);
+int page_zero_tests_run(void);
+int fdt_tests_run(void);
+int vm_tests_run(void);
+int spinlock_tests_run(void);
+int perf_tests_run(void);
 
 int main(void) {
   int rc = page_alloc_tests_run();
@@ -8,6 +15,41 @@ int main(void) {
     return rc;
   }
 
+  rc = page_cache_tests_run();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = slab_tests_run();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = page_zero_tests_run();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = fdt_tests_run();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = vm_tests_run();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = spinlock_tests_run();
+  if (rc != 0) {
+    return rc;
+  }
+
+  rc = perf_tests_run();
+  if (rc != 0) {
+    return rc;
+  }
+
   printf("all unit tests passed\n");
   return 0;
 }
@@ -112,6 +112,243 @@ static int test_alignment_assumptions(void) {
   return 0;
 }
 
+static int test_order_alloc_alignment_and_split(void) {
+  static uint8_t region[17u * PAGE_ALLOC_PAGE_SIZE];
+  uintptr_t start = align_up((uintptr_t)&region[0]);
+  uintptr_t end = start + (16u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
+  uintptr_t block_bytes = 4u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE;
+  void *block = 0;
+  void *single = 0;
+
+  page_alloc_init(start, end);
+  TEST_ASSERT(page_alloc_free_blocks(4u) == 1u, "16-page pool should seed one order-4 block");
+
+  single = page_alloc();
+  TEST_ASSERT(single == (void *)start, "first single page should come from the pool start");
+  TEST_ASSERT(page_alloc_free_blocks(4u) == 0u, "order-4 block should be split");
+  TEST_ASSERT(page_alloc_free_blocks(0u) == 1u, "split should leave one order-0 buddy");
+  TEST_ASSERT(page_alloc_free_blocks(1u) == 1u, "split should leave one order-1 buddy");
+  TEST_ASSERT(page_alloc_free_blocks(2u) == 1u, "split should leave one order-2 buddy");
+  TEST_ASSERT(page_alloc_free_blocks(3u) == 1u, "split should leave one order-3 buddy");
+
+  block = page_alloc_order(2u);
+  TEST_ASSERT(block != 0, "order-2 allocation should succeed");
+  TEST_ASSERT((((uintptr_t)block - start) % block_bytes) == 0u,
+              "order-2 block must be naturally aligned within the pool");
+  TEST_ASSERT(page_alloc_free_pages() == 11u, "order-2 allocation should consume four pages");
+
+  TEST_ASSERT(page_free_order(block, 2u), "order-2 free should succeed");
+  TEST_ASSERT(page_free(single), "single page free should succeed");
+  TEST_ASSERT(page_alloc_free_pages() == 16u, "all pages should be free again");
+  TEST_ASSERT(page_alloc_free_blocks(4u) == 1u, "buddies should coalesce back to order 4");
+  TEST_ASSERT(page_alloc_free_blocks(0u) == 0u, "no order-0 fragments should remain");
+  return 0;
+}
+
+static int test_order_alloc_fragmentation_and_limits(void) {
+  static uint8_t region[9u * PAGE_ALLOC_PAGE_SIZE];
+  uintptr_t start = align_up((uintptr_t)&region[0]);
+  uintptr_t end = start + (8u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
+  void *pages[8];
+  void *block = 0;
+  size_t i;
+
+  page_alloc_init(start, end);
+  TEST_ASSERT(page_alloc_order(PAGE_ALLOC_MAX_ORDER + 1u) == 0,
+              "orders above the maximum must be rejected");
+  TEST_ASSERT(page_alloc_order(4u) == 0, "order larger than the pool must fail");
+
+  for (i = 0u; i < 8u; ++i) {
+    pages[i] = page_alloc();
+    TEST_ASSERT(pages[i] != 0, "setup allocation should succeed");
+  }
+
+  for (i = 0u; i < 8u; i += 2u) {
+    TEST_ASSERT(page_free(pages[i]), "freeing every other page should succeed");
+  }
+
+  TEST_ASSERT(page_alloc_free_pages() == 4u, "four scattered pages should be free");
+  TEST_ASSERT(page_alloc_order(1u) == 0,
+              "order-1 allocation must fail when no two free pages are buddies");
+
+  TEST_ASSERT(page_free(pages[5]), "freeing a buddy should succeed");
+  TEST_ASSERT(page_free(pages[7]), "freeing a buddy should succeed");
+  block = page_alloc_order(2u);
+  TEST_ASSERT(block == pages[4], "coalesced pages 4..7 should satisfy order-2 request");
+  TEST_ASSERT(!page_free(pages[5]), "freeing a tail page of a block must fail");
+  TEST_ASSERT(!page_free_order(block, 1u), "freeing with a smaller order must fail");
+  TEST_ASSERT(!page_free_order(block, 3u), "freeing with a larger order must fail");
+  TEST_ASSERT(page_free_order(block, 2u), "freeing with the allocation order should succeed");
+  TEST_ASSERT(!page_free_order(block, 2u), "double free of a block must fail");
+  return 0;
+}
+
+static int test_lowest_free_page_across_words(void) {
+  static uint8_t region[201u * PAGE_ALLOC_PAGE_SIZE];
+  uintptr_t start = align_up((uintptr_t)&region[0]);
+  uintptr_t end = start + (200u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
+  uintptr_t page_70 = start + (70u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
+  uintptr_t page_191 = start + (191u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
+  size_t i;
+
+  page_alloc_init(start, end);
+  for (i = 0u; i < 200u; ++i) {
+    TEST_ASSERT(page_alloc() != 0, "setup allocation should succeed");
+  }
+
+  TEST_ASSERT(page_free((void *)page_191), "free in the last bitmap word should succeed");
+  TEST_ASSERT(page_free((void *)page_70), "free in the second bitmap word should succeed");
+  TEST_ASSERT(page_alloc() == (void *)page_70, "search should return the lowest free page");
+  TEST_ASSERT(page_alloc() == (void *)page_191,
+              "search should skip full words to reach the next free page");
+  TEST_ASSERT(page_alloc() == 0, "search should fail once every word is full");
+  return 0;
+}
+
+static int test_release_ranges_with_holes(void) {
+  static uint64_t metadata[PAGE_ALLOC_METADATA_WORDS(64u)];
+  const uintptr_t start = 0x80000000u;
+  const uintptr_t end = start + (64u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
+  void *page;
+  size_t i;
+
+  TEST_ASSERT(page_alloc_metadata_bytes(64u) <= sizeof(metadata),
+              "metadata macro should bound the computed size");
+  page_alloc_init_with_metadata(start, end, metadata, sizeof(metadata));
+  TEST_ASSERT(page_alloc_range_end() == end, "range should not be capped with enough metadata");
+  TEST_ASSERT(page_alloc_total_pages() == 0u, "range should start fully reserved");
+  TEST_ASSERT(page_alloc() == 0, "reserved range should not allocate");
+
+  TEST_ASSERT(page_alloc_release_range(start, start + (16u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE)) ==
+                  16u,
+              "low bank should be released");
+  TEST_ASSERT(page_alloc_release_range(start + (32u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE) - 100u,
+                                       end + PAGE_ALLOC_PAGE_SIZE) == 32u,
+              "high bank should be released page-aligned inward and clamped to the range");
+  TEST_ASSERT(page_alloc_release_range(start, start + (16u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE)) ==
+                  0u,
+              "releasing twice should be a no-op");
+  TEST_ASSERT(page_alloc_total_pages() == 48u, "managed pages should exclude the hole");
+  TEST_ASSERT(page_alloc_free_blocks(5u) == 1u && page_alloc_free_blocks(4u) == 1u,
+              "released ranges should coalesce into aligned blocks");
+  TEST_ASSERT(!page_free((void *)(start + (20u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE))),
+              "reserved hole pages must not be freeable");
+
+  page = page_alloc_order(5u);
+  TEST_ASSERT(page == (void *)(start + (32u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE)),
+              "order-5 block should come from the high bank");
+  TEST_ASSERT(page_alloc_order(5u) == 0, "hole should prevent a second order-5 block");
+  for (i = 0u; i < 16u; ++i) {
+    page = page_alloc();
+    TEST_ASSERT(page != 0, "low bank pages should allocate");
+    TEST_ASSERT((uintptr_t)page < start + (16u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE),
+                "allocations must stay outside the hole");
+  }
+  TEST_ASSERT(page_alloc() == 0, "allocator should be exhausted");
+  return 0;
+}
+
+static int test_span_capped_by_metadata(void) {
+  static uint64_t metadata[PAGE_ALLOC_METADATA_WORDS(256u)];
+  const uintptr_t start = 0x80000000u;
+  const uintptr_t end = start + (4096u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
+  size_t span_pages;
+
+  page_alloc_init_with_metadata(start, end, metadata, page_alloc_metadata_bytes(256u));
+  span_pages = (size_t)((page_alloc_range_end() - start) / PAGE_ALLOC_PAGE_SIZE);
+  TEST_ASSERT(span_pages >= 256u && span_pages < 4096u,
+              "span should shrink to what the metadata can describe");
+  TEST_ASSERT(page_alloc_release_range(start, end) == span_pages,
+              "release should clamp to the capped span");
+  return 0;
+}
+
+static uint64_t g_fake_clock;
+
+static uint64_t fake_clock(void) {
+  return ++g_fake_clock;
+}
+
+static int test_fragmentation_report(void) {
+  static uint64_t metadata[PAGE_ALLOC_METADATA_WORDS(200u)];
+  const uintptr_t start = 0x80000000u;
+  const uintptr_t end = start + (200u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
+  page_alloc_frag_report_t report;
+  size_t i;
+
+  page_alloc_init_with_metadata(start, end, metadata, sizeof(metadata));
+  (void)page_alloc_release_range(start, start + (10u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE));
+  (void)page_alloc_release_range(start + (64u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE), end);
+
+  page_alloc_fragmentation(&report);
+  TEST_ASSERT(report.free_pages == page_alloc_free_pages(), "report should count free pages");
+  TEST_ASSERT(report.free_runs == 2u, "reserved hole should split the free space");
+  TEST_ASSERT(report.largest_free_run == 136u, "largest run should span whole bitmap words");
+  TEST_ASSERT(report.run_histogram[3] == 1u && report.run_histogram[7] == 1u,
+              "runs of 10 and 136 pages should land in log2 buckets 3 and 7");
+
+  for (i = 0u; i < 10u; ++i) {
+    TEST_ASSERT(page_alloc() != 0, "low run allocation should succeed");
+  }
+  TEST_ASSERT(page_free((void *)(start + (3u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE))),
+              "single page free should succeed");
+  page_alloc_fragmentation(&report);
+  TEST_ASSERT(report.free_runs == 2u && report.run_histogram[0] == 1u,
+              "isolated free page should be a run of one");
+  return 0;
+}
+
+static int test_trace_ring_and_sites(void) {
+  static uint8_t region[65u * PAGE_ALLOC_PAGE_SIZE];
+  uintptr_t start = align_up((uintptr_t)&region[0]);
+  page_alloc_trace_entry_t entries[4];
+  page_alloc_trace_site_t sites[2];
+  void *single;
+  void *block;
+  size_t i;
+
+  page_alloc_init(start, start + (64u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE));
+  TEST_ASSERT(!page_alloc_trace_enabled(), "tracing should be off by default");
+  TEST_ASSERT(page_free(page_alloc()), "untraced round trip should succeed");
+
+  g_fake_clock = 0u;
+  page_alloc_trace_enable(fake_clock);
+  TEST_ASSERT(page_alloc_trace_records() == 0u, "enable should clear old records");
+  single = page_alloc();
+  block = page_alloc_order(2u);
+  TEST_ASSERT(single != 0 && block != 0, "traced allocations should succeed");
+  TEST_ASSERT(page_free_order(block, 2u), "traced free should succeed");
+
+  TEST_ASSERT(page_alloc_trace_records() == 3u, "each alloc and free should be recorded");
+  TEST_ASSERT(page_alloc_trace_snapshot(entries, 4u) == 3u, "snapshot should return records");
+  TEST_ASSERT(entries[0].kind == PAGE_ALLOC_TRACE_ALLOC && entries[0].order == 0u &&
+                  entries[0].timestamp == 1u && entries[0].caller != 0u,
+              "first record should be the single-page alloc");
+  TEST_ASSERT(entries[1].order == 2u &&
+                  entries[1].page_index == (uint32_t)(((uintptr_t)block - start) /
+                                                      PAGE_ALLOC_PAGE_SIZE),
+              "order-2 record should carry the block index");
+  TEST_ASSERT(entries[2].kind == PAGE_ALLOC_TRACE_FREE && entries[2].timestamp == 3u,
+              "free should be recorded last");
+
+  TEST_ASSERT(page_alloc_trace_top_sites(sites, 2u) >= 1u, "sites should be reported");
+  TEST_ASSERT(sites[0].alloc_pages == 4u && sites[0].alloc_calls == 1u,
+              "order-2 call site should lead by pages");
+
+  for (i = 0u; i < PAGE_ALLOC_TRACE_RING_SIZE + 5u; ++i) {
+    TEST_ASSERT(page_free(page_alloc()), "ring wrap round trip should succeed");
+  }
+  TEST_ASSERT(page_alloc_trace_snapshot(entries, 4u) == 4u, "snapshot should cap at max");
+  TEST_ASSERT(entries[3].kind == PAGE_ALLOC_TRACE_FREE && entries[2].kind == PAGE_ALLOC_TRACE_ALLOC,
+              "snapshot should end with the newest records");
+
+  page_alloc_trace_disable();
+  TEST_ASSERT(page_free(single), "untraced free should succeed");
+  TEST_ASSERT(page_alloc_trace_records() == 3u + (2u * (PAGE_ALLOC_TRACE_RING_SIZE + 5u)),
+              "disabled tracing should not record");
+  return 0;
+}
+
 int page_alloc_tests_run(void) {
   if (test_allocation_exhaustion() != 0) {
     return 1;
@@ -125,6 +362,27 @@ int page_alloc_tests_run(void) {
   if (test_alignment_assumptions() != 0) {
     return 1;
   }
+  if (test_order_alloc_alignment_and_split() != 0) {
+    return 1;
+  }
+  if (test_order_alloc_fragmentation_and_limits() != 0) {
+    return 1;
+  }
+  if (test_lowest_free_page_across_words() != 0) {
+    return 1;
+  }
+  if (test_release_ranges_with_holes() != 0) {
+    return 1;
+  }
+  if (test_span_capped_by_metadata() != 0) {
+    return 1;
+  }
+  if (test_fragmentation_report() != 0) {
+    return 1;
+  }
+  if (test_trace_ring_and_sites() != 0) {
+    return 1;
+  }
 
   printf("page allocator unit tests passed\n");
   return 0;
@@ -0,0 +1,175 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "hart.h"
+#include "page_alloc.h"
+#include "page_cache.h"
+
+#define TEST_ASSERT(cond, msg)                          \
+  do {                                                  \
+    if (!(cond)) {                                      \
+      fprintf(stderr, "FAIL: %s\n", (msg));            \
+      return 1;                                         \
+    }                                                   \
+  } while (0)
+
+static uint32_t g_fake_hart_id;
+
+uint32_t hart_current_id(void) { return g_fake_hart_id; }
+
+static uintptr_t align_up(uintptr_t addr) {
+  return (addr + (PAGE_ALLOC_PAGE_SIZE - 1u)) &
+         ~((uintptr_t)PAGE_ALLOC_PAGE_SIZE - 1u);
+}
+
+static int test_refill_and_hits(void) {
+  static uint8_t region[65u * PAGE_ALLOC_PAGE_SIZE];
+  uintptr_t start = align_up((uintptr_t)&region[0]);
+  uintptr_t end = start + (64u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
+  page_cache_stats_t stats;
+  void *first;
+  void *second;
+
+  page_alloc_init(start, end);
+  page_cache_init();
+  g_fake_hart_id = 0u;
+
+  first = page_cache_alloc();
+  TEST_ASSERT(first != 0, "cache allocation should refill from the global allocator");
+  TEST_ASSERT(page_alloc_free_pages() == 64u - PAGE_CACHE_BATCH,
+              "refill should take one batch from the global allocator");
+  TEST_ASSERT(page_cache_cached_pages() == PAGE_CACHE_BATCH - 1u,
+              "refilled magazine should keep the rest of the batch");
+
+  second = page_cache_alloc();
+  TEST_ASSERT(second != 0 && second != first, "second allocation should hit the magazine");
+  TEST_ASSERT(page_cache_stats(0u, &stats), "stats lookup should succeed");
+  TEST_ASSERT(stats.refills == 1u, "one refill expected");
+  TEST_ASSERT(stats.alloc_hits == 1u, "one allocation hit expected");
+
+  TEST_ASSERT(page_cache_free(second), "free into magazine should succeed");
+  TEST_ASSERT(!page_cache_free(second), "double free into the magazine must fail");
+  TEST_ASSERT(page_cache_alloc() == second, "magazine should hand back the hottest page");
+  TEST_ASSERT(page_alloc_free_pages() == 64u - PAGE_CACHE_BATCH,
+              "magazine hits must not touch the global allocator");
+  return 0;
+}
+
+static int test_drain_and_per_hart_isolation(void) {
+  static uint8_t region[129u * PAGE_ALLOC_PAGE_SIZE];
+  uintptr_t start = align_up((uintptr_t)&region[0]);
+  uintptr_t end = start + (128u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
+  void *pages[PAGE_CACHE_MAGAZINE_SIZE + 1u];
+  page_cache_stats_t stats;
+  uint32_t i;
+
+  page_alloc_init(start, end);
+  page_cache_init();
+  g_fake_hart_id = 1u;
+
+  for (i = 0u; i < PAGE_CACHE_MAGAZINE_SIZE + 1u; ++i) {
+    pages[i] = page_alloc_order(0u);
+    TEST_ASSERT(pages[i] != 0, "setup allocation should succeed");
+  }
+
+  TEST_ASSERT(!page_cache_free((void *)(end - PAGE_ALLOC_PAGE_SIZE)),
+              "free of a page that is not allocated must fail");
+
+  for (i = 0u; i < PAGE_CACHE_MAGAZINE_SIZE + 1u; ++i) {
+    TEST_ASSERT(page_cache_free(pages[i]), "free into magazine should succeed");
+  }
+
+  TEST_ASSERT(page_cache_stats(1u, &stats), "stats lookup should succeed");
+  TEST_ASSERT(stats.drains == 1u, "overflowing the magazine should drain once");
+  TEST_ASSERT(stats.cached_pages == PAGE_CACHE_MAGAZINE_SIZE - PAGE_CACHE_BATCH + 1u,
+              "drain should return one batch to the global allocator");
+  TEST_ASSERT(page_cache_stats(0u, &stats), "stats lookup should succeed");
+  TEST_ASSERT(stats.cached_pages == 0u && stats.refills == 0u,
+              "other harts must not see this hart's pages");
+
+  g_fake_hart_id = 0u;
+  TEST_ASSERT(page_cache_alloc() != 0, "hart 0 should refill its own magazine");
+  page_cache_drain_hart(0u);
+  page_cache_drain_hart(1u);
+  TEST_ASSERT(page_cache_cached_pages() == 0u, "explicit drains should empty all magazines");
+  TEST_ASSERT(page_alloc_free_pages() == 127u, "all but one page should be back in the pool");
+
+  g_fake_hart_id = HART_MAX_HARTS;
+  TEST_ASSERT(page_cache_alloc() != 0, "unknown harts should fall back to page_alloc");
+  TEST_ASSERT(page_alloc_free_pages() == 126u, "fallback should allocate directly");
+  return 0;
+}
+
+static int test_page_alloc_routes_through_magazines(void) {
+  static uint8_t region[65u * PAGE_ALLOC_PAGE_SIZE];
+  uintptr_t start = align_up((uintptr_t)&region[0]);
+  uintptr_t end = start + (64u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
+  page_cache_stats_t stats;
+  void *page;
+
+  page_alloc_init(start, end);
+  page_cache_init();
+  g_fake_hart_id = 2u;
+
+  page = page_alloc();
+  TEST_ASSERT(page != 0 && page_cache_cached_pages() == PAGE_CACHE_BATCH - 1u,
+              "page_alloc should refill the local magazine");
+  TEST_ASSERT(page_free(page), "page_free should accept a cached allocation");
+  TEST_ASSERT(page_alloc_free_pages() == 64u - PAGE_CACHE_BATCH,
+              "page_free should park the page in the magazine");
+  TEST_ASSERT(page_alloc() == page, "the next page_alloc should hit the magazine");
+  TEST_ASSERT(page_cache_stats(2u, &stats) && stats.alloc_hits == 1u && stats.free_hits == 1u,
+              "single-page calls should count as magazine hits");
+
+  page_alloc_init(start, end);
+  TEST_ASSERT(page_alloc() != 0 && page_alloc_free_pages() == 63u,
+              "reinitializing the allocator should remove the front end");
+  return 0;
+}
+
+static int test_cross_hart_double_free(void) {
+  static uint8_t region[65u * PAGE_ALLOC_PAGE_SIZE];
+  uintptr_t start = align_up((uintptr_t)&region[0]);
+  uintptr_t end = start + (64u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
+  void *page;
+
+  page_alloc_init(start, end);
+  page_cache_init();
+  g_fake_hart_id = 0u;
+
+  page = page_cache_alloc();
+  TEST_ASSERT(page != 0, "allocation should succeed");
+  TEST_ASSERT(page_cache_free(page), "first free should park the page on hart 0");
+  g_fake_hart_id = 1u;
+  TEST_ASSERT(!page_cache_free(page), "freeing the same page on another hart must fail");
+  TEST_ASSERT(page_cache_cached_pages() == PAGE_CACHE_BATCH,
+              "the rejected free must not park the page twice");
+  TEST_ASSERT(!page_free_order(page, 0u), "a parked page must not go back to the buddy lists");
+
+  g_fake_hart_id = 0u;
+  TEST_ASSERT(page_cache_alloc() == page, "hart 0 should hand the page out again");
+  TEST_ASSERT(page_free_order(page, 0u), "a handed-out page is freeable directly again");
+  TEST_ASSERT(!page_cache_free(page), "a page back in the buddy lists cannot be parked");
+
+  page_cache_drain_hart(0u);
+  TEST_ASSERT(page_alloc_free_pages() == 64u, "draining should return every parked page");
+  return 0;
+}
+
+int page_cache_tests_run(void) {
+  if (test_refill_and_hits() != 0) {
+    return 1;
+  }
+  if (test_drain_and_per_hart_isolation() != 0) {
+    return 1;
+  }
+  if (test_page_alloc_routes_through_magazines() != 0) {
+    return 1;
+  }
+  if (test_cross_hart_double_free() != 0) {
+    return 1;
+  }
+
+  printf("page cache unit tests passed\n");
+  return 0;
+}
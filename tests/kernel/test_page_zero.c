@@ -0,0 +1,101 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "page_alloc.h"
+#include "page_zero.h"
+
+#define TEST_ASSERT(cond, msg)                          \
+  do {                                                  \
+    if (!(cond)) {                                      \
+      fprintf(stderr, "FAIL: %s\n", (msg));            \
+      return 1;                                         \
+    }                                                   \
+  } while (0)
+
+static uintptr_t align_up(uintptr_t addr) {
+  return (addr + (PAGE_ALLOC_PAGE_SIZE - 1u)) &
+         ~((uintptr_t)PAGE_ALLOC_PAGE_SIZE - 1u);
+}
+
+static void dirty_region(uint8_t *start, size_t pages) {
+  size_t i;
+
+  for (i = 0u; i < pages * PAGE_ALLOC_PAGE_SIZE; ++i) {
+    start[i] = 0xa5u;
+  }
+}
+
+static int page_is_zero(const void *page) {
+  const uint8_t *bytes = (const uint8_t *)page;
+  size_t i;
+
+  for (i = 0u; i < PAGE_ALLOC_PAGE_SIZE; ++i) {
+    if (bytes[i] != 0u) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static int test_miss_then_idle_refill(void) {
+  static uint8_t region[9u * PAGE_ALLOC_PAGE_SIZE];
+  uintptr_t start = align_up((uintptr_t)&region[0]);
+  page_zero_stats_t stats;
+  void *page;
+
+  dirty_region((uint8_t *)start, 8u);
+  page_alloc_init(start, start + (8u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE));
+  page_zero_init(4u);
+
+  page = page_alloc_zeroed();
+  TEST_ASSERT(page != 0 && page_is_zero(page), "miss path must return a cleared page");
+  page_zero_get_stats(&stats);
+  TEST_ASSERT(stats.misses == 1u && stats.hits == 0u, "empty pool should count a miss");
+
+  TEST_ASSERT(page_zero_idle_work(3u) == 3u, "idle work should respect the page budget");
+  TEST_ASSERT(page_zero_idle_work(8u) == 1u, "idle work should stop at the target depth");
+  TEST_ASSERT(page_zero_idle_work(8u) == 0u, "full pool should not zero more pages");
+  page_zero_get_stats(&stats);
+  TEST_ASSERT(stats.depth == 4u && stats.idle_zeroed == 4u, "pool depth mismatch");
+  TEST_ASSERT(page_alloc_free_pages() == 3u, "pooled pages stay allocated in page_alloc");
+
+  page = page_alloc_zeroed();
+  TEST_ASSERT(page != 0 && page_is_zero(page), "hit path must return a cleared page");
+  page_zero_get_stats(&stats);
+  TEST_ASSERT(stats.hits == 1u && stats.depth == 3u, "pool hit should drain one page");
+  TEST_ASSERT(page_free(page), "pooled pages are freed through page_free");
+
+  page_zero_release();
+  TEST_ASSERT(page_alloc_free_pages() == 7u, "release should return pooled pages");
+  return 0;
+}
+
+static int test_target_clamp_and_exhaustion(void) {
+  static uint8_t region[3u * PAGE_ALLOC_PAGE_SIZE];
+  uintptr_t start = align_up((uintptr_t)&region[0]);
+  page_zero_stats_t stats;
+
+  page_alloc_init(start, start + (2u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE));
+  page_zero_init(PAGE_ZERO_POOL_CAPACITY + 10u);
+  page_zero_get_stats(&stats);
+  TEST_ASSERT(stats.target == PAGE_ZERO_POOL_CAPACITY, "target should clamp to capacity");
+
+  TEST_ASSERT(page_zero_idle_work(8u) == 2u, "idle work should stop when memory runs out");
+  TEST_ASSERT(page_alloc_zeroed() != 0, "first pooled page should be available");
+  TEST_ASSERT(page_alloc_zeroed() != 0, "second pooled page should be available");
+  TEST_ASSERT(page_alloc_zeroed() == 0, "allocation should fail when pool and memory are empty");
+  return 0;
+}
+
+int page_zero_tests_run(void) {
+  if (test_miss_then_idle_refill() != 0) {
+    return 1;
+  }
+  if (test_target_clamp_and_exhaustion() != 0) {
+    return 1;
+  }
+
+  printf("zeroed page pool unit tests passed\n");
+  return 0;
+}
@@ -0,0 +1,105 @@
+#define PERF_SCOPE_ENABLED 1
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "perf.h"
+
+#define TEST_ASSERT(cond, msg)                          \
+  do {                                                  \
+    if (!(cond)) {                                      \
+      fprintf(stderr, "FAIL: %s\n", (msg));            \
+      return 1;                                         \
+    }                                                   \
+  } while (0)
+
+static uint64_t g_fake_cycles;
+static uint64_t g_fake_instret;
+/* Cycles and instructions each instrumented call below pretends to take. */
+static uint64_t g_call_cycles;
+static uint64_t g_call_instret;
+
+uint64_t riscv_cycle_now(void) { return g_fake_cycles; }
+
+uint64_t riscv_instret_now(void) { return g_fake_instret; }
+
+static int perf_work(int early) {
+  PERF_SCOPE("test_work");
+
+  g_fake_cycles += g_call_cycles;
+  g_fake_instret += g_call_instret;
+  /* Every return path closes the scope. */
+  if (early != 0) {
+    return 1;
+  }
+  return 0;
+}
+
+static const perf_site_t *perf_find(const char *name) {
+  const perf_site_t *site;
+
+  for (site = perf_site_first(); site != (const perf_site_t *)0; site = site->next) {
+    if (strcmp(site->name, name) == 0) {
+      return site;
+    }
+  }
+  return (const perf_site_t *)0;
+}
+
+static int test_scope_accumulates(void) {
+  const perf_site_t *site;
+  uint32_t i;
+
+  TEST_ASSERT(perf_find("test_work") == (const perf_site_t *)0,
+              "a site should register on its first call");
+
+  g_call_cycles = 100u;
+  g_call_instret = 40u;
+  (void)perf_work(0);
+  g_call_cycles = 1000u;
+  g_call_instret = 300u;
+  (void)perf_work(1);
+  g_call_cycles = 3u;
+  g_call_instret = 1u;
+  (void)perf_work(0);
+
+  site = perf_find("test_work");
+  TEST_ASSERT(site != (const perf_site_t *)0 && site->next == (const perf_site_t *)0,
+              "repeat calls should register the site once");
+  TEST_ASSERT(site->count == 3u && site->cycles == 1103u && site->instret == 341u,
+              "count and sums should cover every return path");
+  TEST_ASSERT(site->cycles_min == 3u && site->cycles_max == 1000u,
+              "min and max should track the extremes");
+  TEST_ASSERT(site->hist[1] == 1u && site->hist[6] == 1u && site->hist[9] == 1u,
+              "calls should land in their log2 buckets");
+
+  for (i = 0u; i < 97u; ++i) {
+    (void)perf_work(0);
+  }
+  TEST_ASSERT(perf_site_percentile(site, 50u) == 4u,
+              "p50 should be the upper bound of the common bucket");
+  TEST_ASSERT(perf_site_percentile(site, 100u) == 1024u,
+              "p100 should reach the slowest call's bucket");
+
+  g_call_cycles = 1ULL << 40;
+  (void)perf_work(0);
+  TEST_ASSERT(site->hist[PERF_HIST_BUCKETS - 1u] == 1u,
+              "huge durations should clamp into the last bucket");
+
+  perf_reset();
+  TEST_ASSERT(site->count == 0u && site->cycles == 0u && site->cycles_max == 0u &&
+                  site->cycles_min == ~0ULL && site->hist[1] == 0u,
+              "reset should clear every counter");
+  TEST_ASSERT(perf_find("test_work") == site, "reset should keep sites registered");
+  return 0;
+}
+
+int perf_tests_run(void) {
+  if (test_scope_accumulates() != 0) {
+    return 1;
+  }
+
+  printf("perf scope unit tests passed\n");
+  return 0;
+}
@@ -3,11 +3,18 @@
 #include <string.h>
 
 #include "clock.h"
+#include "klog.h"
 #include "line_io.h"
+#include "page_alloc.h"
+#include "profile.h"
+#include "riscv_soft_irq.h"
 #include "riscv_timer.h"
 #include "sched.h"
 #include "task.h"
+#include "timer.h"
+#include "trace.h"
 #include "trap.h"
+#include "wait.h"
 
 #define TEST_ASSERT(cond, msg)                       \
   do {                                               \
@@ -30,6 +37,13 @@ static uint64_t g_fake_now;
 static uint64_t g_deadlines[TEST_DEADLINE_CAPACITY];
 static size_t g_deadline_count;
 static unsigned int g_interrupt_enable_count;
+static unsigned int g_soft_irq_raised;
+static unsigned int g_soft_irq_cleared;
+static uint64_t g_fake_cycles;
+static uint32_t g_fake_hart;
+static uint32_t g_ipi_mask;
+/* Runs once from the next yield request; stands in for another hart's interrupt. */
+static void (*g_soft_irq_hook)(void);
 
 static void test_log_reset(void) {
   g_log_len = 0u;
@@ -111,6 +125,42 @@ void riscv_timer_set_deadline(uint64_t deadline) {
 
 void riscv_timer_enable_interrupts(void) { g_interrupt_enable_count += 1u; }
 
+uint64_t riscv_cycle_now(void) { return g_fake_cycles; }
+
+void riscv_soft_irq_enable(void) {}
+
+/* The host has no trap path, so raising the yield interrupt only records the request. */
+void riscv_soft_irq_raise(void) {
+  void (*hook)(void) = g_soft_irq_hook;
+
+  g_soft_irq_raised += 1u;
+  g_fake_cycles += 100u;
+  if (hook != (void (*)(void))0) {
+    g_soft_irq_hook = (void (*)(void))0;
+    hook();
+  }
+}
+
+void riscv_soft_irq_clear(void) { g_soft_irq_cleared += 1u; }
+
+void riscv_soft_irq_send(uint32_t hart_id) { g_ipi_mask |= 1u << hart_id; }
+
+uint64_t riscv_irq_save(void) { return 0u; }
+
+void riscv_irq_restore(uint64_t state) { (void)state; }
+
+uint32_t hart_current_id(void) { return g_fake_hart; }
+
+bool idle_run_once(void) { return false; }
+
+static void setup_stack_pool(void) {
+  static uint8_t region[(TASK_MAX_TASKS * 2u + 1u) * PAGE_ALLOC_PAGE_SIZE];
+  uintptr_t start = ((uintptr_t)&region[0] + (PAGE_ALLOC_PAGE_SIZE - 1u)) &
+                    ~((uintptr_t)PAGE_ALLOC_PAGE_SIZE - 1u);
+
+  page_alloc_init(start, start + ((TASK_MAX_TASKS * 2u) * (uintptr_t)PAGE_ALLOC_PAGE_SIZE));
+}
+
 static int test_clock_behavior(void) {
   size_t i;
 
@@ -154,14 +204,60 @@ static int test_clock_behavior(void) {
   return 0;
 }
 
+static int test_clock_ns_conversion(void) {
+  static const uint64_t k_timebases[] = {10000000ULL, 24000000ULL, 1000000ULL, 32768ULL};
+  static const uint64_t k_ticks[] = {1ULL, 12345ULL, 24000000ULL, 86400ULL * 24000000ULL,
+                                     1ULL << 52};
+  size_t i;
+  size_t j;
+
+  clock_set_timebase(10000000ULL);
+  TEST_ASSERT(clock_ticks_to_ns(1ULL) == 100ULL, "10 MHz tick should be 100 ns");
+  TEST_ASSERT(clock_ns_to_ticks(1000000000ULL) == 10000000ULL,
+              "one second should be 10M ticks at 10 MHz");
+  TEST_ASSERT(clock_slice_ticks() == CLOCK_INTERVAL_TICKS, "10 MHz slice should be 100 ms");
+
+  for (i = 0u; i < sizeof(k_timebases) / sizeof(k_timebases[0]); ++i) {
+    clock_set_timebase(k_timebases[i]);
+    TEST_ASSERT(clock_timebase_hz() == k_timebases[i], "timebase should be recorded");
+    for (j = 0u; j < sizeof(k_ticks) / sizeof(k_ticks[0]); ++j) {
+      unsigned __int128 exact =
+          ((unsigned __int128)k_ticks[j] * 1000000000ULL) / k_timebases[i];
+      uint64_t ns = clock_ticks_to_ns(k_ticks[j]);
+      uint64_t error = ns > (uint64_t)exact ? ns - (uint64_t)exact : (uint64_t)exact - ns;
+
+      /* mult is rounded to 32 bits, so allow a few parts per billion plus one ns. */
+      TEST_ASSERT(error <= 1ULL + (uint64_t)(exact / 100000000ULL),
+                  "tick to ns conversion should track the exact value");
+    }
+  }
+
+  clock_set_timebase(1000000ULL);
+  TEST_ASSERT(clock_slice_ticks() == 100000ULL, "slice should follow the timebase");
+
+  g_fake_now = 5000000ULL;
+  TEST_ASSERT(clock_now_ns() == 5000000000ULL, "now_ns should scale the time CSR");
+  clock_set_wall_ns(1700000000000000000ULL);
+  g_fake_now += 2000000ULL;
+  TEST_ASSERT(clock_wall_ns() == 1700000002000000000ULL, "wall clock should advance with now");
+
+  clock_set_timebase(0ULL);
+  TEST_ASSERT(clock_slice_ticks() == CLOCK_INTERVAL_TICKS, "0 should restore the default");
+  return 0;
+}
+
 static int test_scheduler_round_robin_timer_flow(void) {
   size_t i;
   task_control_block_t *task_1;
   task_control_block_t *task_2;
-  struct trap_frame frame;
+  struct trap_frame boot_frame;
+  struct trap_frame *frame = &boot_frame;
+  struct trap_frame *task_1_initial;
+  uintptr_t task_1_stack_top;
 
   test_log_reset();
   reset_timer_stubs();
+  setup_stack_pool();
 
   g_fake_now = 5000ULL;
   clock_init();
@@ -173,37 +269,1130 @@ static int test_scheduler_round_robin_timer_flow(void) {
   task_2 = task_find(2u);
   TEST_ASSERT(task_1 != NULL, "task 1 should exist after scheduler bootstrap");
   TEST_ASSERT(task_2 != NULL, "task 2 should exist after scheduler bootstrap");
+  TEST_ASSERT(sched_current_task() == task_boot(), "boot context should be running first");
+  TEST_ASSERT(task_1->stack_base != NULL && task_2->stack_base != task_1->stack_base,
+              "each task should own a stack");
+
+  task_1_stack_top = (uintptr_t)task_1->stack_base + TASK_STACK_SIZE;
+  task_1_initial = task_1->context.frame;
+  TEST_ASSERT((uintptr_t)task_1_initial + sizeof(struct trap_frame) == task_1_stack_top,
+              "initial frame should sit at the top of the task stack");
+  TEST_ASSERT(task_1_initial->sp == task_1_stack_top, "initial sp should be the stack top");
+  TEST_ASSERT(task_1_initial->a0 == (uint64_t)(uintptr_t)task_1,
+              "initial a0 should carry the task");
+  TEST_ASSERT(task_1_initial->mepc != 0u, "initial pc should be the task trampoline");
+  TEST_ASSERT((task_1_initial->mstatus & (SSTATUS_SPP | SSTATUS_SPIE)) ==
+                  (uint64_t)(SSTATUS_SPP | SSTATUS_SPIE),
+              "initial sstatus should return to S-mode with interrupts on");
+
+  memset(&boot_frame, 0, sizeof(boot_frame));
+  boot_frame.tp = 3u;
+  boot_frame.mepc = 0x80200000ULL;
+  boot_frame.mcause = 0x8000000000000005ULL;
 
+  /* Rotation is boot -> 1 -> 2 -> boot; each task resumes from the frame it left. */
   for (i = 0u; i < 6u; ++i) {
-    memset(&frame, 0, sizeof(frame));
-    frame.mepc = 0x80000000ULL + (uint64_t)(i * 4u);
-    frame.mcause = 0x8000000000000007ULL;
+    struct trap_frame *next;
 
+    frame->mcause = 0x8000000000000005ULL;
     g_fake_now += CLOCK_INTERVAL_TICKS;
     clock_handle_timer_interrupt();
-    sched_handle_timer_interrupt(&frame);
+    next = sched_handle_timer_interrupt(frame);
+
+    if (i == 0u) {
+      TEST_ASSERT(next == task_1_initial, "first switch should resume task 1's initial frame");
+      TEST_ASSERT(next->tp == 3u, "switched-in frame should inherit the hart's tp");
+    }
+    if (i == 2u || i == 5u) {
+      TEST_ASSERT(next == &boot_frame, "boot context should resume its saved frame");
+    }
+    if (i == 3u) {
+      TEST_ASSERT(next == task_1_initial, "task 1 should resume where it was switched out");
+    }
+    frame = next;
   }
 
   TEST_ASSERT(clock_ticks() == 6ULL, "timer flow should invoke six clock ticks");
+  TEST_ASSERT(sched_switch_count() == 6ULL, "every tick should switch tasks");
 
-  TEST_ASSERT(task_1->run_count == 3ULL, "task 1 should run on alternating slices");
-  TEST_ASSERT(task_2->run_count == 3ULL, "task 2 should run on alternating slices");
-  TEST_ASSERT(task_1->context.switches_in == 3ULL, "task 1 switch-in count mismatch");
-  TEST_ASSERT(task_2->context.switches_in == 3ULL, "task 2 switch-in count mismatch");
-  TEST_ASSERT(task_1->context.switches_out == 3ULL, "task 1 switch-out count mismatch");
+  TEST_ASSERT(task_1->run_count == 2ULL, "task 1 should run on alternating slices");
+  TEST_ASSERT(task_2->run_count == 2ULL, "task 2 should run on alternating slices");
+  TEST_ASSERT(task_1->context.switches_in == 2ULL, "task 1 switch-in count mismatch");
+  TEST_ASSERT(task_2->context.switches_in == 2ULL, "task 2 switch-in count mismatch");
+  TEST_ASSERT(task_1->context.switches_out == 2ULL, "task 1 switch-out count mismatch");
   TEST_ASSERT(task_2->context.switches_out == 2ULL, "task 2 switch-out count mismatch");
-  TEST_ASSERT(task_1->context.last_mcause == 0x8000000000000007ULL,
+  TEST_ASSERT(task_1->context.last_mcause == 0x8000000000000005ULL,
               "task 1 should observe timer interrupt cause");
-  TEST_ASSERT(task_2->context.last_mcause == 0x8000000000000007ULL,
-              "task 2 should observe timer interrupt cause");
+  TEST_ASSERT(task_boot()->state == TASK_STATE_RUNNING, "boot task should be running again");
 
-  TEST_ASSERT(strstr(g_log, "SCHED: policy=round-robin runnable=2") != NULL,
+  TEST_ASSERT(strstr(g_log, "SCHED: policy=priority-rr runnable=2") != NULL,
               "scheduler policy log missing");
-  TEST_ASSERT(strstr(g_log, "TASK: 1 running") != NULL, "task 1 run log missing");
-  TEST_ASSERT(strstr(g_log, "TASK: 2 running") != NULL, "task 2 run log missing");
-  TEST_ASSERT(strstr(g_log, "SCHED_TEST: alternating tasks confirmed") != NULL,
-              "alternation confirmation log missing");
+  TEST_ASSERT(strstr(g_log, "SCHED: switch 0 -> 1\n") != NULL, "boot to task 1 log missing");
+  TEST_ASSERT(strstr(g_log, "SCHED: switch 1 -> 2\n") != NULL, "task 1 to 2 log missing");
+  TEST_ASSERT(strstr(g_log, "SCHED: switch 2 -> 0\n") != NULL, "task 2 to boot log missing");
+
+  return 0;
+}
+
+static int test_yield_exit_and_reap(void) {
+  task_control_block_t *task_1;
+  task_control_block_t *task_2;
+  struct trap_frame boot_frame;
+  struct trap_frame *frame;
+  size_t free_before_reap;
+  sched_switch_bench_t bench;
+
+  test_log_reset();
+  reset_timer_stubs();
+  setup_stack_pool();
+  sched_init();
+  sched_bootstrap_test_tasks();
+  task_1 = task_find(1u);
+  task_2 = task_find(2u);
+  memset(&boot_frame, 0, sizeof(boot_frame));
+
+  g_soft_irq_cleared = 0u;
+  frame = sched_handle_yield(&boot_frame);
+  TEST_ASSERT(g_soft_irq_cleared == 1u, "yield handler should acknowledge the interrupt");
+  TEST_ASSERT(frame == task_1->context.frame && sched_current_task() == task_1,
+              "yield should switch to the next runnable task");
+
+  /* task 1 exits; it stays on its stack until the scheduler moves off it. */
+  task_1->state = TASK_STATE_EXITED;
+  frame = sched_handle_yield(frame);
+  TEST_ASSERT(sched_current_task() == task_2, "exited task should not be picked again");
+  TEST_ASSERT(sched_runnable_count() == 2u, "running exited task should not be reaped yet");
+
+  free_before_reap = page_alloc_free_pages();
+  frame = sched_handle_yield(frame);
+  TEST_ASSERT(frame == &boot_frame, "rotation should reach the boot task");
+  TEST_ASSERT(sched_runnable_count() == 1u, "exited task should be reaped after switching away");
+  TEST_ASSERT(page_alloc_free_pages() == free_before_reap + (1u << TASK_STACK_ORDER),
+              "reaped task stack should be freed");
+  TEST_ASSERT(task_find(1u) == NULL, "reaped task slot should be released");
+
+  frame = sched_handle_yield(frame);
+  TEST_ASSERT(sched_current_task() == task_2, "remaining task should keep rotating");
+
+  g_fake_cycles = 0u;
+  g_soft_irq_raised = 0u;
+  TEST_ASSERT(sched_bench_switch_cost(8u, &bench) == 0, "switch benchmark should run");
+  TEST_ASSERT(g_soft_irq_raised == 8u && bench.yields == 8u && bench.cycles == 800u,
+              "benchmark should yield once per iteration and time with the cycle counter");
+  return 0;
+}
+
+static void test_idle_task(task_control_block_t *task) { (void)task; }
+
+static int test_priority_preemption(void) {
+  task_control_block_t *task_1;
+  task_control_block_t *urgent;
+  struct trap_frame boot_frame;
+  struct trap_frame *frame;
+  unsigned int raised_before;
+
+  test_log_reset();
+  reset_timer_stubs();
+  setup_stack_pool();
+  sched_init();
+  sched_bootstrap_test_tasks();
+  task_1 = task_find(1u);
+  memset(&boot_frame, 0, sizeof(boot_frame));
+  TEST_ASSERT(task_find(TASK_MAX_TASKS + 1u) == NULL, "out-of-range ids should not resolve");
+  TEST_ASSERT(task_find(5u) == NULL, "unused slots should not resolve");
+
+  urgent = task_create("urgent", test_idle_task);
+  TEST_ASSERT(urgent != NULL && urgent->priority == SCHED_PRIORITY_DEFAULT,
+              "new tasks should start at the default priority");
+  TEST_ASSERT(sched_set_priority(urgent, SCHED_PRIORITY_LEVELS) != 0,
+              "out-of-range priority should be rejected");
+  TEST_ASSERT(sched_set_priority(urgent, SCHED_PRIORITY_INTERACTIVE) == 0,
+              "priority should be settable before queueing");
+
+  raised_before = g_soft_irq_raised;
+  TEST_ASSERT(sched_add_task(urgent) == 0, "urgent task should queue");
+  TEST_ASSERT(g_soft_irq_raised == raised_before + 1u,
+              "queueing more urgent work should request preemption");
+
+  frame = sched_handle_yield(&boot_frame);
+  TEST_ASSERT(sched_current_task() == urgent && frame == urgent->context.frame,
+              "most urgent task should run ahead of older queued tasks");
+
+  frame = sched_handle_timer_interrupt(frame);
+  frame = sched_handle_timer_interrupt(frame);
+  TEST_ASSERT(sched_current_task() == urgent && urgent->run_count == 3ULL,
+              "urgent task should keep the CPU over less urgent work");
+  TEST_ASSERT(task_1->run_count == 0ULL, "default-priority task should wait");
 
+  raised_before = g_soft_irq_raised;
+  TEST_ASSERT(sched_set_priority(urgent, SCHED_PRIORITY_BATCH) == 0,
+              "running task should be demotable");
+  TEST_ASSERT(g_soft_irq_raised == raised_before + 1u,
+              "demoting below queued work should request a switch");
+
+  frame = sched_handle_yield(frame);
+  TEST_ASSERT(sched_current_task() == task_1, "demotion should hand the CPU to task 1");
+  frame = sched_handle_yield(frame);
+  frame = sched_handle_yield(frame);
+  frame = sched_handle_yield(frame);
+  TEST_ASSERT(frame == task_1->context.frame && urgent->run_count == 3ULL,
+              "batch task should not run while default-priority tasks are runnable");
+  TEST_ASSERT(sched_runnable_count() == 3u, "scheduler should track three queued tasks");
+  return 0;
+}
+
+static int test_per_hart_queues(void) {
+  task_control_block_t *task_1;
+  task_control_block_t *task_2;
+  task_control_block_t *extra;
+  struct trap_frame boot_frame;
+  struct trap_frame idle_frame;
+  struct trap_frame *frame;
+  sched_hart_stats_t stats;
+
+  test_log_reset();
+  reset_timer_stubs();
+  setup_stack_pool();
+  g_fake_hart = 0u;
+  clock_init();
+  sched_init();
+
+  /* Hart 1 comes online with its idle loop as the root context. */
+  g_fake_hart = 1u;
+  sched_hart_online();
+  clock_init_secondary();
+  TEST_ASSERT(sched_current_task() == task_hart_root(1u), "hart 1 should run its idle root");
+  TEST_ASSERT(task_hart_root(1u)->priority == SCHED_PRIORITY_IDLE,
+              "idle root should sit at the lowest level");
+  g_fake_hart = 0u;
+
+  sched_bootstrap_test_tasks();
+  task_1 = task_find(1u);
+  task_2 = task_find(2u);
+  TEST_ASSERT(task_1->hart == 1u, "first task should go to the idle hart");
+  TEST_ASSERT(task_2->hart == 0u, "second task should balance back to the boot hart");
+  TEST_ASSERT(sched_hart_stats(0u, &stats) == 0 && stats.tasks == 1u,
+              "boot hart should own one task");
+  TEST_ASSERT(sched_hart_stats(1u, &stats) == 0 && stats.tasks == 1u && stats.online,
+              "hart 1 should own one task");
+
+  g_ipi_mask = 0u;
+  extra = task_create("extra", test_idle_task);
+  TEST_ASSERT(extra != NULL && sched_add_task(extra) == 0, "extra task should queue");
+  TEST_ASSERT(extra->hart == 1u && g_ipi_mask == (1u << 1),
+              "placing work on an idle hart should send it an IPI");
+
+  memset(&boot_frame, 0, sizeof(boot_frame));
+  memset(&idle_frame, 0, sizeof(idle_frame));
+  boot_frame.tp = 0u;
+  idle_frame.tp = 1u;
+
+  g_fake_hart = 1u;
+  frame = sched_handle_yield(&idle_frame);
+  TEST_ASSERT(sched_current_task() == task_1 && frame->tp == 1u,
+              "hart 1 should pick its own queued task");
+  frame = sched_handle_timer_interrupt(frame);
+  TEST_ASSERT(sched_current_task() == extra, "hart 1 should rotate within its queue");
+  frame = sched_handle_timer_interrupt(frame);
+  TEST_ASSERT(sched_current_task() == task_1,
+              "idle root should not run while hart 1 has work");
+
+  g_fake_hart = 0u;
+  frame = sched_handle_timer_interrupt(&boot_frame);
+  TEST_ASSERT(sched_current_task() == task_2 && frame->tp == 0u,
+              "boot hart should run only its own task");
+  TEST_ASSERT(task_2->run_count == 1ULL && task_1->run_count == 2ULL,
+              "queues should advance independently");
+
+  g_fake_hart = 1u;
+  clock_handle_timer_interrupt();
+  clock_handle_timer_interrupt();
+  TEST_ASSERT(clock_ticks() == 2ULL && clock_hart_ticks(0u) == 0ULL,
+              "tick counts should be kept per hart");
+  g_fake_hart = 0u;
+  TEST_ASSERT(sched_runnable_count() == 3u, "runnable count should cover every hart");
+  return 0;
+}
+
+static int test_work_stealing(void) {
+  task_control_block_t *tasks[3];
+  struct trap_frame boot_frame;
+  struct trap_frame idle_frame;
+  struct trap_frame *frame;
+  sched_hart_stats_t stats;
+  size_t i;
+
+  test_log_reset();
+  reset_timer_stubs();
+  setup_stack_pool();
+  g_fake_hart = 0u;
+  sched_init();
+  g_fake_hart = 1u;
+  sched_hart_online();
+  g_fake_hart = 0u;
+  sched_start();
+
+  /* Pile everything onto the boot hart; the last task may only ever run there. */
+  for (i = 0u; i < 3u; ++i) {
+    tasks[i] = task_create("work", test_idle_task);
+    TEST_ASSERT(tasks[i] != NULL && sched_set_affinity(tasks[i], 1u << 0) == 0,
+                "work task should be created with a boot-hart hint");
+    TEST_ASSERT(sched_add_task(tasks[i]) == 0 && tasks[i]->hart == 0u,
+                "affinity should steer placement to the boot hart");
+  }
+  TEST_ASSERT(sched_set_affinity(tasks[0], 0u) != 0, "empty affinity should be rejected");
+  TEST_ASSERT(sched_set_affinity(tasks[0], ~0u) == 0 && sched_set_affinity(tasks[1], ~0u) == 0,
+              "hints should be widenable after placement");
+
+  memset(&boot_frame, 0, sizeof(boot_frame));
+  memset(&idle_frame, 0, sizeof(idle_frame));
+  idle_frame.tp = 1u;
+
+  g_fake_hart = 1u;
+  frame = sched_handle_timer_interrupt(&idle_frame);
+  TEST_ASSERT(sched_current_task() == tasks[1] && tasks[1]->hart == 1u,
+              "idle hart should steal the newest allowed task");
+  frame = sched_handle_timer_interrupt(frame);
+  TEST_ASSERT(sched_current_task() == tasks[1],
+              "a hart with its own runnable task should not steal");
+
+  tasks[1]->state = TASK_STATE_EXITED;
+  frame = sched_handle_timer_interrupt(frame);
+  TEST_ASSERT(sched_current_task() == tasks[0] && tasks[0]->hart == 1u,
+              "hart 1 should steal again once its own work is done");
+  TEST_ASSERT(tasks[2]->hart == 0u, "pinned task should stay on the boot hart");
+
+  TEST_ASSERT(sched_hart_stats(1u, &stats) == 0 && stats.steals == 2ULL,
+              "hart 1 should record two steals");
+  TEST_ASSERT(sched_hart_stats(0u, &stats) == 0 && stats.stolen == 2ULL && stats.tasks == 1u,
+              "boot hart should record two stolen tasks");
+
+  sched_set_stealing(false);
+  tasks[0]->state = TASK_STATE_EXITED;
+  frame = sched_handle_timer_interrupt(frame);
+  TEST_ASSERT(sched_current_task() == task_hart_root(1u),
+              "with stealing off an empty hart should fall back to its idle root");
+
+  g_fake_hart = 0u;
+  frame = sched_handle_timer_interrupt(&boot_frame);
+  TEST_ASSERT(sched_current_task() == tasks[2], "boot hart should keep its pinned task");
+  return 0;
+}
+
+static int test_switched_out_task_not_stolen_until_off_stack(void) {
+  task_control_block_t *tasks[2];
+  struct trap_frame boot_frame;
+  struct trap_frame idle_frame;
+  struct trap_frame *frame;
+  struct trap_frame *idle;
+  size_t i;
+
+  test_log_reset();
+  reset_timer_stubs();
+  setup_stack_pool();
+  g_fake_hart = 0u;
+  sched_init();
+  g_fake_hart = 1u;
+  sched_hart_online();
+  g_fake_hart = 0u;
+  sched_start();
+
+  for (i = 0u; i < 2u; ++i) {
+    tasks[i] = task_create("work", test_idle_task);
+    TEST_ASSERT(tasks[i] != NULL && sched_set_affinity(tasks[i], 1u << 0) == 0 &&
+                    sched_add_task(tasks[i]) == 0 && sched_set_affinity(tasks[i], ~0u) == 0,
+                "work task should queue on the boot hart");
+  }
+
+  memset(&boot_frame, 0, sizeof(boot_frame));
+  memset(&idle_frame, 0, sizeof(idle_frame));
+  idle_frame.tp = 1u;
+
+  frame = sched_handle_timer_interrupt(&boot_frame);
+  sched_finish_switch();
+  TEST_ASSERT(sched_current_task() == tasks[0] && tasks[0]->on_cpu, "task 0 should run");
+  frame = sched_handle_timer_interrupt(frame);
+  TEST_ASSERT(sched_current_task() == tasks[1] && tasks[0]->on_cpu,
+              "the switched-out task stays on_cpu until its stack is left");
+
+  /* Hart 1 would take the newest queued task, but hart 0 is still on its stack. */
+  g_fake_hart = 1u;
+  idle = sched_handle_timer_interrupt(&idle_frame);
+  TEST_ASSERT(idle == &idle_frame && sched_current_task() == task_hart_root(1u),
+              "a thief must skip a task that is still on_cpu");
+
+  g_fake_hart = 0u;
+  sched_finish_switch();
+  TEST_ASSERT(!tasks[0]->on_cpu && tasks[1]->on_cpu, "finishing the switch releases task 0");
+
+  g_fake_hart = 1u;
+  (void)sched_handle_timer_interrupt(idle);
+  TEST_ASSERT(sched_current_task() == tasks[0] && tasks[0]->hart == 1u,
+              "the task is stealable once its old hart is off its stack");
+  g_fake_hart = 0u;
+  (void)frame;
+  return 0;
+}
+
+static int test_tickless_idle(void) {
+  task_control_block_t *task;
+  struct trap_frame idle_frame;
+  struct trap_frame *frame;
+  clock_hart_stats_t stats;
+  size_t programmed;
+
+  test_log_reset();
+  reset_timer_stubs();
+  setup_stack_pool();
+  g_fake_hart = 0u;
+  g_fake_now = 1000ULL;
+  clock_init();
+  sched_init();
+  g_fake_hart = 1u;
+  sched_hart_online();
+  clock_init_secondary();
+  g_fake_hart = 0u;
+  sched_start();
+  clock_set_tickless(true);
+
+  /* The boot hart's root is the shell, which keeps the periodic tick. */
+  g_fake_now += CLOCK_INTERVAL_TICKS;
+  clock_handle_timer_interrupt();
+  TEST_ASSERT(clock_hart_stats(0u, &stats) == 0 && !stats.tickless,
+              "boot hart should stay periodic");
+
+  g_fake_hart = 1u;
+  clock_handle_timer_interrupt();
+  TEST_ASSERT(clock_hart_stats(1u, &stats) == 0 && stats.tickless,
+              "idle hart should stop its periodic tick");
+  TEST_ASSERT(g_deadlines[g_deadline_count - 1u] == g_fake_now + (64ULL * CLOCK_INTERVAL_TICKS),
+              "idle hart should only arm the idle backstop");
+  programmed = g_deadline_count;
+  clock_reprogram();
+  TEST_ASSERT(g_deadline_count == programmed, "an unchanged idle deadline should not be rearmed");
+
+  clock_request_event(g_fake_now + 5000ULL);
+  TEST_ASSERT(g_deadline_count == programmed + 1u &&
+                  g_deadlines[g_deadline_count - 1u] == g_fake_now + 5000ULL,
+              "an earlier event should pull the idle deadline in");
+  g_fake_now += 5000ULL;
+  clock_handle_timer_interrupt();
+  TEST_ASSERT(clock_hart_stats(1u, &stats) == 0 && stats.idle_interrupts == 1u &&
+                  stats.interrupts == 2u,
+              "wakeups while parked should count as idle interrupts");
+
+  /* Placing work preempts the idle loop; the kick switches and restarts slices. */
+  g_fake_hart = 0u;
+  g_ipi_mask = 0u;
+  task = task_create("tickless", test_idle_task);
+  TEST_ASSERT(task != NULL && sched_set_affinity(task, 1u << 1) == 0 && sched_add_task(task) == 0,
+              "task should queue on hart 1");
+  TEST_ASSERT(g_ipi_mask == (1u << 1), "parked hart should be kicked");
+
+  memset(&idle_frame, 0, sizeof(idle_frame));
+  idle_frame.tp = 1u;
+  g_fake_hart = 1u;
+  frame = sched_handle_yield(&idle_frame);
+  clock_reprogram();
+  TEST_ASSERT(sched_current_task() == task, "kicked hart should run the new task");
+  TEST_ASSERT(clock_hart_stats(1u, &stats) == 0 && !stats.tickless &&
+                  g_deadlines[g_deadline_count - 1u] == g_fake_now + CLOCK_INTERVAL_TICKS,
+              "hart with work should return to periodic slices");
+
+  task->state = TASK_STATE_EXITED;
+  g_fake_now += CLOCK_INTERVAL_TICKS;
+  clock_handle_timer_interrupt();
+  frame = sched_handle_timer_interrupt(frame);
+  clock_reprogram();
+  TEST_ASSERT(sched_current_task() == task_hart_root(1u) && frame == &idle_frame,
+              "hart should fall back to its idle root");
+  TEST_ASSERT(clock_hart_stats(1u, &stats) == 0 && stats.tickless,
+              "hart should park again once its queue drains");
+
+  clock_set_tickless(false);
+  g_fake_now += 5000ULL;
+  clock_handle_timer_interrupt();
+  TEST_ASSERT(clock_hart_stats(1u, &stats) == 0 && !stats.tickless,
+              "turning tickless off should restore the periodic tick");
+  g_fake_hart = 0u;
+  return 0;
+}
+
+static uint32_t g_timer_fired[16];
+static uint64_t g_timer_fired_at[16];
+static size_t g_timer_fired_count;
+
+static uint64_t jiffy_round_up(uint64_t deadline) {
+  const uint64_t jiffy = 1ULL << TIMER_JIFFY_SHIFT;
+
+  return (deadline + jiffy - 1ULL) & ~(jiffy - 1ULL);
+}
+
+static void test_timer_record(ktimer_t *timer, void *arg) {
+  uint32_t id = (uint32_t)(uintptr_t)arg;
+
+  if (g_timer_fired_count < sizeof(g_timer_fired) / sizeof(g_timer_fired[0])) {
+    g_timer_fired[g_timer_fired_count] = id;
+    g_timer_fired_at[g_timer_fired_count] = g_fake_now;
+    g_timer_fired_count++;
+  }
+  /* Timer 7 re-arms itself once, two jiffies out. */
+  if (id == 7u && g_timer_fired_count == 2u) {
+    (void)timer_add(timer, g_fake_now + (2ULL << TIMER_JIFFY_SHIFT));
+  }
+}
+
+static int test_timer_wheel(void) {
+  static const uint64_t k_jiffies[] = {3u, 100u, 5000u, 300000u, (1ULL << 24) + 1000u, 50u, 40u};
+  ktimer_t timers[7];
+  uint64_t deadlines[7];
+  uint64_t start;
+  size_t i;
+
+  test_log_reset();
+  reset_timer_stubs();
+  g_fake_hart = 0u;
+  g_fake_now = 1000003ULL;
+  clock_init();
+  start = g_fake_now;
+  g_timer_fired_count = 0u;
+
+  for (i = 0u; i < 7u; ++i) {
+    timer_init(&timers[i], test_timer_record, (void *)(uintptr_t)(i + 1u));
+    deadlines[i] = start + (k_jiffies[i] << TIMER_JIFFY_SHIFT) + 17u;
+    TEST_ASSERT(timer_add(&timers[i], deadlines[i]) == 0, "timer should arm");
+  }
+  TEST_ASSERT(g_deadlines[g_deadline_count - 1u] == jiffy_round_up(deadlines[0]),
+              "the earliest timer should pull the clock deadline in");
+  TEST_ASSERT(timer_hart_count(0u) == 7u, "all timers should be pending");
+  TEST_ASSERT(timer_cancel(&timers[5]) && !timer_cancel(&timers[5]) && !timer_pending(&timers[5]),
+              "cancel should report only the first cancellation");
+  TEST_ASSERT(timer_hart_count(0u) == 6u, "cancel should drop the timer");
+
+  g_fake_now = jiffy_round_up(deadlines[0]) - 1u;
+  clock_handle_timer_interrupt();
+  TEST_ASSERT(g_timer_fired_count == 0u, "timer should never fire early");
+  g_fake_now += 1u;
+  clock_handle_timer_interrupt();
+  TEST_ASSERT(g_timer_fired_count == 1u && g_timer_fired[0] == 1u, "first timer should fire");
+  TEST_ASSERT(timer_run(g_fake_now) == jiffy_round_up(deadlines[6]),
+              "next deadline should be the earliest pending timer");
+
+  g_fake_now = jiffy_round_up(deadlines[6]);
+  (void)timer_run(g_fake_now);
+  TEST_ASSERT(g_timer_fired_count == 2u && g_timer_fired[1] == 7u && timer_pending(&timers[6]),
+              "a callback should be able to re-arm its timer");
+  g_fake_now += 2ULL << TIMER_JIFFY_SHIFT;
+  TEST_ASSERT(timer_run(g_fake_now) == jiffy_round_up(deadlines[1]) && g_timer_fired_count == 3u &&
+                  g_timer_fired[2] == 7u,
+              "re-armed timer should fire once more");
+
+  /* Jump well past the cascaded levels; each timer fires exactly once, in order. */
+  for (i = 1u; i < 5u; ++i) {
+    g_fake_now = jiffy_round_up(deadlines[i]) - 1u;
+    (void)timer_run(g_fake_now);
+    TEST_ASSERT(g_timer_fired_count == 2u + i, "cascaded timer should not fire early");
+    g_fake_now += 1u;
+    (void)timer_run(g_fake_now);
+    TEST_ASSERT(g_timer_fired_count == 3u + i && g_timer_fired[2u + i] == i + 1u &&
+                    g_timer_fired_at[2u + i] >= deadlines[i],
+                "cascaded timer should fire at its deadline");
+  }
+
+  TEST_ASSERT(timer_hart_count(0u) == 0u && timer_run(g_fake_now) == ~0ULL,
+              "drained wheel should report no deadline");
+  return 0;
+}
+
+static int test_task_sleep(void) {
+  task_control_block_t *task;
+  struct trap_frame boot_frame;
+  struct trap_frame *frame;
+  struct trap_frame *task_frame;
+  uint64_t deadline;
+
+  test_log_reset();
+  reset_timer_stubs();
+  setup_stack_pool();
+  g_fake_hart = 0u;
+  g_fake_now = 40000ULL;
+  clock_init();
+  sched_init();
+  sched_start();
+
+  TEST_ASSERT(task_sleep_until(g_fake_now + 100000ULL) == -1, "root context should not sleep");
+
+  task = task_create("sleeper", test_idle_task);
+  TEST_ASSERT(task != NULL && sched_add_task(task) == 0, "sleeper should queue");
+  memset(&boot_frame, 0, sizeof(boot_frame));
+  frame = sched_handle_timer_interrupt(&boot_frame);
+  TEST_ASSERT(sched_current_task() == task, "sleeper should be running");
+
+  g_soft_irq_raised = 0u;
+  deadline = g_fake_now + 100000ULL;
+  TEST_ASSERT(task_sleep_until(deadline) == 0, "sleep should be accepted");
+  TEST_ASSERT(task->state == TASK_STATE_BLOCKED && timer_pending(&task->sleep_timer) &&
+                  g_soft_irq_raised == 1u,
+              "sleeping task should block, arm its timer and yield");
+
+  task_frame = frame;
+  frame = sched_handle_yield(frame);
+  TEST_ASSERT(sched_current_task() == task_boot() && frame == &boot_frame,
+              "blocked task should leave the CPU");
+
+  g_fake_now = deadline - 1u;
+  clock_handle_timer_interrupt();
+  frame = sched_handle_timer_interrupt(frame);
+  TEST_ASSERT(sched_current_task() == task_boot() && task->state == TASK_STATE_BLOCKED,
+              "blocked task should not run before its deadline");
+
+  g_fake_now = jiffy_round_up(deadline);
+  clock_handle_timer_interrupt();
+  TEST_ASSERT(task->state == TASK_STATE_RUNNABLE, "expiry should wake the task");
+  frame = sched_handle_timer_interrupt(frame);
+  TEST_ASSERT(sched_current_task() == task && frame == task_frame,
+              "woken task should resume where it blocked");
+
+  /* The timer can beat the yield; the task then just keeps running. */
+  deadline = g_fake_now + 10ULL;
+  TEST_ASSERT(task_sleep_until(deadline) == 0, "short sleep should be accepted");
+  g_fake_now = jiffy_round_up(deadline);
+  clock_handle_timer_interrupt();
+  TEST_ASSERT(task->state == TASK_STATE_RUNNING, "wake before switch-out should cancel the block");
+  frame = sched_handle_yield(frame);
+  TEST_ASSERT(sched_current_task() == task_boot(), "pending yield should still rotate");
+  return 0;
+}
+
+/* Rotates the boot hart until `task` is current; the host has no real trap to do it. */
+static struct trap_frame *switch_to(task_control_block_t *task, struct trap_frame *frame) {
+  uint32_t i;
+
+  for (i = 0u; i < TASK_MAX_TASKS && sched_current_task() != task; ++i) {
+    frame = sched_handle_timer_interrupt(frame);
+  }
+  return frame;
+}
+
+static int test_wait_queues(void) {
+  static wait_queue_t wq;
+  static semaphore_t sem;
+  static condvar_t cv;
+  spinlock_t lock;
+  task_control_block_t *first;
+  task_control_block_t *second;
+  struct trap_frame boot_frame;
+  struct trap_frame *frame;
+  uint64_t deadline;
+
+  test_log_reset();
+  reset_timer_stubs();
+  setup_stack_pool();
+  g_fake_hart = 0u;
+  g_fake_now = 40000ULL;
+  clock_init();
+  sched_init();
+  sched_start();
+  wait_queue_init(&wq);
+
+  TEST_ASSERT(!wait_prepare(&wq, WAIT_FOREVER) && wait_queue_empty(&wq),
+              "root context should not queue itself");
+
+  first = task_create("waiter-a", test_idle_task);
+  second = task_create("waiter-b", test_idle_task);
+  TEST_ASSERT(first != NULL && second != NULL && sched_add_task(first) == 0 &&
+                  sched_add_task(second) == 0,
+              "waiters should queue");
+  memset(&boot_frame, 0, sizeof(boot_frame));
+  frame = switch_to(first, &boot_frame);
+  TEST_ASSERT(sched_current_task() == first, "first waiter should run");
+
+  g_soft_irq_raised = 0u;
+  TEST_ASSERT(wait_prepare(&wq, WAIT_FOREVER), "task should queue itself");
+  TEST_ASSERT(first->state == TASK_STATE_BLOCKED && g_soft_irq_raised == 0u,
+              "prepare should block without yielding");
+  frame = sched_handle_yield(frame);
+  frame = switch_to(second, frame);
+  TEST_ASSERT(sched_current_task() == second, "blocked waiter should stay off the CPU");
+  TEST_ASSERT(wait_prepare(&wq, WAIT_FOREVER), "second task should queue behind the first");
+  frame = sched_handle_yield(frame);
+  TEST_ASSERT(sched_current_task() == task_boot(), "both waiters should be off the CPU");
+
+  TEST_ASSERT(wake_up(&wq) == 1u && first->state == TASK_STATE_RUNNABLE &&
+                  second->state == TASK_STATE_BLOCKED,
+              "wake_up should wake the oldest waiter only");
+  TEST_ASSERT(wake_up_all(&wq) == 1u && second->state == TASK_STATE_RUNNABLE &&
+                  wait_queue_empty(&wq),
+              "wake_up_all should drain the queue");
+  TEST_ASSERT(wake_up(&wq) == 0u, "waking an empty queue should do nothing");
+
+  /* A condition that turns true between prepare and yield cancels the block. */
+  frame = switch_to(first, frame);
+  wait_finish(&wq);
+  TEST_ASSERT(first->state == TASK_STATE_RUNNING, "woken waiter should run normally");
+  TEST_ASSERT(wait_prepare(&wq, WAIT_FOREVER), "waiter should queue again");
+  wait_finish(&wq);
+  TEST_ASSERT(first->state == TASK_STATE_RUNNING && wait_queue_empty(&wq),
+              "finish without a wake should undo the block and leave the queue");
+
+  deadline = g_fake_now + 100000ULL;
+  TEST_ASSERT(wait_prepare(&wq, deadline) && timer_pending(&first->sleep_timer),
+              "a deadline should arm the task timer");
+  frame = sched_handle_yield(frame);
+  g_fake_now = jiffy_round_up(deadline);
+  clock_handle_timer_interrupt();
+  TEST_ASSERT(first->state == TASK_STATE_RUNNABLE && wait_queue_empty(&wq),
+              "timeout should wake the waiter and unlink it");
+  frame = switch_to(first, frame);
+  wait_finish(&wq);
+  TEST_ASSERT(first->state == TASK_STATE_RUNNING, "timed-out waiter should resume");
+
+  sem_init(&sem, 1u);
+  TEST_ASSERT(sem_trydown(&sem) && !sem_trydown(&sem), "semaphore should count down once");
+  TEST_ASSERT(wait_prepare(&sem.waiters, WAIT_FOREVER), "sem waiter should queue");
+  frame = sched_handle_yield(frame);
+  sem_up(&sem);
+  TEST_ASSERT(first->state == TASK_STATE_RUNNABLE && sem.count == 1u,
+              "sem_up should wake a sleeper and leave the count for it");
+  frame = switch_to(first, frame);
+  wait_finish(&sem.waiters);
+  sem_down(&sem);
+  TEST_ASSERT(sem.count == 0u, "sem_down should take an available count without sleeping");
+
+  condvar_init(&cv);
+  spinlock_init(&lock, (lock_stats_t *)0);
+  spin_lock(&lock);
+  g_soft_irq_raised = 0u;
+  condvar_wait(&cv, &lock);
+  TEST_ASSERT(lock.locked != 0u && g_soft_irq_raised == 1u && wait_queue_empty(&cv.waiters),
+              "condvar_wait should yield and return holding the lock");
+  spin_unlock(&lock);
+
+  TEST_ASSERT(wait_prepare(&cv.waiters, WAIT_FOREVER), "first cv waiter should queue");
+  frame = sched_handle_yield(frame);
+  frame = switch_to(second, frame);
+  TEST_ASSERT(wait_prepare(&cv.waiters, WAIT_FOREVER), "second cv waiter should queue");
+  frame = sched_handle_yield(frame);
+  condvar_signal(&cv);
+  TEST_ASSERT(first->state == TASK_STATE_RUNNABLE && second->state == TASK_STATE_BLOCKED,
+              "signal should wake one waiter");
+  condvar_broadcast(&cv);
+  TEST_ASSERT(second->state == TASK_STATE_RUNNABLE && wait_queue_empty(&cv.waiters),
+              "broadcast should wake the rest");
+  (void)frame;
+  return 0;
+}
+
+static wait_queue_t g_race_wq;
+static task_control_block_t *g_race_waiters[3];
+static bool g_race_all_unlinked;
+
+/* Another hart's timeout for the second waiter, landing after wake_up_all woke the first. */
+static void race_fire_timeout(void) {
+  task_control_block_t *late = g_race_waiters[1];
+  size_t i;
+
+  g_race_all_unlinked = wait_queue_empty(&g_race_wq);
+  for (i = 0u; i < 3u; ++i) {
+    if (g_race_waiters[i]->wait_queue != NULL || g_race_waiters[i]->wait_next != NULL) {
+      g_race_all_unlinked = false;
+    }
+  }
+  late->sleep_timer.fn(&late->sleep_timer, late->sleep_timer.arg);
+}
+
+static int test_wake_up_all_races_timeout(void) {
+  struct trap_frame boot_frame;
+  struct trap_frame *frame;
+  uint64_t deadline;
+  size_t i;
+
+  test_log_reset();
+  reset_timer_stubs();
+  setup_stack_pool();
+  g_fake_hart = 0u;
+  g_fake_now = 40000ULL;
+  clock_init();
+  sched_init();
+  sched_start();
+  wait_queue_init(&g_race_wq);
+  memset(&boot_frame, 0, sizeof(boot_frame));
+  frame = &boot_frame;
+
+  deadline = g_fake_now + 100000ULL;
+  for (i = 0u; i < 3u; ++i) {
+    g_race_waiters[i] = task_create("racer", test_idle_task);
+    TEST_ASSERT(g_race_waiters[i] != NULL && sched_add_task(g_race_waiters[i]) == 0,
+                "racing waiter should queue");
+    frame = switch_to(g_race_waiters[i], frame);
+    TEST_ASSERT(wait_prepare(&g_race_wq, deadline), "racing waiter should block with a timeout");
+    frame = sched_handle_yield(frame);
+  }
+  TEST_ASSERT(sched_current_task() == task_boot(), "all racing waiters should be off the CPU");
+  for (i = 0u; i < 3u; ++i) {
+    /* Urgent waiters make the first wake request a yield, which runs the hook. */
+    TEST_ASSERT(sched_set_priority(g_race_waiters[i], SCHED_PRIORITY_INTERACTIVE) == 0,
+                "blocked waiter priority should change");
+  }
+
+  g_race_all_unlinked = false;
+  g_soft_irq_hook = race_fire_timeout;
+  TEST_ASSERT(wake_up_all(&g_race_wq) == 3u, "wake_up_all should report every waiter");
+  TEST_ASSERT(g_soft_irq_hook == NULL, "waking an urgent task should have run the hook");
+  TEST_ASSERT(g_race_all_unlinked,
+              "every waiter should be unlinked before the first one is woken");
+  for (i = 0u; i < 3u; ++i) {
+    TEST_ASSERT(g_race_waiters[i]->state == TASK_STATE_RUNNABLE &&
+                    g_race_waiters[i]->wait_queue == NULL,
+                "every waiter should be runnable and off the queue");
+  }
+  TEST_ASSERT(wait_queue_empty(&g_race_wq), "queue should stay empty after the race");
+  (void)frame;
+  return 0;
+}
+
+static int test_task_accounting(void) {
+  task_control_block_t *worker;
+  task_control_block_t *sleeper;
+  sched_task_stats_t stats;
+  sched_event_t events[SCHED_EVENT_RING_SIZE];
+  struct trap_frame boot_frame;
+  struct trap_frame *frame;
+  uint64_t total;
+  uint32_t count;
+
+  test_log_reset();
+  reset_timer_stubs();
+  setup_stack_pool();
+  g_fake_hart = 0u;
+  g_fake_now = 1000ULL;
+  clock_init();
+  sched_init();
+  sched_start();
+
+  worker = task_create("worker", test_idle_task);
+  sleeper = task_create("sleeper", test_idle_task);
+  TEST_ASSERT(worker != NULL && sleeper != NULL && sched_add_task(worker) == 0 &&
+                  sched_add_task(sleeper) == 0,
+              "accounting tasks should queue");
+  memset(&boot_frame, 0, sizeof(boot_frame));
+
+  /* 10 MHz default timebase: one tick is 100 ns. */
+  g_fake_now += 10ULL;
+  frame = sched_handle_timer_interrupt(&boot_frame);
+  TEST_ASSERT(sched_current_task() == worker, "worker should run first");
+  TEST_ASSERT(sched_task_stats(worker, &stats) == 0 && stats.wait_ns == 1000ULL &&
+                  stats.run_ns == 0ULL,
+              "queued time should count as wait");
+
+  g_fake_now += 30ULL;
+  TEST_ASSERT(sched_task_stats(worker, &stats) == 0 && stats.run_ns == 3000ULL,
+              "the running stint should count live");
+  frame = sched_handle_timer_interrupt(frame);
+  TEST_ASSERT(sched_current_task() == sleeper, "sleeper should run second");
+  TEST_ASSERT(sched_task_stats(worker, &stats) == 0 && stats.run_ns == 3000ULL &&
+                  stats.involuntary_switches == 1u && stats.voluntary_switches == 0u,
+              "preemption should count as an involuntary switch");
+
+  g_fake_now += 5ULL;
+  TEST_ASSERT(sched_block_current() == 0, "sleeper should block");
+  frame = sched_handle_yield(frame);
+  TEST_ASSERT(sched_task_stats(sleeper, &stats) == 0 && stats.voluntary_switches == 1u &&
+                  stats.run_ns == 500ULL && stats.state == TASK_STATE_BLOCKED,
+              "blocking should count as a voluntary switch");
+
+  g_fake_now += 20ULL;
+  TEST_ASSERT(sched_wake(sleeper) == 0, "sleeper should wake");
+  g_fake_now += 7ULL;
+  while (sched_current_task() != sleeper) {
+    frame = sched_handle_timer_interrupt(frame);
+  }
+  TEST_ASSERT(sched_task_stats(sleeper, &stats) == 0 && stats.wakeups == 1u &&
+                  stats.wakeup_latency_max_ns == 700ULL,
+              "wakeup-to-run latency should be recorded");
+
+  count = sched_events_read(0u, events, SCHED_EVENT_RING_SIZE, &total);
+  TEST_ASSERT(count == total && count >= 4u, "events should be kept in the ring");
+  TEST_ASSERT(events[0].type == SCHED_EVENT_SWITCH && events[0].task == TASK_BOOT_ID &&
+                  events[0].other == worker->id,
+              "first event should be the switch to the worker");
+  TEST_ASSERT(events[2].type == SCHED_EVENT_SWITCH && events[2].task == sleeper->id &&
+                  events[2].state == TASK_STATE_BLOCKED,
+              "blocking switch should record why the task left");
+  TEST_ASSERT(events[3].type == SCHED_EVENT_WAKE && events[3].task == sleeper->id,
+              "wake should be recorded");
+  TEST_ASSERT(sched_events_read(0u, events, 1u, &total) == 1u &&
+                  events[0].type == SCHED_EVENT_SWITCH && events[0].other == sleeper->id,
+              "a short read should return the newest events");
+  return 0;
+}
+
+static int test_tick_fast_path_decision(void) {
+  task_control_block_t *task;
+  task_control_block_t *pinned;
+  struct trap_frame boot_frame;
+  struct trap_frame *frame;
+
+  test_log_reset();
+  reset_timer_stubs();
+  setup_stack_pool();
+  g_fake_hart = 0u;
+  clock_init();
+  sched_init();
+  TEST_ASSERT(!sched_tick_needs_switch(), "a stopped scheduler should never switch");
+  sched_start();
+  TEST_ASSERT(!sched_tick_needs_switch(), "the boot task alone should stay on the fast path");
+
+  task = task_create("fast", test_idle_task);
+  TEST_ASSERT(task != NULL && sched_add_task(task) == 0, "task should queue");
+  TEST_ASSERT(sched_tick_needs_switch(), "a queued task at the same level should get a turn");
+
+  memset(&boot_frame, 0, sizeof(boot_frame));
+  frame = sched_handle_timer_interrupt(&boot_frame);
+  TEST_ASSERT(sched_current_task() == task, "task should run");
+  TEST_ASSERT(sched_tick_needs_switch(), "the requeued boot task should get its turn back");
+  TEST_ASSERT(sched_set_priority(task, SCHED_PRIORITY_INTERACTIVE) == 0 &&
+                  !sched_tick_needs_switch(),
+              "less urgent queued work should not force a switch");
+  TEST_ASSERT(sched_block_current() == 0 && sched_tick_needs_switch(),
+              "a blocked current task should take the full path");
+  frame = sched_handle_yield(frame);
+
+  g_fake_hart = 1u;
+  sched_hart_online();
+  TEST_ASSERT(!sched_tick_needs_switch(), "an idle hart with nothing to steal should stay fast");
+  g_fake_hart = 0u;
+  pinned = task_create("pinned", test_idle_task);
+  TEST_ASSERT(pinned != NULL && sched_set_affinity(pinned, 1u << 0) == 0 &&
+                  sched_add_task(pinned) == 0,
+              "pinned task should queue on hart 0");
+  g_fake_hart = 1u;
+  TEST_ASSERT(sched_tick_needs_switch(), "an idle hart should go steal queued work");
+  sched_set_stealing(false);
+  TEST_ASSERT(!sched_tick_needs_switch(), "without stealing the idle hart should stay fast");
+  sched_set_stealing(true);
+  g_fake_hart = 0u;
+  (void)frame;
+  return 0;
+}
+
+static unsigned int g_klog_notifies;
+
+static void test_klog_notify(void) { g_klog_notifies++; }
+
+static int test_klog_ring(void) {
+  static klog_record_t records[8];
+  klog_hart_stats_t stats;
+  klog_record_t *record;
+  uint32_t count;
+  uint32_t i;
+
+  test_log_reset();
+  g_fake_hart = 0u;
+  g_fake_now = 1000ULL;
+  klog(KLOG_INFO, "synchronous before klogd");
+  TEST_ASSERT(strcmp(g_log, "synchronous before klogd\n") == 0,
+              "records should reach the console directly until klogd starts");
+
+  test_log_reset();
+  klog_set_deferred(true, test_klog_notify);
+  klog_arm_notify();
+  g_fake_hart = 1u;
+  g_fake_now = 2000ULL;
+  record = klog_begin(KLOG_WARN);
+  g_fake_hart = 0u;
+  g_fake_now = 3000ULL;
+  /* A trap on hart 0 logs while hart 1's record is still open. */
+  klog(KLOG_INFO, "hart0 second");
+  TEST_ASSERT(g_log[0] == '\0' && klog_pending(), "deferred records should wait for a flush");
+  TEST_ASSERT(g_klog_notifies == 1u, "only the first record after arming should notify");
+  klog(KLOG_INFO, "hart0 third");
+  TEST_ASSERT(g_klog_notifies == 1u, "notify should not repeat until re-armed");
+
+  klog_flush();
+  TEST_ASSERT(g_log[0] == '\0', "an open record should hold back the merge");
+  klog_puts(record, "hart1 first ");
+  klog_put_u64(record, 42u);
+  g_fake_hart = 1u;
+  klog_end(record);
+  klog_flush();
+  TEST_ASSERT(strcmp(g_log, "hart1 first 42\nhart0 second\nhart0 third\n") == 0,
+              "flush should merge harts in timestamp order");
+  TEST_ASSERT(!klog_pending(), "flush should drain every ring");
+
+  /* Lap hart 2's ring before flushing: the oldest records are counted as dropped. */
+  test_log_reset();
+  g_fake_hart = 2u;
+  for (i = 0u; i < KLOG_RING_RECORDS + 5u; ++i) {
+    g_fake_now = 10000ULL + i;
+    record = klog_begin(KLOG_DEBUG);
+    klog_puts(record, "lap ");
+    klog_put_u64(record, i);
+    klog_end(record);
+  }
+  klog_flush();
+  TEST_ASSERT(klog_hart_stats(2u, &stats) == 0 && stats.dropped == 5u &&
+                  stats.records == KLOG_RING_RECORDS + 5u,
+              "overwritten records should be counted as dropped");
+  TEST_ASSERT(strncmp(g_log, "lap 5\n", 6u) == 0 && strstr(g_log, "lap 4\n") == NULL,
+              "flush should resume at the oldest surviving record");
+
+  count = klog_read(records, 3u);
+  TEST_ASSERT(count == 3u && records[0].hart == 2u && records[0].len == 6u &&
+                  strncmp(records[0].text, "lap 66", 6u) == 0 &&
+                  strncmp(records[2].text, "lap 68", 6u) == 0,
+              "dmesg read should return the newest records oldest first");
+  count = klog_read(records, 8u);
+  TEST_ASSERT(count == 8u && records[7].time_ns > records[0].time_ns,
+              "dmesg read should stay in time order");
+
+  klog_set_deferred(false, (void (*)(void))0);
+  g_fake_hart = 0u;
+  test_log_reset();
+  return 0;
+}
+
+static void trace_capture(const char *s) {
+  test_log_append(s);
+}
+
+/* Decodes one "TRACE: ev" line back into the raw event, as the host decoder does. */
+static int trace_parse_event(const char *line, trace_event_t *out) {
+  uint8_t *bytes = (uint8_t *)out;
+  uint32_t i;
+
+  if (strncmp(line, "TRACE: ev ", 10u) != 0) {
+    return -1;
+  }
+  line += 10u;
+  for (i = 0u; i < TRACE_EVENT_SIZE; ++i) {
+    unsigned int value;
+
+    if (sscanf(line + i * 2u, "%2x", &value) != 1) {
+      return -1;
+    }
+    bytes[i] = (uint8_t)value;
+  }
+  return line[TRACE_EVENT_SIZE * 2u] == '\n' ? 0 : -1;
+}
+
+static int test_trace_ring(void) {
+  trace_event_t event;
+  const char *line;
+  void *page;
+  uint64_t first_ns;
+  uint32_t i;
+
+  trace_clear();
+  g_fake_hart = 0u;
+  g_fake_now = 100ULL;
+  trace_event(TRACE_SHELL_EXEC_BEGIN, 0u, 0u, 0u);
+  TEST_ASSERT(trace_event_count() == 0u, "disabled tracepoints should record nothing");
+
+  trace_set_enabled(true);
+  g_fake_hart = 2u;
+  first_ns = clock_now_ns();
+  trace_event(TRACE_SHELL_EXEC_BEGIN, 0u, 0u, 0u);
+  page = page_alloc();
+  TEST_ASSERT(page != NULL, "trace test needs a page");
+  TEST_ASSERT(page_free(page), "trace test page should free");
+  g_fake_now = 200ULL;
+  trace_event(TRACE_SHELL_EXEC_END, (uint64_t)(int64_t)-1, 0u, 0u);
+  TEST_ASSERT(trace_event_count() == 4u && trace_lost_count() == 0u,
+              "enabled tracepoints and the page allocator hook should record");
+
+  test_log_reset();
+  trace_dump(trace_capture);
+  TEST_ASSERT(strncmp(g_log, "TRACE: begin version=1 harts=4 event_size=40\n", 45u) == 0,
+              "dump should open with the format header");
+  TEST_ASSERT(strstr(g_log, "TRACE: name 1 i sched_switch prev,next,prev_state\n") != NULL &&
+                  strstr(g_log, "TRACE: name 5 E trap -\n") != NULL,
+              "dump should carry the event name table");
+  TEST_ASSERT(strstr(g_log, "TRACE: end events=4 lost=0\n") != NULL,
+              "dump should close with the event count");
+  TEST_ASSERT(trace_enabled(), "tracing should resume after a dump");
+
+  line = strstr(g_log, "TRACE: ev ");
+  TEST_ASSERT(line != NULL && trace_parse_event(line, &event) == 0,
+              "events should be dumped as raw hex");
+  TEST_ASSERT(event.id == TRACE_SHELL_EXEC_BEGIN && event.hart == 2u &&
+                  event.time_ns == first_ns,
+              "first event should decode to the shell begin");
+  line = strstr(line + 1, "TRACE: ev ");
+  TEST_ASSERT(line != NULL && trace_parse_event(line, &event) == 0 &&
+                  event.id == TRACE_PAGE_ALLOC && event.args[0] == (uint64_t)(uintptr_t)page &&
+                  event.args[1] == 0u,
+              "page allocations should be traced with their address and order");
+
+  /* Lap hart 3's ring: the oldest events go, plus one slot kept free for a racing writer. */
+  trace_clear();
+  g_fake_hart = 3u;
+  for (i = 0u; i < TRACE_RING_EVENTS + 10u; ++i) {
+    trace_event(TRACE_WM_RENDER_BEGIN, i, 0u, 0u);
+  }
+  TEST_ASSERT(trace_event_count() == TRACE_RING_EVENTS - 1u && trace_lost_count() == 11u,
+              "a lapped ring should count the overwritten events as lost");
+
+  trace_set_enabled(false);
+  trace_clear();
+  g_fake_hart = 0u;
+  test_log_reset();
+  return 0;
+}
+
+static int test_profile_samples(void) {
+  profile_hart_stats_t stats;
+  const task_control_block_t *task;
+  char expected[96];
+  uint32_t i;
+
+  g_fake_hart = 1u;
+  profile_tick(0x80200000ULL, 0x80200100ULL);
+  TEST_ASSERT(profile_hart_stats(1u, &stats) == 0 && stats.samples == 0u,
+              "a stopped profiler should record nothing");
+
+  profile_start();
+  task = sched_current_task();
+  TEST_ASSERT(task != NULL, "profile test needs a current task");
+  profile_tick(0x80201000ULL, 0x80200010ULL);
+  profile_tick(0x80201000ULL, 0x80200010ULL);
+  profile_tick(0x80201000ULL, 0x80200010ULL);
+  profile_tick(0x80202abcULL, 0x80200010ULL);
+  profile_stop();
+  profile_tick(0x80203000ULL, 0x80200010ULL);
+  TEST_ASSERT(profile_hart_stats(1u, &stats) == 0 && stats.samples == 4u && stats.dropped == 0u,
+              "ticks should be sampled only between start and stop");
+
+  test_log_reset();
+  profile_dump(test_log_append);
+  TEST_ASSERT(strncmp(g_log, "PROFILE: begin harts=4 per_hart=2048\n", 37u) == 0,
+              "dump should open with the header");
+  TEST_ASSERT(strstr(g_log, "PROFILE: task 0 root\n") != NULL, "dump should name root contexts");
+  snprintf(expected, sizeof(expected), "PROFILE: s 1 %u 0x80201000 0x80200010 3\n",
+           (unsigned int)task->id);
+  TEST_ASSERT(strstr(g_log, expected) != NULL, "identical samples should share one line");
+  snprintf(expected, sizeof(expected), "PROFILE: s 1 %u 0x80202abc 0x80200010 1\n",
+           (unsigned int)task->id);
+  TEST_ASSERT(strstr(g_log, expected) != NULL, "a new pc should start a new line");
+  TEST_ASSERT(strstr(g_log, "PROFILE: end samples=4 dropped=0\n") != NULL,
+              "dump should close with the totals");
+
+  /* A full buffer keeps its first window and counts the rest. */
+  profile_start();
+  for (i = 0u; i < PROFILE_SAMPLES_PER_HART + 9u; ++i) {
+    profile_tick(0x80200000ULL + i * 4u, 0u);
+  }
+  profile_stop();
+  TEST_ASSERT(profile_hart_stats(1u, &stats) == 0 && stats.samples == PROFILE_SAMPLES_PER_HART &&
+                  stats.dropped == 9u,
+              "samples past a full buffer should be dropped and counted");
+  profile_start();
+  profile_stop();
+  TEST_ASSERT(profile_hart_stats(1u, &stats) == 0 && stats.samples == 0u && stats.dropped == 0u,
+              "start should discard the previous run");
+
+  g_fake_hart = 0u;
+  test_log_reset();
   return 0;
 }
 
@@ -211,9 +1400,57 @@ int main(void) {
   if (test_clock_behavior() != 0) {
     return 1;
   }
+  if (test_clock_ns_conversion() != 0) {
+    return 1;
+  }
   if (test_scheduler_round_robin_timer_flow() != 0) {
     return 1;
   }
+  if (test_yield_exit_and_reap() != 0) {
+    return 1;
+  }
+  if (test_priority_preemption() != 0) {
+    return 1;
+  }
+  if (test_per_hart_queues() != 0) {
+    return 1;
+  }
+  if (test_work_stealing() != 0) {
+    return 1;
+  }
+  if (test_switched_out_task_not_stolen_until_off_stack() != 0) {
+    return 1;
+  }
+  if (test_tickless_idle() != 0) {
+    return 1;
+  }
+  if (test_timer_wheel() != 0) {
+    return 1;
+  }
+  if (test_task_sleep() != 0) {
+    return 1;
+  }
+  if (test_wait_queues() != 0) {
+    return 1;
+  }
+  if (test_wake_up_all_races_timeout() != 0) {
+    return 1;
+  }
+  if (test_task_accounting() != 0) {
+    return 1;
+  }
+  if (test_tick_fast_path_decision() != 0) {
+    return 1;
+  }
+  if (test_klog_ring() != 0) {
+    return 1;
+  }
+  if (test_trace_ring() != 0) {
+    return 1;
+  }
+  if (test_profile_samples() != 0) {
+    return 1;
+  }
 
   printf("scheduler/timer integration tests passed\n");
   return 0;
@@ -0,0 +1,128 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "page_alloc.h"
+#include "page_cache.h"
+#include "slab.h"
+
+#define TEST_ASSERT(cond, msg)                          \
+  do {                                                  \
+    if (!(cond)) {                                      \
+      fprintf(stderr, "FAIL: %s\n", (msg));            \
+      return 1;                                         \
+    }                                                   \
+  } while (0)
+
+typedef struct test_object {
+  uint64_t id;
+  uint8_t payload[88];
+} test_object_t;
+
+static uintptr_t align_up(uintptr_t addr) {
+  return (addr + (PAGE_ALLOC_PAGE_SIZE - 1u)) &
+         ~((uintptr_t)PAGE_ALLOC_PAGE_SIZE - 1u);
+}
+
+static void setup_pool(uint8_t *region, size_t region_size, size_t pages) {
+  uintptr_t start = align_up((uintptr_t)region);
+
+  (void)region_size;
+  page_alloc_init(start, start + (pages * (uintptr_t)PAGE_ALLOC_PAGE_SIZE));
+  page_cache_init();
+  kmalloc_init();
+}
+
+static int test_typed_cache_alignment_and_reuse(void) {
+  static uint8_t region[33u * PAGE_ALLOC_PAGE_SIZE];
+  slab_cache_t cache;
+  test_object_t *objects[64];
+  test_object_t *reused;
+  uint32_t i;
+
+  setup_pool(region, sizeof(region), 32u);
+  TEST_ASSERT(slab_cache_init(&cache, "test-object", sizeof(test_object_t)),
+              "typed cache init should succeed");
+  TEST_ASSERT(cache.stride == 128u, "96-byte objects should use a 128-byte stride");
+  TEST_ASSERT(!slab_cache_init(&cache, "too-big", SLAB_MAX_OBJECT_SIZE + 1u) &&
+                  cache.stride == 128u,
+              "oversized typed caches must be rejected without touching the cache");
+
+  for (i = 0u; i < 64u; ++i) {
+    objects[i] = (test_object_t *)slab_alloc(&cache);
+    TEST_ASSERT(objects[i] != 0, "typed allocation should succeed");
+    TEST_ASSERT(((uintptr_t)objects[i] % SLAB_CACHE_LINE_SIZE) == 0u,
+                "objects must be cache-line aligned");
+    objects[i]->id = i;
+  }
+
+  TEST_ASSERT(cache.slab_count == 3u, "64 objects at 31 per slab should need three slabs");
+  TEST_ASSERT(cache.active_objects == 64u, "active object count mismatch");
+  for (i = 0u; i < 64u; ++i) {
+    TEST_ASSERT(objects[i]->id == i, "objects must not overlap");
+  }
+
+  TEST_ASSERT(slab_free(&cache, objects[10]), "typed free should succeed");
+  TEST_ASSERT(!slab_free(&cache, objects[10]), "double free must fail");
+  TEST_ASSERT(cache.lock.locked == 0u, "a rejected free must release the cache lock");
+  TEST_ASSERT(!slab_free(&cache, (uint8_t *)objects[11] + 8u), "interior pointers must fail");
+  reused = (test_object_t *)slab_alloc(&cache);
+  TEST_ASSERT(reused == objects[10], "freed slot should be reused first");
+
+  for (i = 0u; i < 64u; ++i) {
+    TEST_ASSERT(slab_free(&cache, objects[i]), "releasing every object should succeed");
+  }
+  TEST_ASSERT(cache.active_objects == 0u, "cache should have no active objects");
+  TEST_ASSERT(cache.slab_count == 1u, "only one empty slab should be retained");
+  slab_cache_shrink(&cache);
+  TEST_ASSERT(cache.slab_count == 0u, "shrink should release the retained slab");
+  TEST_ASSERT(cache.lock.locked == 0u, "cache lock should be free after alloc/free/shrink");
+  return 0;
+}
+
+static int test_kmalloc_size_classes(void) {
+  static uint8_t region[65u * PAGE_ALLOC_PAGE_SIZE];
+  uint8_t *small;
+  uint8_t *medium;
+  uint8_t *large;
+  size_t i;
+
+  setup_pool(region, sizeof(region), 64u);
+  TEST_ASSERT(kmalloc(0u) == 0, "zero-size kmalloc should fail");
+
+  small = (uint8_t *)kmalloc(10u);
+  medium = (uint8_t *)kzalloc(300u);
+  large = (uint8_t *)kmalloc(3u * PAGE_ALLOC_PAGE_SIZE);
+  TEST_ASSERT(small != 0 && medium != 0 && large != 0, "kmalloc allocations should succeed");
+  TEST_ASSERT(((uintptr_t)small % 16u) == 0u, "small objects should be 16-byte aligned");
+  TEST_ASSERT(((uintptr_t)medium % SLAB_CACHE_LINE_SIZE) == 0u,
+              "medium objects should be cache-line aligned");
+  TEST_ASSERT(((uintptr_t)large % PAGE_ALLOC_PAGE_SIZE) == 0u,
+              "large allocations should be page aligned");
+  for (i = 0u; i < 300u; ++i) {
+    TEST_ASSERT(medium[i] == 0u, "kzalloc must zero the object");
+  }
+
+  TEST_ASSERT(kmalloc_cache(0u)->active_objects == 1u, "10 bytes should use kmalloc-16");
+  TEST_ASSERT(kmalloc_cache(5u)->active_objects == 1u, "300 bytes should use kmalloc-512");
+  TEST_ASSERT(kmalloc_cache_count() == 8u, "expected eight kmalloc size classes");
+
+  TEST_ASSERT(kfree(small), "kfree of small object should succeed");
+  TEST_ASSERT(kfree(medium), "kfree of medium object should succeed");
+  TEST_ASSERT(kfree(large), "kfree of large allocation should succeed");
+  TEST_ASSERT(!kfree(large), "double kfree of large allocation must fail");
+  TEST_ASSERT(!kfree(0), "kfree(NULL) must fail");
+  TEST_ASSERT(kmalloc_cache(0u)->active_objects == 0u, "kmalloc-16 should be empty again");
+  return 0;
+}
+
+int slab_tests_run(void) {
+  if (test_typed_cache_alignment_and_reuse() != 0) {
+    return 1;
+  }
+  if (test_kmalloc_size_classes() != 0) {
+    return 1;
+  }
+
+  printf("slab allocator unit tests passed\n");
+  return 0;
+}
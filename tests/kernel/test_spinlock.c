@@ -0,0 +1,245 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "spinlock.h"
+
+#define TEST_ASSERT(cond, msg)                          \
+  do {                                                  \
+    if (!(cond)) {                                      \
+      fprintf(stderr, "FAIL: %s\n", (msg));            \
+      return 1;                                         \
+    }                                                   \
+  } while (0)
+
+enum {
+  STRESS_THREADS = 4,
+  STRESS_ITERATIONS = 20000,
+  STRESS_ITERATIONS_UNIPROCESSOR = 500,
+};
+
+static unsigned int g_irq_saves;
+static unsigned int g_irq_restores;
+static uint64_t g_fake_clock;
+
+/* The host has no sstatus; record that the irqsave variants bracket the lock. */
+uint64_t riscv_irq_save(void) {
+  g_irq_saves++;
+  return 1u;
+}
+
+void riscv_irq_restore(uint64_t state) {
+  if (state != 0u) {
+    g_irq_restores++;
+  }
+}
+
+static uint64_t fake_clock(void) { return g_fake_clock; }
+
+static int test_spinlock_basics(void) {
+  static lock_stats_t stats;
+  spinlock_t lock;
+  uint64_t irq_state;
+
+  lock_stats_register(&stats, "test-spin");
+  spinlock_init(&lock, &stats);
+
+  spin_lock(&lock);
+  TEST_ASSERT(!spin_trylock(&lock), "trylock should fail while held");
+  spin_unlock(&lock);
+  TEST_ASSERT(spin_trylock(&lock), "trylock should succeed once released");
+  spin_unlock(&lock);
+
+  g_irq_saves = 0u;
+  g_irq_restores = 0u;
+  irq_state = spin_lock_irqsave(&lock);
+  TEST_ASSERT(g_irq_saves == 1u && g_irq_restores == 0u, "irqsave should mask first");
+  spin_unlock_irqrestore(&lock, irq_state);
+  TEST_ASSERT(g_irq_restores == 1u, "irqrestore should unmask after release");
+
+  TEST_ASSERT(stats.acquisitions == 3u && stats.contended == 0u,
+              "uncontended acquisitions should be counted");
+  return 0;
+}
+
+static int test_ticket_lock_basics(void) {
+  static lock_stats_t stats;
+  ticket_lock_t lock;
+  uint64_t irq_state;
+
+  lock_stats_register(&stats, "test-ticket");
+  ticket_lock_init(&lock, &stats);
+
+  ticket_lock(&lock);
+  TEST_ASSERT(!ticket_trylock(&lock), "ticket trylock should fail while held");
+  TEST_ASSERT(lock.next == 1u, "failed trylock should not take a ticket");
+  ticket_unlock(&lock);
+  TEST_ASSERT(ticket_trylock(&lock), "ticket trylock should succeed once released");
+  ticket_unlock(&lock);
+
+  irq_state = ticket_lock_irqsave(&lock);
+  ticket_unlock_irqrestore(&lock, irq_state);
+  TEST_ASSERT(lock.next == 3u && lock.serving == 3u, "tickets should be served in order");
+  TEST_ASSERT(stats.acquisitions == 3u, "ticket acquisitions should be counted");
+  return 0;
+}
+
+static int test_mcs_lock_basics(void) {
+  mcs_lock_t lock;
+  mcs_node_t first;
+  mcs_node_t second;
+  uint64_t irq_state;
+
+  mcs_lock_init(&lock, (lock_stats_t *)0);
+
+  mcs_lock(&lock, &first);
+  TEST_ASSERT(lock.tail == &first, "holder should be the queue tail");
+  TEST_ASSERT(!mcs_trylock(&lock, &second), "mcs trylock should fail while held");
+  mcs_unlock(&lock, &first);
+  TEST_ASSERT(lock.tail == (mcs_node_t *)0, "release without waiters should empty the queue");
+
+  TEST_ASSERT(mcs_trylock(&lock, &second), "mcs trylock should succeed once released");
+  mcs_unlock(&lock, &second);
+
+  irq_state = mcs_lock_irqsave(&lock, &first);
+  mcs_unlock_irqrestore(&lock, &first, irq_state);
+  TEST_ASSERT(lock.tail == (mcs_node_t *)0, "irqsave variant should release the queue");
+  return 0;
+}
+
+static int test_hold_time_and_registry(void) {
+  static lock_stats_t stats;
+  spinlock_t lock;
+  const lock_stats_t *cursor;
+  unsigned int listed = 0u;
+
+  lock_stats_register(&stats, "test-hold");
+  lock_stats_register(&stats, "test-hold");
+  spinlock_init(&lock, &stats);
+  lock_stats_set_clock(fake_clock);
+
+  g_fake_clock = 100u;
+  spin_lock(&lock);
+  g_fake_clock = 130u;
+  spin_unlock(&lock);
+  g_fake_clock = 200u;
+  spin_lock(&lock);
+  g_fake_clock = 210u;
+  spin_unlock(&lock);
+  lock_stats_set_clock((lock_clock_fn_t)0);
+
+  TEST_ASSERT(stats.hold_ns == 40u && stats.hold_max_ns == 30u,
+              "hold time should sum and track the maximum");
+
+  for (cursor = lock_stats_first(); cursor != (const lock_stats_t *)0; cursor = cursor->next) {
+    if (cursor == &stats) {
+      listed++;
+    }
+  }
+  TEST_ASSERT(listed == 1u, "registering twice should not duplicate the entry");
+  return 0;
+}
+
+typedef struct stress_state {
+  spinlock_t spin;
+  ticket_lock_t ticket;
+  mcs_lock_t mcs;
+  uint64_t spin_counter;
+  uint64_t ticket_counter;
+  uint64_t mcs_counter;
+} stress_state_t;
+
+static stress_state_t g_stress;
+static int g_stress_iterations;
+
+static void *stress_worker(void *arg) {
+  int i;
+
+  (void)arg;
+  for (i = 0; i < g_stress_iterations; ++i) {
+    mcs_node_t node;
+
+    spin_lock(&g_stress.spin);
+    g_stress.spin_counter++;
+    spin_unlock(&g_stress.spin);
+
+    ticket_lock(&g_stress.ticket);
+    g_stress.ticket_counter++;
+    ticket_unlock(&g_stress.ticket);
+
+    mcs_lock(&g_stress.mcs, &node);
+    g_stress.mcs_counter++;
+    mcs_unlock(&g_stress.mcs, &node);
+  }
+
+  return NULL;
+}
+
+static int test_locks_under_contention(void) {
+  static lock_stats_t spin_stats;
+  static lock_stats_t ticket_stats;
+  static lock_stats_t mcs_stats;
+  pthread_t threads[STRESS_THREADS];
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  int thread_count = STRESS_THREADS;
+  uint64_t expected;
+  int i;
+
+  /*
+   * On one CPU a waiter burns its whole timeslice before the holder runs again, and the
+   * ticket lock hands off in FIFO order, so keep the uniprocessor run short.
+   */
+  if (cpus > 0 && cpus < thread_count) {
+    thread_count = cpus < 2 ? 2 : (int)cpus;
+  }
+  g_stress_iterations = cpus > 1 ? STRESS_ITERATIONS : STRESS_ITERATIONS_UNIPROCESSOR;
+  expected = (uint64_t)thread_count * (uint64_t)g_stress_iterations;
+
+  lock_stats_register(&spin_stats, "stress-spin");
+  lock_stats_register(&ticket_stats, "stress-ticket");
+  lock_stats_register(&mcs_stats, "stress-mcs");
+  spinlock_init(&g_stress.spin, &spin_stats);
+  ticket_lock_init(&g_stress.ticket, &ticket_stats);
+  mcs_lock_init(&g_stress.mcs, &mcs_stats);
+
+  for (i = 0; i < thread_count; ++i) {
+    TEST_ASSERT(pthread_create(&threads[i], NULL, stress_worker, NULL) == 0,
+                "stress thread should start");
+  }
+  for (i = 0; i < thread_count; ++i) {
+    TEST_ASSERT(pthread_join(threads[i], NULL) == 0, "stress thread should finish");
+  }
+
+  TEST_ASSERT(g_stress.spin_counter == expected, "spinlock should serialize increments");
+  TEST_ASSERT(g_stress.ticket_counter == expected, "ticket lock should serialize increments");
+  TEST_ASSERT(g_stress.mcs_counter == expected, "mcs lock should serialize increments");
+  TEST_ASSERT(spin_stats.acquisitions == expected && ticket_stats.acquisitions == expected &&
+                  mcs_stats.acquisitions == expected,
+              "every acquisition should be counted");
+  TEST_ASSERT(g_stress.mcs.tail == (mcs_node_t *)0, "mcs queue should drain");
+  return 0;
+}
+
+int spinlock_tests_run(void) {
+  if (test_spinlock_basics() != 0) {
+    return 1;
+  }
+  if (test_ticket_lock_basics() != 0) {
+    return 1;
+  }
+  if (test_mcs_lock_basics() != 0) {
+    return 1;
+  }
+  if (test_hold_time_and_registry() != 0) {
+    return 1;
+  }
+  if (test_locks_under_contention() != 0) {
+    return 1;
+  }
+
+  printf("lock primitive unit tests passed\n");
+  return 0;
+}
@@ -0,0 +1,177 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "mmu.h"
+#include "page_alloc.h"
+#include "page_zero.h"
+#include "vm.h"
+
+#define TEST_ASSERT(cond, msg)                          \
+  do {                                                  \
+    if (!(cond)) {                                      \
+      fprintf(stderr, "FAIL: %s\n", (msg));            \
+      return 1;                                         \
+    }                                                   \
+  } while (0)
+
+static unsigned int g_tlb_flushes;
+
+void mmu_flush_tlb(void) { g_tlb_flushes++; }
+
+static uintptr_t align_up(uintptr_t addr) {
+  return (addr + (PAGE_ALLOC_PAGE_SIZE - 1u)) &
+         ~((uintptr_t)PAGE_ALLOC_PAGE_SIZE - 1u);
+}
+
+/* Leaf physical addresses are never dereferenced, so only table pages need real memory. */
+static void setup_table_pool(void) {
+  static uint8_t region[33u * PAGE_ALLOC_PAGE_SIZE];
+  uintptr_t start = align_up((uintptr_t)&region[0]);
+
+  page_alloc_init(start, start + (32u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE));
+  page_zero_init(0u);
+}
+
+static int test_largest_leaf_selection(void) {
+  vm_space_t space;
+  uintptr_t pa = 0u;
+  unsigned int level = VM_LEVELS;
+
+  setup_table_pool();
+  TEST_ASSERT(vm_space_init(&space) == 0, "space init should allocate a root table");
+  TEST_ASSERT(vm_map(&space, 0x801ff000u, 0x801ff000u, 0x100001000ull - 0x801ff000u,
+                     VM_PTE_R | VM_PTE_W, VM_LEVEL_1G) == 0,
+              "identity map across 4k/2m/1g boundaries should succeed");
+  TEST_ASSERT(space.leaf_count[VM_LEVEL_4K] == 2u, "unaligned edges should use 4 KiB pages");
+  TEST_ASSERT(space.leaf_count[VM_LEVEL_2M] == 511u,
+              "2 MiB aligned middle should use megapages");
+  TEST_ASSERT(space.leaf_count[VM_LEVEL_1G] == 1u, "1 GiB aligned span should use a gigapage");
+  TEST_ASSERT(space.table_pages == 5u, "only tables on the 4 KiB edges should be allocated");
+
+  TEST_ASSERT(vm_translate(&space, 0x80200123u, &pa, &level) && pa == 0x80200123u &&
+                  level == VM_LEVEL_2M,
+              "megapage translation should keep the offset");
+  TEST_ASSERT(vm_translate(&space, 0xc1234567u, &pa, &level) && pa == 0xc1234567u &&
+                  level == VM_LEVEL_1G,
+              "gigapage translation should keep the offset");
+  TEST_ASSERT(vm_translate(&space, 0x100000ff8ull, &pa, &level) && level == VM_LEVEL_4K,
+              "tail page should translate as 4 KiB");
+  TEST_ASSERT(!vm_translate(&space, 0x801fe000u, &pa, &level),
+              "addresses below the range should not translate");
+  return 0;
+}
+
+static int test_alignment_limits_leaf_size(void) {
+  vm_space_t space;
+  uintptr_t pa = 0u;
+  unsigned int level = VM_LEVELS;
+
+  setup_table_pool();
+  TEST_ASSERT(vm_space_init(&space) == 0, "space init should succeed");
+  TEST_ASSERT(vm_map(&space, 0x40000000u, 0x80001000u, 0x200000u, VM_PTE_R, VM_LEVEL_1G) == 0,
+              "mapping with a misaligned physical base should succeed");
+  TEST_ASSERT(space.leaf_count[VM_LEVEL_4K] == 512u && space.leaf_count[VM_LEVEL_2M] == 0u,
+              "misaligned physical base should fall back to 4 KiB pages");
+
+  TEST_ASSERT(vm_map(&space, 0x2000000000ull, 0x80200000u, 0x400000u, VM_PTE_R,
+                     VM_LEVEL_4K) == 0,
+              "max_level should cap the leaf size");
+  TEST_ASSERT(space.leaf_count[VM_LEVEL_4K] == 1536u && space.leaf_count[VM_LEVEL_2M] == 0u,
+              "capped mapping should only add 4 KiB leaves");
+  TEST_ASSERT(vm_translate(&space, 0x2000201234ull, &pa, &level) && pa == 0x80401234u &&
+                  level == VM_LEVEL_4K,
+              "non-identity mapping should translate");
+  return 0;
+}
+
+static int test_overlap_and_invalid_requests(void) {
+  vm_space_t space;
+
+  setup_table_pool();
+  TEST_ASSERT(vm_space_init(&space) == 0, "space init should succeed");
+  TEST_ASSERT(vm_map(&space, 0x80000000u, 0x80000000u, 0x40000000u, VM_PTE_R | VM_PTE_X,
+                     VM_LEVEL_1G) == 0,
+              "gigapage map should succeed");
+  TEST_ASSERT(vm_map(&space, 0x80001000u, 0x1000u, 0x1000u, VM_PTE_R, VM_LEVEL_4K) != 0,
+              "mapping inside a gigapage must fail");
+  TEST_ASSERT(vm_map(&space, 0x80000000u, 0x80000000u, 0x1000u, VM_PTE_R, VM_LEVEL_4K) != 0,
+              "remapping a mapped page must fail");
+  TEST_ASSERT(vm_map(&space, 0x1000u, 0x1000u, 0x1000u, 0u, VM_LEVEL_4K) != 0,
+              "mapping without permissions must fail");
+  TEST_ASSERT(vm_map(&space, 0x1080u, 0x1000u, 0x1000u, VM_PTE_R, VM_LEVEL_4K) != 0,
+              "misaligned virtual address must fail");
+  TEST_ASSERT(vm_map(&space, VM_VA_LIMIT, 0x1000u, 0x1000u, VM_PTE_R, VM_LEVEL_4K) != 0,
+              "upper-half addresses must be rejected");
+  TEST_ASSERT((vm_space_satp(&space) >> 60) == 8u &&
+                  (vm_space_satp(&space) & ((1ull << 44) - 1u)) ==
+                      ((uint64_t)(uintptr_t)space.root >> 12),
+              "satp should select Sv39 and point at the root table");
+  return 0;
+}
+
+static int test_unmap(void) {
+  vm_space_t space;
+  unsigned int flushes;
+
+  setup_table_pool();
+  TEST_ASSERT(vm_space_init(&space) == 0, "space init should succeed");
+  TEST_ASSERT(vm_map(&space, 0x80000000u, 0x80000000u, 0x400000u, VM_PTE_R | VM_PTE_W,
+                     VM_LEVEL_2M) == 0,
+              "megapage map should succeed");
+  TEST_ASSERT(vm_unmap(&space, 0x80000000u, 0x1000u) != 0,
+              "partial unmap of a megapage must fail");
+  TEST_ASSERT(vm_translate(&space, 0x80000000u, (uintptr_t *)0, (unsigned int *)0),
+              "failed unmap should keep the megapage");
+
+  flushes = g_tlb_flushes;
+  TEST_ASSERT(vm_unmap(&space, 0x80200000u, 0x200000u) == 0, "whole megapage unmap should work");
+  TEST_ASSERT(g_tlb_flushes == flushes + 1u, "unmap should flush the TLB");
+  TEST_ASSERT(!vm_translate(&space, 0x80300000u, (uintptr_t *)0, (unsigned int *)0),
+              "unmapped megapage should not translate");
+  TEST_ASSERT(space.leaf_count[VM_LEVEL_2M] == 1u, "leaf count should drop after unmap");
+  TEST_ASSERT(vm_map(&space, 0x80200000u, 0x90000000u, 0x1000u, VM_PTE_R, VM_LEVEL_4K) == 0,
+              "unmapped range should be mappable again");
+  return 0;
+}
+
+static int test_tables_come_from_zero_pool(void) {
+  vm_space_t space;
+  page_zero_stats_t stats;
+  uintptr_t pa;
+
+  setup_table_pool();
+  page_zero_init(2u);
+  TEST_ASSERT(page_zero_idle_work(2u) == 2u, "idle work should fill the pool");
+  TEST_ASSERT(vm_space_init(&space) == 0, "space init should succeed");
+  TEST_ASSERT(vm_map(&space, 0x80000000u, 0x80000000u, 0x1000u, VM_PTE_R, VM_LEVEL_4K) == 0,
+              "4 KiB map should succeed");
+  page_zero_get_stats(&stats);
+  TEST_ASSERT(stats.hits == 2u && stats.misses == 1u && stats.depth == 0u,
+              "root and first table should come from the pool, the last table from a miss");
+  TEST_ASSERT(vm_translate(&space, 0x80000000u, &pa, (unsigned int *)0) && pa == 0x80000000u,
+              "mapping through pooled tables should translate");
+  TEST_ASSERT(!vm_translate(&space, 0x80001000u, (uintptr_t *)0, (unsigned int *)0),
+              "pooled tables must start empty");
+  return 0;
+}
+
+int vm_tests_run(void) {
+  if (test_largest_leaf_selection() != 0) {
+    return 1;
+  }
+  if (test_alignment_limits_leaf_size() != 0) {
+    return 1;
+  }
+  if (test_overlap_and_invalid_requests() != 0) {
+    return 1;
+  }
+  if (test_unmap() != 0) {
+    return 1;
+  }
+  if (test_tables_come_from_zero_pool() != 0) {
+    return 1;
+  }
+
+  printf("sv39 page table unit tests passed\n");
+  return 0;
+}
@@ -1,11 +1,24 @@
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "clock.h"
+#include "klog.h"
 #include "page_alloc.h"
+#include "page_cache.h"
+#include "page_zero.h"
+#include "perf.h"
+#include "profile.h"
 #include "shell_builtins.h"
 #include "shell_builtins_fs.h"
+#include "sched.h"
 #include "shell_parser.h"
+#include "path_state.h"
+#include "slab.h"
+#include "trace.h"
+#include "uart.h"
+#include "vm_kernel.h"
 
 #define TEST_ASSERT(cond, msg)                       \
   do {                                               \
@@ -58,6 +71,221 @@ void line_io_write(const char *s) { test_output_append(s); }
 
 void console_putc(char c) { test_output_append_char(c); }
 
+uint32_t hart_current_id(void) { return 0u; }
+
+uint64_t riscv_timer_now(void) { return 42u; }
+
+uint64_t riscv_irq_save(void) { return 0u; }
+
+void riscv_irq_restore(uint64_t state) { (void)state; }
+
+static bool g_tickless;
+
+void clock_set_tickless(bool enabled) { g_tickless = enabled; }
+
+bool clock_tickless_enabled(void) { return g_tickless; }
+
+uint64_t clock_timebase_hz(void) { return 10u; }
+
+uint64_t clock_now_ns(void) { return 4200u; }
+
+int clock_hart_stats(uint32_t hart_id, clock_hart_stats_t *out) {
+  out->running = hart_id == 0u;
+  out->tickless = g_tickless;
+  out->interrupts = 20u;
+  out->idle_interrupts = g_tickless ? 5u : 0u;
+  out->started_at = 2u;
+  return 0;
+}
+
+int sched_bench_switch_cost(uint32_t yields, sched_switch_bench_t *out) {
+  out->yields = yields;
+  out->switches = (uint64_t)yields * 3u;
+  out->cycles = (uint64_t)yields * 3u * 250u;
+  return 0;
+}
+
+static bool g_trap_fast = true;
+
+void trap_set_fast_path(bool enabled) { g_trap_fast = enabled; }
+
+bool trap_fast_path_enabled(void) { return g_trap_fast; }
+
+bool trap_vectored(void) { return true; }
+
+uint32_t klog_read(klog_record_t *out, uint32_t max) {
+  static const char *const k_text[] = {"SCHED: switch 0 -> 1", "TICK: periodic interrupt"};
+  uint32_t i;
+
+  for (i = 0u; i < 2u && i < max; ++i) {
+    memset(&out[i], 0, sizeof(out[i]));
+    out[i].time_ns = 1000u * (i + 1u);
+    out[i].hart = (uint8_t)i;
+    out[i].level = i == 0u ? KLOG_INFO : KLOG_DEBUG;
+    out[i].len = (uint16_t)strlen(k_text[i]);
+    memcpy(out[i].text, k_text[i], out[i].len);
+  }
+  return i;
+}
+
+static bool g_trace_on;
+
+void trace_set_enabled(bool enabled) { g_trace_on = enabled; }
+
+bool trace_enabled(void) { return g_trace_on; }
+
+void trace_clear(void) {}
+
+uint64_t trace_event_count(void) { return g_trace_on ? 42u : 0u; }
+
+uint64_t trace_lost_count(void) { return 0u; }
+
+void trace_dump(void (*write)(const char *s)) {
+  write("TRACE: begin version=1 harts=4 event_size=40\n");
+  write("TRACE: end events=0 lost=0\n");
+}
+
+static perf_site_t g_perf_sites[2] = {
+    {.name = "page_alloc", .count = 4u, .cycles = 800u, .cycles_min = 90u, .cycles_max = 500u,
+     .instret = 240u, .hist = {[6] = 2u, [7] = 1u, [8] = 1u}, .next = &g_perf_sites[1]},
+    {.name = "idle_site", .cycles_min = ~0ULL},
+};
+static unsigned int g_perf_resets;
+
+const perf_site_t *perf_site_first(void) { return &g_perf_sites[0]; }
+
+uint64_t perf_site_percentile(const perf_site_t *site, uint32_t pct) {
+  (void)site;
+  return pct >= 99u ? 512u : 128u;
+}
+
+void perf_reset(void) { g_perf_resets++; }
+
+static bool g_profile_on;
+
+void profile_start(void) { g_profile_on = true; }
+
+void profile_stop(void) { g_profile_on = false; }
+
+bool profile_running(void) { return g_profile_on; }
+
+int profile_hart_stats(uint32_t hart_id, profile_hart_stats_t *out) {
+  memset(out, 0, sizeof(*out));
+  if (hart_id == 0u) {
+    out->samples = 2048u;
+    out->dropped = 7u;
+  }
+  return 0;
+}
+
+void profile_dump(void (*write)(const char *s)) {
+  write("PROFILE: begin harts=4 per_hart=2048\n");
+  write("PROFILE: end samples=0 dropped=0\n");
+}
+
+int klog_hart_stats(uint32_t hart_id, klog_hart_stats_t *out) {
+  memset(out, 0, sizeof(*out));
+  if (hart_id == 1u) {
+    out->records = 4u;
+    out->dropped = 1u;
+    out->cycles = 720u;
+  }
+  return 0;
+}
+
+static bool g_uart_irq;
+static unsigned int g_uart_resets;
+
+void uart_set_interrupt_mode(bool enabled) { g_uart_irq = enabled; }
+
+bool uart_interrupt_mode(void) { return g_uart_irq; }
+
+void uart_stats_reset(void) { g_uart_resets++; }
+
+void uart_stats(uart_stats_t *out) {
+  memset(out, 0, sizeof(*out));
+  out->tx_bytes = 4000u;
+  out->rx_bytes = 12u;
+  out->interrupts = 260u;
+  out->tx_full_waits = 1u;
+  out->write_cycles = 300000u;
+  out->irq_cycles = 100000u;
+  out->tx_active_ns = 2000000u;
+}
+
+int trap_cycle_stats(uint32_t hart_id, trap_cycle_stats_t *out) {
+  memset(out, 0, sizeof(*out));
+  if (hart_id == 0u) {
+    out->fast_count = 10u;
+    out->fast_cycles = 900u;
+    out->full_count = 4u;
+    out->full_cycles = 1600u;
+  }
+  return 0;
+}
+
+static task_control_block_t g_test_root = {.id = 0u, .name = "boot", .state = TASK_STATE_RUNNING};
+static task_control_block_t g_test_task = {.id = 1u, .name = "worker", .state = TASK_STATE_BLOCKED};
+
+task_control_block_t *task_hart_root(uint32_t hart_id) {
+  return hart_id == 0u ? &g_test_root : (task_control_block_t *)0;
+}
+
+task_control_block_t *task_find(uint32_t task_id) {
+  return task_id == 1u ? &g_test_task : (task_control_block_t *)0;
+}
+
+int sched_hart_stats(uint32_t hart_id, sched_hart_stats_t *out) {
+  memset(out, 0, sizeof(*out));
+  out->online = hart_id == 0u;
+  out->tasks = 1u;
+  out->switches = 9u;
+  return 0;
+}
+
+int sched_task_stats(const task_control_block_t *task, sched_task_stats_t *out) {
+  memset(out, 0, sizeof(*out));
+  out->id = task->id;
+  out->name = task->name;
+  out->state = task->state;
+  out->priority = 16u;
+  out->age_ns = 1000u;
+  out->run_ns = task->id == 0u ? 750u : 250u;
+  out->wait_ns = 40u;
+  out->voluntary_switches = task->id;
+  out->involuntary_switches = 3u;
+  out->wakeups = task->id * 2u;
+  out->wakeup_latency_ns = 60u;
+  out->wakeup_latency_max_ns = 50u;
+  return 0;
+}
+
+uint32_t sched_events_read(uint32_t hart_id, sched_event_t *out, uint32_t max, uint64_t *total) {
+  (void)hart_id;
+  if (max < 2u) {
+    return 0u;
+  }
+  out[0].time_ns = 100u;
+  out[0].type = SCHED_EVENT_WAKE;
+  out[0].task = 1u;
+  out[0].other = 0u;
+  out[1].time_ns = 120u;
+  out[1].type = SCHED_EVENT_SWITCH;
+  out[1].state = TASK_STATE_RUNNABLE;
+  out[1].task = 0u;
+  out[1].other = 1u;
+  *total = 2u;
+  return 2u;
+}
+
+int vm_kernel_tlb_bench(uint32_t passes, vm_tlb_bench_result_t *out) {
+  out->pages = 8192u;
+  out->passes = passes;
+  out->small_ns = 8192u * 30u * passes;
+  out->huge_ns = 8192u * 10u * passes;
+  return 0;
+}
+
 static int test_parser(void) {
   char line[] = " \t  echo   alpha\tbeta  ";
   char *argv[8] = {0};
@@ -80,9 +308,32 @@ static int test_basic_commands(void) {
   uintptr_t alloc_start = align_up_page((uintptr_t)&alloc_region[0] + 13u);
   uintptr_t alloc_end = alloc_start + (2u * (uintptr_t)PAGE_ALLOC_PAGE_SIZE);
   char *argv_meminfo[] = {"meminfo", NULL};
+  char *argv_tlbbench[] = {"tlbbench", "2", NULL};
+  char *argv_ctxbench[] = {"ctxbench", "10", NULL};
+  char *argv_lockstat[] = {"lockstat", NULL};
+  char *argv_clockstat[] = {"clockstat", "tickless", "on", NULL};
+  char *argv_top[] = {"top", NULL};
+  char *argv_trapstat[] = {"trapstat", "fast", "off", NULL};
+  char *argv_uartstat[] = {"uartstat", "irq", "on", NULL};
+  char *argv_dmesg[] = {"dmesg", NULL};
+  char *argv_dmesg_stats[] = {"dmesg", "stats", NULL};
+  char *argv_tracing_on[] = {"trace", "on", NULL};
+  char *argv_tracing_dump[] = {"trace", "dump", NULL};
+  char *argv_profile_start[] = {"profile", "start", NULL};
+  char *argv_profile_dump[] = {"profile", "dump", NULL};
+  char *argv_perfstat_hist[] = {"perfstat", "hist", NULL};
+  char *argv_perfstat_reset[] = {"perfstat", "reset", NULL};
+  char *argv_schedstat[] = {"schedstat", "events", NULL};
+  char *argv_meminfo_verbose[] = {"meminfo", "-v", NULL};
+  char *argv_pagemap[] = {"pagemap", NULL};
+  char *argv_trace_on[] = {"pagemap", "trace", "on", NULL};
+  char *argv_trace_off[] = {"pagemap", "trace", "off", NULL};
+  char *argv_trace_dump[] = {"pagemap", "trace", NULL};
+  void *traced_page;
   int rc;
 
   page_alloc_init(alloc_start, alloc_end);
+  page_zero_init(1u);
   shell_builtins_fs_init();
 
   test_output_reset();
@@ -111,6 +362,177 @@ static int test_basic_commands(void) {
   TEST_ASSERT(strstr(g_output, " page_size=4096") != NULL, "meminfo page size missing");
   TEST_ASSERT(strstr(g_output, " total_pages=2") != NULL, "meminfo total page count mismatch");
   TEST_ASSERT(strstr(g_output, " free_pages=2") != NULL, "meminfo free page count mismatch");
+  TEST_ASSERT(strstr(g_output, "meminfo: pcp") == NULL,
+              "meminfo should omit idle per-hart caches");
+  TEST_ASSERT(strstr(g_output, "meminfo: zero_pool depth=0/1 hits=0 misses=0 hit_rate=0%\n") !=
+                  NULL,
+              "meminfo zero pool line mismatch");
+
+  page_cache_init();
+  TEST_ASSERT(page_zero_idle_work(1u) == 1u, "idle zeroing should fill the pool");
+  TEST_ASSERT(page_free(page_alloc_zeroed()), "zeroed page round trip should succeed");
+  TEST_ASSERT(page_cache_free(page_cache_alloc()), "page cache round trip should succeed");
+  test_output_reset();
+  rc = shell_execute_builtin(1, argv_meminfo);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "meminfo should execute successfully");
+  TEST_ASSERT(strstr(g_output, " cached_pages=2") != NULL, "meminfo cached page count mismatch");
+  TEST_ASSERT(strstr(g_output, "meminfo: pcp hart=0 cached=2 alloc_hits=1 free_hits=2 "
+                               "refills=1 drains=0\n") != NULL,
+              "meminfo per-hart cache line mismatch");
+  TEST_ASSERT(strstr(g_output, "meminfo: zero_pool depth=0/1 hits=1 misses=0 hit_rate=100%\n") !=
+                  NULL,
+              "meminfo zero pool hit rate mismatch");
+
+  test_output_reset();
+  rc = shell_execute_builtin(1, argv_meminfo);
+  TEST_ASSERT(strstr(g_output, "pagemap:") == NULL, "plain meminfo should omit the pagemap");
+  test_output_reset();
+  rc = shell_execute_builtin(2, argv_meminfo_verbose);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "meminfo -v should execute successfully");
+  TEST_ASSERT(strstr(g_output, "meminfo: range=0x") != NULL, "meminfo -v should keep summary");
+  TEST_ASSERT(strstr(g_output, "pagemap: free_pages=") != NULL, "meminfo -v should add pagemap");
+
+  page_cache_drain_hart(0u);
+  test_output_reset();
+  rc = shell_execute_builtin(3, argv_trace_on);
+  TEST_ASSERT(rc == SHELL_EXEC_OK && page_alloc_trace_enabled(), "trace on should enable");
+  traced_page = page_alloc_order(0u);
+  TEST_ASSERT(traced_page != NULL, "traced allocation should succeed");
+  test_output_reset();
+  rc = shell_execute_builtin(1, argv_pagemap);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "pagemap should execute successfully");
+  TEST_ASSERT(strstr(g_output, "pagemap: trace=on records=1 untracked_pages=0\n") != NULL,
+              "pagemap trace summary mismatch");
+  TEST_ASSERT(strstr(g_output, "pagemap: site 0x") != NULL &&
+                  strstr(g_output, " allocs=1 pages=1 freed=0\n") != NULL,
+              "pagemap call site line mismatch");
+  TEST_ASSERT(strstr(g_output, "pagemap: run_hist") != NULL, "pagemap histogram missing");
+  test_output_reset();
+  rc = shell_execute_builtin(2, argv_trace_dump);
+  TEST_ASSERT(strstr(g_output, "pagemap: t_ns=4200 alloc 0x") != NULL &&
+                  strstr(g_output, " order=0 caller=0x") != NULL,
+              "pagemap trace dump mismatch");
+  rc = shell_execute_builtin(3, argv_trace_off);
+  TEST_ASSERT(rc == SHELL_EXEC_OK && !page_alloc_trace_enabled(), "trace off should disable");
+  TEST_ASSERT(page_free(traced_page), "traced page free should succeed");
+
+  test_output_reset();
+  rc = shell_execute_builtin(2, argv_tlbbench);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "tlbbench should execute successfully");
+  TEST_ASSERT(strcmp(g_output, "tlbbench: pages=8192 passes=2 4k_ns=491520 2m_ns=163840 "
+                               "4k_ps_per_access=30000 "
+                               "2m_ps_per_access=10000\n") == 0,
+              "tlbbench output mismatch");
+
+  test_output_reset();
+  rc = shell_execute_builtin(2, argv_ctxbench);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "ctxbench should execute successfully");
+  TEST_ASSERT(strcmp(g_output, "ctxbench: yields=10 switches=30 cycles=7500 "
+                               "cycles_per_switch=250\n") == 0,
+              "ctxbench output mismatch");
+
+  test_output_reset();
+  rc = shell_execute_builtin(1, argv_lockstat);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "lockstat should execute successfully");
+  TEST_ASSERT(strstr(g_output, "lockstat: page_alloc acquisitions=") != NULL,
+              "lockstat should list the page allocator lock");
+  TEST_ASSERT(strstr(g_output, " contended=0 spins=0 hold_avg_ns=0 hold_max_ns=0\n") != NULL,
+              "single-threaded lock stats should show no contention");
+
+  test_output_reset();
+  rc = shell_execute_builtin(3, argv_clockstat);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "clockstat should execute successfully");
+  TEST_ASSERT(strcmp(g_output, "clockstat: tickless=on timebase_hz=10\n"
+                               "clockstat: hart0 mode=tickless interrupts=20 idle=5 per_sec=5\n") == 0,
+              "clockstat output mismatch");
+
+  test_output_reset();
+  rc = shell_execute_builtin(3, argv_trapstat);
+  TEST_ASSERT(rc == SHELL_EXEC_OK && !g_trap_fast, "trapstat fast off should disable");
+  TEST_ASSERT(strcmp(g_output, "trapstat: fast_path=off stvec=vectored\n"
+                               "trapstat: hart0 fast=10 fast_avg_cycles=90 full=4 "
+                               "full_avg_cycles=400\n") == 0,
+              "trapstat output mismatch");
+
+  test_output_reset();
+  rc = shell_execute_builtin(3, argv_uartstat);
+  TEST_ASSERT(rc == SHELL_EXEC_OK && g_uart_irq && g_uart_resets == 1u,
+              "uartstat irq on should switch modes and reset the counters");
+  TEST_ASSERT(strcmp(g_output, "uartstat: mode=irq tx_bytes=4000 rx_bytes=12 rx_dropped=0 "
+                               "irqs=260 full_waits=1\n"
+                               "uartstat: cpu_cycles=400000 cycles_per_byte=100 "
+                               "tx_active_ns=2000000 tx_bytes_per_s=2000000\n") == 0,
+              "uartstat output mismatch");
+
+  test_output_reset();
+  rc = shell_execute_builtin(1, argv_dmesg);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "dmesg should execute successfully");
+  TEST_ASSERT(strcmp(g_output, "dmesg: t_ns=1000 hart0 info SCHED: switch 0 -> 1\n"
+                               "dmesg: t_ns=2000 hart1 debug TICK: periodic interrupt\n") == 0,
+              "dmesg output mismatch");
+
+  test_output_reset();
+  rc = shell_execute_builtin(2, argv_dmesg_stats);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "dmesg stats should execute successfully");
+  TEST_ASSERT(strcmp(g_output, "dmesg: hart1 records=4 dropped=1 avg_cycles=180\n") == 0,
+              "dmesg stats output mismatch");
+
+  test_output_reset();
+  rc = shell_execute_builtin(2, argv_tracing_on);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "trace on should execute successfully");
+  TEST_ASSERT(strcmp(g_output, "trace: on events=42 lost=0\n") == 0, "trace status mismatch");
+
+  test_output_reset();
+  rc = shell_execute_builtin(2, argv_tracing_dump);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "trace dump should execute successfully");
+  TEST_ASSERT(strcmp(g_output, "TRACE: begin version=1 harts=4 event_size=40\n"
+                               "TRACE: end events=0 lost=0\n") == 0,
+              "trace dump output mismatch");
+
+  test_output_reset();
+  rc = shell_execute_builtin(2, argv_profile_start);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "profile start should execute successfully");
+  TEST_ASSERT(strcmp(g_output, "profile: running\nprofile: hart0 samples=2048 dropped=7\n") == 0,
+              "profile status mismatch");
+
+  test_output_reset();
+  rc = shell_execute_builtin(2, argv_profile_dump);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "profile dump should execute successfully");
+  TEST_ASSERT(strcmp(g_output, "PROFILE: begin harts=4 per_hart=2048\n"
+                               "PROFILE: end samples=0 dropped=0\n") == 0,
+              "profile dump output mismatch");
+
+  test_output_reset();
+  rc = shell_execute_builtin(2, argv_perfstat_hist);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "perfstat should execute successfully");
+  TEST_ASSERT(strcmp(g_output, "perfstat: page_alloc calls=4 min=90 avg=200 max=500 p50<128 "
+                               "p99<512 instret_avg=60\n"
+                               "perfstat:   hist 2^6=2 2^7=1 2^8=1\n") == 0,
+              "perfstat output mismatch");
+
+  test_output_reset();
+  rc = shell_execute_builtin(2, argv_perfstat_reset);
+  TEST_ASSERT(rc == SHELL_EXEC_OK && g_perf_resets == 1u && g_output[0] == '\0',
+              "perfstat reset should clear the sites quietly");
+
+  test_output_reset();
+  rc = shell_execute_builtin(1, argv_top);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "top should execute successfully");
+  TEST_ASSERT(strcmp(g_output,
+                     "top: id=0 name=boot hart=0 state=running prio=16 cpu_pct=75 run_ns=750 "
+                     "wait_ns=40 vcsw=0 ivcsw=3 wake_avg_ns=0 wake_max_ns=50\n"
+                     "top: id=1 name=worker hart=0 state=blocked prio=16 cpu_pct=25 run_ns=250 "
+                     "wait_ns=40 vcsw=1 ivcsw=3 wake_avg_ns=30 wake_max_ns=50\n") == 0,
+              "top output mismatch");
+
+  test_output_reset();
+  rc = shell_execute_builtin(2, argv_schedstat);
+  TEST_ASSERT(rc == SHELL_EXEC_OK, "schedstat should execute successfully");
+  TEST_ASSERT(strcmp(g_output,
+                     "schedstat: hart0 tasks=1 ready=0 switches=9 steals=0 stolen=0 events=2\n"
+                     "schedstat: hart0 t_ns=100 wake 1 by hart0\n"
+                     "schedstat: hart0 t_ns=120 switch 0->1 prev=runnable\n") == 0,
+              "schedstat output mismatch");
 
   rc = shell_execute_builtin(1, argv_unknown);
   TEST_ASSERT(rc == SHELL_EXEC_NOT_FOUND, "unknown command should be reported as not found");
@@ -126,6 +548,7 @@ static int test_shell_fs_commands(void) {
   char *argv_cd_projects[] = {"cd", "projects", NULL};
   char *argv_mkdir_notes[] = {"mkdir", "notes", NULL};
   char *argv_cd_missing[] = {"cd", "/missing", NULL};
+  char *argv_cat_note[] = {"cat", "/tmp/note.txt", NULL};
   int rc;
 
   shell_builtins_fs_init();
@@ -179,6 +602,19 @@ static int test_shell_fs_commands(void) {
   TEST_ASSERT(strcmp(g_output, "cd: no such directory\n") == 0,
               "cd missing should emit deterministic error");
 
+  kmalloc_init();
+  TEST_ASSERT(path_state_write_file("/tmp/note.txt", "hi\n", 3u, 0) == 0,
+              "writing a dynamic file should succeed");
+  TEST_ASSERT(kmalloc_cache(5u)->active_objects == 1u,
+              "dynamic file contents should come from kmalloc-512");
+  test_output_reset();
+  rc = shell_execute_builtin(2, argv_cat_note);
+  TEST_ASSERT(rc == SHELL_EXEC_OK && strcmp(g_output, "hi\n") == 0,
+              "cat should print the dynamic file");
+  path_state_init();
+  TEST_ASSERT(kmalloc_cache(5u)->active_objects == 0u,
+              "resetting the shell fs should kfree dynamic file contents");
+
   return 0;
 }
 